@@ -47,6 +47,17 @@
 /*********************************************************************/
 #define HARDWARE_SPI
 
+/*********************************************************************/
+// ENABLE_SPI_BURST uses the enhanced buffer mode of the SPI (8 byte
+// FIFOs): the transceiver driver queues bytes with SPIStart and 
+// collects them with SPIWait, so it works while they are shifted
+/*********************************************************************/
+#define ENABLE_SPI_BURST
+
+#if defined(ENABLE_SPI_BURST) && !defined(HARDWARE_SPI)
+    #error "ENABLE_SPI_BURST requires HARDWARE_SPI"
+#endif
+
 //------------------------------------------------------------------------
 // Definition of Protocol Stack. ONLY ONE PROTOCOL STACK CAN BE CHOSEN
 //------------------------------------------------------------------------
@@ -125,6 +136,15 @@
 /*********************************************************************/
 //#define ENABLE_NETWORK_FREEZER 
 
+/*********************************************************************/
+// ENABLE_FAST_REJOIN lets the application keep the network state of
+// the node (MiApp_GetNetworkState) and operate in the network again 
+// without a scan after a wakeup (MiApp_ResumeNetwork). It keeps only
+// what the network freezer would restore, and the application decides
+// where to keep it - the network freezer hooks need an NVM driver
+/*********************************************************************/
+#define ENABLE_FAST_REJOIN
+
 /*********************************************************************/
 // MY_ADDRESS_LENGTH defines the size of wireless node permanent 
 // address in byte. This definition is not valid for IEEE 802.15.4
@@ -221,6 +241,16 @@
 /*********************************************************************/
 //#define ENABLE_SLEEP
 
+/*********************************************************************/
+// ENABLE_LOW_POWER_LISTEN lets an idle node doze: the MCU and the RF
+// transceiver sleep, and the wake-up timer of the transceiver wakes
+// them every LPL_INTERVAL_MS to listen for a short while (see TxRx.h).
+// LPL_INTERVAL_MS bounds the added latency of a command to the node,
+// and sets its duty cycle; the wake-up timer allows up to 4200 ms
+/*********************************************************************/
+#define ENABLE_LOW_POWER_LISTEN
+#define LPL_INTERVAL_MS             1000
+
 /*********************************************************************/
 // ENABLE_ED_SCAN will enable the device to do an energy detection scan
 // to find out the channel with least noise and operate on that channel
@@ -241,6 +271,16 @@
 /*********************************************************************/
 //#define ENABLE_SECURITY 
 
+/*********************************************************************/
+// ENABLE_TXRX_SECURITY will enable the TxRx layer to encrypt and 
+// authenticate each data block as a whole (XTEA-128 CCM), rather than
+// each MiWi frame as ENABLE_SECURITY does (see TxRx.h). It changes the
+// data blocks on the air, and needs a provisioned key - the plug and
+// all the stones must be built alike, see "TxRx block security" in 
+// WistoneAPI_boaz.txt
+/*********************************************************************/
+//#define ENABLE_TXRX_SECURITY
+
 /*********************************************************************/
 // ENABLE_INDIRECT_MESSAGE will enable the device to store the packets
 // for the sleeping devices temporarily until they wake up and ask for
@@ -270,6 +310,15 @@
 /*********************************************************************/
 #define ENABLE_FREQUENCY_AGILITY
 
+/*********************************************************************/
+// ENABLE_CHANNEL_MAP will enable the TxRx layer to keep the quality 
+// of each channel in the EEPROM, to start the network on the best 
+// known channel, and to move the network to another channel when the
+// frame error rate is high (see TxRx.h). It requires 
+// ENABLE_FREQUENCY_AGILITY
+/*********************************************************************/
+#define ENABLE_CHANNEL_MAP
+
 
 // Constants Validation
     
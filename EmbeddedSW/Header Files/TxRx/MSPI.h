@@ -60,6 +60,9 @@
 void SPIPut(BYTE v);
 BYTE SPIGet(void);
 
+void SPIStart(BYTE v);
+BYTE SPIWait(void);
+
 void SPIPut2(BYTE v);
 BYTE SPIGet2(void);
 
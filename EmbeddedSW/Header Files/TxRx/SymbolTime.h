@@ -184,6 +184,10 @@
 #define ONE_MINUTE          (ONE_SECOND*60)
 #define ONE_HOUR            (ONE_MINUTE*60)
 
+// The Wistone core runs at 32MHz from the PLL (Fcy = 16MHz, see _CONFIG2 in wistone_main.c), whereas the
+// timeouts above assume CLOCK_FREQ; where the real time of a tick matters (time stamps), use SYMBOL_TIMER_FREQ:
+#define SYMBOL_TIMER_FREQ   (16000000 / CLOCK_DIVIDER)
+
 #define MiWi_TickGetDiff(a,b) (a.Val - b.Val)
 
 /************************ DATA TYPES *******************************/
@@ -75,9 +75,12 @@ void Delay10us( UINT32 tenMicroSecondCounter );
     None
 
   Remarks:
-    None
+    DelayMsHook, if the application set it, is called with ms first.
   ***************************************************************************/
 void DelayMs( UINT16 ms );
 
+// an application hook, told of each DelayMs (NULL - none); it may be called from an ISR:
+extern void (*DelayMsHook)( UINT16 ms );
+
 void Delay1us( UINT32 oneMicroSecondCounter );
 
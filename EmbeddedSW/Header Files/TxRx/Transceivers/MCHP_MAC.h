@@ -155,6 +155,7 @@
             BOOL        altSourceAddress;               // Source address is the alternative network address
             WORD_VAL    SourcePANID;                    // PAN ID of the sender
         // YL 26.8 #endif
+        DWORD       SofTick;                            // symbol timer tick at the start of the frame (see TxPacket of the transceiver)
     } MAC_RECEIVED_PACKET;
         
     /***************************************************************************
@@ -133,6 +133,15 @@
 	#define ENABLE_RETRANSMISSION
 	//#endif
 
+    /*********************************************************************/
+    // ENABLE_LINK_RATE_ADAPTATION lets the TxRx layer re-tune the data
+    // rate of each plug-stone link at runtime (9600...115200, BAND_434
+    // only), in the TDMA upload slot of the stone. The DATA_RATE_xxx 
+    // defined above remains the base rate, which is used for joining the
+    // network, outside the upload slots and as the fallback of every link.
+    /*********************************************************************/
+	#define ENABLE_LINK_RATE_ADAPTATION
+
 
     /*********************************************************************/
     // INFER_DEST_ADDRESS enables inferred destination address mode, which
@@ -208,7 +217,10 @@
     
     /*********************************************************************/
     // BANK_SIZE defines the number of packet can be received and stored
-    // to wait for handling in MiMAC layer.
+    // to wait for handling in MiMAC layer. The banks are a pool of frames:
+    // the RX interrupt fills a free frame, and the frame returns to the 
+    // pool when the last user releases it (MiMAC_DiscardPacket, 
+    // MiMAC_ReleasePacket). RAM: BANK_SIZE * (RX_PACKET_SIZE + 7) bytes.
     /*********************************************************************/
 	#if defined (COMMUNICATION_PLUG)
     	#define BANK_SIZE               9
@@ -324,4 +336,8 @@
     #endif
     #undef DATA_RATE_DEFINED
 
+    #if defined(ENABLE_LINK_RATE_ADAPTATION) && (!defined(BAND_434) || defined(DATA_RATE_1200))
+        #error "Link rate adaptation is supported only at BAND_434 with base data rate of 9600 and above"
+    #endif
+
 #endif
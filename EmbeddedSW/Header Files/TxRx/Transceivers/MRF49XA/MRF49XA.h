@@ -344,6 +344,7 @@
         #define         GENCREG                 (0x8000|FREQ_BAND|XTAL_LD_CAP)
         #define         PMCREG                  0x8209	// ABYS: 0x8201 => 0x8259 Enabling always the OSC and SYNTHEIZER //MC #define PMCREG 0x8201 // TODO - YL should be 0x8259 instead?
         #define         FIFORSTREG              0xCA81
+        #define         WTSREG                  0xE000
         #define         AFCCREG                 0xC4B7
         #define         BBFCREG                 0xC2AC
     
@@ -367,7 +368,7 @@
             #define TX_PACKET_SIZE (TX_BUFFER_SIZE+PROTOCOL_HEADER_SIZE+BLOCK_SIZE+MY_ADDRESS_LENGTH+MY_ADDRESS_LENGTH+10)	
             #define RX_PACKET_SIZE (RX_BUFFER_SIZE+PROTOCOL_HEADER_SIZE+MY_ADDRESS_LENGTH+MY_ADDRESS_LENGTH+BLOCK_SIZE+10)
         #else
-            #define TX_PACKET_SIZE  (TX_BUFFER_SIZE+PROTOCOL_HEADER_SIZE+MY_ADDRESS_LENGTH+MY_ADDRESS_LENGTH+5)	// YL 60 + 11 + 2 + 2 + 5 = 80
+            #define TX_PACKET_SIZE  (MY_ADDRESS_LENGTH+MY_ADDRESS_LENGTH+5)	// the MAC header only - the payload is sent from the buffer of the caller (MACTxFrame)
             #define RX_PACKET_SIZE  (RX_BUFFER_SIZE+PROTOCOL_HEADER_SIZE+MY_ADDRESS_LENGTH+MY_ADDRESS_LENGTH+5) // YL 60 + 11 + 2 + 2 + 5 = 80
         #endif
     
@@ -392,15 +393,20 @@
                 BYTE    Val;
                 struct
                 {
-                    BYTE    Valid       :1;
                     BYTE    RSSI        :1;
                     BYTE    DQD         :1;
                 } bits;
             } flags; 
             BYTE        Payload[RX_PACKET_SIZE];
             BYTE        PayloadLen;
+            BYTE        RefCount;       // the users of the frame (0 - free); the RX interrupt hands the frame over with 1
+            DWORD       SofTick;        // symbol timer tick when the length byte arrived
         } RX_PACKET;
         
+        // the frames wait for MiMAC_ReceivedPacket in the order they were received;
+        // the RX interrupt is the only writer of the tail, MiMAC_ReceivedPacket of the head
+        #define RX_QUEUE_SIZE       (BANK_SIZE + 1)
+        
         typedef struct
         {
             BOOL        Valid;
@@ -433,5 +439,87 @@
         
       
         extern volatile TRANSCEIVER_STATUS   TransceiverStatus;
+
+        // link statistics, counted by TxPacket and by the RX interrupt;
+        // the counters are free running - users take differences of snapshots
+        typedef struct
+        {
+            WORD    txFrames;           // frames sent by TxPacket (including MAC acknowledgements)
+            WORD    txRetries;          // retransmissions because the MAC acknowledgement did not arrive in time
+            WORD    txFailures;         // frames given up after RETRANSMISSION_TIMES tries or CCA failure
+            WORD    rxFrames;           // frames received with a valid CRC
+            WORD    rxCrcErrors;        // frames dropped because of CRC mismatch
+            WORD    rxDqdLost;          // frames dropped because DQD was low at the end of the frame
+            WORD    rxRssiHigh;         // valid frames received above RSSI_THRESHOLD
+            WORD    rxPoolFull;         // frames dropped because all the frames of the pool were in use (BANK_SIZE)
+            WORD    rxBadLength;        // frames dropped because of an invalid length byte
+            WORD    rxTimeouts;         // frames dropped because the FIFO stopped filling in the middle of the frame
+            WORD    rxNotForMe;         // frames dropped because of another destination address
+            WORD    rxDuplicates;       // retransmitted frames that were already received (ENABLE_RETRANSMISSION)
+        } LINK_STATS;
+
+        extern volatile LINK_STATS          MACLinkStats;
+        
+        // an application hook, called by the transceiver interrupt (NULL - none); it must be short,
+        // as it runs in the interrupt:
+        extern void (*MRF49XA_IsrHook)(void);
+        
+        /************************************************************************************
+         * Function:
+         *      BYTE MiMAC_RetainPacket(void)
+         *      void MiMAC_ReleasePacket(BYTE frame)
+         *
+         * Summary:
+         *      These functions keep the current received frame after MiMAC_DiscardPacket
+         *
+         * Description:        
+         *      MiMAC_RetainPacket adds a user to the frame of the current packet, and returns
+         *      its handle. The payload stays in place until the handle is released by 
+         *      MiMAC_ReleasePacket, while the MAC layer receives the next packets into the 
+         *      other frames of the pool.
+         *
+         *****************************************************************************************/ 
+        BYTE MiMAC_RetainPacket(void);
+        void MiMAC_ReleasePacket(BYTE frame);
+
+        #if defined(ENABLE_LOW_POWER_LISTEN)
+            // the transceiver sleeps but for its wake-up timer, which interrupts after 
+            // 1.03 * M * 2^R ms: R = 4 and M is computed from LPL_INTERVAL_MS
+            #define POWER_STATE_WAKE_TIMER  0x01
+            #define WAKE_TIMER_R            4
+            #define WAKE_TIMER_M            ((LPL_INTERVAL_MS * 100L) / (103L * 16))
+            #if (WAKE_TIMER_M < 1) || (WAKE_TIMER_M > 255)
+                #error "LPL_INTERVAL_MS must be between 17 and 4200"
+            #endif
+        #endif
+
+        #if defined(ENABLE_LINK_RATE_ADAPTATION)
+            // runtime data rates of the 434MHz band, slowest first
+            typedef enum
+            {
+                LINK_RATE_9600 = 0,
+                LINK_RATE_19200,
+                LINK_RATE_38400,
+                LINK_RATE_57600,
+                LINK_RATE_115200,
+                LINK_RATE_NUM
+            } LINK_RATE;
+
+            #if defined(DATA_RATE_9600)
+                #define BASE_LINK_RATE      LINK_RATE_9600
+            #elif defined(DATA_RATE_19200)
+                #define BASE_LINK_RATE      LINK_RATE_19200
+            #elif defined(DATA_RATE_38400)
+                #define BASE_LINK_RATE      LINK_RATE_38400
+            #elif defined(DATA_RATE_57600)
+                #define BASE_LINK_RATE      LINK_RATE_57600
+            #else
+                #define BASE_LINK_RATE      LINK_RATE_115200
+            #endif
+
+            extern BYTE currentLinkRate;
+
+            BOOL MiMAC_SetDataRate(BYTE rate);
+        #endif
     #endif
 #endif
@@ -52,10 +52,19 @@
 
     #if defined(SOFTWARE_SECURITY)
     
-        //#define XTEA_128
-        #define XTEA_64
+        #define XTEA_128                // the standard XTEA: 64-bit block, 128-bit key
+        //#define XTEA_64
         
         #define XTEA_ROUND  32
+        #if defined(XTEA_128)
+            #define XTEA_DELTA  0x9E3779B9L
+        #else
+            #define XTEA_DELTA  0x9E37
+        #endif
+        
+        #if (XTEA_ROUND % 4) != 0
+            #error "XTEA_Encode runs 4 rounds per loop"
+        #endif
 
         #define SEC_LEVEL_CTR           0
         #define SEC_LEVEL_CBC_MAC_16    1
@@ -69,10 +78,12 @@
             #define BLOCK_SIZE 8
             #define BLOCK_UNIT DWORD
             #define KEY_SIZE 16
+            #define XTEA_SCHEDULE_SIZE  (2 * XTEA_ROUND)    // the round keys (sum + key word) of the half rounds
         #elif defined(XTEA_64)
             #define BLOCK_SIZE 4
             #define BLOCK_UNIT WORD
             #define KEY_SIZE 8
+            #define XTEA_SCHEDULE_SIZE  (2 * XTEA_ROUND)    // the round keys (sum + key word) of the half rounds
         #endif
         
         #if SECURITY_LEVEL == SEC_LEVEL_CTR
@@ -91,6 +102,14 @@
             #define SEC_MIC_LEN     8
         #endif
         
+        // CCM of a whole block (CCM_SealBlock/CCM_OpenBlock): the counter block is 
+        // [nonce, counter byte] - counter CCM_CTR_MIC encrypts the MIC, and the 
+        // cipher blocks of the text take the counters from CCM_CTR_DATA up
+        #define CCM_NONCE_LEN       (BLOCK_SIZE - 1)
+        #define CCM_BLOCK_MIC_LEN   BLOCK_SIZE
+        #define CCM_CTR_MIC         1
+        #define CCM_CTR_DATA        2
+        #define CCM_BLOCK_MAX_LEN   (BLOCK_SIZE * (256 - CCM_CTR_DATA))
         
         extern ROM const unsigned char mySecurityKey[];
 
@@ -98,6 +117,13 @@
         void CBC_MAC(BYTE *text, BYTE len, BYTE *key, BYTE *MIC);
         void CCM_Enc(BYTE *text, BYTE headerLen, BYTE payloadLen, BYTE *key);
         BOOL CCM_Dec(BYTE *text, BYTE headerLen, BYTE payloadLen, BYTE *key);
+        
+        #if defined(XTEA_128) || defined(XTEA_64)
+            void XTEA_Schedule(BLOCK_UNIT *key, BLOCK_UNIT *schedule);
+            void XTEA_Encode(BLOCK_UNIT *text, BLOCK_UNIT *schedule);
+            WORD CCM_SealBlock(BYTE *dest, BYTE *text, WORD len, BYTE *nonce, BLOCK_UNIT *schedule);
+            BOOL CCM_OpenBlock(BYTE *text, WORD len, BYTE *nonce, BLOCK_UNIT *schedule);
+        #endif
     
     #endif
 
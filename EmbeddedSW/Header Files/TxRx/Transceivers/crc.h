@@ -56,5 +56,18 @@
         #define CRC_LOOKUP_TABLE //YL 13.4(BM) - use CRC LUT
         WORD CRC16(BYTE *ptr, signed char count, WORD initCRC);
         
+        // CRC16_BYTE adds a single byte to a running CRC. It is used where the 
+        // bytes pass one at a time anyway (the SPI loops of the transceiver), so
+        // the CRC is ready when the last byte is. 
+        // Since no final XOR is used, the CRC of the data followed by its own 
+        // (big endian) CRC is 0 - the receiver does not need to single out the CRC bytes.
+        #if defined(CRC_LOOKUP_TABLE)
+            extern const ROM unsigned int CRC16Table[256];
+            #define CRC16_BYTE(crc, b)	((WORD)(((crc) << 8) ^ CRC16Table[(BYTE)((crc) >> 8) ^ (BYTE)(b)]))
+        #else
+            WORD CRC16Byte(WORD crc, BYTE b);
+            #define CRC16_BYTE(crc, b)	CRC16Byte((crc), (b))
+        #endif
+        
     #endif
 #endif
@@ -30,19 +30,21 @@
 #define __TX_RX_H_
 
 #include "wistone_main.h"
+#include "ConfigApp.h"		// the MiWi feature flags that the prototypes below depend on
 /************************ VARIABLES ********************************/
 #define SCAN_SPEED 					10
 #define TXRX_HEADER_SIZE 			3
-#define TXRX_TRAILER_SIZE 			4
 
 #define RESYNC_THRESHOLD 			3 	// YS 5.10 number of failed TXRX actions before a resync/reset occurs
 
-#define MAX_NWK_SIZE				3				// the number of devices in the network (including the plug) 
+#define MAX_NWK_SIZE				33				// the max number of devices in the network (including the plug) - the size of the plug's stone table 
 #define INIT_NWK_SIZE				2				// every network must contain the plug and the network-starter 
 
 #define MAX_ACK_LENGTH				60  			// 60 bits
-#define MAX_NWK_ADDR_EUI0			MAX_NWK_SIZE 	// the max address of a device in the network
-#define PLUG_NWK_ADDR_EUI0			MAX_NWK_SIZE	// the EUI0 network address of the plug (the plug has the highest EUI[0])
+#define MAX_NWK_ADDR_EUI0			63			 	// the max address of a device in the network (the addresses need not be contiguous)
+#define MAX_STONE_ADDR_EUI0			(MAX_NWK_ADDR_EUI0 - 1)	// the max address of a stone (as programmed in its EEPROM)
+#define PLUG_NWK_ADDR_EUI0			MAX_NWK_ADDR_EUI0	// the EUI0 network address of the plug - above the stones, so no stone can take it (TxRx_Init sets it, the EEPROM of the plug is not read)
+#define PLUG_OLD_NWK_ADDR_EUI0		3				// the plug address before it moved above the stones - still accepted for "reconnect" (parser.c)
 #define PLUG_NWK_ADDR_EUI1			EUI_1			// the EUI1 network address of the plug (constant)
 #define NWK_STARTER_ADDR_EUI0		1				// the network address of the stone that calls MiApp_StartConnection
 #define BROADCAST_NWK_ADDR			0				// the network address for broadcast command
@@ -50,12 +52,71 @@
 #define MSG_INF_LENGTH				1   // 1 byte with ack and type information of the message
 #define MSG_LEN_LENGTH				2   // 2 bytes with the length of the message
 #define MSG_PHS_LENGTH				2	// 2 bytes with the phase of the message
+#define MSG_ACK_LENGTH				1	// 1 byte with the piggybacked ack of the message (ENABLE_CUMULATIVE_ACK)
+#define MSG_SRC_LENGTH				1	// 1 byte with EUI_0 of the source of the message (ENABLE_COMPACT_HEADER)
+
+#define TXRX_RX_BLOCKS				4	// the plug receives blocks from up to 4 stones at the same time
+
+// The plug queues the commands from the host (see TxRx_QueueCommand), and reports each one as "CMD#<tag> ...: QUEUED",
+// and then "DELIVERED" (acked by the stone; its reply follows), "DONE" (broadcast) or "FAILED - <error>". Each reply of a stone
+// is written as "CMD#<tag> STONE eui0# <eui0>: <reply>", with the tag of the last command sent to the stone:
+#define CMD_QUEUE_SIZE				10
+#define CMD_RETRIES					5		// failed attempts before the command is reported failed,
+#define CMD_TIMEOUT					(10 * ONE_SECOND)			// or the time since the first attempt
+#define CMD_RETRY_BACKOFF			(500 * ONE_MILI_SECOND)		// between the attempts to deliver a command
+#define CMD_ACK_TIMEOUT				TIMEOUT_RECEIVING_MESSAGE	// an attempt fails if the stone does not ack the command in time
+#define CMD_MEMBER_GAP				(100 * ONE_MILI_SECOND)		// between the deliveries of a broadcast command to the stones
 
 // If TxRx ack is preferable, define the following:
 //#if !defined DEBUG_PRINT // YL 25.12 remove later!
 #define ENABLE_TXRX_ACK
 //#endif
 
+// If the stone should keep sending data blocks while their acks are on the way (the plug acks several blocks at once, 
+// or in the header of a block it sends to the stone anyway), define the following:
+#define ENABLE_CUMULATIVE_ACK
+
+#if defined ENABLE_CUMULATIVE_ACK && !defined ENABLE_TXRX_ACK
+	#error "ENABLE_CUMULATIVE_ACK requires ENABLE_TXRX_ACK"
+#endif
+
+// If the TxRx header should rely on the MiWi addressing (see the compact header below), define the following:
+// (it changes the frames on the air - the plug and all the stones must be built alike, see "TxRx header" in WistoneAPI_boaz.txt)
+//#define ENABLE_COMPACT_HEADER
+
+// The header of a block is [info, source (2 bytes), destination (2 bytes), length (2 bytes, MSB first)], followed by the
+// block and a constant trailer. The compact header is [info, EUI_0 of the source, length] - MiWi delivers the message
+// to the address of the destination, and EUI_1 is constant - where the length takes 7 bits per byte, LSB first, and the MSB
+// of a byte indicates that another byte follows (a command takes 1 byte, a data block 2). The trailer is then the CRC16 of 
+// the block (MSB first), and an ack has no length. Both sides must use the same header.
+#if defined ENABLE_COMPACT_HEADER
+	#define MSG_ADR_LENGTH			MSG_SRC_LENGTH
+	#define TXRX_TRAILER_SIZE		2
+#else
+	#define MSG_ADR_LENGTH			(2 * MY_ADDRESS_LENGTH)
+	#define TXRX_TRAILER_SIZE		4
+#endif
+
+// If the stones should upload data blocks in plug-scheduled slots (instead of contending for the channel), define the following:
+#define ENABLE_TDMA_UPLOAD
+
+// If the stones should keep the network time of the plug (to compare the timing of samples across stones), define the following:
+#define ENABLE_TIME_SYNC
+
+// If the plug should write each data block to the host in a frame that names its stone (rather than the bare block), define the following:
+// (it changes the USB stream - the host must parse the frames, see "Data blocks on USB" in WistoneAPI_boaz.txt)
+//#define ENABLE_USB_FRAMING
+
+// If the plug should send the commands to the stones in binary form, and the stones should reply with a binary status 
+// instead of the text of cmd_ok()/err() (see parser.h), define the following:
+// (it changes the commands on the air - a stone without it can not read them, see "Binary commands" in WistoneAPI_boaz.txt)
+//#define ENABLE_BINARY_COMMANDS
+
+// If a block that arrives in a single message (a command, a control block) should be handled in the received frame
+// rather than copied into the block buffer (the frame is retained in the receive pool of the MAC until the block was handled), 
+// define the following:
+#define ENABLE_ZERO_COPY_RX
+
 // Next are defines of times until timeout.. To change here the timing, confused between timing of message and packet..
 #define TIMEOUT_RECEIVING_MESSAGE							400 * ONE_MILI_SECOND	// YS 25.1 // YL 22.12 was: 250 * ONE_MILI_SECOND // YL 29.12 was: 400 * ONE_MILI_SECOND
 #define TIMEOUT_RETRYING_RECEIVING_PACKET 					2 * ONE_SECOND 			// YS 25.1 // YL 29.12 was: 2 * ONE_SECOND 
@@ -69,6 +130,166 @@
 #define TXRX_ACK_MASK	0xFC
 #define TXRX_SEQ_MASK	0x3F
 
+// Control blocks (TXRX_TYPE_CONTROL) are consumed by the TxRx layer itself; the first byte of the block is the control id:
+#define TXRX_CTRL_RATE	0x01				// [TXRX_CTRL_RATE, LINK_RATE] - the stone moves the link to a new data rate
+#define TXRX_CTRL_DOZE	0x02				// [TXRX_CTRL_DOZE] - the stone dozes until the plug wakes it (ENABLE_LOW_POWER_LISTEN)
+
+// Link rate adaptation (ENABLE_LINK_RATE_ADAPTATION in ConfigMRF49XA.h):
+// the stone evaluates the MAC link statistics every RATE_WINDOW_BLOCKS data blocks, and proposes a step up/down to the plug 
+// (a direct link only). The rate is used in the TDMA upload slot of the stone; the rest of the superframe is at the base rate.
+#define RATE_WINDOW_BLOCKS			8
+#define RATE_UP_RETRY_PERCENT		5		// step up when less than 5% of the sent frames needed a retransmission, and...
+#define RATE_UP_RSSI_PERCENT		75		// ...at least 75% of the received frames were above RSSI_THRESHOLD
+#define RATE_DOWN_RETRY_PERCENT		25		// step down when more than 25% of the sent frames needed a retransmission, 
+#define RATE_DOWN_RX_ERR_PERCENT	25		// or when more than 25% of the received frames were lost (CRC/DQD), or on any MAC failure
+#define RATE_UP_HOLDOFF				4		// windows to wait after a step down before stepping up again
+#if defined ENABLE_TXRX_SECURITY
+	#define TXRX_MAX_LINK_RATE		LINK_RATE_57600		// a sealed block keeps 90% of the plain throughput only up to 57600 (Host Tests/sec/budget.py)
+#else
+	#define TXRX_MAX_LINK_RATE		LINK_RATE_115200
+#endif
+
+// Cumulative acks (ENABLE_CUMULATIVE_ACK): the stone sends up to TXRX_ACK_WINDOW data blocks before it waits for an ack, and keeps 
+// a copy of each block until it is acked. An ack acks the blocks before its sequence too. The plug acks a data block in order 
+// after TXRX_ACK_EVERY blocks, or TXRX_ACK_DELAY after the first block it did not ack, or in the header of the next block it 
+// sends to the stone: every block but an ack carries [piggybacked ack] after the block length - TXRX_PIGGYBACK_ACK | sequence, 
+// or 0 for none. A repeated block is acked at once. The stone sends the window again after TXRX_ACK_TIMEOUT without an ack.
+#define TXRX_ACK_WINDOW				3		// 3 block copies on the stone (1.5 KB)
+#define TXRX_ACK_EVERY				2
+#define TXRX_ACK_DELAY				(300 * ONE_MILI_SECOND)	// more than a block at BASE_LINK_RATE, so a stream is acked every TXRX_ACK_EVERY blocks
+#define TXRX_ACK_TIMEOUT			(600 * ONE_MILI_SECOND)	// TXRX_ACK_DELAY, and the ack itself with its MAC retries
+#define TXRX_PIGGYBACK_ACK			0x80
+
+// Replies: the stone collects its wireless output (m_TxRx_write) in the reply buffer, and sends it as one packet at the prompt 
+// (write_eol), when the next string does not fit the buffer (a string is split only when it is longer than the buffer, so a 
+// binary status never is), before a data block, and after the command was handled (TxRx_FlushReply).
+// Broadcast commands: the plug delivers the command to each member stone with [reply slot, reply slots] after its '\0', 
+// and then broadcasts [TXRX_REPLY_START_ID, reply slots]. Each stone holds its reply until its slot, and the plug prints 
+// the replies as one response, followed by the stones that did not reply.
+#define TXRX_REPLY_START_ID			0xB6
+#define TXRX_REPLY_INFO_LENGTH		3		// '\0', reply slot, reply slots
+#define TXRX_REPLY_BUFFER_SIZE		160		// the reply of the stone is collected here (a longer reply to a broadcast command is cut)
+#define TXRX_REPLY_CUT_MARK			"<CUT>"	// ends a reply that was cut, so the host knows it is not whole
+#define TXRX_REPLY_SLOT_TIME		(200 * ONE_MILI_SECOND)	// a reply block with its ack, including retries
+#define TXRX_REPLY_GUARD_TIME		(200 * ONE_MILI_SECOND)	// the plug waits for the last slot to end
+#define TXRX_BCAST_SEND_TIME		(300 * ONE_MILI_SECOND)	// the plug delivers the command to one stone (including CMD_MEMBER_GAP)
+
+// TDMA upload (ENABLE_TDMA_UPLOAD): while stones send data blocks, the plug broadcasts a beacon at the beginning of each superframe
+// with the upload slot of each active stone; a stone sends data blocks only inside its slot, or - if it has no slot yet - in the
+// contention part at the end of the superframe. The beacon is [TDMA_BEACON_ID, number of slots, contention blocks] followed by 
+// one byte per slot: EUI_0 of the stone (6 MSBs) and the log2 of the slot length in blocks (2 LSBs).
+#define TDMA_BEACON_ID				0xB5
+#define TDMA_BEACON_HEADER			3
+#define TDMA_MAX_SLOTS				(TX_BUFFER_SIZE - MIWI_HEADER_LEN - TDMA_BEACON_HEADER)	// one beacon frame
+#define TDMA_SLOT_SHIFT_MASK		0x03
+#define TDMA_MAX_SLOT_SHIFT			3		// max slot of 8 blocks
+#define TDMA_NO_SLOT				0xFF
+#define TDMA_BLOCK_TIME				(250 * ONE_MILI_SECOND)	// a data block with its ack at BASE_LINK_RATE, including MAC retries - the unit of the slots
+#define TDMA_GUARD_TIME				(50 * ONE_MILI_SECOND)	// the beacon itself, and its rebroadcast jitter, before the first slot
+#define TDMA_CONTENTION_BLOCKS		2		// the part of the superframe for stones without a slot
+#define TDMA_MAX_SUPERFRAME_BLOCKS	48		// when the slots exceed it, the largest are halved (max-min fairness)
+#define TDMA_IDLE_SUPERFRAMES		2		// the plug frees the slot of a stone that sent nothing for 2 superframes
+#define TDMA_BEACON_LOSS			3		// the stone returns to contention after 3 superframes without a beacon
+
+// Time sync (ENABLE_TIME_SYNC): the network time is the symbol timer of the plug. Every TSYNC_PERIOD the plug broadcasts 
+// [TSYNC_ID, sequence, level, network time (4 bytes, LSB first)]. The MAC of the transmitter - the plug, or a coordinator that 
+// rebroadcasts it - writes its level (hops from the plug) and its network time at the start of the frame, and the receiver 
+// takes its own tick at the start of the frame. The stone fits the offset and the skew of its clock to the last 
+// TSYNC_TABLE_SIZE reference points. All times are in symbol timer ticks.
+#define TSYNC_ID					0xB7
+#define TSYNC_LEVEL					2
+#define TSYNC_TIME					3
+#define TSYNC_LENGTH				7
+#define TSYNC_NOT_SYNCED			0xFF	// the level of a transmitter without a time base - the receivers ignore the message
+#define TSYNC_PERIOD				(10 * ONE_SECOND)
+#define TSYNC_TABLE_SIZE			8		// 80 seconds of reference points
+#define TSYNC_MIN_ENTRIES			3		// the stone has a time base from the 3rd reference point
+#define TSYNC_ERROR_LIMIT			(10 * ONE_MILI_SECOND)	// a reference point further than this from the time base is dropped,
+#define TSYNC_MAX_ERRORS			3		// unless 3 came in a row - then the stone starts over (e.g. the plug was restarted)
+#define TSYNC_TIMEOUT				(30 * TSYNC_PERIOD)		// the stone drops a time base that was not refreshed for 5 minutes
+
+// Low power listening (ENABLE_LOW_POWER_LISTEN in ConfigApp.h): a stone that had no blocks to send or receive for LPL_IDLE_TIMEOUT,
+// and routes for no child, sends [TXRX_CTRL_DOZE] to the plug and dozes - the MCU and the transceiver sleep, and every LPL_INTERVAL_MS
+// the wake-up timer of the transceiver wakes them to listen for LPL_LISTEN_MS. The plug takes a stone for dozing after its
+// [TXRX_CTRL_DOZE], or after LPL_IDLE_TIMEOUT without blocks from it. Before it sends a command to a dozing stone, it sends 
+// [LPL_WAKE_ID, EUI_0 of the stone] to the stone every LPL_WAKE_GAP for LPL_WAKE_TIME - a whole cycle of the stone - so one of 
+// them comes while the stone listens; the MAC ack of a neighbour stone ends them at once. A broadcast command wakes its dozing 
+// stones together: the frames are broadcast, with LPL_WAKE_ALL. A command waits at most LPL_WAKE_TIME more for a dozing stone,
+// and after a failed attempt, a stone that sent no block since is woken again.
+#define LPL_WAKE_ID					0xB8
+#define LPL_WAKE_ALL				0xFF
+#define LPL_WAKE_LENGTH				2		// a unicast wake frame is too short to be a block
+#define LPL_WAKE_GAP				(5 * ONE_MILI_SECOND)	// from a wake frame to the next - a listen window takes three of them
+#define LPL_IDLE_TIMEOUT			(30 * ONE_SECOND)
+#define LPL_STARTUP_MS				10		// the oscillator of the transceiver starts (MiMAC_PowerState)
+#define LPL_LISTEN_MS				20		// two wake frames, and the gap between them, at BASE_LINK_RATE
+#define LPL_WAKE_TIME				((LPL_INTERVAL_MS + LPL_STARTUP_MS + LPL_LISTEN_MS) * ONE_MILI_SECOND)
+
+// Link statistics ("txrx stats" - to the plug: "63 txrx stats"): the TxRx layer counts per neighbour - the plug per stone, the stone
+// for the plug - and prints a CSV record for each neighbour, then its channel map (ENABLE_CHANNEL_MAP), and then the counters of 
+// the MAC, which can not tell the source of a frame that was dropped (e.g. on a CRC error):
+// LINK,<EUI_0>,<EUI_0 of the neighbour>,tx blocks,tx failures,MAC retries,rx frames,rx RSSI high,rx DQD,rx blocks,trailer errors,
+//		sequence errors,RTT (ms),auth errors
+// CHAN,<EUI_0>,operating channel,noise of channel 0,PER of channel 0 (%),noise of channel 1,...
+// MAC,<EUI_0>,tx frames,tx retries,tx failures,rx frames,CRC errors,DQD lost,RSSI high,pool full,bad length,timeouts,not for me,
+//		duplicates
+// The counters are free running (16 bit, unsigned) - the host takes differences of snapshots. The RTT is the average (EWMA, weight 1/TXRX_RTT_WEIGHT) 
+// of the time from sending a block to its ack, including the delay of a cumulative ack.
+#define TXRX_RTT_WEIGHT				8
+
+// Channel quality map (ENABLE_CHANNEL_MAP in ConfigApp.h): every node keeps in the EEPROM (CHANNEL_MAP_ADDRESS) the channel of 
+// its last network, and for each channel the noise - the energy detect level (MiMAC_ChannelAssessment) - and the PER of its 
+// sessions there; both are moving averages (a new sample weighs 1/CHMAP_EWMA_WEIGHT). The noise of the operating channel is 
+// sampled every CHMAP_SAMPLE_PERIOD if no frame was sent or received since the last time, and a whole channel scan replaces it. 
+// The PER is taken from the MAC statistics every CHMAP_PER_FRAMES frames (MAC retries, failures and CRC errors per frame).
+// The network starter starts on the channel of the lowest noise + CHMAP_PER_WEIGHT * PER, if a short energy detect finds it 
+// not noisier than known (by CHMAP_NOISE_MARGIN) - otherwise, or with an empty map, it scans all the channels. The others search
+// the channel of their last network first. When the PER of the operating channel crosses CHMAP_AGILITY_PER, the network starter
+// scans the channels, one CHMAP_STEP_DURATION window per TxRx_ChannelTasks call, and then moves the network to a better one 
+// (StartChannelHopping), at most once in CHMAP_AGILITY_HOLDOFF.
+#define CHMAP_SAMPLE_PERIOD			(10 * ONE_SECOND)
+#define CHMAP_PER_FRAMES			64
+#define CHMAP_EWMA_WEIGHT			4
+#define CHMAP_PER_WEIGHT			2
+#define CHMAP_NOISE_MARGIN			36		// a step of MiMAC_ChannelAssessment
+#define CHMAP_CHECK_DURATION		8		// ScanTime[] index - 1/4 s to check the best known channel
+#define CHMAP_SCAN_DURATION			10		// ScanTime[] index - 1 s for each channel of a scan (as MiApp_StartConnection did)
+#define CHMAP_STEP_DURATION			6		// ScanTime[] index - 62 ms for each channel of the agility scan, away from the network
+#define CHMAP_SAVE_PER_STEP			10		// the map is saved when the PER of the operating channel moved by this much
+#define CHMAP_AGILITY_PER			30
+#define CHMAP_AGILITY_HOLDOFF		(60 * ONE_SECOND)
+
+// Block security (ENABLE_TXRX_SECURITY in ConfigApp.h): the stone sends a data block as [KEY_SEQUENCE_NUMBER, 0, counter (4 
+// bytes, MSB first), encrypted block, MIC (8 bytes)], sealed by the standard XTEA (64-bit block, 128-bit key) in CCM mode 
+// (Security.h) with the header as the nonce. The key of a stone is derived from the network key and its EUI_0, so a stone can 
+// not seal blocks in the name of another one. The network key is provisioned in the EEPROM (SEC_KEY_ADDRESS) by "txrx key" over 
+// the USB of each device; until then the stone sends no data blocks, and the plug drops them.
+// The counter is never reused: the stone reserves the counters in the EEPROM (SEC_COUNTER_ADDRESS), TXRX_SEC_COUNTER_INTERVAL 
+// at a time, so after a reset it skips the rest of the interval; it stops sending data after TXRX_SEC_COUNTER_MAX blocks (27 
+// years at 5 blocks/s - the 1,000,000 write cycles of the EEPROM page last 10^9 blocks, 6 years of uploading without a pause). 
+// The plug drops a block with a wrong MIC, another key sequence number, or a counter below the next expected one (a replay), 
+// and counts it as an auth error. It keeps a replay mark of each stone in its EEPROM (SEC_REPLAY_ADDRESS), written the same 
+// way: after a reset of the plug the counters below the mark are replays, so it drops up to TXRX_SEC_COUNTER_INTERVAL blocks 
+// of each stone that uploads until the stone passes the mark. Commands and replies are not sealed.
+#define TXRX_SEC_HEADER_LEN			6		// [KEY_SEQUENCE_NUMBER, 0, counter] - keeps the encrypted block word aligned
+#define TXRX_SEC_OVERHEAD			(TXRX_SEC_HEADER_LEN + 8)	// and the MIC
+#define TXRX_SEC_COUNTER_INTERVAL	1024	// an EEPROM write every 1024 blocks
+#define TXRX_SEC_COUNTER_MAX		(0xFFFFFFFEL - TXRX_SEC_COUNTER_INTERVAL)	// the reserved limit stays below 0xFFFFFFFF (an erased EEPROM)
+#if defined ENABLE_TXRX_SECURITY
+	#define TXRX_MAX_BLOCK_LEN		(MAX_BLOCK_SIZE + TXRX_SEC_OVERHEAD)
+#else
+	#define TXRX_MAX_BLOCK_LEN		MAX_BLOCK_SIZE
+#endif
+
+// USB framing (ENABLE_USB_FRAMING): the plug writes a data block to the host as [USB_FRAME_SYNC_0, USB_FRAME_SYNC_1, EUI_0, EUI_1, 
+// block length (2 bytes, MSB first), block, CRC16 (MSB first)], where EUI_0, EUI_1 is the stone and the CRC covers everything after
+// the sync bytes. Replies and prompts remain plain text between the frames (text never contains the sync bytes), so the host 
+// looks for the sync bytes, checks the CRC, and writes the block to the file of its stone.
+#define USB_FRAME_SYNC_0			0xA5
+#define USB_FRAME_SYNC_1			0x5A
+#define USB_FRAME_HEADER_SIZE		6
+#define USB_FRAME_CRC_SIZE			2
+
 #if defined ENABLE_RETRANSMISSION
 	extern BYTE blockTryTxCounter;
 #endif
@@ -78,8 +299,12 @@ extern BOOL isAppStop;						// we received "app stop" command
 
 // YL 31.10 ...
 extern BOOL isTxRxTypeCommand;
+extern BYTE txPhaseIndex;					// the phase in the application header of the command (the header depends on the TxRx options)
 // ... YL 31.10
 
+extern BYTE *txSlice;						// the data that the MAC sends after the MiWi TxBuffer in the next frame (not copied)
+extern BYTE txSliceLen;						// (0 - none; cleared by the MAC when it takes the slice)
+
 // YL 12.1 ...
 extern WORD_VAL g_phase_counter_start;
 extern WORD_VAL g_phase_counter_stop;
@@ -102,18 +327,21 @@ typedef enum {
 	TXRX_RECEIVED_INVALID_TRAILER,
 	TXRX_NWK_UNKNOWN_ADDR,				// YL 4.8 invalid network address of the destination
 	TXRX_NWK_NOT_ME,					// YL 23.7 the stone received a command that wasn't addressed to it
+	TXRX_CMD_QUEUE_FULL,				// the plug has no room for another command
 	TXRX_ERROR_MAX						// YL 14.8 
 } TXRX_ERRORS;
 
-// There are 3 command types:
+// There are 4 command types:
 // - The regular one, which consists of command and their response. 
 // - The second type is data block, which consists of block in size of 512B.
 // - The ack packet.
+// - The control block, which is handled by the TxRx layer of the receiver (e.g. link rate change).
 
 typedef enum {
 	TXRX_TYPE_COMMAND = 0,
 	TXRX_TYPE_DATA,
 	TXRX_TYPE_ACK,
+	TXRX_TYPE_CONTROL,
 	TXRX_TYPE_MAX	// YL 1.11
 } BLOCK_TYPE;
 
@@ -190,7 +418,8 @@ TXRX_ERRORS TxRx_PeriodTasks();
 * Description:
 *      This function sending a data packet to the other device. This function is
 *	   the previously TXBlock() function. It uses that TxRx_SendPacketWithConfimation()
-*	   function to accomplish this aim.
+*	   function to accomplish this aim. With ENABLE_CUMULATIVE_ACK it does not wait 
+*	   for the ack of the block while there is room in the window (TXRX_ACK_WINDOW).
 *
 * Parameters:
 *	   samples_block - The data we want to send - may be data or command.
@@ -203,6 +432,22 @@ TXRX_ERRORS TxRx_PeriodTasks();
 ******************************************************************************/
 TXRX_ERRORS TxRx_SendData(BYTE* samples_block, WORD TX_message_length);
 
+/******************************************************************************
+* Function:
+*		TXRX_ERRORS TxRx_TrySendData(BYTE *block, WORD blockLen)
+*
+* Description:
+*      Sends a data block once, without waiting for room in the window or for
+*	   retries - for a live stream that must not hold back the sampler (TEE).
+*	   A block that could not be sent at once is dropped. Text that waits in
+*	   the reply buffer is left for the main loop.
+*
+* Return value: 
+*	   TXRX_UNABLE_SEND_PACKET if the block was dropped.
+*
+******************************************************************************/
+TXRX_ERRORS TxRx_TrySendData(BYTE *block, WORD blockLen);
+
 /******************************************************************************
 * Function:
 *		TXRX_ERRORS m_TxRx_write(BYTE *str)
@@ -222,10 +467,72 @@ TXRX_ERRORS TxRx_SendData(BYTE* samples_block, WORD TX_message_length);
 ******************************************************************************/
 TXRX_ERRORS m_TxRx_write(BYTE *str);
 
+/******************************************************************************
+* Function:
+*		void TxRx_FlushOutput(void)
+*
+* Description:
+*      Sends the reply that m_TxRx_write collected, unless it is a reply to a
+*	   broadcast command (which waits for TxRx_FlushReply).
+*
+******************************************************************************/
+void TxRx_FlushOutput(void);
+
+/******************************************************************************
+* Function:
+*		void TxRx_FlushReply(void)
+*
+* Description:
+*      Sends the reply that m_TxRx_write collected, or - to a broadcast 
+*	   command - holds it for TxRx_BackgroundTasks to send in the reply slot
+*	   of the stone. Call it after the command was handled.
+*
+******************************************************************************/
+void TxRx_FlushReply(void);
+
+/******************************************************************************
+* Function:
+*		void TxRx_BackgroundTasks(void)
+*
+* Description:
+*      The stone sends what waits for its slot: the held reply to a broadcast
+*	   command, and the data blocks that wait for the upload slot. Call it on 
+*	   every pass of the main loop - nothing waits for the slot in place.
+*
+******************************************************************************/
+void TxRx_BackgroundTasks(void);
+
+/******************************************************************************
+* Function:
+*		void TxRx_SaveNetwork(void)
+*
+* Description:
+*      Keeps the network state of the stone in the EEPROM, so that TxRx_Init 
+*	   resumes it after the next wakeup instead of a scan. Call it before the 
+*	   stone shuts down (only with ENABLE_FAST_REJOIN, see ConfigApp.h).
+*
+******************************************************************************/
+void TxRx_SaveNetwork(void);
+
+#if defined ENABLE_LOW_POWER_LISTEN
+/******************************************************************************
+* Function:
+*		void TxRx_LowPowerListen(void)
+*
+* Description:
+*      Makes one doze cycle (a sleep and a listen) once the stone was idle 
+*	   for LPL_IDLE_TIMEOUT, until the plug wakes it (a command follows);
+*	   returns at once otherwise. Call it on every pass of the main loop 
+*	   while the application has nothing to do.
+*
+******************************************************************************/
+void TxRx_LowPowerListen(void);
+#endif
+
 #elif defined COMMUNICATION_PLUG
 /******************************************************************************
 * Function:
-*		TXRX_ERRORS TxRx_SendCommand(BYTE *command)
+*		TXRX_ERRORS TxRx_SendCommand(BYTE *command, WORD commandLen)
 *
 * Description:
 *      This function sending a command packet to the other device. It uses the
@@ -236,7 +543,7 @@ TXRX_ERRORS m_TxRx_write(BYTE *str);
 *		if(ProccessIO)
 *		{
 *			strcpy(msg, cmd_Current);	
-*			TXRX_ERRORS status = TxRx_SendCommand(msg);
+*			TXRX_ERRORS status = TxRx_SendCommand(msg, strlen(msg));
 *			if(status != TXRX_NO_ERROR)
 *			{
 *				// Error handling
@@ -247,13 +554,30 @@ TXRX_ERRORS m_TxRx_write(BYTE *str);
 *
 * Parameters:
 *	   command - The command you want to send.
+*	   commandLen - The length of the command (a binary command may hold '\0').
 *
 * Return value: 
 *	   Any parameter at the TXRX_ERRORS enum.
 *	   
 *
 ******************************************************************************/
-TXRX_ERRORS TxRx_SendCommand(BYTE *command);
+TXRX_ERRORS TxRx_SendCommand(BYTE *command, WORD commandLen);
+
+/******************************************************************************
+* Function:
+*		TXRX_ERRORS TxRx_QueueCommand(BYTE *command)
+*
+* Description:
+*      Queues a stone command from the host, after TxRx_ExecuteIfPlugCommand
+*	   found its destination. TxRx_PeriodTasks delivers the queued commands
+*	   (TxRx_CommandTasks) and reports each one to the host.
+*
+* Return value: 
+*	   TXRX_CMD_QUEUE_FULL if there is no room for the command.
+*
+******************************************************************************/
+TXRX_ERRORS TxRx_QueueCommand(BYTE *command);
+void TxRx_CommandTasks(void);
 
 #endif // WISDOM_STONE, COMMUNICATION_PLUG
 
@@ -266,12 +590,54 @@ void TxRx_Reset_ACK_Sequencers();
 
 #endif // ENABLE_TXRX_ACK
 
+#if defined ENABLE_TIME_SYNC
+/******************************************************************************
+* Function:
+*		BOOL TxRx_GlobalTime(DWORD localTick, DWORD *globalTick)
+*
+* Description:
+*      Converts a tick of the symbol timer (MiWi_TickGet, or the SofTick of a
+*	   received frame) to the network time - the symbol timer of the plug.
+*
+* Parameters:
+*	   localTick - the local tick.
+*	   globalTick - returns the network time at localTick.
+*
+* Return value: 
+*	   FALSE if the stone has no time base yet (globalTick is not set).
+*
+******************************************************************************/
+BOOL TxRx_GlobalTime(DWORD localTick, DWORD *globalTick);
+
+/******************************************************************************
+* Function:
+*		BYTE TxRx_TimeSyncLevel(void)
+*
+* Description:
+*      The hops between this device and the plug on the path of the time base.
+*
+******************************************************************************/
+BYTE TxRx_TimeSyncLevel(void);
+
+#endif // ENABLE_TIME_SYNC
+
 /******************************************************************************
 * Function:
 *		int TxRx_PrintError(TXRX_ERRORS error) 
 ******************************************************************************/	
 int TxRx_PrintError(TXRX_ERRORS error);	
 
+/******************************************************************************
+* Function:
+*		int handle_txrx(int sub_cmd)
+*
+* Description:
+*      Handles the "txrx" commands: "txrx stats" prints the link statistics,
+*	   "txrx key" provisions the network key of the block security.
+*
+******************************************************************************/
+int handle_txrx(int sub_cmd);
+
 #if defined COMMUNICATION_PLUG
 /******************************************************************************
 * Function:
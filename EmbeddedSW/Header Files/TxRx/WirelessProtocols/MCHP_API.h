@@ -162,6 +162,70 @@
     BOOL    MiApp_ProtocolInit(BOOL bNetworkFreezer);
     
     
+    #if defined(ENABLE_FAST_REJOIN)
+        /***************************************************************************
+         * Network state of the node
+         *
+         *      This structure contains the network information that the network
+         *      freezer restores, so that the node can operate in the network 
+         *      without a scan and an association.
+         **************************************************************************/
+        typedef struct
+        {
+            WORD_VAL            PANID;
+            WORD_VAL            ShortAddress;
+            BYTE                Channel;
+            BYTE                Parent;                         // the index of the parent in ConnectionTable (0xFF - none)
+            #if defined(NWK_ROLE_COORDINATOR)
+                BYTE            Role;
+                BYTE            KnownCoordinators;
+                BYTE            RoutingTable[8];
+            #endif
+            CONNECTION_ENTRY    ConnectionTable[CONNECTION_SIZE];
+        } NETWORK_STATE;
+        
+        /************************************************************************************
+         * Function:
+         *      void MiApp_GetNetworkState(NETWORK_STATE *state)
+         *
+         * Summary:
+         *      This function copies the network state of the node
+         *
+         * Description:        
+         *      The application keeps the state, and gives it to MiApp_ResumeNetwork 
+         *      after the node is powered again.
+         *
+         * PreCondition:    
+         *      The node has started or joined a network
+         *
+         *********************************************************************************/
+        void    MiApp_GetNetworkState(NETWORK_STATE *state);
+        
+        /************************************************************************************
+         * Function:
+         *      BOOL MiApp_ResumeNetwork(NETWORK_STATE *state)
+         *
+         * Summary:
+         *      This function restores the network state of the node
+         *
+         * Description:        
+         *      The link to the parent is confirmed with a single data request, which
+         *      the MAC of the parent acknowledges. The PAN coordinator has no parent 
+         *      to confirm.
+         *
+         * PreCondition:    
+         *      MiApp_ProtocolInit(FALSE) has been called
+         *
+         * Returns: 
+         *      TRUE if the node operates in the network again. If FALSE, the network 
+         *      state is not valid, and MiApp_ProtocolInit should be called again 
+         *      before a scan.
+         *
+         *********************************************************************************/
+        BOOL    MiApp_ResumeNetwork(NETWORK_STATE *state);
+    #endif
+    
+    
     /************************************************************************************
      * Function:
      *      BOOL MiApp_SetChannel(BYTE Channel)
@@ -777,6 +841,42 @@
      *****************************************************************************************/      
     void    MiApp_DiscardMessage(void);
     
+    
+    /************************************************************************************
+     * Function:
+     *      BYTE    MiApp_RetainMessage(void)
+     *      void    MiApp_ReleaseMessage(BYTE handle)
+     *
+     * Summary:
+     *      These functions let the application use the payload of the current message
+     *      in place after MiApp_DiscardMessage
+     *
+     * Description:        
+     *      rxMessage.Payload points into a frame of the receive pool of the MAC layer.
+     *      MiApp_RetainMessage keeps the frame for the application and returns its 
+     *      handle; MiApp_DiscardMessage lets the stack receive the next message as usual,
+     *      and the frame returns to the pool when the handle is released.
+     *
+     * PreCondition:    
+     *      A message has been received by the application layer (for MiApp_RetainMessage).
+     *
+     * Example:
+     *      <code>
+     *      if( TRUE == MiApp_MessageAvailable() )
+     *      {
+     *          BYTE *data = rxMessage.Payload;
+     *          BYTE handle = MiApp_RetainMessage();
+     *
+     *          MiApp_DiscardMessage();
+     *          // handle data, and then:
+     *          MiApp_ReleaseMessage(handle);
+     *      }
+     *      </code>
+     *
+     *****************************************************************************************/      
+    BYTE    MiApp_RetainMessage(void);
+    void    MiApp_ReleaseMessage(BYTE handle);
+    
     #define NOISE_DETECT_ENERGY 0x00
     #define NOISE_DETECT_CS     0x01
     /************************************************************************************
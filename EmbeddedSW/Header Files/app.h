@@ -7,6 +7,7 @@ extern int g_mode;
 void 	handle_SS(void);
 void 	handle_TS(void);
 void 	handle_OST(void);
+void 	handle_TEE(void);
 int 	handle_application(int sub_cmd);
 BOOL 	runPlugCommand();
 
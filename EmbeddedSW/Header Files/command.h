@@ -13,11 +13,14 @@ extern int  g_ntokens;
 extern char	g_in_msg[MAX_CMD_LEN]; 	
 extern BOOL	g_boot_seq_pause;
 extern BYTE g_is_cmd_received;
+extern BOOL	g_is_bin_cmd;
 
 /***** FUNCTION PROTOTYPES: ***************************************************/
 int 	exec_message_command(void);
 void 	cmd_ok(void);
 int 	cmd_error(int errid);
+BOOL	bin_status(BYTE error);
+void	write_reply(char *reply);
 void 	write_eol(void);
 void 	b_write(BYTE* block_buffer, int len);	
 void 	m_write(char *str);	
@@ -30,5 +33,6 @@ void	blink_buzz(); // YL 7.5
 void 	m_write_debug(char *str); 	// YL 12.1 edited m_write_debug
 void	put_char_debug(void);
 #endif
+BOOL	is_debug_pending(void);		// DEBUG_PRINT (declared always - wistone_main.h includes this file before it defines DEBUG_PRINT)
 
 #endif //#ifndef __COMMAND_H__
@@ -0,0 +1,20 @@
+#ifndef __DECIMATOR_H__
+#define __DECIMATOR_H__
+
+#include "wistone_main.h"
+#include "GenericTypeDefs.h"
+
+/***** DEFINE: ****************************************************************/
+#define DECIM_TAPS_PER_PHASE	6			// FIR length is (decimation factor x DECIM_TAPS_PER_PHASE) taps
+#define DECIM_MAX_FACTOR		8			// supported decimation factors: 1 (bypass), 2, 4, 8
+#define DECIM_ADS1282_SAMP_SIZE	4			// bytes (ADS1282_SAMP_SIZE is in bits)
+
+extern BYTE g_decim_factor;
+extern int	g_decim_cutoff;
+
+/***** FUNCTION PROTOTYPES: ***************************************************/
+int 	decim_init(int factor, int cutoff);
+BYTE*	decim_accmtr_block(BYTE *in_blk);
+BYTE*	decim_ads1282_block(BYTE *in_blk);
+
+#endif //__DECIMATOR_H__
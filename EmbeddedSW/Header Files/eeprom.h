@@ -25,6 +25,11 @@
 #define SN_ADDRESS 				EEPROM_MEMORY_SIZE - 1	// last address in EEPROM address space
 #define ALARM_ADDRESS			EEPROM_MEMORY_SIZE - 2	// to indicate that the alarm was set
 #define EUI_0_ADDRESS			EEPROM_MEMORY_SIZE - 3	// YL 6.4 the first byte of 8-byte globally unique hardware identifier (for MiWi); in 32K EEPROM the EUI address is: 32765
+#define NWK_STATE_ADDRESS		(EEPROM_MEMORY_SIZE - 2 * EEPROM_PAGE_SIZE)	// the page before the last one keeps the network state of the stone (TxRx fast rejoin)
+#define SEC_COUNTER_ADDRESS		(EEPROM_MEMORY_SIZE - 3 * EEPROM_PAGE_SIZE)	// the page before it keeps the block counter of the stone (TxRx block security)
+#define SEC_KEY_ADDRESS			(EEPROM_MEMORY_SIZE - 4 * EEPROM_PAGE_SIZE)	// the page before it keeps the network key (TxRx block security, "txrx key")
+#define SEC_REPLAY_ADDRESS		(EEPROM_MEMORY_SIZE - 8 * EEPROM_PAGE_SIZE)	// the 4 pages before it keep the replay mark (4 bytes) of each EUI_0 on the plug (TxRx block security)
+#define CHANNEL_MAP_ADDRESS		(EEPROM_MEMORY_SIZE - 9 * EEPROM_PAGE_SIZE)	// the page before them keeps the channel quality map (TxRx)
 //boot table:
 #define MAX_BOOT_CMD_LEN		EEPROM_PAGE_SIZE		
 #define MAX_BOOT_ENTRY_NUM		9
@@ -35,11 +40,14 @@
 /***** FUNCTION PROTOTYPES: ***************************************************/
 int eeprom_write_byte(long addr, BYTE dat);	//read/write byte may be omitted, but they are slightly different (SN_ADDRESS, activated by r/w) 
 int eeprom_read_byte(long addr);
+int eeprom_write_block(long addr, BYTE* dat, int len);
+int eeprom_read_block(long addr, BYTE* dat, int len);
 int eeprom_write_n_bytes(long addr, char* dat);				
 int eeprom_read_n_bytes(long addr, char* dat, int len);		
 int eeprom_boot_set(BYTE entry, char* dat);					
 int eeprom_boot_get(BYTE entry);									
 int eeprom_format(void);						
+void eeprom_wait_ready(void);					// until the write cycle of the last write is over (before a power-down)
 int handle_eeprom(int sub_cmd);						
 
 #endif //__EEPROM_H__
@@ -47,6 +47,7 @@ typedef enum {
 	ERR_INVALID_MODE, 		
 	ERR_INVALID_COMM,			// YL 5.8 instead of ERR_INVALID_DEST
 	ERR_INVALID_SAMP,
+	ERR_INVALID_DECIM,
 	
 	ERR_ACCMTR_UNKNOWN_ID,			
 	ERR_ACCMTR_REG_WRITE, 	
@@ -64,6 +65,7 @@ extern ErrType g_error;
 
 /***** FUNCTION PROTOTYPES: ***************************************************/
 char *get_last_error_str(void);
+char *get_error_str(int error);
 int err(ErrType err);
 void err_clear(void);
 
@@ -13,6 +13,10 @@ extern WORD_VAL g_phase_counter;
 	extern WORD_VAL g_broadcast_counter;
 #endif // COMMUNICATION_PLUG
 // ... YL 31.10
+#if defined WISDOM_STONE && defined ENABLE_TIME_SYNC
+	extern BOOL g_sync_locked;
+	extern int	g_sync_phase_error;
+#endif
 
 /***** FUNCTION PROTOTYPES: ***************************************************/
 void init_timer4(void);
@@ -21,5 +25,8 @@ void init_leds(void);
 int	 play_buzzer(int period);
 int  set_led(int state, int led_num);
 int  get_switch(int switch_num);
+#if defined WISDOM_STONE && defined ENABLE_TIME_SYNC
+	void timer4_sync_tasks(void);
+#endif
 
 #endif //__LED_BUZZER_H__
@@ -15,6 +15,28 @@
 #define N_MODES (sizeof(g_mode_names)/sizeof(char*))			
 #define N_COMMUNICATIONS (sizeof(g_comm_names)/sizeof(char*))	//YL 5.8 was: N_DESTINATIONS
 #define N_SAMPLERS (sizeof(g_samp_names)/sizeof(char*))	
+#define N_CUTOFFS (sizeof(g_cutoff_names)/sizeof(char*))
+#define N_NAME_LISTS (sizeof(g_name_lists)/sizeof(NAME_LIST))
+
+// Binary commands (ENABLE_BINARY_COMMANDS in TxRx.h): the plug translates a stone command into 
+// [BIN_CMD_MARK, token count, token, token, ...], where each token is one of:
+// - [BIN_ARG_NAME, list (NameListTypes), index] - a name of the tables below (the command and the sub 
+//   command are the first two),
+// - [BIN_ARG_NUM, value (4 bytes, LSB first)] - a number of [0 : MAX_SIGNED_LONG],
+// - any other token as it is, ended by '\0'.
+// tokenize() points g_tokens to the tokens of a binary command, and parse_name()/parse_long_num() take 
+// their values as they are instead of parsing text, so the handlers are the same for both forms. A command 
+// that takes free text (w, r, eeprom sboot/write, flash wsector) is sent as text. 
+// The stone replies to a binary command with the status [BIN_RSP_MARK, BIN_RSP_ERROR | error] (ERR_NONE 
+// for ok) instead of the text of cmd_ok()/err(), and the plug writes that text to the host.
+#define BIN_CMD_MARK		0x01
+#define BIN_RSP_MARK		0x02
+#define BIN_ARG_NAME		0x03
+#define BIN_ARG_NUM			0x04
+#define BIN_RSP_ERROR		0x80	// the status never holds '\0', so it can be held in a text reply
+#define BIN_CMD_HEADER_LEN	2
+#define BIN_NAME_LEN		3
+#define BIN_NUM_LEN			5
 
 typedef enum {
 	CMD_WRITE = 0,
@@ -27,7 +49,8 @@ typedef enum {
 	CMD_FLASH,
 	CMD_ADS,			//YL 7.11
 	CMD_ACCMTR,	
-	CMD_APP
+	CMD_APP,
+	CMD_TXRX
 } CmdTypes;
 
 typedef enum {
@@ -67,7 +90,9 @@ typedef enum {
 	SUB_CMD_MINIT,
 	SUB_CMD_GCAP,		
 	SUB_CMD_WSECTOR,	
-	SUB_CMD_RSECTOR		
+	SUB_CMD_RSECTOR,
+	SUB_CMD_STATS,		//txrx
+	SUB_CMD_KEY			//txrx
 } SubCmdTypes;
 
 typedef enum {
@@ -87,6 +112,7 @@ typedef enum {
 	MODE_SS = 0,	
 	MODE_TS,
 	MODE_OST,
+	MODE_TEE,
 	MODE_IDLE	
 } ModeTypes;
 
@@ -101,6 +127,26 @@ typedef enum {
 	SAMP_ONLY_8451
 } SampTypes;
 
+typedef enum {
+	CUTOFF_WIDE = 0,	// OST decimator pass band up to 0.8 x output Nyquist
+	CUTOFF_NARROW		// OST decimator pass band up to 0.5 x output Nyquist
+} CutoffTypes;
+
+typedef enum {
+	LIST_CMD = 0,
+	LIST_SUB_CMD,
+	LIST_DEV,
+	LIST_MODE,
+	LIST_COMM,
+	LIST_SAMP,
+	LIST_CUTOFF
+} NameListTypes;
+
+typedef struct {
+	char	**names;
+	int		len;
+} NAME_LIST;
+
 /***** FUNCTION PROTOTYPES: ***************************************************/
 void 	tokenize(char *msg);
 long 	parse_long_num(char *str); 	
@@ -113,7 +159,12 @@ int 	parse_device(char *name);
 int 	parse_mode(char *name);  		
 int 	parse_destination(char *name);
 int		parse_single_dual_mode(char *name);
+int		parse_cutoff(char *name);
+int		bin_command_len(char *msg, int len);
 int 	handle_plug_msg(void);	// YL 4.8 added
+#if defined COMMUNICATION_PLUG
+int		encode_command(char *msg, char *bin);
+#endif // #if defined COMMUNICATION_PLUG
 #if defined WISDOM_STONE
 int 	handle_msg(char *msg);			
 int 	handle_write(void);
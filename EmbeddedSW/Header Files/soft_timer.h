@@ -0,0 +1,38 @@
+#ifndef __SOFT_TIMER_H__
+#define __SOFT_TIMER_H__
+
+#include "wistone_main.h"
+#include "GenericTypeDefs.h"
+
+/***** DEFINE: ****************************************************************/
+#define SOFT_TIMER_TICK_HZ		400			// Timer4 rate (ADS1282_FREQ in led_buzzer.c)
+#define NO_EVENT				EVENT_NUM	// a timer that does not post an event
+
+// the timers are owned by their users - one id for each wait:
+typedef enum {
+	TIMER_TS_PAUSE = 0,		// handle_TS: the pause after reading a FLASH sector
+	TIMER_EEPROM_WRITE,		// eeprom.c: the internal write cycle of the EEPROM
+	TIMER_USB_ATTACH,		// init_all: the time we wait for a USB connection
+	TIMER_SHUTDOWN,			// prepare_for_shutdown: the last message goes out
+	TIMER_LED_BLINK,		// blink_led: the LED is turned off by the callback
+	TIMER_NUM
+} SoftTimerIds;
+
+typedef enum {
+	TIMER_ONE_SHOT = 0,		// stops when it expires
+	TIMER_PERIODIC			// restarts when it expires
+} SoftTimerModes;
+
+typedef void (*SOFT_TIMER_CALLBACK)(void);
+
+/***** FUNCTION PROTOTYPES: ***************************************************/
+void 	soft_timer_start(BYTE id, WORD ms, BYTE mode, SOFT_TIMER_CALLBACK callback, BYTE event);
+void 	soft_timer_stop(BYTE id);
+BOOL 	soft_timer_is_running(BYTE id);
+void 	soft_timer_wait(BYTE id);
+void 	soft_timer_tick(void);
+void 	soft_timer_tasks(void);
+void 	add_blocking_delay(WORD ms);
+DWORD	get_blocking_delay(void);
+
+#endif //__SOFT_TIMER_H__
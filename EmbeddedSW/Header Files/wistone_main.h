@@ -44,8 +44,32 @@
 	#error "CYCLIC_BUFFER_SIZE should be 2,4 or 8"
 #endif
 
+//OOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOO
+//MAIN LOOP EVENTS:
+//OOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOO
+// If the main loop of the stone should run only the handlers of the events that the ISRs posted, 
+// and idle (Idle()) until the next interrupt when nothing is pending, define the following:
+#define ENABLE_EVENT_LOOP
+
+typedef enum {
+	EVENT_BLOCK_READY = 0,	// the ADS1282 / accelerometer ISR filled a sampler block
+	EVENT_RADIO,			// the transceiver interrupt
+	EVENT_USB,				// the USB interrupt
+	EVENT_RTC,				// the RTC alarm woke the stone (the boot sequence runs)
+	EVENT_TIMER,			// Timer4 (400Hz) - the periodic tasks
+	EVENT_NUM
+} EventTypes;
+
+// an event is a single byte write, so the ISRs post it without masking the other interrupts:
+#define post_event(e)	(g_events[e] = 1)
+
 extern BOOL g_usb_connected;
 extern BYTE g_sleep_request;
 extern char g_curr_msg[MAX_CMD_LEN]; 
+extern volatile BYTE g_events[EVENT_NUM];
+
+#if defined WISDOM_STONE && defined ENABLE_EVENT_LOOP
+BYTE get_idle_percent(void);
+#endif
 
 #endif //__WISTONE_MAIN_H__
@@ -109,4 +109,22 @@ USB_STATUS USB_ReceiveDataFromHost(void);
 void USB_SendDataToHost(void);
 // ... YL 7.11
 
+/******************************************************************************
+ * Function:        BOOL USB_IsSendPending(void)
+ *
+ * PreCondition:    None
+ *
+ * Input:           None
+ *
+ * Output:          TRUE while the data that was written did not reach the host yet.
+ *
+ * Side Effects:    None
+ *
+ * Overview:        Performs the CDC transmission tasks; call it until it returns
+ *					FALSE to wait for the output to go out.
+ *
+ * Note:            None
+ *****************************************************************************/
+BOOL USB_IsSendPending(void);
+
 #endif // _WISTONE_USB_H_
@@ -0,0 +1,151 @@
+/*******************************************************************************
+
+sim_ack.c - model of the TxRx acks of data blocks (ENABLE_CUMULATIVE_ACK in TxRx.h)
+=================================================================================
+
+one stone streams data blocks to the plug over a half-duplex MRF49XA link at
+57.6 kbps. every MiWi frame is MAC-acked and retried (RETRANSMISSION_TIMES 5):
+each attempt is a frame, a turnaround, the MAC ack (or the ack timeout) and a
+turnaround. compares the stop-and-wait TxRx ack of each block with the window
+of TXRX_ACK_WINDOW blocks, acked every TXRX_ACK_EVERY blocks or on a command of
+the plug (piggybacked ack), for a frame loss of 0..10% and with or without a
+command of the plug every 4 blocks.
+
+build and run (from this directory):
+	gcc -Wall -O2 -o sim_ack sim_ack.c
+	./sim_ack
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define RATE_BPS	57600.0
+#define PHY_OVERHEAD	(3 + 2 + 1 + 2)	// preamble, sync, length, CRC
+#define MIWI_HEADER	11
+#define TX_BUFFER	50
+#define FRAME_PAYLOAD	(TX_BUFFER - MIWI_HEADER)
+#define MAC_ACK_BYTES	(PHY_OVERHEAD + 2)
+#define T_TURN	1.5	// ms: TX<->RX switch, SPI load, ISR
+#define T_CSMA	1.0	// ms: mean backoff before a frame
+#define T_ACK_WAIT	8.0	// ms: MAC ack timeout
+#define T_PLUG_PROC	3.0	// ms: PlugHandler (USB frame) before the ack
+#define MAC_RETRIES	5
+#define BLOCK	512
+#define TRAILER	4
+#define TXRX_TIMEOUT	400.0	// ms: TIMEOUT_RECEIVING_MESSAGE
+#define WINDOW	3
+#define ACK_EVERY	2
+#define ACK_TIMEOUT	600.0
+
+static double p;	// loss probability of each frame (data and MAC ack alike)
+static double now;	// ms
+static long turns;	// link direction reversals
+static long reverseFrames;	// TxRx frames from the plug to the stone
+
+static int lost(void) { return drand48() < p; }
+static double air(int bytes) { return bytes * 8.0 * 1000.0 / RATE_BPS; }
+
+// one MAC-acked frame; returns 1 if delivered (and the sender learnt it)
+static int frame(int payload, int *delivered)
+{
+	int a;
+	*delivered = 0;
+	for (a = 0; a <= MAC_RETRIES; a++) {
+		now += T_CSMA + air(PHY_OVERHEAD + MIWI_HEADER + payload) + T_TURN;
+		turns++;
+		if (lost()) { now += T_ACK_WAIT; continue; }
+		*delivered = 1;
+		now += air(MAC_ACK_BYTES) + T_TURN;
+		turns++;
+		if (lost()) { now += T_ACK_WAIT - air(MAC_ACK_BYTES) - T_TURN; continue; }
+		return 1;
+	}
+	return 0;
+}
+
+// a TxRx block of len bytes (header included); returns 1 if the receiver got all of it
+static int block(int len)
+{
+	int ok = 1, d, n = (len + FRAME_PAYLOAD - 1) / FRAME_PAYLOAD;
+	while (n--) {
+		while (!frame(FRAME_PAYLOAD, &d)) ;     // TxRx_TransmitBuffer retries until TIMEOUT_RESENDING_PACKET
+		ok &= d;
+	}
+	return ok;
+}
+
+static int ackFrame(void)
+{
+	int d;
+	reverseFrames++;
+	frame(1 + 2 + 2 + 2, &d);
+	return d;
+}
+
+// cmdEvery: the plug sends a command (e.g. a status query) every cmdEvery blocks, 0 - none
+static void run(int mode, int cmdEvery, long blocks, double *tpb, double *turnsPerBlock, double *goodput, double *rev)
+{
+	long delivered = 0, sent = 0;
+	int pending = 0, outstanding = 0;
+	now = 0; turns = 0; reverseFrames = 0;
+	while (delivered < blocks) {
+		int cmd = cmdEvery && (sent % cmdEvery == cmdEvery - 1);
+		if (mode == 0) {                            // stop-and-wait
+			int got = block(7 + BLOCK + TRAILER);
+			now += T_PLUG_PROC;
+			if (got && ackFrame()) { delivered++; sent++; }
+			else now += TXRX_TIMEOUT;               // the stone waits, and sends the block again
+			if (cmd) {                              // the command and its ack
+				reverseFrames++;
+				block(9 + 20 + TRAILER);
+				ackFrame(); reverseFrames--;        // the ack of the stone is not a reverse frame
+			}
+		} else {                                    // window, cumulative and piggybacked acks
+			int got = block(8 + BLOCK + TRAILER);
+			sent++; outstanding++;
+			if (got) { delivered++; pending++; }
+			now += T_PLUG_PROC / 4;                 // the plug handles the block while the next one starts
+			if (cmd && pending) {                   // the ack rides on the command
+				reverseFrames++;
+				block(10 + 20 + TRAILER);
+				ackFrame(); reverseFrames--;
+				pending = 0; outstanding = 0;
+			} else if (cmd) {
+				reverseFrames++; block(10 + 20 + TRAILER); ackFrame(); reverseFrames--;
+			}
+			if (pending >= ACK_EVERY) {
+				if (ackFrame()) outstanding = 0;
+				pending = 0;
+			}
+			if (!got) {                             // go back N after the ack timeout
+				now += ACK_TIMEOUT;
+				delivered -= pending; pending = 0;
+				outstanding = 0;
+			}
+			if (outstanding >= WINDOW) { now += ACK_TIMEOUT; outstanding = 0; }
+		}
+	}
+	*tpb = now / blocks;
+	*turnsPerBlock = (double)turns / blocks;
+	*goodput = blocks * BLOCK * 8.0 / now;          // kbit/s
+	*rev = (double)reverseFrames / blocks;
+}
+
+int main(void)
+{
+	double ps[] = { 0.0, 0.01, 0.05, 0.10 };
+	int cmds[] = { 0, 4 };
+	int i, c, m;
+	srand48(1);
+	printf("loss  cmd/blk  mode        ms/block  turns/block  reverse frames/block  goodput kbps\n");
+	for (c = 0; c < 2; c++)
+	for (i = 0; i < 4; i++)
+	for (m = 0; m < 2; m++) {
+		double tpb, tb, g, r;
+		p = ps[i];
+		run(m, cmds[c], 20000, &tpb, &tb, &g, &r);
+		printf("%4.0f%%  %-7s  %-10s  %8.1f  %11.2f  %20.2f  %12.2f\n", p * 100,
+			cmds[c] ? "1/4" : "none", m ? "cumulative" : "stop-wait", tpb, tb, r, g);
+	}
+	return 0;
+}
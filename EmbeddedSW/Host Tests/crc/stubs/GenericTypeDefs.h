@@ -0,0 +1,10 @@
+/* host stub of GenericTypeDefs.h */
+#ifndef __GENERIC_TYPE_DEFS_H_
+#define __GENERIC_TYPE_DEFS_H_
+
+#define ROM						const
+
+typedef unsigned char			BYTE;		/* 8-bit unsigned  */
+typedef unsigned short			WORD;		/* 16-bit unsigned */
+
+#endif //__GENERIC_TYPE_DEFS_H_
@@ -0,0 +1,7 @@
+/* host stub of Transceivers.h - the MRF49XA computes its CRC in software */
+#ifndef __TRANSCEIVERS_H
+#define __TRANSCEIVERS_H
+
+#define SOFTWARE_CRC
+
+#endif
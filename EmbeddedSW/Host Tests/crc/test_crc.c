@@ -0,0 +1,113 @@
+/*******************************************************************************
+
+test_crc.c - host test of the MRF49XA software CRC (Source Files/TxRx/Transceivers/crc.c)
+========================================================================================
+
+checks the table method that the transceiver uses:
+- CRC16() and the running CRC16_BYTE (crc.h) against the reference vectors of
+  CRC-16/XMODEM (poly 0x1021, init 0, no reflection, no final XOR)
+- CRC16_BYTE against a bitwise reference, over random frames of 4..124 bytes
+  (the MRF49XA frame sizes)
+- the receive side check of the ISR: the CRC over a frame followed by its own
+  big endian CRC is 0, and every single bit error is detected
+
+build and run (from this directory):
+	gcc -Wall -I stubs -I "../../Header Files/TxRx" -o test_crc test_crc.c "../../Source Files/TxRx/Transceivers/crc.c"
+	./test_crc
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "GenericTypeDefs.h"
+#include "Transceivers/crc.h"
+
+#define NUM_OF_FRAMES	200000
+#define MIN_FRAME_LEN	4
+#define MAX_FRAME_LEN	124
+
+typedef struct {
+	const char	*data;
+	int			len;
+	WORD		crc;
+} CRC_VECTOR;
+
+static const CRC_VECTOR vectors[] = {
+	{"", 					0, 0x0000},
+	{"\xFF", 				1, 0x1EF0},
+	{"123456789", 			9, 0x31C3},		// the standard check value of CRC-16/XMODEM
+	{"Wistone", 			7, 0x3C85},
+};
+
+static int failures = 0;
+
+static void fail(const char *what, int index)
+{
+	if (failures++ < 20)
+		printf("FAIL: %s at %d\n", what, index);
+}
+
+static WORD crc_bitwise(const BYTE *data, int len)
+{
+	WORD	crc = 0;
+	int		i;
+
+	while (len-- > 0) {
+		crc ^= (WORD)*data++ << 8;
+		for (i = 0; i < 8; i++)
+			crc = (crc & 0x8000) ? (WORD)((crc << 1) ^ 0x1021) : (WORD)(crc << 1);
+	}
+	return crc;
+}
+
+static WORD crc_running(const BYTE *data, int len)
+{
+	WORD crc = 0;
+
+	while (len-- > 0)
+		crc = CRC16_BYTE(crc, *data++);
+	return crc;
+}
+
+int main(void)
+{
+	BYTE	frame[MAX_FRAME_LEN];
+	BYTE	all[256];
+	WORD	crc;
+	int		i, n, len;
+
+	for (i = 0; i < (int)(sizeof(vectors) / sizeof(vectors[0])); i++) {
+		if (CRC16((BYTE *)vectors[i].data, (signed char)vectors[i].len, 0) != vectors[i].crc)
+			fail("CRC16 vector", i);
+		if (crc_running((const BYTE *)vectors[i].data, vectors[i].len) != vectors[i].crc)
+			fail("CRC16_BYTE vector", i);
+	}
+	for (i = 0; i < 256; i++)
+		all[i] = (BYTE)i;
+	if (crc_running(all, 256) != crc_bitwise(all, 256))		// every table entry
+		fail("CRC16_BYTE table", 0);
+
+	srand(1);
+	for (n = 0; n < NUM_OF_FRAMES; n++) {
+		len = MIN_FRAME_LEN + rand() % (MAX_FRAME_LEN - MIN_FRAME_LEN + 1);
+		for (i = 0; i < len - 2; i++)
+			frame[i] = (BYTE)rand();
+		crc = crc_running(frame, len - 2);					// TxPacket
+		if ((crc != crc_bitwise(frame, len - 2)) || (crc != CRC16(frame, (signed char)(len - 2), 0)))
+			fail("frame CRC", n);
+		frame[len - 2] = (BYTE)(crc >> 8);
+		frame[len - 1] = (BYTE)crc;
+		if (crc_running(frame, len) != 0)					// _INT1Interrupt
+			fail("frame residue", n);
+		frame[rand() % len] ^= (BYTE)(1 << (rand() % 8));
+		if (crc_running(frame, len) == 0)
+			fail("single bit error not detected", n);
+	}
+
+	if (failures != 0) {
+		printf("%d failures\n", failures);
+		return 1;
+	}
+	printf("PASS\n");
+	return 0;
+}
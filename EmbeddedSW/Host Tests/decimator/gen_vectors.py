@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+"""
+gen_vectors.py - golden model of the OST decimator (Source Files/decimator.c)
+
+- designs the Q15 tables the same way they were designed for decimator.c
+  (Hamming windowed sinc, factor x 6 taps, fc = 0.8 / 0.5 of the output Nyquist,
+  rounding residue folded into the two centre taps) and checks that they are
+  the tables in decimator.c
+- checks the 32 bit accumulator headroom of the accelerometer path
+  (sum of |h| x 32768 < 2^31)
+- filters the test input (the same LCG as test_decimator.c) with exact integer
+  arithmetic, and writes the expected outputs to vectors.txt:
+      y[m] = sat((sum(h[i] * x[m * factor - i]) + 2^14) >> 15),  x[n < 0] = 0
+
+usage: python3 gen_vectors.py [path to decimator.c]
+"""
+import math
+import os
+import re
+import sys
+
+TAPS_PER_PHASE = 6
+FACTORS = (2, 4, 8)
+CUTOFFS = (("wide", 0.8), ("narrow", 0.5))
+ACCMTR_BLOCKS = 8           # x 84 samples x 3 axes
+ADS1282_BLOCKS = 8          # x 126 samples
+ACCMTR_SAMPLES = 84
+ADS1282_SAMPLES = 126
+AXES = 3
+
+
+def design(factor, frac):
+    n_taps = factor * TAPS_PER_PHASE
+    fc = frac * 0.5 / factor
+    h = []
+    for i in range(n_taps):
+        n = i - (n_taps - 1) / 2
+        x = 2 * fc * n
+        sinc = 1.0 if x == 0 else math.sin(math.pi * x) / (math.pi * x)
+        h.append(2 * fc * sinc * (0.54 - 0.46 * math.cos(2 * math.pi * i / (n_taps - 1))))
+    s = sum(h)
+    q = [int(round(x / s * 32768)) for x in h]
+    d = 32768 - sum(q)
+    c = n_taps // 2
+    q[c - 1] += d // 2
+    q[c] += d - d // 2
+    return q
+
+
+def tree_tables(path):
+    text = open(path, encoding="latin-1").read()
+    tabs = {}
+    for name, body in re.findall(r"decim_coeffs_(\w+)\[[^]]*\]\s*=\s*\{([^}]*)\}", text):
+        tabs[name] = [int(v) for v in body.replace("\n", " ").split(",") if v.strip()]
+    return tabs
+
+
+class Lcg:
+    """the LCG of test_decimator.c - the upper 16 bits of each step"""
+    def __init__(self, seed):
+        self.s = seed
+
+    def next16(self):
+        self.s = (self.s * 1103515245 + 12345) & 0xFFFFFFFF
+        return self.s >> 16
+
+
+def s16(v):
+    return v - 0x10000 if v & 0x8000 else v
+
+
+def s32(v):
+    return v - 0x100000000 if v & 0x80000000 else v
+
+
+def decimate(q, factor, x, lo, hi):
+    y = []
+    for m in range(len(x) // factor):
+        acc = 0
+        for i, h in enumerate(q):
+            n = m * factor - i
+            if n >= 0:
+                acc += h * x[n]
+        v = (acc + (1 << 14)) >> 15
+        y.append(min(max(v, lo), hi))
+    return y
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    src = sys.argv[1] if len(sys.argv) > 1 else os.path.join(here, "..", "..", "Source Files", "decimator.c")
+    tabs = tree_tables(src)
+
+    lcg = Lcg(1)
+    accmtr = [[] for _ in range(AXES)]
+    for _ in range(ACCMTR_BLOCKS * ACCMTR_SAMPLES):
+        for axis in range(AXES):
+            accmtr[axis].append(s16(lcg.next16()))
+    ads1282 = []
+    for _ in range(ADS1282_BLOCKS * ADS1282_SAMPLES):
+        hi = lcg.next16()
+        ads1282.append(s32((hi << 16) | lcg.next16()))
+
+    out = open(os.path.join(here, "vectors.txt"), "w", newline="\n")
+    out.write("# expected outputs of decimator.c - generated by gen_vectors.py, do not edit\n")
+    for cut, frac in CUTOFFS:
+        for factor in FACTORS:
+            name = "%s_x%d" % (cut, factor)
+            q = design(factor, frac)
+            assert sum(q) == 32768, name
+            assert tabs.get(name) == q, "decim_coeffs_%s differs from the design" % name
+            assert sum(abs(h) for h in q) * 32768 < (1 << 31), "accumulator headroom of " + name
+            ys = [decimate(q, factor, accmtr[axis], -32768, 32767) for axis in range(AXES)]
+            ya = decimate(q, factor, ads1282, -(1 << 31), (1 << 31) - 1)
+            out.write("accmtr %s %d\n" % (cut, factor))
+            for m in range(len(ys[0])):
+                out.write("%d %d %d\n" % (ys[0][m], ys[1][m], ys[2][m]))
+            out.write("ads1282 %s %d\n" % (cut, factor))
+            for v in ya:
+                out.write("%d\n" % v)
+    out.close()
+    print("tables match the design, vectors.txt written")
+
+
+if __name__ == "__main__":
+    main()
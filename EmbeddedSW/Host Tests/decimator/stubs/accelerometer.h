@@ -0,0 +1,12 @@
+/* host stub of accelerometer.h - the sampler block layout */
+#ifndef __ACCELEROMETER_H__
+#define __ACCELEROMETER_H__
+
+#define ACCMTR_SAMP_SIZE		6
+#define BLOCK_TAIL_SIZE			8
+#define LAST_DATA_BYTE			((MAX_BLOCK_SIZE - BLOCK_TAIL_SIZE) - 1)
+#define RETRY_COUNTER_LOCATION	(LAST_DATA_BYTE + 1)
+#define HW_OVERFLOW_LOCATION	(LAST_DATA_BYTE + 2)
+#define SW_OVERFLOW_LOCATION	(LAST_DATA_BYTE + 3)
+
+#endif //__ACCELEROMETER_H__
@@ -0,0 +1 @@
+/* host stub of ads1282.h - nothing is needed */
@@ -0,0 +1,11 @@
+/* host stub of error.h */
+#ifndef __ERROR_H__
+#define __ERROR_H__
+
+typedef enum {
+	ERR_INVALID_DECIM = 1
+} ErrType;
+
+int err(ErrType err);
+
+#endif //__ERROR_H__
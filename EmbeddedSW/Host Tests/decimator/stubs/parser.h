@@ -0,0 +1,10 @@
+/* host stub of parser.h */
+#ifndef __PARSER_H__
+#define __PARSER_H__
+
+typedef enum {
+	CUTOFF_WIDE = 0,
+	CUTOFF_NARROW
+} CutoffTypes;
+
+#endif //__PARSER_H__
@@ -0,0 +1,10 @@
+/* host stub of wistone_main.h - only what decimator.c needs */
+#ifndef __WISTONE_MAIN_H__
+#define __WISTONE_MAIN_H__
+
+#include "GenericTypeDefs.h"
+
+#define WISDOM_STONE
+#define MAX_BLOCK_SIZE			512
+
+#endif //__WISTONE_MAIN_H__
@@ -0,0 +1,208 @@
+/*******************************************************************************
+
+test_decimator.c - host test of Source Files/decimator.c
+=======================================================
+
+feeds the accelerometer and ADS1282 paths of the decimator with the input of
+gen_vectors.py (same LCG), for every factor and cut-off, and compares:
+- every output sample with vectors.txt (exact, the golden model rounds the
+  same way: (acc + 2^14) >> 15, saturated)
+- the number of output blocks (input blocks / factor)
+- the tail of each output block: 'x' padding, retry counter 0, and the
+  overflow counters of the input blocks that were folded into it
+
+build and run (from this directory):
+	python3 gen_vectors.py
+	gcc -Wall -I stubs -I "../../Header Files" -o test_decimator test_decimator.c "../../Source Files/decimator.c"
+	./test_decimator
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "wistone_main.h"
+#include "decimator.h"
+#include "error.h"
+#include "parser.h"
+#include "accelerometer.h"
+
+#define ACCMTR_BLOCKS		8
+#define ADS1282_BLOCKS		8
+#define ACCMTR_SAMPLES		((LAST_DATA_BYTE + 1) / ACCMTR_SAMP_SIZE)
+#define ADS1282_SAMPLES		((LAST_DATA_BYTE + 1) / DECIM_ADS1282_SAMP_SIZE)
+#define AXES				3
+#define IN_HW_OVERFLOW		1		// overflow counters of each input block
+#define IN_SW_OVERFLOW		2
+
+static SHORT	accmtr_in[ACCMTR_BLOCKS * ACCMTR_SAMPLES][AXES];
+static LONG		ads1282_in[ADS1282_BLOCKS * ADS1282_SAMPLES];
+static DWORD	lcg_state = 1;
+static int		failures = 0;
+
+int err(ErrType type)
+{
+	(void)type;
+	return -1;
+}
+
+static WORD lcg_next16(void)
+{
+	lcg_state = lcg_state * 1103515245u + 12345u;
+	return (WORD)(lcg_state >> 16);
+}
+
+static void make_input(void)
+{
+	int i, axis;
+
+	for (i = 0; i < ACCMTR_BLOCKS * ACCMTR_SAMPLES; i++)
+		for (axis = 0; axis < AXES; axis++)
+			accmtr_in[i][axis] = (SHORT)lcg_next16();
+	for (i = 0; i < ADS1282_BLOCKS * ADS1282_SAMPLES; i++) {
+		DWORD hi = lcg_next16();
+		ads1282_in[i] = (LONG)((hi << 16) | lcg_next16());
+	}
+}
+
+static void fail(const char *what, const char *name, int factor, int index)
+{
+	if (failures++ < 20)
+		printf("FAIL: %s %s x%d at %d\n", what, name, factor, index);
+}
+
+static void check_tail(BYTE *blk, int factor, const char *name, int index)
+{
+	int i;
+
+	for (i = LAST_DATA_BYTE + 1; i < MAX_BLOCK_SIZE; i++) {
+		if ((i != RETRY_COUNTER_LOCATION) && (i != HW_OVERFLOW_LOCATION) && (i != SW_OVERFLOW_LOCATION) && (blk[i] != 'x'))
+			fail("tail padding", name, factor, index);
+	}
+	if ((blk[RETRY_COUNTER_LOCATION] != 0) ||
+		(blk[HW_OVERFLOW_LOCATION] != IN_HW_OVERFLOW * factor) ||
+		(blk[SW_OVERFLOW_LOCATION] != IN_SW_OVERFLOW * factor))
+		fail("tail counters", name, factor, index);
+}
+
+static void set_tail(BYTE *blk)
+{
+	memset(&blk[LAST_DATA_BYTE + 1], 'x', BLOCK_TAIL_SIZE);
+	blk[RETRY_COUNTER_LOCATION] = 0;
+	blk[HW_OVERFLOW_LOCATION] = IN_HW_OVERFLOW;
+	blk[SW_OVERFLOW_LOCATION] = IN_SW_OVERFLOW;
+}
+
+static int read_header(FILE *f, const char *path, const char *cut, int factor)
+{
+	char	p[16], c[16];
+	int		r;
+
+	if ((fscanf(f, "%15s %15s %d", p, c, &r) != 3) || strcmp(p, path) || strcmp(c, cut) || (r != factor)) {
+		printf("FAIL: vectors.txt is out of order at %s %s x%d - run gen_vectors.py\n", path, cut, factor);
+		return -1;
+	}
+	return 0;
+}
+
+static int test_accmtr(FILE *f, int cutoff, const char *cut, int factor)
+{
+	BYTE	blk[MAX_BLOCK_SIZE];
+	BYTE	*out;
+	int		b, i, axis, m = 0, blocks = 0;
+	long	expected;
+	SHORT	y;
+
+	if (read_header(f, "accmtr", cut, factor) != 0)
+		return -1;
+	decim_init(factor, cutoff);
+	for (b = 0; b < ACCMTR_BLOCKS; b++) {
+		for (i = 0; i < ACCMTR_SAMPLES; i++) {
+			for (axis = 0; axis < AXES; axis++) {
+				blk[i * ACCMTR_SAMP_SIZE + 2 * axis] = (BYTE)((WORD)accmtr_in[b * ACCMTR_SAMPLES + i][axis] >> 8);
+				blk[i * ACCMTR_SAMP_SIZE + 2 * axis + 1] = (BYTE)accmtr_in[b * ACCMTR_SAMPLES + i][axis];
+			}
+		}
+		set_tail(blk);
+		while ((out = decim_accmtr_block(blk)) != NULL) {
+			check_tail(out, factor, cut, blocks++);
+			for (i = 0; i <= LAST_DATA_BYTE; i += ACCMTR_SAMP_SIZE, m++) {
+				for (axis = 0; axis < AXES; axis++) {
+					y = (SHORT)(((WORD)out[i + 2 * axis] << 8) | out[i + 2 * axis + 1]);
+					if ((fscanf(f, "%ld", &expected) != 1) || (y != expected))
+						fail("accmtr sample", cut, factor, m);
+				}
+			}
+		}
+	}
+	if (blocks != ACCMTR_BLOCKS / factor)
+		fail("accmtr block count", cut, factor, blocks);
+	return 0;
+}
+
+static int test_ads1282(FILE *f, int cutoff, const char *cut, int factor)
+{
+	BYTE	blk[MAX_BLOCK_SIZE];
+	BYTE	*out;
+	int		b, i, m = 0, blocks = 0;
+	long	expected;
+	LONG	y;
+
+	if (read_header(f, "ads1282", cut, factor) != 0)
+		return -1;
+	decim_init(factor, cutoff);
+	for (b = 0; b < ADS1282_BLOCKS; b++) {
+		for (i = 0; i < ADS1282_SAMPLES; i++) {
+			DWORD v = (DWORD)ads1282_in[b * ADS1282_SAMPLES + i];
+			blk[i * 4] = (BYTE)(v >> 24);
+			blk[i * 4 + 1] = (BYTE)(v >> 16);
+			blk[i * 4 + 2] = (BYTE)(v >> 8);
+			blk[i * 4 + 3] = (BYTE)v;
+		}
+		set_tail(blk);
+		while ((out = decim_ads1282_block(blk)) != NULL) {
+			check_tail(out, factor, cut, blocks++);
+			for (i = 0; i <= LAST_DATA_BYTE; i += DECIM_ADS1282_SAMP_SIZE, m++) {
+				y = (LONG)(((DWORD)out[i] << 24) | ((DWORD)out[i + 1] << 16) | ((DWORD)out[i + 2] << 8) | out[i + 3]);
+				if ((fscanf(f, "%ld", &expected) != 1) || (y != expected))
+					fail("ads1282 sample", cut, factor, m);
+			}
+		}
+	}
+	if (blocks != ADS1282_BLOCKS / factor)
+		fail("ads1282 block count", cut, factor, blocks);
+	return 0;
+}
+
+int main(void)
+{
+	static const int	factors[] = {2, 4, 8};
+	static const char	*cuts[] = {"wide", "narrow"};
+	char				line[128];
+	FILE				*f;
+	int					c, r;
+
+	if ((f = fopen("vectors.txt", "r")) == NULL) {
+		printf("FAIL: no vectors.txt - run gen_vectors.py\n");
+		return 1;
+	}
+	fgets(line, sizeof(line), f);		// comment line
+	make_input();
+	for (c = CUTOFF_WIDE; c <= CUTOFF_NARROW; c++) {
+		for (r = 0; r < 3; r++) {
+			if ((test_accmtr(f, c, cuts[c], factors[r]) != 0) || (test_ads1282(f, c, cuts[c], factors[r]) != 0)) {
+				fclose(f);
+				return 1;
+			}
+		}
+	}
+	fclose(f);
+	if (decim_init(3, CUTOFF_WIDE) != -1)
+		fail("invalid factor accepted", "-", 3, 0);
+	if ((decim_init(2, CUTOFF_NARROW + 1) != -1) || (g_decim_factor != 8) || (g_decim_cutoff != CUTOFF_NARROW))
+		fail("invalid cutoff changed the state", "-", 2, 0);
+	if (failures != 0) {
+		printf("%d failures\n", failures);
+		return 1;
+	}
+	printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""
+sim.py - low power listening of an idle stone (ENABLE_LOW_POWER_LISTEN)
+
+the average current of a dozing stone, and the time until the wake frames of
+the plug reach it, against the wake interval (LPL_INTERVAL_MS) and the listen
+window (LPL_LISTEN_MS). the plug sends a wake frame every LPL_WAKE_GAP for
+LPL_WAKE_TIME; a stone that hears no whole frame in its window is reached
+after a failed delivery attempt. the currents are assumed (data sheet figures), not measured.
+
+run (from this directory):
+	python3 sim.py
+"""
+import random
+BITRATE = 57600
+FRAME_BYTES = 3 + 2 + 1 + 6 + 11 + 2 + 2      # preamble, sync, length, MAC header, MiWi header, [LPL_WAKE_ID, eui0], CRC
+AIR = FRAME_BYTES * 8 * 1000.0 / BITRATE      # ms
+PERIOD = 5.0                                  # ms from a wake frame to the next (LPL_WAKE_GAP)
+STARTUP = 10.0                                # ms, LPL_STARTUP_MS
+I_MCU_RUN, I_MCU_SLEEP = 12.0, 0.05           # mA (assumed, PIC24FJ256GB110 @ 16 MIPS / sleep with RTCC)
+I_RX, I_OSC, I_WAKE_TIMER = 11.0, 0.6, 0.0015 # mA (MRF49XA receiver on / oscillator only / wake-up timer)
+CMD_FAIL = 2000.0                             # ms, a failed delivery attempt (TIMEOUT_RESENDING_PACKET) before the plug wakes again
+I_AWAKE = I_MCU_RUN + I_RX
+
+def current(interval, listen):
+    cycle = interval + STARTUP + listen
+    q = interval * (I_MCU_SLEEP + I_WAKE_TIMER) + STARTUP * (I_MCU_RUN + I_OSC) + listen * I_AWAKE
+    return q / cycle
+
+def woken(listen, loss, phase_frames):
+    # the strobe is aligned at a random phase to the listen window; the stone must hear a whole frame inside it
+    offset = random.uniform(0, PERIOD)
+    t = offset
+    while t + AIR <= listen:
+        if random.random() >= loss:
+            return True
+        t += PERIOD
+    return False
+
+def simulate(interval, listen, loss, runs=20000):
+    wake = interval + STARTUP + listen        # LPL_WAKE_TIME
+    total = 0.0
+    worst = 0.0
+    misses = 0
+    for _ in range(runs):
+        lat = 0.0
+        while True:
+            lat += wake
+            if woken(listen, loss, 0):
+                break
+            misses += 1
+            lat += CMD_FAIL
+        total += lat
+        worst = max(worst, lat)
+    return wake, total / runs, misses / float(runs)
+
+random.seed(1)
+print("frame %.2f ms, strobe period %.2f ms, always-on idle %.1f mA" % (AIR, PERIOD, I_AWAKE))
+print("%9s %7s %6s %9s %8s %9s %11s %11s" % ("interval", "listen", "duty%", "avg mA", "saving", "bound ms", "mean@5%loss", "miss@20%"))
+for interval in (250, 500, 1000, 2000, 4000):
+    for listen in (10, 20, 40):
+        i = current(interval, listen)
+        duty = 100.0 * (STARTUP + listen) / (interval + STARTUP + listen)
+        bound, mean5, _ = simulate(interval, listen, 0.05)
+        _, _, miss20 = simulate(interval, listen, 0.20)
+        print("%9d %7d %6.1f %9.3f %7.1fx %9.0f %11.0f %11.4f" % (interval, listen, duty, i, I_AWAKE / i, bound, mean5, miss20))
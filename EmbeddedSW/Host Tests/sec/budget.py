@@ -0,0 +1,44 @@
+# Throughput budget of a sealed 512 byte data block (stone -> plug) with the MRF49XA and MiWi as configured:
+# the air time of the frames and MAC acks plus the time of CCM_SealBlock on the PIC24 (the plug opens the block
+# after it acked it, so only the stone's sealing delays the link).
+import math
+
+FCY = 20e6 / 2                              # CLOCK_FREQ / 2 (C30)
+PAYLOAD = 50 - 11                           # TX_BUFFER_SIZE - MIWI_HEADER_LEN: TxRx bytes per frame
+FRAME_OVH = 3 + 2 + 1 + 6 + 11 + 2 + 2      # preamble, sync, length, MAC header, MiWi header, CRC, dummy
+MAC_ACK = 3 + 2 + 1 + 4 + 2 + 2             # MAC ack frame
+TX_ENABLE = 1e-3                            # DelayMs(1) in TxPacket
+TURNAROUND = 1e-3                           # rx->tx and the plug's handling of each frame
+HDR = 1 + 1 + 2 + 1                         # compact header: info, source, length (2 bytes), piggybacked ack
+TRAILER = 2
+BLOCK = 512
+
+# PIC24 cycles of XTEA_Encode (with the call) and of the CCM_LOAD/STORE/COUNTER of one cipher block. These are
+# counts of the instruction sequences by hand, not measured (no simulator here): a 16-bit half round is 7
+# instructions, a 32-bit one 16 (the shifts and adds of the two halves of each double word).
+ENGINES = (
+	# name,      cipher block bytes, encode cycles, cycles per cipher block, header + MIC
+	("XTEA-64",  4,                  450,           30,                     4 + 4),
+	("XTEA-128", 8,                  1100,          80,                     6 + 8),
+)
+
+def crypto(block, enc, chunk, n=BLOCK):
+	blocks = math.ceil(n / block)
+	return ((2 * blocks + 3) * enc + blocks * chunk) / FCY
+
+def block_time(rate, n):
+	total = HDR + n + TRAILER
+	frames = math.ceil(total / PAYLOAD)
+	air = (total + frames * (FRAME_OVH + MAC_ACK)) * 8 / rate
+	ack = ((HDR + TRAILER + FRAME_OVH + MAC_ACK) * 8 / rate + TX_ENABLE + TURNAROUND) / 2   # a TxRx ack every 2 blocks
+	return frames, air + frames * (TX_ENABLE + TURNAROUND) + ack
+
+for name, size, enc, chunk, seal in ENGINES:
+	print("%-8s crypto per %d byte block: %.1f ms" % (name, BLOCK, crypto(size, enc, chunk) * 1e3))
+for rate in (19200, 38400, 57600, 115200):
+	fp, tp = block_time(rate, BLOCK)
+	for name, size, enc, chunk, seal in ENGINES:
+		fs, ts = block_time(rate, BLOCK + seal)
+		t = ts + crypto(size, enc, chunk)
+		print("%6d bps: plaintext %d frames %3.0f ms/block; %-8s sealed %d frames %3.0f ms/block -> %.1f%% of the plaintext throughput"
+			% (rate, fp, tp * 1e3, name, fs, t * 1e3, 100 * tp / t))
@@ -0,0 +1,13 @@
+/* host stub of GenericTypeDefs.h - the C30 sizes on a 32/64 bit host */
+#ifndef __GENERIC_TYPE_DEFS_H_
+#define __GENERIC_TYPE_DEFS_H_
+
+#define ROM						const
+
+typedef enum _BOOL { FALSE = 0, TRUE } BOOL;
+
+typedef unsigned char			BYTE;		/* 8-bit unsigned  */
+typedef unsigned short			WORD;		/* 16-bit unsigned */
+typedef unsigned int			DWORD;		/* 32-bit unsigned */
+
+#endif //__GENERIC_TYPE_DEFS_H_
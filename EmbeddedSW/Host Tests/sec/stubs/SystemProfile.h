@@ -0,0 +1,7 @@
+/* host stub of SystemProfile.h - only the TxRx block security, as in ConfigApp.h */
+#ifndef __SYSTEM_PROFILE_H
+#define __SYSTEM_PROFILE_H
+
+#define ENABLE_TXRX_SECURITY
+
+#endif
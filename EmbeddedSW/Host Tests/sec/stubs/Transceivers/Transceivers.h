@@ -0,0 +1,28 @@
+/* host stub of Transceivers.h - the MRF49XA has the software security engine (the key of ConfigMRF49XA.h) */
+#ifndef __TRANSCEIVERS_H
+#define __TRANSCEIVERS_H
+
+#include "GenericTypeDefs.h"
+
+#define SOFTWARE_SECURITY
+
+#define SECURITY_KEY_00 0x00
+#define SECURITY_KEY_01 0x01
+#define SECURITY_KEY_02 0x02
+#define SECURITY_KEY_03 0x03
+#define SECURITY_KEY_04 0x04
+#define SECURITY_KEY_05 0x05
+#define SECURITY_KEY_06 0x06
+#define SECURITY_KEY_07 0x07
+#define SECURITY_KEY_08 0x08
+#define SECURITY_KEY_09 0x09
+#define SECURITY_KEY_10 0x0a
+#define SECURITY_KEY_11 0x0b
+#define SECURITY_KEY_12 0x0c
+#define SECURITY_KEY_13 0x0d
+#define SECURITY_KEY_14 0x0e
+#define SECURITY_KEY_15 0x0f
+
+#define SECURITY_LEVEL	SEC_LEVEL_CCM_16
+
+#endif
@@ -0,0 +1,257 @@
+/*******************************************************************************
+
+test_sec.c - host test of the TxRx block security (Source Files/TxRx/Transceivers/security.c)
+==========================================================================================
+
+checks the engine and the block CCM that seal the data blocks of the stones
+(ENABLE_TXRX_SECURITY):
+- XTEA_Schedule + XTEA_Encode against the reference code of Needham and
+  Wheeler (64-bit block, 128-bit key, 32 cycles), on random keys and texts,
+  and against the published test vectors
+- CCM_SealBlock against a byte-wise reference of the same CCM (built on the
+  reference XTEA), over texts of 0..1016 bytes, in place too
+- CCM_OpenBlock: the round trip, every tampered block (one flipped bit of
+  the text or the MIC) and every wrong nonce is rejected
+- the vectors of the block CCM below, with the key of ConfigMRF49XA.h
+and prints the host time of sealing a 512 byte block (not of the PIC24 -
+budget.py has the PIC24 figures).
+
+build and run (from this directory):
+	gcc -Wall -O2 -I stubs -I "../../Header Files/TxRx" -o test_sec test_sec.c "../../Source Files/TxRx/Transceivers/security.c"
+	./test_sec
+	python3 budget.py
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include "GenericTypeDefs.h"
+#include "Transceivers/Security.h"
+
+#define NUM_OF_KERNEL_CASES		200000
+#define NUM_OF_CCM_CASES		3000
+#define MAX_TEXT_LEN			1016
+#define NUM_OF_TIMED_BLOCKS		20000
+
+typedef struct {
+	BYTE	key[16];
+	BYTE	plain[8];
+	BYTE	cipher[8];
+} XTEA_VECTOR;
+
+// the published vectors of the 32 cycle XTEA (words big endian)
+static const XTEA_VECTOR xteaVectors[] = {
+	{{0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f},
+	 {0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48}, {0x49, 0x7d, 0xf3, 0xd0, 0x72, 0x61, 0x2c, 0xb5}},
+	{{0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f},
+	 {0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41}, {0xe7, 0x8f, 0x2d, 0x13, 0x74, 0x43, 0x41, 0xd8}},
+	{{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+	 {0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48}, {0xa0, 0x39, 0x05, 0x89, 0xf8, 0xb8, 0xef, 0xa5}},
+	{{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+	 {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, {0xde, 0xe9, 0xd4, 0xd8, 0xf7, 0x13, 0x1e, 0xd9}},
+};
+
+// sealed with the key of ConfigMRF49XA.h (00 01 .. 0f) and the nonce 00 00 00 00 00 01 00
+// (the header of the block with counter 1): the text is 00 01 02 .., the MIC follows it.
+// they were made by the code and checked against seal_reference - they keep the format fixed
+static const BYTE ccmNonce[CCM_NONCE_LEN] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00};
+static const BYTE ccmSeal16[16 + CCM_BLOCK_MIC_LEN] = {
+	0x93, 0x9a, 0x7e, 0x4a, 0x9c, 0x33, 0x66, 0x65, 0xca, 0xd3, 0xd8, 0x33, 0x30, 0x5d, 0x05, 0x6b,
+	0x05, 0x5d, 0x4d, 0xb1, 0xf4, 0x56, 0x32, 0x3d};
+static const BYTE ccmSeal5[5 + CCM_BLOCK_MIC_LEN] = {
+	0x93, 0x9a, 0x7e, 0x4a, 0x9c, 0xa4, 0xe6, 0xf3, 0x19, 0xbd, 0x40, 0x81, 0x1e};
+static const BYTE ccmMic512[CCM_BLOCK_MIC_LEN] = {
+	0xb5, 0x3b, 0x8b, 0x5d, 0x8b, 0x8b, 0x06, 0x01};
+
+static int failures = 0;
+
+static void fail(const char *what, int index)
+{
+	if (failures++ < 20)
+		printf("FAIL: %s at %d\n", what, index);
+}
+
+// the reference code of Needham and Wheeler (32 cycles)
+static void xtea_reference(DWORD *v, const DWORD *k)
+{
+	DWORD	v0 = v[0], v1 = v[1], sum = 0, delta = 0x9E3779B9;
+	int		i;
+
+	for (i = 0; i < 32; i++) {
+		v0 += (((v1 << 4) ^ (v1 >> 5)) + v1) ^ (sum + k[sum & 3]);
+		sum += delta;
+		v1 += (((v0 << 4) ^ (v0 >> 5)) + v0) ^ (sum + k[(sum >> 11) & 3]);
+	}
+	v[0] = v0; v[1] = v1;
+}
+
+static DWORD load_be(const BYTE *p)
+{
+	return ((DWORD)p[0] << 24) | ((DWORD)p[1] << 16) | ((DWORD)p[2] << 8) | p[3];
+}
+
+static void store_be(BYTE *p, DWORD w)
+{
+	p[0] = (BYTE)(w >> 24); p[1] = (BYTE)(w >> 16); p[2] = (BYTE)(w >> 8); p[3] = (BYTE)w;
+}
+
+static void block_reference(BYTE *b, const DWORD *k)
+{
+	DWORD v[2];
+
+	v[0] = load_be(b); v[1] = load_be(b + 4);
+	xtea_reference(v, k);
+	store_be(b, v[0]); store_be(b + 4, v[1]);
+}
+
+// the block CCM of CCM_SealBlock, byte by byte: the CBC-MAC of [nonce, 0], [0, 0, len, 0, 0, 0, 0] and the
+// text padded with zeros, encrypted by the counter block [nonce, CCM_CTR_MIC]; the text by [nonce, CCM_CTR_DATA + i]
+static WORD seal_reference(BYTE *dest, const BYTE *text, WORD len, const BYTE *nonce, const DWORD *k)
+{
+	BYTE	mic[8], pad[8], p[8];
+	WORD	i, j;
+	BYTE	ctr = CCM_CTR_DATA;
+
+	memcpy(mic, nonce, CCM_NONCE_LEN); mic[7] = 0;
+	block_reference(mic, k);
+	mic[2] ^= (BYTE)(len >> 8); mic[3] ^= (BYTE)len;
+	block_reference(mic, k);
+	for (i = 0; i < len; i += 8) {
+		for (j = 0; j < 8; j++)
+			p[j] = (i + j < len) ? text[i + j] : 0;
+		for (j = 0; j < 8; j++)
+			mic[j] ^= p[j];
+		block_reference(mic, k);
+		memcpy(pad, nonce, CCM_NONCE_LEN); pad[7] = ctr++;
+		block_reference(pad, k);
+		for (j = 0; (j < 8) && (i + j < len); j++)
+			dest[i + j] = p[j] ^ pad[j];
+	}
+	memcpy(pad, nonce, CCM_NONCE_LEN); pad[7] = CCM_CTR_MIC;
+	block_reference(pad, k);
+	for (j = 0; j < 8; j++)
+		dest[len + j] = mic[j] ^ pad[j];
+	return len + 8;
+}
+
+static void print_hex(const char *name, const BYTE *b, int len)
+{
+	int i;
+
+	printf("%s", name);
+	for (i = 0; i < len; i++)
+		printf("%02x", b[i]);
+	printf("\n");
+}
+
+static double now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+	static BYTE	text[MAX_TEXT_LEN], a[MAX_TEXT_LEN + CCM_BLOCK_MIC_LEN], b[MAX_TEXT_LEN + CCM_BLOCK_MIC_LEN];
+	DWORD		key[4], schedule[XTEA_SCHEDULE_SIZE], x[2], y[2];
+	BYTE		nonce[CCM_NONCE_LEN];
+	WORD		len, la, lb;
+	int			i, n, bit;
+	double		t0, t;
+
+	if (sizeof(DWORD) != 4) {
+		printf("FAIL: DWORD is not 32 bit on this host\n");
+		return 1;
+	}
+
+	// 1. the engine
+	for (i = 0; i < (int)(sizeof(xteaVectors) / sizeof(xteaVectors[0])); i++) {
+		for (n = 0; n < 4; n++)
+			key[n] = load_be(&xteaVectors[i].key[4 * n]);
+		XTEA_Schedule(key, schedule);
+		x[0] = load_be(xteaVectors[i].plain); x[1] = load_be(xteaVectors[i].plain + 4);
+		XTEA_Encode(x, schedule);
+		if ((x[0] != load_be(xteaVectors[i].cipher)) || (x[1] != load_be(xteaVectors[i].cipher + 4)))
+			fail("XTEA vector", i);
+	}
+	srand(45);
+	for (n = 0; n < NUM_OF_KERNEL_CASES; n++) {
+		for (i = 0; i < 4; i++)
+			key[i] = ((DWORD)rand() << 16) ^ (DWORD)rand();
+		x[0] = y[0] = ((DWORD)rand() << 16) ^ (DWORD)rand();
+		x[1] = y[1] = ((DWORD)rand() << 16) ^ (DWORD)rand();
+		XTEA_Schedule(key, schedule);
+		XTEA_Encode(x, schedule);
+		xtea_reference(y, key);
+		if ((x[0] != y[0]) || (x[1] != y[1]))
+			fail("XTEA against the reference", n);
+	}
+
+	// 2. the block CCM with the key of ConfigMRF49XA.h
+	for (i = 0; i < 4; i++)
+		key[i] = load_be(&mySecurityKey[4 * i]);
+	XTEA_Schedule(key, schedule);
+	for (n = 0; n < NUM_OF_CCM_CASES; n++) {
+		len = (WORD)(rand() % (MAX_TEXT_LEN + 1));
+		for (i = 0; i < len; i++)
+			text[i] = (BYTE)rand();
+		for (i = 0; i < CCM_NONCE_LEN; i++)
+			nonce[i] = (BYTE)rand();
+		la = CCM_SealBlock(a, text, len, nonce, schedule);
+		lb = seal_reference(b, text, len, nonce, key);
+		if ((la != lb) || memcmp(a, b, la))
+			fail("seal against the reference", n);
+		memcpy(b, text, len);
+		if ((CCM_SealBlock(b, b, len, nonce, schedule) != la) || memcmp(a, b, la))
+			fail("seal in place", n);
+		memcpy(b, a, la);
+		if ((CCM_OpenBlock(b, la, nonce, schedule) == FALSE) || memcmp(b, text, len))
+			fail("round trip", n);
+		bit = rand() % (8 * la);
+		memcpy(b, a, la);
+		b[bit / 8] ^= (BYTE)(1 << (bit % 8));
+		if (CCM_OpenBlock(b, la, nonce, schedule) == TRUE)
+			fail("tampered block accepted", n);
+		memcpy(b, a, la);
+		nonce[rand() % CCM_NONCE_LEN] ^= (BYTE)(1 << (rand() % 8));
+		if (CCM_OpenBlock(b, la, nonce, schedule) == TRUE)
+			fail("wrong nonce accepted", n);
+	}
+	if (CCM_OpenBlock(b, CCM_BLOCK_MIC_LEN - 1, nonce, schedule) == TRUE)
+		fail("block shorter than the MIC accepted", 0);
+
+	// 3. the vectors of the block CCM
+	for (i = 0; i < 512; i++)
+		text[i] = (BYTE)i;
+	la = CCM_SealBlock(a, text, 16, (BYTE *)ccmNonce, schedule);
+	print_hex("seal(00 01 .. 0f)  = ", a, la);
+	if (memcmp(a, ccmSeal16, sizeof(ccmSeal16)))
+		fail("CCM vector 16", 0);
+	la = CCM_SealBlock(a, text, 5, (BYTE *)ccmNonce, schedule);
+	print_hex("seal(00 01 .. 04)  = ", a, la);
+	if (memcmp(a, ccmSeal5, sizeof(ccmSeal5)))
+		fail("CCM vector 5", 0);
+	CCM_SealBlock(a, text, 512, (BYTE *)ccmNonce, schedule);
+	print_hex("MIC of 512 x i     = ", a + 512, CCM_BLOCK_MIC_LEN);
+	if (memcmp(a + 512, ccmMic512, sizeof(ccmMic512)))
+		fail("CCM vector 512", 0);
+
+	// 4. the host time of a 512 byte block
+	t0 = now();
+	for (n = 0; n < NUM_OF_TIMED_BLOCKS; n++) {
+		nonce[CCM_NONCE_LEN - 1] = (BYTE)n;
+		CCM_SealBlock(a, text, 512, nonce, schedule);
+	}
+	t = (now() - t0) / NUM_OF_TIMED_BLOCKS;
+	printf("host time of CCM_SealBlock of 512 bytes: %.1f us\n", t * 1e6);
+
+	if (failures != 0) {
+		printf("%d failures\n", failures);
+		return 1;
+	}
+	printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+"""
+extract.py - takes the stone table of the plug out of TxRx.c for test_stone_table.c
+
+writes stone_table.inc with:
+- the network address definitions of TxRx.h (MAX_NWK_SIZE, the EUI0 ranges,
+  TDMA_NO_SLOT)
+- the typedefs of BLOCK_ACK_INFO, TXRX_LINK_STATS and STONE_ENTRY
+- stoneTable, stoneSlot and stoneCount
+- TxRx_GetStone, TxRx_AddStone and TxRx_JoinStone
+so the test runs the code of the tree, not a copy of it.
+
+usage: python3 extract.py [output path]
+"""
+import os
+import re
+import sys
+
+DEFINES = ("MAX_NWK_SIZE", "MAX_NWK_ADDR_EUI0", "MAX_STONE_ADDR_EUI0", "PLUG_NWK_ADDR_EUI0",
+           "NWK_STARTER_ADDR_EUI0", "BROADCAST_NWK_ADDR", "TDMA_NO_SLOT")
+TYPES = ("BLOCK_ACK_INFO", "TXRX_LINK_STATS", "STONE_ENTRY")
+VARIABLES = ("stoneTable", "stoneSlot", "stoneCount")
+FUNCTIONS = ("TxRx_GetStone", "TxRx_AddStone", "TxRx_JoinStone")
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    txrx = os.path.join(here, "..", "..", "Source Files", "TxRx", "TxRx.c")
+    header = os.path.join(here, "..", "..", "Header Files", "TxRx", "TxRx.h")
+    out_path = sys.argv[1] if len(sys.argv) > 1 else os.path.join(here, "stone_table.inc")
+    src = open(txrx, encoding="latin-1").read()
+    hdr = open(header, encoding="latin-1").read()
+
+    out = ["/* extracted from TxRx.h and TxRx.c by extract.py - do not edit */\n"]
+    for name in DEFINES:
+        m = re.search(r"^#define\s+%s\s+(.*?)\s*(//.*)?$" % name, hdr, re.M)
+        assert m, "no #define %s in TxRx.h" % name
+        out.append("#define %s %s\n" % (name, m.group(1)))
+    for name in TYPES:
+        m = re.search(r"^typedef struct \{\n(?:(?!^\}).)*^\} %s;\n" % name, src, re.M | re.S)
+        assert m, "no typedef %s in TxRx.c" % name
+        out.append("\n" + m.group(0))
+    out.append("\n")
+    for name in VARIABLES:
+        m = re.search(r"^\s*(\w+\s+%s\b[^;]*;)" % name, src, re.M)
+        assert m, "no %s in TxRx.c" % name
+        out.append(m.group(1) + "\n")
+    for name in FUNCTIONS:
+        m = re.search(r"^STONE_ENTRY\* %s\([^)]*\) \{\n(?:(?!^\}).)*^\}\n" % name, src, re.M | re.S)
+        assert m, "no %s in TxRx.c" % name
+        out.append("\n" + m.group(0))
+    open(out_path, "w", newline="\n").write("".join(out))
+    print("%s written" % out_path)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,13 @@
+/* host stub of SymbolTime.h - MIWI_TICK only */
+#ifndef __SYMBOL_TIME_H_
+#define __SYMBOL_TIME_H_
+
+#include "GenericTypeDefs.h"
+
+typedef union _MIWI_TICK
+{
+    DWORD Val;
+    BYTE v[4];
+} MIWI_TICK;
+
+#endif //__SYMBOL_TIME_H_
@@ -0,0 +1,186 @@
+/*******************************************************************************
+
+test_stone_table.c - host test of the stone table of the plug (Source Files/TxRx/TxRx.c)
+======================================================================================
+
+runs TxRx_GetStone, TxRx_AddStone and TxRx_JoinStone of the tree (extract.py)
+with all the TxRx options of the stone entry enabled, and checks:
+- the plug address is a device address outside the stone range
+- join-info is accepted only from stones that join through a member parent
+  (the network-starter, with no parent, first), and never for the broadcast
+  or the plug address
+- a stone that sent blocks without join-info has an entry, but is no member
+- the table holds MAX_NWK_SIZE devices (the plug and 32 stones with sparse
+  addresses), and is full then
+- every address 0..255 is looked up to its own entry, or to none
+
+and prints the RAM of the table with the 2 byte alignment of C30, and the
+host time of a lookup with a small and a full table (the lookup is a bounds
+check and two indexed reads, whatever the number of stones - the PIC24 cycles
+were not measured).
+
+build and run (from this directory):
+	python3 extract.py
+	gcc -Wall -O2 -I stubs -o test_stone_table test_stone_table.c
+	./test_stone_table
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "GenericTypeDefs.h"
+#include "SymbolTime.h"
+
+// the tick of the last block from a stone (low power listen) - no timer on the host
+static MIWI_TICK MiWi_TickGet(void)
+{
+	MIWI_TICK tick;
+
+	tick.Val = 0;
+	return tick;
+}
+
+#define ENABLE_LOW_POWER_LISTEN
+#define ENABLE_CUMULATIVE_ACK
+#define ENABLE_LINK_RATE_ADAPTATION
+#define ENABLE_TDMA_UPLOAD
+#define ENABLE_TXRX_SECURITY
+#define BASE_LINK_RATE		0
+#define NUM_OF_LOOKUPS		20000000
+
+// the replay mark is read from the EEPROM of the plug - there is none on the host
+#define TxRx_SecReplayInit(stone)	((stone)->secCounter = (stone)->secCounterLimit = 0)
+
+#pragma pack(push, 2)				// C30 aligns DWORD (and MIWI_TICK) to 2 bytes
+#include "stone_table.inc"
+#pragma pack(pop)
+
+static int failures = 0;
+
+static void fail(const char *what, int eui0)
+{
+	if (failures++ < 20)
+		printf("FAIL: %s (eui0 %d)\n", what, eui0);
+}
+
+static void reset_table(void)
+{
+	memset(stoneSlot, 0, sizeof(stoneSlot));
+	stoneCount = 0;
+}
+
+// TxRx_Connect of the plug:
+static void connect(void)
+{
+	STONE_ENTRY *stone;
+
+	reset_table();
+	stone = TxRx_AddStone(PLUG_NWK_ADDR_EUI0);
+	stone->isNetworkMember = TRUE;
+	stone->parentEUI0 = NWK_STARTER_ADDR_EUI0;
+	stone = TxRx_AddStone(NWK_STARTER_ADDR_EUI0);
+	stone->isNetworkMember = TRUE;
+	stone->parentEUI0 = 0xFF;
+}
+
+static double lookup_ns(void)
+{
+	volatile BYTE	sum = 0;
+	STONE_ENTRY		*stone;
+	clock_t			t;
+	long			n;
+
+	t = clock();
+	for (n = 0; n < NUM_OF_LOOKUPS; n++) {
+		stone = TxRx_GetStone((BYTE)(n & MAX_NWK_ADDR_EUI0));
+		if (stone != NULL)
+			sum += stone->eui0;
+	}
+	return (double)(clock() - t) * 1e9 / CLOCKS_PER_SEC / NUM_OF_LOOKUPS;
+}
+
+int main(void)
+{
+	STONE_ENTRY	*stone;
+	BYTE		isMember[256] = {0};
+	int			eui0, parent, joined;
+	double		smallTable, fullTable;
+
+	if ((PLUG_NWK_ADDR_EUI0 <= MAX_STONE_ADDR_EUI0) || (PLUG_NWK_ADDR_EUI0 > MAX_NWK_ADDR_EUI0))
+		fail("the plug address is not above the stones", PLUG_NWK_ADDR_EUI0);
+
+	connect();
+	smallTable = lookup_ns();
+
+	// invalid join-info:
+	if (TxRx_JoinStone(BROADCAST_NWK_ADDR, NWK_STARTER_ADDR_EUI0) != NULL)
+		fail("broadcast address joined", BROADCAST_NWK_ADDR);
+	if (TxRx_JoinStone(PLUG_NWK_ADDR_EUI0, NWK_STARTER_ADDR_EUI0) != NULL)
+		fail("plug address joined as a stone", PLUG_NWK_ADDR_EUI0);
+	if (TxRx_JoinStone(MAX_NWK_ADDR_EUI0 + 1, NWK_STARTER_ADDR_EUI0) != NULL)
+		fail("address above the network joined", MAX_NWK_ADDR_EUI0 + 1);
+	if (TxRx_JoinStone(5, 0xFF) != NULL)
+		fail("stone without a parent joined", 5);
+	if (TxRx_JoinStone(5, 9) != NULL)
+		fail("stone with an unknown parent joined", 5);
+	if (TxRx_JoinStone(5, 5) != NULL)
+		fail("stone joined through itself", 5);
+	if (TxRx_GetStone(5) != NULL)
+		fail("rejected join-info allocated an entry", 5);
+
+	// a stone that only sent blocks is known, but is no parent:
+	stone = TxRx_AddStone(9);
+	if ((stone == NULL) || (stone->isNetworkMember != FALSE))
+		fail("stone of a block", 9);
+	if (TxRx_JoinStone(5, 9) != NULL)
+		fail("stone joined through a non member", 5);
+	if ((TxRx_JoinStone(9, PLUG_NWK_ADDR_EUI0) == NULL) || (TxRx_GetStone(9)->isNetworkMember != TRUE))
+		fail("stone of a block did not join", 9);
+	isMember[NWK_STARTER_ADDR_EUI0] = isMember[9] = 1;
+
+	// sparse stone addresses 2, 4, ..., 62 (without 0 and 9), each joining through the last member:
+	parent = NWK_STARTER_ADDR_EUI0;
+	for (eui0 = 2; eui0 <= MAX_STONE_ADDR_EUI0; eui0 += 2) {
+		stone = TxRx_JoinStone((BYTE)eui0, (BYTE)parent);
+		if (stoneCount <= MAX_NWK_SIZE - 1 && stone == NULL && !isMember[eui0])
+			fail("stone did not join", eui0);
+		if (stone != NULL) {
+			if ((stone->eui0 != eui0) || (stone->parentEUI0 != parent) || (stone->isNetworkMember != TRUE))
+				fail("join-info entry", eui0);
+			isMember[eui0] = 1;
+			parent = eui0;
+		}
+	}
+	if (stoneCount != MAX_NWK_SIZE)
+		fail("table not full", stoneCount);
+	for (eui0 = 0, joined = 0; eui0 < 256; eui0++)
+		joined += isMember[eui0];
+	if (joined != MAX_NWK_SIZE - 1)
+		fail("stones in a full table", joined);
+	if ((TxRx_AddStone(61) != NULL) || (TxRx_JoinStone(61, NWK_STARTER_ADDR_EUI0) != NULL))
+		fail("entry beyond MAX_NWK_SIZE", 61);
+
+	// every address to its own entry:
+	for (eui0 = 0; eui0 < 256; eui0++) {
+		stone = TxRx_GetStone((BYTE)eui0);
+		if (isMember[eui0] || (eui0 == PLUG_NWK_ADDR_EUI0)) {
+			if ((stone == NULL) || (stone->eui0 != eui0) || (stone->isNetworkMember != TRUE))
+				fail("lookup of a member", eui0);
+		}
+		else if (stone != NULL)
+			fail("lookup of an unknown address", eui0);
+	}
+	fullTable = lookup_ns();
+
+	printf("STONE_ENTRY %u bytes, stoneTable %u + stoneSlot %u + stoneCount 1 = %u bytes of RAM\n",
+		(unsigned)sizeof(STONE_ENTRY), (unsigned)sizeof(stoneTable), (unsigned)sizeof(stoneSlot),
+		(unsigned)(sizeof(stoneTable) + sizeof(stoneSlot) + 1));
+	printf("TxRx_GetStone on the host: %.2f ns with 2 devices, %.2f ns with %d devices\n", smallTable, fullTable, MAX_NWK_SIZE);
+
+	if (failures != 0) {
+		printf("%d failures\n", failures);
+		return 1;
+	}
+	printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""
+sim.py - upload of N stones to the plug, CSMA against the TDMA upload (ENABLE_TDMA_UPLOAD)
+
+a discrete event model with a 1 ms step: every stone offers 512 byte blocks at
+its own rate (mixed demand, about twice the channel), each block is FRAMES MiWi
+frames and a TxRx ack.
+- csma: CCA with random backoff for each frame, hidden pairs (the plug hears
+  both, they do not hear each other), MAC retries, and the block sent again
+  after a failure
+- tdma: the superframe of TxRx_TdmaSchedule (slots doubled when full, halved
+  when used up to half, freed after IDLE superframes, max-min halving above
+  MAXSF blocks, CONT contention blocks); a stone starts a block only when the
+  whole block fits in the rest of its slot (TxRx_UploadSlotOpen), and is
+  otherwise free for other work until then
+prints the goodput and the Jain fairness of goodput/demand for 8..32 stones.
+all links are at the base rate (57.6 kbps), so a block is one TDMA_BLOCK_TIME.
+
+usage: python3 sim.py (about 30 s)
+"""
+import random, sys
+FRAME=12; FRAMES=11; ACK=12          # ms per 50B frame at 57.6 kbps incl. MAC ack/turnaround; frames per block; TxRx ack
+BLOCK_TIME=250; GUARD=50; CONT=2; MAXSF=48; MAXSHIFT=3; IDLE=2
+RETRIES=3; RESEND=2000
+def jain(x):
+    s=sum(x); q=sum(v*v for v in x); return s*s/(len(x)*q) if q else 1
+def run(n, mode, rates, T=300000, phidden=0.2, seed=1):
+    rnd=random.Random(seed)
+    hidden=[[i!=j and rnd.random()<phidden for j in range(n)] for i in range(n)]
+    for i in range(n):
+        for j in range(i): hidden[i][j]=hidden[j][i]
+    q=[0.0]*n; cap=64; delivered=[0]*n; dropped=[0]*n
+    # per-stone tx state
+    st=[dict(state='idle',t=0,frame=0,retry=0,tx_end=-1,coll=False) for _ in range(n)]
+    active=[]   # (i, start, end)
+    # tdma
+    shift=[None]*n; used=[0]*n; idle=[0]*n; sf_start=0; sf_len=0; slot=[None]*n; cont=None
+    def beacon(t):
+        nonlocal sf_start,sf_len,cont
+        blocks=0
+        for i in range(n):
+            if used[i]==0:
+                if shift[i] is not None:
+                    idle[i]+=1
+                    if idle[i]>=IDLE: shift[i]=None
+            else:
+                idle[i]=0
+                if shift[i] is None: shift[i]=0
+                elif used[i]>=(1<<shift[i]): shift[i]=min(shift[i]+1,MAXSHIFT)
+                elif shift[i]>0 and used[i]<=(1<<(shift[i]-1)): shift[i]-=1
+            used[i]=0
+            if shift[i] is not None: blocks+=1<<shift[i]
+        while blocks>MAXSF:
+            k=max((i for i in range(n) if shift[i] is not None), key=lambda i:shift[i])
+            shift[k]-=1; blocks-=1<<shift[k]
+        off=GUARD
+        for i in range(n):
+            if shift[i] is not None:
+                slot[i]=(off,off+(1<<shift[i])*BLOCK_TIME); off+=(1<<shift[i])*BLOCK_TIME
+            else: slot[i]=None
+        cont=(off,off+CONT*BLOCK_TIME)
+        sf_start=t; sf_len=off+CONT*BLOCK_TIME if blocks else 0
+    for t in range(T):
+        for i in range(n):
+            q[i]+=rates[i]/1000.0
+            if q[i]>cap: dropped[i]+=q[i]-cap; q[i]=cap
+        if mode=='tdma' and (sf_len==0 or t-sf_start>=sf_len):
+            beacon(t)
+        # finish transmissions
+        for a in active[:]:
+            i,s,e=a
+            if e==t:
+                active.remove(a); x=st[i]
+                if x['coll']:
+                    x['retry']+=1
+                    if x['retry']>RETRIES: x['state']='resend'; x['t']=t+rnd.randint(0,RESEND)
+                    else: x['state']='backoff'; x['t']=t+5+rnd.randint(0,8)*4
+                else:
+                    x['retry']=0; x['frame']+=1
+                    if x['frame']>=FRAMES:
+                        x['state']='ack'; x['t']=t+ACK
+                    else: x['state']='cca'; x['t']=t
+        for i in range(n):
+            x=st[i]
+            if x['state']=='ack' and t>=x['t']:
+                delivered[i]+=1; q[i]-=1; used[i]+=1; x['state']='idle'
+            if x['state']=='resend' and t>=x['t']: x['state']='idle'
+            if x['state']=='idle' and q[i]>=1:
+                if mode=='tdma' and sf_len:
+                    w=slot[i] or cont; e=(t-sf_start)
+                    if not (w[0]<=e and e+BLOCK_TIME<=w[1]): continue
+                x['state']='cca'; x['t']=t; x['frame']=0; x['retry']=0
+            if x['state'] in ('cca','backoff') and t>=x['t']:
+                busy=any(not hidden[i][j] for j,_,_ in active)
+                if busy: x['state']='backoff'; x['t']=t+1+rnd.randint(0,7)*2; continue
+                x['state']='tx'; x['coll']=False
+                for a in active:
+                    st[a[0]]['coll']=True; x['coll']=True
+                active.append((i,t,t+FRAME))
+    return [d*1000.0/T for d in delivered], rates
+if __name__=='__main__':
+    for n in (8,16,24,32):
+        rates=[(0.25 if i%2 else 0.75)*8.0/n*2 for i in range(n)]   # offered ~2x channel capacity, mixed demand
+        for mode in ('csma','tdma'):
+            g,r=run(n,mode,rates)
+            print(f"n={n:2d} {mode}: goodput {sum(g):5.2f} blk/s ({sum(g)*512*8/1000:5.1f} kbps)  jain(goodput/demand) {jain([a/b for a,b in zip(g,r)]):.3f}  min/max per stone {min(g):.3f}/{max(g):.3f}")
@@ -0,0 +1,224 @@
+/*******************************************************************************
+
+sim_tsync.c - model of the time sync of the stones (ENABLE_TIME_SYNC in TxRx.c)
+==============================================================================
+
+a chain of H hops from the plug, each node with its own oscillator skew. The
+plug broadcasts [TSYNC_ID, sequence, level, network time] every PERIOD; each
+hop takes the message at the start of its frame, with the interrupt latency
+jitter, and rebroadcasts it restamped after the MiWi jitter. receive() and
+fit() follow TxRx_ReceiveTimeSync and TxRx_TimeSyncFit (the same fixed point
+arithmetic), global_time() follows TxRx_GlobalTime.
+
+prints, for each hop, the error of the network time against the plug, sampled
+10 times per period after the first 10 minutes. With a restart time, the plug
+is restarted then (its tick and its sequence start over - the sequence goes
+backwards), and the time each hop takes to follow it is printed instead.
+
+build and run (from this directory):
+	gcc -Wall -O2 -o sim_tsync sim_tsync.c -lm
+	./sim_tsync [skew ppm] [jitter us] [hops] [hours] [period s] [table] [restart s] [seed]
+defaults: 40 20 4 2 10 8 0 1
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <string.h>
+
+typedef uint32_t	DWORD;
+typedef uint8_t		BYTE;
+
+#define TICK_US				16.0
+#define ONE_SECOND			62500
+#define SOF_DELAY			17				// ticks from the start of the frame to the SOF interrupt (2 bytes at 57.6 kbps)
+#define AIR_US				278.4
+#define MIN_ENTRIES			3				// TSYNC_MIN_ENTRIES
+#define ERROR_LIMIT			(10 * ONE_SECOND / 1000)	// TSYNC_ERROR_LIMIT
+#define MAX_ERRORS			3				// TSYNC_MAX_ERRORS
+#define MAX_HOPS			7
+#define MAX_TABLE			32
+#define MAX_SAMPLES			200000
+
+typedef struct {
+	DWORD	local;
+	DWORD	offset;
+} ENTRY;
+
+typedef struct {
+	double	skew;							// ppm
+	double	phase;							// s
+	ENTRY	table[MAX_TABLE];
+	int		count, next, errors;
+	BYTE	seq, level;
+	DWORD	anchor, base;
+	long	intercept, skewQ;
+} NODE;
+
+static int		tableSize = 8;
+static double	errors[MAX_HOPS + 1][MAX_SAMPLES];
+static int		numErrors[MAX_HOPS + 1];
+
+static double urand(void)
+{
+	return rand() / (RAND_MAX + 1.0);
+}
+
+static DWORD local_at(NODE *x, double t)
+{
+	return (DWORD)(int64_t)floor((t * (1 + x->skew * 1e-6) + x->phase) / (TICK_US * 1e-6));
+}
+
+static void fit(NODE *x)
+{
+	long long	sumLocal = 0, sumOffset = 0, sumLocal2 = 0, sumLocalOffset = 0, den;
+	long		dLocal, dOffset;
+	int			i, n = x->count;
+
+	for (i = 0; i < n; i++)
+		sumLocal += (int32_t)(x->table[i].local - x->table[0].local);
+	x->anchor = x->table[0].local + (int32_t)(sumLocal / n);
+	x->base = x->table[0].offset;
+	sumLocal = 0;
+	for (i = 0; i < n; i++) {
+		dLocal = (int32_t)(x->table[i].local - x->anchor);
+		dOffset = (int32_t)(x->table[i].offset - x->base);
+		sumLocal += dLocal;
+		sumOffset += dOffset;
+		sumLocal2 += (long long)dLocal * dLocal;
+		sumLocalOffset += (long long)dLocal * dOffset;
+	}
+	den = n * sumLocal2 - sumLocal * sumLocal;
+	x->skewQ = (den > 0) ? (long)(((n * sumLocalOffset - sumLocal * sumOffset) << 24) / den) : 0;
+	x->intercept = (long)(((sumOffset << 8) - ((x->skewQ * sumLocal) >> 16)) / n);
+}
+
+static int global_time(NODE *x, DWORD local, DWORD *global)
+{
+	if (x->level == 0) {					// the plug
+		*global = local;
+		return 1;
+	}
+	if (x->count < MIN_ENTRIES)
+		return 0;
+	*global = local + x->base + (int32_t)((x->intercept + (((long long)x->skewQ * (int32_t)(local - x->anchor)) >> 16) + 128) >> 8);
+	return 1;
+}
+
+static void receive(NODE *x, BYTE seq, BYTE level, DWORD global, DWORD local)
+{
+	DWORD		estimate;
+	int32_t		error;
+	signed char	seqDiff = (signed char)(seq - x->seq);
+
+	if (level == 0xFF)
+		return;
+	if (x->count && (seqDiff == 0))			// another copy of the last message
+		return;
+	if (x->count && (seqDiff < 0)) {		// a late copy, or the plug was restarted
+		if (++x->errors < MAX_ERRORS)
+			return;
+		x->count = 0;
+	}
+	if (global_time(x, local, &estimate)) {
+		error = (int32_t)(global - estimate);
+		if ((error > ERROR_LIMIT) || (error < -ERROR_LIMIT)) {
+			if (++x->errors < MAX_ERRORS)
+				return;
+			x->count = 0;
+		}
+	}
+	x->errors = 0;
+	if (x->count == 0)
+		x->next = 0;
+	x->table[x->next].local = local;
+	x->table[x->next].offset = global - local;
+	x->next = (x->next + 1) % tableSize;
+	if (x->count < tableSize)
+		x->count++;
+	x->seq = seq;
+	x->level = level + 1;
+	fit(x);
+}
+
+static int compare(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x < y) ? -1 : (x > y);
+}
+
+int main(int argc, char **argv)
+{
+	double	skew = (argc > 1) ? atof(argv[1]) : 40;
+	double	jitter = (argc > 2) ? atof(argv[2]) : 20;
+	int		hops = (argc > 3) ? atoi(argv[3]) : 4;
+	double	hours = (argc > 4) ? atof(argv[4]) : 2;
+	double	period = (argc > 5) ? atof(argv[5]) : 10;
+	double	restart = (argc > 7) ? atof(argv[7]) : 0;
+	double	t = 1, end, tx, rx, ts, resynced[MAX_HOPS + 1] = {0};
+	NODE	node[MAX_HOPS + 1];
+	BYTE	seq = 0, level;
+	DWORD	global, root, g;
+	int		h, k, i, n, ok, isRestarted = 0;
+
+	tableSize = (argc > 6) ? atoi(argv[6]) : 8;
+	srand((argc > 8) ? atoi(argv[8]) : 1);
+	if ((hops < 1) || (hops > MAX_HOPS) || (tableSize < 1) || (tableSize > MAX_TABLE)) {
+		printf("1..%d hops, table of 1..%d\n", MAX_HOPS, MAX_TABLE);
+		return 1;
+	}
+	memset(node, 0, sizeof(node));
+	for (h = 0; h <= hops; h++) {
+		node[h].skew = (2 * urand() - 1) * skew;
+		node[h].phase = urand() * 1000;
+		node[h].level = h ? 0xFF : 0;
+	}
+	end = hours * 3600;
+	while (t < end) {
+		if ((restart > 0) && !isRestarted && (t >= restart)) {
+			isRestarted = 1;
+			node[0].phase = -t;				// the tick of the plug starts over
+			seq = 0;						// and so does its sequence
+		}
+		seq++;
+		tx = t;
+		for (h = 0; h < hops; h++) {		// each hop restamps the message when it rebroadcasts it
+			ok = global_time(&node[h], local_at(&node[h], tx), &global);
+			level = ok ? node[h].level : 0xFF;
+			rx = tx + AIR_US * 1e-6 + urand() * jitter * 1e-6;
+			receive(&node[h + 1], seq, level, global, local_at(&node[h + 1], rx) - SOF_DELAY);
+			tx = rx + 0.002 + urand() * 0.020 + urand() * jitter * 1e-6;
+		}
+		for (k = 1; k <= 10; k++) {
+			ts = t + period * k / 10.0;
+			root = local_at(&node[0], ts);
+			for (h = 1; h <= hops; h++) {
+				ok = global_time(&node[h], local_at(&node[h], ts), &g);
+				if (isRestarted) {
+					if (!ok || (abs((int32_t)(g - root)) > ERROR_LIMIT))
+						resynced[h] = ts - restart;
+				}
+				else if ((t > 600) && ok && (numErrors[h] < MAX_SAMPLES))
+					errors[h][numErrors[h]++] = fabs((int32_t)(g - root) * TICK_US);
+			}
+		}
+		t += period;
+	}
+	for (h = 1; h <= hops; h++) {
+		double max = 0, sum = 0;
+		n = numErrors[h];
+		if (isRestarted) {
+			printf("hop %d: follows the restarted plug after %.0f s\n", h, resynced[h]);
+			continue;
+		}
+		qsort(errors[h], n, sizeof(double), compare);
+		for (i = 0; i < n; i++) {
+			sum += errors[h][i];
+			if (errors[h][i] > max)
+				max = errors[h][i];
+		}
+		printf("hop %d: mean %6.1f us  p99 %6.1f us  max %6.1f us  (n=%d)\n", h, sum / n, errors[h][(int)(n * 0.99)], max, n);
+	}
+	return 0;
+}
@@ -93,6 +93,10 @@ void SPIPut(BYTE v)
         #if defined(__PIC32MX__)
             putcSPI1(v);
             i = (BYTE)getcSPI1();
+        #elif defined(ENABLE_SPI_BURST)
+            SPI2BUF = v;
+            while( SPI2STATbits.SRXMPT ){}  // the byte is received when it has been sent
+            i = SPI2BUF;
         #else
             IFS2bits.SPI2IF = 0;
             i = SPI2BUF;
@@ -143,6 +147,10 @@ BYTE SPIGet(void)
             putcSPI1(0x00);
             dummy = (BYTE)getcSPI1();
             return(dummy);
+        #elif defined(ENABLE_SPI_BURST)
+            SPI2BUF = 0x00;
+            while( SPI2STATbits.SRXMPT ){}
+            return SPI2BUF;
         #else
             SPIPut(0x00);
             return SPI2BUF;
@@ -150,6 +158,53 @@ BYTE SPIGet(void)
     #endif
 }
 
+#if defined(ENABLE_SPI_BURST) && !defined(__PIC32MX__)
+/*********************************************************************
+* Function:         void SPIStart(BYTE v)
+*
+* PreCondition:     SPI has been configured in enhanced buffer mode
+*
+* Input:		    v - is the byte that needs to be transfered
+*
+* Output:		    none
+*
+* Side Effects:	    SPI transmits the byte
+*
+* Overview:		    This function queues a byte in the transmit buffer
+*                   and returns without waiting for it to be sent
+*
+* Note:			    Each SPIStart is followed by an SPIWait, and at 
+*                   most 8 bytes are queued at a time
+********************************************************************/
+void SPIStart(BYTE v)
+{
+    SPI2BUF = v;
+}
+
+/*********************************************************************
+* Function:         BYTE SPIWait(void)
+*
+* PreCondition:     SPIStart has been called
+*
+* Input:		    none
+*
+* Output:		    BYTE - the byte that was received while the byte 
+*                   of the oldest SPIStart was sent
+*
+* Side Effects:	    none
+*
+* Overview:		    This function waits for the oldest queued byte to 
+*                   be transfered, and returns the received byte
+*
+* Note:			    None
+********************************************************************/
+BYTE SPIWait(void)
+{
+    while( SPI2STATbits.SRXMPT ){}
+    return SPI2BUF;
+}
+#endif
+
 #if defined(SUPPORT_TWO_SPI)
     /*********************************************************************
     * Function:         void SPIPut2(BYTE v)
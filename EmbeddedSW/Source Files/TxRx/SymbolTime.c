@@ -207,7 +207,10 @@ MIWI_TICK MiWi_TickGet(void)
     /* enable the timer*/
     TMR_IE = 1;
     
-#elif defined(__dsPIC30F__) || defined(__dsPIC33F__) || defined(__PIC24F__) || defined(__PIC24FK__) || defined(__PIC24H__) || defined(__PIC32MX__)
+#elif defined(__dsPIC30F__) || defined(__dsPIC33F__) || defined(__PIC24F__) || defined(__PIC24FK__) || defined(__PIC24H__)
+    currentTime.word.w0 = TMR2;
+    currentTime.word.w1 = TMR3HLD;      // reading TMR2 latched TMR3, so a carry between the two reads can not tear the tick
+#elif defined(__PIC32MX__)
     currentTime.word.w0 = TMR2;
     currentTime.word.w1 = TMR3;
 #else
@@ -46,6 +46,8 @@ Date        Comments
 #include "HardwareProfileTxRx.h"
 #include "TimeDelay.h" 
 
+void (*DelayMsHook)( UINT16 ms ) = NULL;	// set by the application (init_all)
+
 /****************************************************************************
   Function:
     void Delay10us( UINT32 tenMicroSecondCounter )
@@ -202,6 +204,10 @@ void DelayMs( UINT16 ms )
     
         volatile UINT8 i;
         
+        if (DelayMsHook != NULL)
+        {
+            DelayMsHook(ms);
+        }
         while (ms--)
         {
             i = 4;
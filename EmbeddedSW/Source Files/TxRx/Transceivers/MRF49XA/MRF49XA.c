@@ -74,6 +74,34 @@
     // Global variables:
     //==============================================================
        BYTE messageRetryCounter = 0; 	// ABYS: For calculating PER.. 
+    volatile LINK_STATS MACLinkStats;	// link statistics for link rate adaptation and diagnostics
+    void (*MRF49XA_IsrHook)(void) = NULL;	// set by the application (init_all)
+    
+    #if defined(ENABLE_LINK_RATE_ADAPTATION)
+        // per-rate settings of the 434MHz band, indexed by LINK_RATE
+        // (the same values as the DATA_RATE_xxx blocks in MRF49XA.h):
+        ROM WORD linkRateDRVSREG[LINK_RATE_NUM] = {0xC623, 0xC611, 0xC608, 0xC605, 0xC602};
+        ROM BYTE linkRateRawDev[LINK_RATE_NUM]  = {19, 29, 48, 67, 125};
+        
+        BYTE currentLinkRate = BASE_LINK_RATE;
+        WORD currentRfDev = RF_DEV;			// the deviation follows the data rate; the receiver BW and TXCREG follow the deviation
+        BYTE currentTxPower = TX_POWER;
+        #define LINK_RF_DEV		currentRfDev
+        #define LINK_DRVSREG	linkRateDRVSREG[currentLinkRate]
+    #else
+        #define LINK_RF_DEV		RF_DEV
+        #define LINK_DRVSREG	DRVSREG
+    #endif
+    
+    // The start of a frame is timestamped with the symbol timer on both sides: the transmitter when it 
+    // writes the length byte (the second sync byte is shifted out meanwhile), and the receiver when the 
+    // length byte fills the FIFO - two bytes later on the air. The bit rate is 10MHz / 29 / (R+1) / (1+7*cs) 
+    // (DRVSREG: cs is bit 7, R bits 6..0); the delay is rounded to the nearest tick.
+    #define SOF_DELAY_BYTES			2
+    #define SOF_DELAY_TICKS(drvsreg)	(((DWORD)SOF_DELAY_BYTES * 8 * 29 * (((drvsreg) & 0x7F) + 1) * \
+    									(((drvsreg) & 0x80) ? 8 : 1) * (SYMBOL_TIMER_FREQ / 100) + 50000) / 100000)
+    #define TSYNC_INDEX				(MAC_HEADER_SIZE + PROTOCOL_HEADER_SIZE)	// the time-sync message in MACTxBuffer
+    
     /**********************************************************************
      * "#pragma udata" is used to specify the starting address of a 
      * global variable. The address may be MCU dependent on RAM available
@@ -94,6 +122,10 @@
     BYTE                        TxMACSeq;
     BYTE                        MACSeq;
     BYTE                        ReceivedBankIndex;
+    volatile BYTE               RxQueue[RX_QUEUE_SIZE];     // the received frames (indexes to RxPacket), oldest first
+    volatile BYTE               RxQueueHead;
+    volatile BYTE               RxQueueTail;
+    MIWI_TICK                   rxSofTick;      // latched by the ISR, kept with the packet in its bank
 	
 	// YL 29.8 ...
 	WORD_VAL myNetworkAddress;
@@ -134,9 +166,28 @@
     #if defined(__18CXX)
         #pragma udata
     #endif
+    
+    // The frame is sent from its segments, in order: the MAC header in MACTxBuffer, the MAC payload in the 
+    // buffer of the caller (the MiWi TxBuffer), a slice of the TxRx block (txSlice) and the crc - so the 
+    // payload and the data are not copied into MACTxBuffer. TxPacket reaches the bytes by MACTxByte.
+    typedef struct
+    {
+        BYTE        headerLen;
+        BYTE        *payload;
+        BYTE        payloadLen;
+        BYTE        *slice;
+        BYTE        sliceLen;
+        BYTE        crc[2];
+    } MAC_TX_FRAME;
+    
+    MAC_TX_FRAME    MACTxFrame;
 	
     void SPIPut(BYTE v);
     BYTE SPIGet(void);
+    #if defined(ENABLE_SPI_BURST)
+        void SPIStart(BYTE v);
+        BYTE SPIWait(void);
+    #endif
     
     /*********************************************************************
      * WORD getReceiverBW(void)
@@ -163,7 +214,7 @@
     {
         BYTE bw_table[16] = {6,6,6,5,5,4,4,4,3,3,2,2,1,1,1,1};   
         
-        return ( ((WORD)(bw_table[(BYTE)((WORD)RF_DEV/15)])) << 5);
+        return ( ((WORD)(bw_table[(BYTE)((WORD)LINK_RF_DEV/15)])) << 5);
     }
 
     
@@ -195,8 +246,15 @@
 		ACC_IE = 0;
         RFIE = 0;
         PHY_CS = 0;
-        SPIPut((BYTE)(setting >> 8));
-        SPIPut((BYTE)setting);
+        #if defined(ENABLE_SPI_BURST)
+            SPIStart((BYTE)(setting >> 8));     // both bytes are shifted back to back
+            SPIStart((BYTE)setting);
+            SPIWait();
+            SPIWait();
+        #else
+            SPIPut((BYTE)(setting >> 8));
+            SPIPut((BYTE)setting);
+        #endif
         PHY_CS = 1;
         RFIE = oldRFIE;
 		ACC_IE = oldACCIE;
@@ -231,7 +289,14 @@
         nFSEL = 1;
         PHY_CS = 0;
         
-        #if defined(HARDWARE_SPI)
+        #if defined(ENABLE_SPI_BURST)
+        
+            SPIStart(0x00);
+            SPIStart(0x00);
+            TransceiverStatus.v[0] = SPIWait();
+            TransceiverStatus.v[1] = SPIWait();
+            
+        #elif defined(HARDWARE_SPI)
         
             TransceiverStatus.v[0] = SPIGet();
             TransceiverStatus.v[1] = SPIGet();
@@ -291,11 +356,41 @@
     }
     
     
+    /*********************************************************************
+     * volatile BYTE *MACTxByte(INPUT BYTE index)
+     *
+     * Overview:        
+     *              This function returns the byte at index in the frame
+     *              that is described by MACTxFrame
+     *
+     ********************************************************************/
+    volatile BYTE *MACTxByte(INPUT BYTE index)
+    {
+        if( index < MACTxFrame.headerLen )
+        {
+            return &MACTxBuffer[index];
+        }
+        index -= MACTxFrame.headerLen;
+        if( index < MACTxFrame.payloadLen )
+        {
+            return &MACTxFrame.payload[index];
+        }
+        index -= MACTxFrame.payloadLen;
+        if( index < MACTxFrame.sliceLen )
+        {
+            return &MACTxFrame.slice[index];
+        }
+        index -= MACTxFrame.sliceLen;
+        return &MACTxFrame.crc[index];
+    }
+    
+    
     /*********************************************************************
      * BOOL TxPacket(INPUT BYTE TxPacketLen, INPUT BOOL CCA)
      *
      * Overview:        
-     *              This function send the packet in the buffer MACTxBuffer
+     *              This function send the packet that is described by 
+     *              MACTxFrame (its header is in MACTxBuffer)
      *
      * PreCondition:    
      *              MRF49XA transceiver has been properly initialized
@@ -321,6 +416,12 @@
         MIWI_TICK t1, t2;
         BYTE i;
         WORD counter;
+        WORD crc;
+        #if defined ENABLE_TIME_SYNC
+            BOOL isTimeSyncFrame;
+            MIWI_TICK tsyncLocal;
+            DWORD tsyncGlobal;
+        #endif
 
 		BYTE oldACCIE = ACC_IE;
 		ACC_IE = 0;
@@ -373,6 +474,8 @@ Start_CCA:
                     {
                         if(CCARetries++ > CCA_RETRIES )
                         {
+                            MACLinkStats.txFrames++;
+                            MACLinkStats.txFailures++;
 							ACC_IE = oldACCIE;
                             return FALSE;
                         }
@@ -384,6 +487,20 @@ Start_CCA:
 			ACC_IE = 0;
             RFIE = 0;
             
+            #if defined ENABLE_TIME_SYNC
+            // a time-sync broadcast (the original or a MiWi rebroadcast) carries the network time of this
+            // device at the start of the frame: take the network time now - before the transmitter is 
+            // enabled, so the preamble is not delayed - and add the ticks until the length byte is written
+            isTimeSyncFrame = FALSE;
+            if( (MACTxBuffer[0] & BROADCAST_MASK) && (TxPacketLen >= TSYNC_INDEX + TSYNC_LENGTH + 2) &&
+                (*MACTxByte(TSYNC_INDEX) == TSYNC_ID) )
+            {
+                tsyncLocal = MiWi_TickGet();
+                isTimeSyncFrame = TxRx_GlobalTime(tsyncLocal.Val, &tsyncGlobal);
+                *MACTxByte(TSYNC_INDEX + TSYNC_LEVEL) = (isTimeSyncFrame == TRUE) ? TxRx_TimeSyncLevel() : TSYNC_NOT_SYNCED;
+            }
+            #endif
+            
             // Turn off receiver, enable the TX register
             RegisterSet(PMCREG);
             RegisterSet(GENCREG | 0x0080);
@@ -395,11 +512,19 @@ Start_CCA:
              
             TxPacketPtr = 0;
             synCount = 0;
+            crc = 0;
 
             PHY_CS = 0;
 
-            SPIPut(0xB8);
-            SPIPut(0xAA);                 // 3rd preamble
+            #if defined(ENABLE_SPI_BURST)
+                SPIStart(0xB8);
+                SPIStart(0xAA);           // 3rd preamble
+                SPIWait();
+                SPIWait();
+            #else
+                SPIPut(0xB8);
+                SPIPut(0xAA);             // 3rd preamble
+            #endif
            
             counter = 0;
 			
@@ -412,16 +537,16 @@ Start_CCA:
 				// MAC treats this header as a part of a MAC-payload;
 				// - MAC header size is MAC_HEADER_SIZE
 				// - MiWi header size is PROTOCOL_HEADER_SIZE
-				// - Application header: 	blockInf + sourceNwkAddress + destinationNwkAddress + blockLen [+ g_phase_counter if TXRX_TYPE_COMMAND]
-				//   						MSG_INF_LENGTH + 2 * MY_ADDRESS_LENGTH + MSG_LEN_LENGTH [+ MSG_PHS_LENGTH if TXRX_TYPE_COMMAND]				
-				BYTE phaseIndex = MAC_HEADER_SIZE + PROTOCOL_HEADER_SIZE + MSG_INF_LENGTH + 2 * MY_ADDRESS_LENGTH + MSG_LEN_LENGTH;
+				// - Application header: 	blockInf + source [+ destination] + blockLen [+ piggybacked ack] [+ g_phase_counter if TXRX_TYPE_COMMAND],
+				//   						where TxRx_TransmitBuffer sets txPhaseIndex to the phase
+				BYTE phaseIndex = MAC_HEADER_SIZE + PROTOCOL_HEADER_SIZE + txPhaseIndex;
 				WORD phase = 0;
 				BYTE j;
-				// extract the received phase value from MACTxBuffer:
+				// extract the received phase value from the frame:
 				for( j = 0; j < MSG_PHS_LENGTH; j++ )
 				{
 					phase <<= 8;
-					phase += (WORD)(MACTxBuffer[phaseIndex + j]);
+					phase += (WORD)(*MACTxByte(phaseIndex + j));
 				}
 				// add local g_phase_counter value to the received phase (only the delta):
 				g_phase_counter_stop.Val = g_phase_counter.Val - g_phase_counter_start.Val;
@@ -429,10 +554,10 @@ Start_CCA:
 					g_phase_counter_stop.Val += 0xFFFF; // overflow
 				}
 				phase += g_phase_counter_stop.Val; 		// TODO overflow
-				// update the phase value in MACTxBuffer:
+				// update the phase value in the frame:
 				for( j = MSG_PHS_LENGTH; j > 0; j-- )
 				{
-					MACTxBuffer[phaseIndex++] = (BYTE)(phase >> (8 * (j - 1)));
+					*MACTxByte(phaseIndex++) = (BYTE)(phase >> (8 * (j - 1)));
 				}
 			}		
 			// ... YL 12.1				
@@ -453,6 +578,19 @@ Start_CCA:
                                 break;
                             case 2:
                                 SPIPut(TxPacketLen);
+                                #if defined ENABLE_TIME_SYNC
+                                if( isTimeSyncFrame )
+                                {
+                                    MIWI_TICK tsyncSof = MiWi_TickGet();
+                                    DWORD_VAL stamp;
+                                    
+                                    stamp.Val = tsyncGlobal + MiWi_TickGetDiff(tsyncSof, tsyncLocal);
+                                    *MACTxByte(TSYNC_INDEX + TSYNC_TIME) = stamp.v[0];
+                                    *MACTxByte(TSYNC_INDEX + TSYNC_TIME + 1) = stamp.v[1];
+                                    *MACTxByte(TSYNC_INDEX + TSYNC_TIME + 2) = stamp.v[2];
+                                    *MACTxByte(TSYNC_INDEX + TSYNC_TIME + 3) = stamp.v[3];
+                                }
+                                #endif
                                 break;
                             default:
                                 break;
@@ -461,8 +599,29 @@ Start_CCA:
                     }
                     else
                     {				
-                        SPIPut(MACTxBuffer[TxPacketPtr]);					
+                        BYTE txByte = *MACTxByte(TxPacketPtr);
+                        
+                        #if defined(ENABLE_SPI_BURST)
+                            SPIStart(txByte);
+                        #else
+                            SPIPut(txByte);
+                        #endif
+                        // the CRC is computed while the transceiver shifts the byte out, and 
+                        // placed in the last 2 bytes of the frame just before they are sent;
+                        // so it also covers the phase that was updated above
+                        if( TxPacketPtr < TxPacketLen - 2 )
+                        {
+                            crc = CRC16_BYTE(crc, txByte);
+                            if( TxPacketPtr == TxPacketLen - 3 )
+                            {
+                                *MACTxByte(TxPacketLen - 2) = (BYTE)(crc >> 8);
+                                *MACTxByte(TxPacketLen - 1) = (BYTE)crc;
+                            }
+                        }
                         TxPacketPtr++;
+                        #if defined(ENABLE_SPI_BURST)
+                            SPIWait();            // SPI_SDI is valid again when the byte has been sent
+                        #endif
 
                     }
                     counter = 0;
@@ -535,6 +694,12 @@ Start_CCA:
         status = FALSE;
         
 TX_END_HERE:    
+        MACLinkStats.txFrames++;
+        MACLinkStats.txRetries += messageRetryCounter - 1;
+        if( status == FALSE )
+        {
+            MACLinkStats.txFailures++;
+        }
 		ACC_IE = oldACCIE;
         return status;
     }
@@ -700,11 +865,76 @@ TX_END_HERE:
         {
             return FALSE;
         }
-        RegisterSet(0x9800 | (((WORD)RF_DEV/15 - 1) << 4) | outputPower);    
+        RegisterSet(0x9800 | (((WORD)LINK_RF_DEV/15 - 1) << 4) | outputPower);    
+        #if defined(ENABLE_LINK_RATE_ADAPTATION)
+            currentTxPower = outputPower;      // kept for MiMAC_SetDataRate
+        #endif
         return TRUE;
     }
     
     
+    #if defined(ENABLE_LINK_RATE_ADAPTATION)
+    /************************************************************************************
+     * Function:
+     *      BOOL MiMAC_SetDataRate(BYTE rate)
+     *
+     * Summary:
+     *      This function re-tunes the data rate of the RF transceiver
+     *
+     * Description:        
+     *      The function sets the bit rate (DRVSREG), and the frequency deviation
+     *      that matches it - both in the transmitter (TXCREG) and in the 
+     *      receiver band width (RXCREG), the same way MiMAC_Init does for the
+     *      compile-time DATA_RATE_xxx. The channel (centre frequency) and the
+     *      output power are kept. Both sides of a link must use the same rate,
+     *      so the caller is responsible for coordinating the change with the peer.
+     *
+     * PreCondition:    
+     *      MiMAC initialization has been done. 
+     *
+     * Parameters: 
+     *      BYTE rate -  one of LINK_RATE values
+     *
+     * Returns: 
+     *      A boolean to indicates if the rate setting is successful.
+     *
+     * Example:
+     *      <code>
+     *      MiMAC_SetDataRate(LINK_RATE_115200);
+     *      </code>
+     *
+     * Remarks:    
+     *      Only the 434MHz band is supported. The channel plan (FREQ_START, 
+     *      FREQ_STEP) stays the one of the base rate.
+     *
+     *****************************************************************************************/ 
+    BOOL MiMAC_SetDataRate(INPUT BYTE rate)
+    {
+        WORD rawDev;
+        
+        if( rate >= LINK_RATE_NUM )
+        {
+            return FALSE;
+        }
+        if( rate == currentLinkRate )
+        {
+            return TRUE;
+        }
+        
+        rawDev = (WORD)linkRateRawDev[rate] + 2*((WORD)CRYSTAL_PPM*434/1000);
+        currentRfDev = ((rawDev % 15) < 8) ? (rawDev - (rawDev % 15)) : (rawDev - (rawDev % 15) + 15);
+        
+        RegisterSet(linkRateDRVSREG[rate]);
+        RegisterSet(RXCREG | getReceiverBW());
+        RegisterSet(0x9800 | (((WORD)currentRfDev/15 - 1) << 4) | currentTxPower);
+        RegisterSet(FIFORSTREG);
+        RegisterSet(FIFORSTREG | 0x0002);                   // re-enable synchron latch with the new bit clock
+        currentLinkRate = rate;
+        return TRUE;
+    }
+    #endif
+    
+    
     /************************************************************************************
      * Function:
      *      BOOL MiMAC_Init(MACINIT_PARAM initValue)
@@ -752,7 +982,16 @@ TX_END_HERE:
         for(i = 0; i < BANK_SIZE; i++)
         {
             RxPacket[i].flags.Val = 0;
+            RxPacket[i].RefCount = 0;
         }
+        RxQueueHead = 0;
+        RxQueueTail = 0;
+        
+        #if defined(ENABLE_LINK_RATE_ADAPTATION)
+            currentLinkRate = BASE_LINK_RATE;   // DRVSREG, RXCREG and TXCREG are written below with the base rate settings
+            currentRfDev = RF_DEV;
+            currentTxPower = TX_POWER;
+        #endif
         
         #if defined(ENABLE_ACK) && defined(RETRANSMISSION)
             for(i = 0; i < ACK_INFO_SIZE; i++)
@@ -854,9 +1093,12 @@ TX_END_HERE:
 
         BYTE i;
         BYTE TxIndex;
-        WORD crc;	/*YL - note the difference: MRF49 calculates crc, MRF24 probably uses hardware crc*/ 
+        BYTE *slice = txSlice;          // the slice of the TxRx block is taken by this frame only
+        BYTE sliceLen = txSliceLen;
+        
+        txSliceLen = 0;
  	  		
-        if( MACPayloadLen > TX_BUFFER_SIZE )
+        if( MACPayloadLen + sliceLen > TX_BUFFER_SIZE )
         {		
             return FALSE;
         }
@@ -937,7 +1179,6 @@ TX_END_HERE:
 		// YL - 1. MAC Header: - Sequence Number (1 byte):
 		
         MACTxBuffer[1] = MACSeq++;
-        crc = CRC16((BYTE *)MACTxBuffer, 2, 0);
         
         TxIndex = 2;
         
@@ -981,7 +1222,6 @@ TX_END_HERE:
         // {
             // crc = CRC16(transParam.DestAddress, MACInitParams.actionFlags.bits.PAddrLength, crc);
         // }
-		crc = CRC16(destination, MACInitParams.actionFlags.bits.PAddrLength, crc);		// destination is the address that is eventually sent
 		// ... YL 6.9
 
 		// YL - 1. MAC Header: - Source Address:
@@ -1014,7 +1254,6 @@ TX_END_HERE:
 		}
 		// YL 6.9 ...
 		// was: crc = CRC16((BYTE *)&(MACTxBuffer[TxIndex - MACInitParams.actionFlags.bits.PAddrLength]), MACInitParams.actionFlags.bits.PAddrLength, crc); /*YL we write the address anyway, so there is no need to check if (sourcePrsnt)*/
-		crc = CRC16(source, MACInitParams.actionFlags.bits.PAddrLength, crc); // source is the address that is eventually sent		
 		// ... YL 6.9
 		// ... YL 30.8		
 				
@@ -1040,10 +1279,16 @@ TX_END_HERE:
                     
                     headerLen = TxIndex;
                     
+                    // the payload is encrypted in MACTxBuffer, so it is copied with the slice
                     for(i = 0; i < MACPayloadLen; i++)
                     {
                         MACTxBuffer[TxIndex++] = MACPayload[i];
                     }
+                    for(i = 0; i < sliceLen; i++)
+                    {
+                        MACTxBuffer[TxIndex++] = slice[i];
+                    }
+                    MACPayloadLen += sliceLen;
                     
                     #if SECURITY_LEVEL == SEC_LEVEL_CTR
                         {
@@ -1069,8 +1314,9 @@ TX_END_HERE:
                         CBC_MAC(MACTxBuffer, TxIndex, key, &(MACTxBuffer[TxIndex]));
                         TxIndex += SEC_MIC_LEN;
                     #endif
-                    
-                    crc = CRC16((BYTE *)&(MACTxBuffer[headerLen - 5]), (MACPayloadLen + SEC_MIC_LEN + 5), crc);
+                    MACTxFrame.headerLen = TxIndex;
+                    MACTxFrame.payloadLen = 0;
+                    MACTxFrame.sliceLen = 0;
                 }
             }
             else
@@ -1079,18 +1325,23 @@ TX_END_HERE:
     
 		// YL - 2. MAC Payload:
 		
-		// MAC Payload typically consists of [MiWi header || Application header || Application payload]				
-		for(i = 0; i < MACPayloadLen; i++)
+		// MAC Payload typically consists of [MiWi header || Application header || Application payload];
+		// it is sent from the buffer of the caller, and the slice from the TxRx block - both are not copied
 		{
-			MACTxBuffer[TxIndex++] = MACPayload[i];			
+			MACTxFrame.headerLen = TxIndex;
+			MACTxFrame.payload = MACPayload;
+			MACTxFrame.payloadLen = MACPayloadLen;
+			MACTxFrame.slice = slice;
+			MACTxFrame.sliceLen = sliceLen;
+			TxIndex += MACPayloadLen + sliceLen;
 		}
 		
-		crc = CRC16(MACPayload, MACPayloadLen, crc);   
-    
 		// YL - 3. CRC:
-			
-        MACTxBuffer[TxIndex++] = (BYTE)(crc >> 8);
-        MACTxBuffer[TxIndex++] = (BYTE)crc;
+		
+		// MRF49 calculates the crc in software (MRF24 uses hardware crc); TxPacket fills it while sending the frame
+        MACTxFrame.crc[0] = 0;
+        MACTxFrame.crc[1] = 0;
+        TxIndex += 2;
 		         		 
 		//BYTE oldACCIE = ACC_IE;
 		//ACC_IE = 0;
@@ -1135,10 +1386,11 @@ TX_END_HERE:
        		
 		// YL - MiMAC_ReceivedPacket fills MACRxPacket (MAC_RECEIVED_PACKET) with data from RxPacket (filled by _INT1Interrupt):
 				
-        for( i = 0; i < BANK_SIZE; i++ ) 
+        if( RxQueueHead != RxQueueTail )
         {
-            if( RxPacket[i].flags.bits.Valid )
-            {
+            i = RxQueue[RxQueueHead];                           // the oldest frame
+            RxQueueHead = (RxQueueHead + 1) % RX_QUEUE_SIZE;
+            ReceivedBankIndex = i;                              // from now on MiMAC_DiscardPacket releases the frame
                 BYTE PayloadIndex;
 				
 				// YL - MAC_RECEIVED_PACKET - flags:
@@ -1166,6 +1418,7 @@ TX_END_HERE:
 				// YL - MAC_RECEIVED_PACKET - PayloadLen:
 				
                 MACRxPacket.PayloadLen = RxPacket[i].PayloadLen;
+                MACRxPacket.SofTick = RxPacket[i].SofTick - SOF_DELAY_TICKS(LINK_DRVSREG);	// the time the sender took its stamp
 								
                 PayloadIndex = 2;
                 
@@ -1259,7 +1512,7 @@ TX_END_HERE:
                         // check key sequence number first
                         if( KEY_SEQUENCE_NUMBER != RxPacket[i].Payload[PayloadIndex + 4] )    
                         {
-                            RxPacket[i].flags.Val = 0;
+                            MiMAC_DiscardPacket();
                             return FALSE;
                         }
                         
@@ -1287,7 +1540,7 @@ TX_END_HERE:
                                 
                                 if( IncomingFrameCounter[j].Val > FrameCounter.Val )
                                 {
-                                    RxPacket[i].flags.Val = 0;
+                                    MiMAC_DiscardPacket();
                                     return FALSE;
                                 }
                                 else
@@ -1322,7 +1575,7 @@ TX_END_HERE:
 
                             if(CCM_Dec((BYTE *)RxPacket[i].Payload, PayloadIndex, RxPacket[i].PayloadLen-PayloadIndex, key) == FALSE)
                             {
-                                RxPacket[i].flags.Val = 0;
+                                MiMAC_DiscardPacket();
                                 return FALSE;
                             }
 
@@ -1335,7 +1588,7 @@ TX_END_HERE:
                                 {
                                     if( MIC[j] != RxPacket[i].Payload[RxPacket[i].PayloadLen-SEC_MIC_LEN+j] )
                                     {
-                                        RxPacket[i].flags.Val = 0;
+                                        MiMAC_DiscardPacket();
                                         return FALSE;
                                     }    
                                 }
@@ -1381,9 +1634,7 @@ TX_END_HERE:
                     }
                     MACRxPacket.LQIValue = RxPacket[i].flags.bits.DQD;
                 #endif
-                ReceivedBankIndex = i;			
                 return TRUE;
-            }			
         } 	
         return FALSE;    
     }
@@ -1427,11 +1678,43 @@ TX_END_HERE:
     {
         if( ReceivedBankIndex < BANK_SIZE )
         {
-            RxPacket[ReceivedBankIndex].flags.Val = FALSE;
+            if( RxPacket[ReceivedBankIndex].RefCount > 0 )
+            {
+                RxPacket[ReceivedBankIndex].RefCount--; // the frame is free when its last user releases it
+            }
             ReceivedBankIndex = 0xFF;    
         }
     }
     
+    /***************************************************************************
+     * Function:
+     *      BYTE MiMAC_RetainPacket(void)
+     *
+     * Returns:
+     *      The handle of the frame of the current packet (0xFF - none); the 
+     *      payload stays valid until MiMAC_ReleasePacket(handle)
+	***************************************************************************/
+    BYTE MiMAC_RetainPacket(void)
+    {
+        if( ReceivedBankIndex < BANK_SIZE )
+        {
+            RxPacket[ReceivedBankIndex].RefCount++;
+        }
+        return ReceivedBankIndex;
+    }
+    
+    /***************************************************************************
+     * Function:
+     *      void MiMAC_ReleasePacket(BYTE frame)
+	***************************************************************************/
+    void MiMAC_ReleasePacket(BYTE frame)
+    {
+        if( frame < BANK_SIZE && RxPacket[frame].RefCount > 0 )
+        {
+            RxPacket[frame].RefCount--;
+        }
+    }
+    
     
     #if defined(ENABLE_ED_SCAN)
         /************************************************************************************
@@ -1520,7 +1803,7 @@ TX_END_HERE:
     #endif
     
     
-    #if defined(ENABLE_SLEEP)
+    #if defined(ENABLE_SLEEP) || defined(ENABLE_LOW_POWER_LISTEN)
         /************************************************************************************
          * Function:
          *      BOOL MiMAC_PowerState(BYTE PowerState)
@@ -1543,6 +1826,9 @@ TX_END_HERE:
          *                          The minimum definitions for all RF transceivers are
          *                          * POWER_STATE_DEEP_SLEEP RF transceiver deep sleep mode.
          *                          * POWER_STATE_OPERATE RF transceiver operating mode.
+         *                          MRF49XA adds (ENABLE_LOW_POWER_LISTEN)
+         *                          * POWER_STATE_WAKE_TIMER RF transceiver sleeps, and its
+         *                            wake-up timer interrupts after LPL_INTERVAL_MS.
          * Returns: 
          *      A boolean to indicate if changing power state of RF transceiver is successful.
          *
@@ -1576,12 +1862,30 @@ TX_END_HERE:
                     }
                     break;
                 
+                #if defined(ENABLE_LOW_POWER_LISTEN)
+                case POWER_STATE_WAKE_TIMER:
+                    {
+                        RegisterSet(FIFORSTREG);                // turn off FIFO
+                        RegisterSet(GENCREG);                   // disable FIFO, TX_latch
+                        RegisterSet(PMCREG & ~0x0008);          // turn off the receiver, the transmitter and the oscillator
+                        RegisterSet(WTSREG | (WAKE_TIMER_R << 8) | WAKE_TIMER_M);
+                        RegisterSet((PMCREG & ~0x0008) | 0x0002);   // (re)start the wake-up timer
+                        StatusRead();                           // reset all non latched interrupts
+                        nFSEL = 1;
+                    }
+                    break;
+                #endif
+                
                 case POWER_STATE_OPERATE:
                     {
                         BYTE i;
                         
                         RegisterSet(PMCREG | 0x0008);           // switch on oscillator
                         DelayMs(10);                            // oscillator start up time 2~7 ms. Use 10ms here
+                        RegisterSet(PMCREG | 0x0080);           // turn on the receiver (and off the wake-up timer)
+                        RegisterSet(GENCREG | 0x0040);          // enable the FIFO
+                        RegisterSet(FIFORSTREG);
+                        RegisterSet(FIFORSTREG | 0x0002);       // wait for the synchron pattern again
                         #if defined(ENABLE_ACK)
                             for(i = 0; i < ACK_INFO_SIZE; i++)
                             {
@@ -1621,6 +1925,9 @@ TX_END_HERE:
         if( RFIE && RFIF )
         {
 			//RFIE = 0;
+			if (MRF49XA_IsrHook != NULL) {
+				MRF49XA_IsrHook();		// the application learns that the transceiver has something
+			}
             PHY_CS = 0;
             #if defined(__dsPIC30F__) || defined(__dsPIC33F__) || defined(__PIC24F__) || defined(__PIC24FK__) || defined(__PIC24H__) || defined(__PIC32MX__)
                 Nop();         			// add Nop here to make sure PIC24 family MCU can respond to the SPI_SDI change
@@ -1630,6 +1937,7 @@ TX_END_HERE:
 			// start to record of the phase-counter:
 			g_phase_counter_start.Val = g_phase_counter.Val;
 			// ... YL 12.1		
+			rxSofTick = MiWi_TickGet();
 
             if( SPI_SDI == 1 )
             {
@@ -1639,6 +1947,8 @@ TX_END_HERE:
                 WORD counter;
                 BOOL bAck;
                 BYTE ackPacket[4];
+                BYTE rxByte;
+                WORD rxCrc;
                 
                 // There is data in RX FIFO
                 PHY_CS = 1;
@@ -1648,7 +1958,7 @@ TX_END_HERE:
 				
                 for( BankIndex = 0; BankIndex < BANK_SIZE; BankIndex++ )
                 {
-                    if( RxPacket[BankIndex].flags.bits.Valid == FALSE )
+                    if( RxPacket[BankIndex].RefCount == 0 )     // a free frame of the pool
                     {
                         break;
                     }
@@ -1665,6 +1975,14 @@ TX_END_HERE:
 
                 if( PacketLen >= RX_PACKET_SIZE || PacketLen == 0 || (BankIndex >= BANK_SIZE && (bAck == FALSE)) )
                 {			
+                    if( PacketLen >= RX_PACKET_SIZE || PacketLen == 0 )
+                    {
+                        MACLinkStats.rxBadLength++;
+                    }
+                    else
+                    {
+                        MACLinkStats.rxPoolFull++;
+                    }
 IGNORE_HERE:       
                     nFSEL = 1;                                      // bad packet len received
                     RFIF = 0;
@@ -1679,30 +1997,45 @@ IGNORE_HERE:
                 
                 RxPacketPtr = 0;
                 counter = 0;
+                rxCrc = 0;
+                rxByte = 0;
 
                 while(1)
                 {
                     if(FINT == 1)
                     {
+                        #if defined(ENABLE_SPI_BURST)
+                            // the CRC of the previous byte is computed while this one is shifted in 
+                            // (for the first byte it adds 0 to 0, which is 0)
+                            SPIStart(0x00);
+                            rxCrc = CRC16_BYTE(rxCrc, rxByte);
+                            rxByte = SPIWait();
+                        #else
+                            rxByte = SPIGet();
+                            rxCrc = CRC16_BYTE(rxCrc, rxByte);    // CRC over the whole frame, including the received CRC, is 0
+                        #endif
                         if( bAck )
                         {
-                            ackPacket[RxPacketPtr++] = SPIGet();
+                            ackPacket[RxPacketPtr++] = rxByte;
                         }
                         else
                         {
-                            RxPacket[BankIndex].Payload[RxPacketPtr++] = SPIGet();
+                            RxPacket[BankIndex].Payload[RxPacketPtr++] = rxByte;
                         }
                         
                         if( RxPacketPtr >= PacketLen ) //RxPacket[BankIndex].PayloadLen )
                         {
                             WORD received_crc;
-                            WORD calculated_crc;
                             BYTE i;
 
+                            #if defined(ENABLE_SPI_BURST)
+                                rxCrc = CRC16_BYTE(rxCrc, rxByte);    // CRC over the whole frame, including the received CRC, is 0
+                            #endif
                             StatusRead();
 
                             if( TransceiverStatus.bits.DQD == 0 )
                             {
+                                MACLinkStats.rxDqdLost++;
                                 goto IGNORE_HERE;
                             }
                             
@@ -1715,14 +2048,15 @@ IGNORE_HERE:
                                 #if defined(ENABLE_ACK)
                                 if( ( ackPacket[0] & PACKET_TYPE_MASK ) == PACKET_TYPE_ACK )
                                 {
-                                    received_crc  = ((WORD)ackPacket[3]) + (((WORD)ackPacket[2]) << 8);
-                                    calculated_crc = CRC16(ackPacket, 2, 0);
-                                    if( received_crc != calculated_crc)
+                                    if( rxCrc != 0 )
                                     {
+                                        MACLinkStats.rxCrcErrors++;
 										RxPacketPtr = 0;
                                         RegisterSet(FIFORSTREG | 0x0002);
 										goto IGNORE_HERE;
                                     }
+                                    MACLinkStats.rxFrames++;
+                                    MACLinkStats.rxRssiHigh += TransceiverStatus.bits.RSSI_ATS;
                                     if( ackPacket[1] == TxMACSeq )
                                     {
                                         hasAck = TRUE;
@@ -1735,6 +2069,7 @@ IGNORE_HERE:
                                 #endif
                                 if( BankIndex >= BANK_SIZE )
                                 {
+                                    MACLinkStats.rxPoolFull++;
                                     RxPacketPtr = 0;
                                     RegisterSet(FIFORSTREG | 0x0002);								
                                     goto IGNORE_HERE;
@@ -1746,6 +2081,7 @@ IGNORE_HERE:
                             }
                             
                             RxPacket[BankIndex].PayloadLen = PacketLen;
+                            RxPacket[BankIndex].SofTick = rxSofTick.Val;
 
                             // checking CRC
                             received_crc = ((WORD)(RxPacket[BankIndex].Payload[RxPacket[BankIndex].PayloadLen - 1])) + (((WORD)(RxPacket[BankIndex].Payload[RxPacket[BankIndex].PayloadLen - 2])) << 8);	
@@ -1763,16 +2099,20 @@ IGNORE_HERE:
                                 //calculated_crc = CRC16(MACInitParams.PAddress, MACInitParams.actionFlags.bits.PAddrLength, calculated_crc);								
                                 //calculated_crc = CRC16((BYTE *)&(RxPacket[BankIndex].Payload[2]), RxPacket[BankIndex].PayloadLen - 4, calculated_crc);								
                             //}															                               
-							calculated_crc = CRC16((BYTE *)RxPacket[BankIndex].Payload, RxPacket[BankIndex].PayloadLen - 2, 0);						
+							// was: calculated_crc = CRC16((BYTE *)RxPacket[BankIndex].Payload, RxPacket[BankIndex].PayloadLen - 2, 0);						
 							// ... YL 6.9
+							// the CRC was accumulated while the bytes were read:
                             
-                            if( received_crc != calculated_crc )
+                            if( rxCrc != 0 )
                             {	
+                                MACLinkStats.rxCrcErrors++;
 								RxPacketPtr = 0;
                                 RxPacket[BankIndex].PayloadLen = 0;
                                 RegisterSet(FIFORSTREG | 0x0002);            // FIFO synchron latch re-enable 
 								goto IGNORE_HERE;
                             }
+                            MACLinkStats.rxFrames++;
+                            MACLinkStats.rxRssiHigh += TransceiverStatus.bits.RSSI_ATS;
 							                            
                             #if !defined(TARGET_SMALL)
                                 RxPacket[BankIndex].flags.bits.DQD = 1;
@@ -1829,6 +2169,7 @@ IGNORE_HERE:
 											{													
 												if( RxPacket[BankIndex].Payload[2 + i] != myNetworkAddress.v[i] )
 												{
+													MACLinkStats.rxNotForMe++;
 													RxPacketPtr = 0;
 													RxPacket[BankIndex].PayloadLen = 0;
 													RegisterSet(FIFORSTREG | 0x0002);
@@ -1844,6 +2185,8 @@ IGNORE_HERE:
                                 #if defined(ENABLE_ACK)
                                     if( (RxPacket[BankIndex].Payload[0] & ACK_MASK) )  // acknowledgement required
                                     {
+                                        MAC_TX_FRAME txFrame = MACTxFrame;        // the frame that may be sent now
+                                        
                                         RegisterSet(FIFORSTREG | 0x0002);
                                         
                                         for( i = 0; i < 4; i++ )
@@ -1852,9 +2195,9 @@ IGNORE_HERE:
                                         }
                                         MACTxBuffer[0] = PACKET_TYPE_ACK | BROADCAST_MASK;   // frame control, ack type + broadcast
                                         MACTxBuffer[1] = RxPacket[BankIndex].Payload[1];     // sequence number
-                                        calculated_crc = CRC16((BYTE *)MACTxBuffer, 2, 0);	 /*YL in ack case - send back calculated crc*/
-                                        MACTxBuffer[2] = calculated_crc >> 8;
-                                        MACTxBuffer[3] = calculated_crc;
+                                        MACTxFrame.headerLen = 2;                            // crc, calculated by TxPacket
+                                        MACTxFrame.payloadLen = 0;
+                                        MACTxFrame.sliceLen = 0;
                                         DelayMs(2);;
 										TxPacket(4, FALSE);
                                         
@@ -1863,6 +2206,7 @@ IGNORE_HERE:
                                         {
                                             MACTxBuffer[i] = ackPacket[i];
                                         }
+                                        MACTxFrame = txFrame;
                                     }
                                 #endif
                                     
@@ -1873,6 +2217,7 @@ IGNORE_HERE:
                                             AckInfo[i].CRC == received_crc )
                                         {										
                                             AckInfo[i].startTick = MiWi_TickGet();
+                                            MACLinkStats.rxDuplicates++;
                                             break;    
                                         }
                                         if( (ackInfoIndex == 0xFF) && (AckInfo[i].Valid == FALSE) )
@@ -1891,12 +2236,16 @@ IGNORE_HERE:
                                         }
 
                                         RxPacket[BankIndex].PayloadLen -= 2;        // remove CRC
-                                        RxPacket[BankIndex].flags.bits.Valid = TRUE;
+                                        RxPacket[BankIndex].RefCount = 1;
+                                        RxQueue[RxQueueTail] = BankIndex;           // hand the frame over to MiMAC_ReceivedPacket
+                                        RxQueueTail = (RxQueueTail + 1) % RX_QUEUE_SIZE;
                                     }
                                 #else
                                 
                                     RxPacket[BankIndex].PayloadLen -= 2;            // remove CRC
-                                    RxPacket[BankIndex].flags.bits.Valid = TRUE;
+                                    RxPacket[BankIndex].RefCount = 1;
+                                    RxQueue[RxQueueTail] = BankIndex;               // hand the frame over to MiMAC_ReceivedPacket
+                                    RxQueueTail = (RxQueueTail + 1) % RX_QUEUE_SIZE;
                                     #if !defined(TARGET_SMALL)
                                         RxPacket[BankIndex].flags.bits.RSSI = TransceiverStatus.bits.RSSI_ATS;
                                         RxPacket[BankIndex].flags.bits.DQD = TransceiverStatus.bits.DQD; 
@@ -1911,6 +2260,7 @@ IGNORE_HERE:
                     }
                     else if( counter++ > 0xFFFE )
                     {
+                        MACLinkStats.rxTimeouts++;
                         goto IGNORE_HERE;
                     }
                 }
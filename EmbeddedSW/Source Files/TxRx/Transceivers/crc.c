@@ -186,6 +186,17 @@
             return crc;
         }
         
+        /*********************************************************************
+         * WORD CRC16Byte(INPUT WORD crc, INPUT BYTE b)
+         *
+         * Overview:        This function adds a single byte to a running CRC
+         *                  (the loop method behind CRC16_BYTE)
+         ********************************************************************/
+        WORD CRC16Byte(WORD crc, BYTE b)
+        {
+            return CRC16(&b, 1, crc);
+        }
+        
     #endif
 #else
     /*******************************************************************
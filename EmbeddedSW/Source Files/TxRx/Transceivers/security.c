@@ -56,69 +56,341 @@
 #include "SystemProfile.h"
 #include "Transceivers/Transceivers.h"
 
-#if defined(SOFTWARE_SECURITY) && defined(ENABLE_SECURITY)
+#if defined(SOFTWARE_SECURITY) && (defined(ENABLE_SECURITY) || defined(ENABLE_TXRX_SECURITY))
 
     #include "GenericTypeDefs.h"
     #include "Transceivers/Security.h"                                
 	//#include "WirelessProtocols/Console.h"
     
-    BYTE tmpBlock[BLOCK_SIZE];
+    #if defined(ENABLE_SECURITY)
+        BYTE tmpBlock[BLOCK_SIZE];
+    #endif
         
-    #if defined(XTEA_128)
-		 /**************************************************************************
-		  * To follow US export control regulation, this free download version 
-		  * implements XTEA with 32bit block size and 64bit key length. To acquire 
-		  * the XTEA engine with 64bit block size and 128bit key length, customer
-		  * needs to authorize through MicrochipDirect web site or any other Microchip 
-		  * agent.
-		  ***************************************************************************/
-    
-    #elif defined(XTEA_64)
+    #if defined(XTEA_128) || defined(XTEA_64)
         #if defined(__18CXX)
             //#pragma romdata securityKey = 0x2E
         #endif
-            ROM const unsigned char mySecurityKey[8] = {SECURITY_KEY_00, SECURITY_KEY_01, SECURITY_KEY_02,    // The 16-byte security key used in the
-                SECURITY_KEY_03, SECURITY_KEY_04, SECURITY_KEY_05, SECURITY_KEY_06, SECURITY_KEY_07};   // security module.                                                              
+            ROM const unsigned char mySecurityKey[KEY_SIZE] = {SECURITY_KEY_00, SECURITY_KEY_01, SECURITY_KEY_02,    // The security key used in the
+                SECURITY_KEY_03, SECURITY_KEY_04, SECURITY_KEY_05, SECURITY_KEY_06, SECURITY_KEY_07                 // security module.
+            #if defined(XTEA_128)
+                , SECURITY_KEY_08, SECURITY_KEY_09, SECURITY_KEY_10, SECURITY_KEY_11, SECURITY_KEY_12, 
+                SECURITY_KEY_13, SECURITY_KEY_14, SECURITY_KEY_15
+            #endif
+                };
         #if defined(__18CXX)
             //#pragma romdata
         #endif
         
         /*********************************************************************
-         * void encode(INPUT WORD *text, INPUT WORD *key)
+         * void XTEA_Schedule(INPUT BLOCK_UNIT *key, OUTPUT BLOCK_UNIT *schedule)
+         *
+         * Overview:        This function calculates the round keys of the 
+         *                  XTEA engine (sum + key word of each half round),
+         *                  so the engine does not calculate them for every 
+         *                  block that is encoded with the same key
+         *
+         * PreCondition:    None
+         *
+         * Input:       
+         *          BLOCK_UNIT *    key         The security key for the XTEA engine
+         * Output:          
+         *          BLOCK_UNIT *    schedule    XTEA_SCHEDULE_SIZE round keys
          *
-         * Overview:        This function apply XTEA-64 security engine to
+         * Side Effects:    None
+         * 
+         ********************************************************************/
+        void XTEA_Schedule(BLOCK_UNIT *key, BLOCK_UNIT *schedule)
+        {
+            BLOCK_UNIT sum = 0;
+            BYTE i;
+            
+            for(i = 0; i < XTEA_ROUND; i++)
+            {
+                *schedule++ = sum + key[sum & 3];
+                sum += XTEA_DELTA;
+                *schedule++ = sum + key[(sum >> 11) & 3];
+            }
+        }
+        
+        // a half round - with XTEA_64 the 16-bit shifts and adds map onto single PIC24 instructions
+        #define XTEA_HALF_ROUND(a, b)   a += (((b << 4) ^ (b >> 5)) + b) ^ *schedule++
+        
+        /*********************************************************************
+         * void XTEA_Encode(INPUT BLOCK_UNIT *text, INPUT BLOCK_UNIT *schedule)
+         *
+         * Overview:        This function apply XTEA security engine to
+         *                  the input data buffer with the round keys of the
+         *                  security key (XTEA_Schedule). The encoded data will
+         *                  replace the input data
+         *
+         * PreCondition:    None
+         *
+         * Input:       
+         *          BLOCK_UNIT *    text        The input buffer to the XTEA engine. The 
+         *                                      encoded data will replace the original 
+         *                                      content after the function call
+         *          BLOCK_UNIT *    schedule    The round keys of the security key
+         * Output:          
+         *          None
+         *
+         * Side Effects:    None
+         * 
+         ********************************************************************/
+        void XTEA_Encode(BLOCK_UNIT *text, BLOCK_UNIT *schedule)
+        {
+            BLOCK_UNIT part1 = text[0], part2 = text[1];
+            BYTE i;
+            
+            for(i = 0; i < XTEA_ROUND; i += 4)
+            {
+                XTEA_HALF_ROUND(part1, part2);
+                XTEA_HALF_ROUND(part2, part1);
+                XTEA_HALF_ROUND(part1, part2);
+                XTEA_HALF_ROUND(part2, part1);
+                XTEA_HALF_ROUND(part1, part2);
+                XTEA_HALF_ROUND(part2, part1);
+                XTEA_HALF_ROUND(part1, part2);
+                XTEA_HALF_ROUND(part2, part1);
+            }
+            text[0] = part1; text[1] = part2;
+        }
+        
+    #if defined(ENABLE_SECURITY)
+        BLOCK_UNIT scheduleKey[KEY_SIZE/sizeof(BLOCK_UNIT)];    // the key of keySchedule (encode)
+        BLOCK_UNIT keySchedule[XTEA_SCHEDULE_SIZE];
+        BOOL isKeyScheduled = FALSE;
+        
+        /*********************************************************************
+         * void encode(INPUT BLOCK_UNIT *text, INPUT BLOCK_UNIT *key)
+         *
+         * Overview:        This function apply XTEA security engine to
          *                  the input data buffer with input security key. 
-         *                  The encoded data will replace the input data
+         *                  The encoded data will replace the input data. The
+         *                  round keys of the last key are kept, and calculated
+         *                  again only when the key changes
          *
          * PreCondition:    None
          *
          * Input:       
-         *          WORD *      data        The input buffer to the XTEA engine. The 
-         *                                  encoded data will replace the original 
-         *                                  content after the function call
-         *          WORD *      key         The security key for the XTEA engine
+         *          BLOCK_UNIT *    data        The input buffer to the XTEA engine. The 
+         *                                      encoded data will replace the original 
+         *                                      content after the function call
+         *          BLOCK_UNIT *    key         The security key for the XTEA engine
          * Output:          
          *          None
          *
          * Side Effects:    None
          * 
          ********************************************************************/
-        void encode(WORD *text, WORD *key)
+        void encode(BLOCK_UNIT *text, BLOCK_UNIT *key)
         {
-            WORD part1=text[0], part2=text[1];
-            WORD sum=0, delta=0x9E37;
             BYTE i;
             
-            for(i=0; i<XTEA_ROUND; i++) 
+            for(i = 0; i < KEY_SIZE/sizeof(BLOCK_UNIT); i++)
             {
-                part1 += (((part2 << 4) ^ (part2 >> 5)) + part2) ^ (sum + key[sum & 3]);
-                sum += delta;
-                part2 += (((part1 << 4) ^ (part1 >> 5)) + part1) ^ (sum + key[(sum>>11) & 3]);
+                if( scheduleKey[i] != key[i] )
+                {
+                    isKeyScheduled = FALSE;
+                }
+            }
+            if( isKeyScheduled == FALSE )
+            {
+                for(i = 0; i < KEY_SIZE/sizeof(BLOCK_UNIT); i++)
+                {
+                    scheduleKey[i] = key[i];
+                }
+                XTEA_Schedule(key, keySchedule);
+                isKeyScheduled = TRUE;
             }
-            text[0]=part1; text[1]=part2;
+            XTEA_Encode(text, keySchedule);
+        }
+    #endif
+        
+        // the cipher blocks of CCM_SealBlock/CCM_OpenBlock, as 2 block units:
+        #if defined(XTEA_128)
+            // 2 big endian double words, so the engine is the XTEA of the reference code and its test vectors
+            #define CCM_UNIT(p)         (((DWORD)(p)[0] << 24) | ((DWORD)(p)[1] << 16) | ((WORD)(p)[2] << 8) | (p)[3])
+            #define CCM_LOAD(w, p)      w[0] = CCM_UNIT(p); w[1] = CCM_UNIT((p) + 4)
+            #define CCM_STORE(p, w)     (p)[0] = (BYTE)(w[0] >> 24); (p)[1] = (BYTE)(w[0] >> 16); (p)[2] = (BYTE)(w[0] >> 8); (p)[3] = (BYTE)w[0]; \
+                                        (p)[4] = (BYTE)(w[1] >> 24); (p)[5] = (BYTE)(w[1] >> 16); (p)[6] = (BYTE)(w[1] >> 8); (p)[7] = (BYTE)w[1]
+            #define CCM_COUNTER(w, nonce, ctr)  w[0] = CCM_UNIT(nonce); \
+                                        w[1] = ((DWORD)nonce[4] << 24) | ((DWORD)nonce[5] << 16) | ((WORD)nonce[6] << 8) | (BYTE)(ctr)
+        #else
+            // 2 words (the byte order of encode)
+            #define CCM_LOAD(w, p)      w[0] = (WORD)(p)[0] | ((WORD)(p)[1] << 8); w[1] = (WORD)(p)[2] | ((WORD)(p)[3] << 8)
+            #define CCM_STORE(p, w)     (p)[0] = (BYTE)w[0]; (p)[1] = (BYTE)(w[0] >> 8); (p)[2] = (BYTE)w[1]; (p)[3] = (BYTE)(w[1] >> 8)
+            #define CCM_COUNTER(w, nonce, ctr)  w[0] = (WORD)nonce[0] | ((WORD)nonce[1] << 8); w[1] = (WORD)nonce[2] | ((WORD)(ctr) << 8)
+        #endif
+        
+        /*********************************************************************
+         * WORD CCM_SealBlock(BYTE *dest, 
+         *                    BYTE *text, 
+         *                    WORD len, 
+         *                    BYTE *nonce, 
+         *                    BLOCK_UNIT *schedule)
+         *
+         * Overview:        This function implements CCM mode of security 
+         *                  engine for a whole block (up to CCM_BLOCK_MAX_LEN
+         *                  bytes) in a single pass over the text: the CBC-MAC
+         *                  of [nonce, 0], a block of the length and the text
+         *                  (padded with zeros) is encrypted with counter 
+         *                  CCM_CTR_MIC, and the text with the counters from 
+         *                  CCM_CTR_DATA 
+         *
+         * PreCondition:    The nonce is never used twice with the same key
+         *
+         * Input:       
+         *          BYTE *      text        The text to be authenticated and encrypted
+         *          WORD        len         The length of the text
+         *          BYTE *      nonce       CCM_NONCE_LEN bytes
+         *          BLOCK_UNIT *schedule    The round keys of the security key
+         * Output:          
+         *          BYTE *      dest        The encrypted text, followed by the 
+         *                                  encrypted MIC (CCM_BLOCK_MIC_LEN bytes).
+         *                                  It may be the text itself
+         *
+         * Return value:    The length of dest
+         *
+         * Side Effects:    None
+         * 
+         ********************************************************************/
+        WORD CCM_SealBlock(BYTE *dest, BYTE *text, WORD len, BYTE *nonce, BLOCK_UNIT *schedule)
+        {
+            BLOCK_UNIT mic[2], pad[2], block[2];
+            BYTE last[BLOCK_SIZE];
+            BYTE ctr = CCM_CTR_DATA;
+            WORD i, j;
+            
+            CCM_COUNTER(mic, nonce, 0);
+            XTEA_Encode(mic, schedule);
+            mic[0] ^= len;
+            XTEA_Encode(mic, schedule);
+            
+            for(i = 0; i + BLOCK_SIZE <= len; i += BLOCK_SIZE)
+            {
+                CCM_LOAD(block, &text[i]);
+                mic[0] ^= block[0]; mic[1] ^= block[1];
+                XTEA_Encode(mic, schedule);
+                CCM_COUNTER(pad, nonce, ctr++);
+                XTEA_Encode(pad, schedule);
+                block[0] ^= pad[0]; block[1] ^= pad[1];
+                CCM_STORE(&dest[i], block);
+            }
+            if( i < len )                           // the last cipher block is partial
+            {
+                for(j = 0; j < BLOCK_SIZE; j++)
+                {
+                    last[j] = (i + j < len) ? text[i + j] : 0;
+                }
+                CCM_LOAD(block, last);
+                mic[0] ^= block[0]; mic[1] ^= block[1];
+                XTEA_Encode(mic, schedule);
+                CCM_COUNTER(pad, nonce, ctr);
+                XTEA_Encode(pad, schedule);
+                block[0] ^= pad[0]; block[1] ^= pad[1];
+                CCM_STORE(last, block);
+                for(j = 0; i < len; j++, i++)
+                {
+                    dest[i] = last[j];
+                }
+            }
+            
+            CCM_COUNTER(pad, nonce, CCM_CTR_MIC);
+            XTEA_Encode(pad, schedule);
+            mic[0] ^= pad[0]; mic[1] ^= pad[1];
+            CCM_STORE(&dest[len], mic);
+            return len + CCM_BLOCK_MIC_LEN;
+        }
+        
+        /*********************************************************************
+         * BOOL CCM_OpenBlock(BYTE *text, 
+         *                    WORD len, 
+         *                    BYTE *nonce, 
+         *                    BLOCK_UNIT *schedule)
+         *
+         * Overview:        This function decrypts a block of CCM_SealBlock in
+         *                  place, and checks its MIC
+         *
+         * PreCondition:    None
+         *
+         * Input:       
+         *          BYTE *      text        The encrypted text followed by the MIC. 
+         *                                  The decrypted text will replace it, 
+         *                                  even if the MIC is wrong
+         *          WORD        len         The length of the text with the MIC
+         *          BYTE *      nonce       CCM_NONCE_LEN bytes
+         *          BLOCK_UNIT *schedule    The round keys of the security key
+         * Output:          
+         *          None
+         *
+         * Return value:    TRUE if the MIC is right
+         *
+         * Side Effects:    None
+         * 
+         ********************************************************************/
+        BOOL CCM_OpenBlock(BYTE *text, WORD len, BYTE *nonce, BLOCK_UNIT *schedule)
+        {
+            BLOCK_UNIT mic[2], pad[2], block[2];
+            BYTE last[BLOCK_SIZE];
+            BYTE ctr = CCM_CTR_DATA;
+            WORD i, j;
+            
+            if( len < CCM_BLOCK_MIC_LEN )
+            {
+                return FALSE;
+            }
+            len -= CCM_BLOCK_MIC_LEN;
+            CCM_COUNTER(mic, nonce, 0);
+            XTEA_Encode(mic, schedule);
+            mic[0] ^= len;
+            XTEA_Encode(mic, schedule);
+            
+            for(i = 0; i + BLOCK_SIZE <= len; i += BLOCK_SIZE)
+            {
+                CCM_LOAD(block, &text[i]);
+                CCM_COUNTER(pad, nonce, ctr++);
+                XTEA_Encode(pad, schedule);
+                block[0] ^= pad[0]; block[1] ^= pad[1];
+                CCM_STORE(&text[i], block);
+                mic[0] ^= block[0]; mic[1] ^= block[1];
+                XTEA_Encode(mic, schedule);
+            }
+            if( i < len )
+            {
+                for(j = 0; j < BLOCK_SIZE; j++)
+                {
+                    last[j] = (i + j < len) ? text[i + j] : 0;
+                }
+                CCM_LOAD(block, last);
+                CCM_COUNTER(pad, nonce, ctr);
+                XTEA_Encode(pad, schedule);
+                block[0] ^= pad[0]; block[1] ^= pad[1];
+                CCM_STORE(last, block);
+                for(j = 0; j < BLOCK_SIZE; j++)
+                {
+                    if( i + j < len )
+                    {
+                        text[i + j] = last[j];
+                    }
+                    else
+                    {
+                        last[j] = 0;                // the MIC was calculated over zeros
+                    }
+                }
+                CCM_LOAD(block, last);
+                mic[0] ^= block[0]; mic[1] ^= block[1];
+                XTEA_Encode(mic, schedule);
+            }
+            
+            CCM_COUNTER(pad, nonce, CCM_CTR_MIC);
+            XTEA_Encode(pad, schedule);
+            mic[0] ^= pad[0]; mic[1] ^= pad[1];
+            CCM_LOAD(block, &text[len]);
+            return ((mic[0] ^ block[0]) | (mic[1] ^ block[1])) == 0;
         }
     #endif
     
+    #if defined(ENABLE_SECURITY)
     /*********************************************************************
      * void CTR(BYTE *text, 
      *          BYTE len, 
@@ -356,6 +628,7 @@
         #endif  
         return TRUE;
     }
+    #endif // ENABLE_SECURITY
 
 #endif
 
@@ -21,10 +21,38 @@
 #include "command.h"		
 #include "eeprom.h" 		
 #include "parser.h"			
+#include "error.h"
 #include "TimeDelay.h"		
 #include "led_buzzer.h"		// YL 31.10 for broadcast and phase counters 
+#if defined ENABLE_TXRX_SECURITY
+	#include "Transceivers/Security.h"
+	#if !defined SOFTWARE_SECURITY || !defined XTEA_128 || (TXRX_SEC_OVERHEAD != TXRX_SEC_HEADER_LEN + CCM_BLOCK_MIC_LEN) || (TXRX_SEC_HEADER_LEN > CCM_NONCE_LEN)
+		#error "ENABLE_TXRX_SECURITY requires the XTEA-128 SOFTWARE_SECURITY of the transceiver"
+	#endif
+#endif
+#if defined ENABLE_USB_FRAMING || defined ENABLE_COMPACT_HEADER || (defined ENABLE_FAST_REJOIN && defined WISDOM_STONE) || defined ENABLE_CHANNEL_MAP
+	#include "Transceivers/crc.h"
+#endif
 
 /************************ DEFINE ************************************/
+#if defined ENABLE_CHANNEL_MAP && (!defined ENABLE_FREQUENCY_AGILITY || !defined NWK_ROLE_COORDINATOR)
+	#error "ENABLE_CHANNEL_MAP moves the network by the frequency agility of a coordinator"
+#endif
+#if defined ENABLE_TDMA_UPLOAD && ((MAX_NWK_ADDR_EUI0 > 0x3F) || (TDMA_MAX_SLOTS < MAX_NWK_SIZE - 1) || (TDMA_MAX_SUPERFRAME_BLOCKS < MAX_NWK_SIZE - 1))
+	#error "TDMA upload: every stone must fit a slot byte, the beacon and the superframe"
+#endif
+#if defined ENABLE_TDMA_UPLOAD && !defined ENABLE_CUMULATIVE_ACK
+	#error "TDMA upload: the data blocks wait for the upload slot in the window of ENABLE_CUMULATIVE_ACK"
+#endif
+#if defined ENABLE_LINK_RATE_ADAPTATION && !defined ENABLE_TDMA_UPLOAD
+	#error "Link rate adaptation: a link leaves the base rate only in the upload slot of its stone"
+#endif
+#if defined ENABLE_USB_FRAMING && !defined SOFTWARE_CRC
+	#error "USB framing: the frame CRC uses the software CRC of the transceiver"
+#endif
+#if defined ENABLE_COMPACT_HEADER && !defined SOFTWARE_CRC
+	#error "Compact header: the block CRC uses the software CRC of the transceiver"
+#endif
 
 static char *TxRx_err_messages[] = {
 	"TxRx - No Error",
@@ -40,16 +68,20 @@ static char *TxRx_err_messages[] = {
 	"TxRx - Received invalid packet trailer",
 	"TxRx - NWK Unknown Destination",			// YL 4.8 invalid network address of the destination
 	"TxRx - NWK Not Me",						// YL 23.7 
+	"TxRx - Command queue is full",
 	""
 };
 
+#if !defined ENABLE_COMPACT_HEADER
 // The trailer is constant, and is used for synchronization after each block.
 static BYTE TxRx_Trailer[TXRX_TRAILER_SIZE] = {
 	0x25, 0x83, 0x33, 0x57
 };
+#endif
 
 // Next is the struct of transmission block. 
-// It consists of block header, buffer, trailer and current position in the block.
+// It consists of block header, data, trailer and current position in the block.
+// The data is the block of the caller - it is not copied, and must not change until the block is sent.
 // The header consists of block type, ackSeq and block length (without header and trailer).
 typedef struct {
 
@@ -63,9 +95,12 @@ typedef struct {
 															//		destinationNwkAddress[0] is a parameter EUI_0 
 															//		destinationNwkAddress[1] is a parameter EUI_1 
 		WORD blockLen;
+		#if defined ENABLE_CUMULATIVE_ACK
+		BYTE piggyAck;										// TXRX_PIGGYBACK_ACK | the sequence of the ack (0 - none)
+		#endif
 	} blockHeader;
 	
-	BYTE blockBuffer[MAX_BLOCK_SIZE + 10]; 
+	BYTE *blockData; 
 	BYTE blockTrailer[TXRX_TRAILER_SIZE];
 	WORD blockPos;
 } TX_BLOCK_BUFFER;
@@ -81,13 +116,25 @@ typedef struct {
 		WORD blockLen;
 	} blockHeader;
 
-	BYTE blockBuffer[MAX_BLOCK_SIZE + 10];
+	#if defined ENABLE_ZERO_COPY_RX
+	BYTE *blockBuffer;								// blockStore, or the block in the received frame (TxRx_ReceivePacketHeader)
+	BYTE blockStore[TXRX_MAX_BLOCK_LEN + 10];
+	BYTE rxFrame;									// the frame that holds the block (MiApp_RetainMessage; 0xFF - none)
+	#else
+	BYTE blockBuffer[TXRX_MAX_BLOCK_LEN + 10];
+	#endif
 	BYTE blockTrailer[TXRX_TRAILER_SIZE];
 
 	struct {
 		WORD blockPos;
 		BOOL isHeader;	
 		BOOL isTrailer;
+		#if defined COMMUNICATION_PLUG
+		BYTE srcAddr[2];			// the MiWi source of the messages of the block (short or long address)
+		BOOL isAltSrcAddr;
+		BYTE eui0;					// EUI_0 of the stone that sent the block
+		MIWI_TICK lastTick;			// the last message of the block
+		#endif
 	} handlingParam;
 } RX_BLOCK_BUFFER;
 
@@ -102,14 +149,95 @@ typedef struct {
 	BYTE rxExpectedSeq;
 } BLOCK_ACK_INFO;
 
+// Link statistics of a neighbour ("txrx stats"); the counters are free running:
+typedef struct {
+	WORD			txBlocks;				// blocks delivered to the neighbour (acked)
+	WORD			txFailures;				// blocks that could not be delivered to the neighbour
+	WORD			macRetries;				// MAC retransmissions of the messages to the neighbour
+	WORD			rxFrames;				// messages received from the neighbour,
+	WORD			rxRssiHigh;				// above RSSI_THRESHOLD,
+	WORD			rxDqd;					// with DQD at the end of the frame
+	WORD			rxBlocks;				// blocks received from the neighbour
+	WORD			rxTrailerErrors;		// blocks with a wrong trailer/CRC (TXRX_RECEIVED_INVALID_TRAILER)
+	WORD			rxSeqErrors;			// TXRX_WRONG_DATA_SEQ and TXRX_WRONG_ACK_SEQ
+	WORD			rttAverage;				// the round trip of a block and its ack, in ms (0 - no sample yet)
+	WORD			rxAuthErrors;			// data blocks that were dropped by TxRx_OpenBlock
+} TXRX_LINK_STATS;
+
+#if defined COMMUNICATION_PLUG
+// The plug keeps the state of each network device (the plug included) in stoneTable.
+// Entries are allocated in the order the devices become known - by join-info, or by the 
+// first block to/from the device - and stoneSlot maps EUI[0] to the entry, so the lookup 
+// on the receive path is a single indexed read whatever the size of the network.
+typedef struct {
+	BYTE			eui0;					// the network address of the device
+	BYTE			parentEUI0;				// EUI_0 of the parent of the device (0xFF - none)
+	BYTE			isNetworkMember	: 1;
+	BYTE			isCoordinator	: 1;
+	BYTE			isStopped		: 1;	// "app stop" was sent to the stone, and therefore its next data block will not be printed
+	BYTE			isReplyPending	: 1;	// a broadcast command was sent to the stone, and its reply was not received yet
+	#if defined ENABLE_LOW_POWER_LISTEN
+	BYTE			isDozing		: 1;	// the stone sent TXRX_CTRL_DOZE - it has to be woken before a command
+	#endif
+	BYTE			replyTag;				// the tag of the last command sent to the stone - its replies are reported with it
+	BLOCK_ACK_INFO	ackInfo;
+	#if defined ENABLE_CUMULATIVE_ACK
+	BYTE			ackPending;				// data blocks that were received from the stone and not acked yet
+	MIWI_TICK		ackTick;				// the first of them was received
+	#endif
+	#if defined ENABLE_LINK_RATE_ADAPTATION
+	BYTE			linkRate;				// the data rate of the link to the stone
+	#endif
+	#if defined ENABLE_LOW_POWER_LISTEN
+	MIWI_TICK		lplTick;				// the last block from the stone - it dozes after LPL_IDLE_TIMEOUT without blocks
+	#endif
+	#if defined ENABLE_TDMA_UPLOAD
+	BYTE			slotShift;				// the upload slot of the stone is (1 << slotShift) blocks (TDMA_NO_SLOT - none)
+	BYTE			slotUsed;				// data blocks received from the stone in the current superframe
+	BYTE			slotIdle;				// superframes in a row without data from the stone
+	#endif
+	TXRX_LINK_STATS	stats;					// of the link to the stone
+	#if defined ENABLE_TXRX_SECURITY
+	DWORD			secCounter;				// the lowest block counter that is not a replay
+	DWORD			secCounterLimit;		// the replay mark in the EEPROM (SEC_REPLAY_ADDRESS)
+	#endif
+} STONE_ENTRY;
+#endif // COMMUNICATION_PLUG
+
 /************************ VARIABLES ********************************/
 TX_BLOCK_BUFFER txBlock;
-RX_BLOCK_BUFFER rxBlock;
+#if defined WISDOM_STONE
+	RX_BLOCK_BUFFER rxBlockBuffer;
+	RX_BLOCK_BUFFER *rxBlock = &rxBlockBuffer;
+#elif defined COMMUNICATION_PLUG
+	// Stones may upload at the same time, so the messages of their blocks interleave: each block is received
+	// into its own buffer, chosen by the MiWi source of the message. rxBlock is the buffer of the last message.
+	RX_BLOCK_BUFFER rxBlockPool[TXRX_RX_BLOCKS];
+	RX_BLOCK_BUFFER *rxBlock = &rxBlockPool[0];
+#endif
 #if defined WISDOM_STONE
 	BLOCK_ACK_INFO  blockAckInfo;
+	#if defined ENABLE_CUMULATIVE_ACK
+	// The data blocks that were sent and not acked yet: the k-th block from txWindowFirst has the sequence txLastSeq + 1 + k.
+	typedef struct {
+		BYTE		block[TXRX_MAX_BLOCK_LEN];	// sealed, with ENABLE_TXRX_SECURITY
+		WORD		blockLen;
+		MIWI_TICK	sentTick;					// the last time the block was sent
+	} TX_WINDOW_ENTRY;
+	
+	TX_WINDOW_ENTRY	txWindow[TXRX_ACK_WINDOW];
+	BYTE		txWindowFirst;
+	BYTE		txWindowCount;
+	BYTE		txWindowSent;					// the first blocks of the window that were sent (the rest wait for the upload slot)
+	BOOL		isWindowSending;				// the window is being sent or waited for (TxRx_WindowTasks must not send it again)
+	MIWI_TICK	txWindowTick;					// the last ack that released blocks, or the first block in an empty window
+	MIWI_TICK	txResendTick;					// the last block of the window was sent
+	#endif
 #elif defined COMMUNICATION_PLUG
-	BLOCK_ACK_INFO  blockAckInfo[MAX_NWK_SIZE];  			// the indices in the array match EUI[0] of the stone: 
-															// e.g - ack info of the stone with EUI[0] = 2 is in blockAckInfo[2]
+	STONE_ENTRY		stoneTable[MAX_NWK_SIZE];				// the ack info, flags and counters of each device in the network
+	BYTE			stoneSlot[MAX_NWK_ADDR_EUI0 + 1];		// the indices in the array match EUI[0] of the device: 
+															// e.g - the entry of the stone with EUI[0] = 2 is stoneTable[stoneSlot[2] - 1] (0 - unknown device)
+	BYTE			stoneCount;								// the number of allocated entries in stoneTable
 #endif // WISDOM_STONE
 
 // Next global variables are only for receiving commands during transmission of blocks.
@@ -125,8 +253,6 @@ RX_BLOCK_BUFFER rxBlock;
 	// indicates for the plug that "app stop" was sent to the stone, and therefore the next block that will be received, will not be printed.
 	BOOL isAppStop;							// YL indicates that the plug received "app stop" command, 
 											// and therefore it should stop receiving data blocks from the stone
-	BOOL isStopped[MAX_NWK_SIZE];			// the indices in the array match EUI[0] of the stone: 
-											// e.g - ack info of the stone with EUI[0] = 2 is in blockAckInfo[2]
 #endif // COMMUNICATION_PLUG
 
 #if defined ENABLE_RETRANSMISSION
@@ -134,22 +260,65 @@ RX_BLOCK_BUFFER rxBlock;
 	extern BYTE messageRetryCounter;
 #endif
 
-BYTE finalDestinationNwkAddress[MY_ADDRESS_LENGTH]; 		// currently max possible MAX_NWK_SIZE is 8 components in the network, so 1 byte is enough for the network address of the destination
+BYTE finalDestinationNwkAddress[MY_ADDRESS_LENGTH]; 		// EUI[0] of the devices is up to MAX_NWK_ADDR_EUI0, so 1 byte is enough for the network address of the destination
 BOOL isBroadcast;											// indicates that we received broadcast command
 
-#if defined COMMUNICATION_PLUG && defined ENABLE_TXRX_ACK 	// for indices of blockAckInfo array
-	BYTE txToEUI0;			// EUI_0 of the destination when the plug is the transmitter (= finalDestinationNwkAddress[0])
-	BYTE rxFromEUI0;		// EUI_0 of the source when the plug is the receiver (= finalDestinationNwkAddress[0])
-#endif // COMMUNICATION_PLUG, ENABLE_TXRX_ACK
-
 #if defined COMMUNICATION_PLUG
-	BOOL isNetworkMember[MAX_NWK_SIZE]; 	// array of indications whether the stone is or isn't network member; the "0" index belongs to the plug, all other indices reflect the EUI_0 of the stone  
-	BOOL isCoordinator[MAX_NWK_SIZE];		// array of indications whether the stone is or isn't network member; the "0" index belongs to the plug, all other indices reflect the EUI_0 of the stone
-	BYTE parentDeviceEUI0[MAX_NWK_SIZE];	// array of EUI_0 addresses of stone-network-members' parents; the "0" index belongs to the plug, all other indices reflect the EUI_0 of the stone
-	BYTE currentNwkSize;	
+	STONE_ENTRY *txToStone;		// the entry of the destination when the plug is the transmitter (= finalDestinationNwkAddress[0])
+	STONE_ENTRY *rxFromStone;	// the entry of the source when the plug is the receiver (= finalDestinationNwkAddress[0])
+	#define TX_STATS	(txToStone->stats)
+	#define RX_STATS	(rxFromStone->stats)
 #elif defined WISDOM_STONE
 	BOOL isCoordinator;
 	BYTE parentDeviceEUI0;
+	TXRX_LINK_STATS linkStats;	// of the link to the plug
+	#define TX_STATS	linkStats
+	#define RX_STATS	linkStats
+#endif
+
+#if defined ENABLE_CHANNEL_MAP
+	#define CHMAP_MAGIC			0x5A
+	#define CHMAP_UNKNOWN		0xFF			// the noise of a channel that was never sampled
+	
+	typedef struct {
+		BYTE		magic;
+		BYTE		channel;					// of the last network (0xFF - none)
+		BYTE		noise[CHANNEL_NUM];
+		BYTE		per[CHANNEL_NUM];			// in %
+		WORD		crc;						// CRC16 of the bytes before it
+	} CHANNEL_MAP;								// it must fit an EEPROM page (eeprom_write_block)
+	
+	CHANNEL_MAP	chanMap;
+	BYTE		chanSavedPer;					// the PER of the operating channel in the EEPROM
+	LINK_STATS	chanWindowStart;				// MACLinkStats at the beginning of the PER window
+	WORD		chanSampleFrames;				// the frames sent and received up to the last noise sample
+	MIWI_TICK	chanSampleTick;
+	#if defined WISDOM_STONE
+		BYTE	chanScanNext;					// the next channel of the agility scan (CHMAP_NO_SCAN - none)
+		#define CHMAP_NO_SCAN	0xFF
+	#endif
+	#if defined WISDOM_STONE
+		MIWI_TICK	chanHopTick;				// the network starter started or moved the network
+	#endif
+#endif
+
+#if defined ENABLE_TXRX_SECURITY
+	BYTE secKey[KEY_SIZE];					// the network key, provisioned in the EEPROM by "txrx key"
+	BOOL isSecKeyLoaded;					// nothing is sealed or opened without it
+	BLOCK_UNIT secSchedule[XTEA_SCHEDULE_SIZE];	// the round keys of the stone key
+	#if defined COMMUNICATION_PLUG
+		BYTE secScheduleEUI0;				// the stone of secSchedule (0xFF - none)
+		#define TXRX_DATA_OFFSET	TXRX_SEC_HEADER_LEN	// the data of a sealed block follows [KEY_SEQUENCE_NUMBER, counter]
+	#elif defined WISDOM_STONE
+		DWORD secCounter;					// of the next block
+		DWORD secCounterLimit;				// the counters below it are reserved in the EEPROM
+		#if !defined ENABLE_CUMULATIVE_ACK
+			BYTE secBlock[TXRX_MAX_BLOCK_LEN];	// the sealed block that is sent
+		#endif
+		extern CommTypes g_usb_or_wireless_print;	// where the command came from (command.c)
+	#endif
+#else
+	#define TXRX_DATA_OFFSET	0
 #endif
 
 #define JOIN_SEND				0b01010101					// 0b0101,0101 for join-info correspondence (join-info messages are sent only at init stage, therefore no ambiguity is expected)
@@ -159,8 +328,12 @@ BOOL isBroadcast;											// indicates that we received broadcast command
 
 // YL 31.10 ...
 BOOL isTxRxTypeCommand;	// for g_phase_counter
+BYTE txPhaseIndex;
 // ... YL 31.10
 
+BYTE *txSlice;			// the data of the next message, sent by the MAC from txBlock after the TxBuffer
+BYTE txSliceLen;
+
 // YL 11.1 ...
 WORD_VAL g_phase_counter_start;
 WORD_VAL g_phase_counter_stop;
@@ -168,6 +341,107 @@ WORD_VAL g_broadcast_counter_start;
 WORD_VAL g_broadcast_counter_stop;
 // ... YL 11.1
 
+#if defined ENABLE_LINK_RATE_ADAPTATION && defined WISDOM_STONE
+		BYTE	linkRate;						// the data rate of the link to the plug in the upload slot of the stone
+		BYTE	linkSlotBlocks;					// data blocks sent in the upload slot of the current superframe
+		LINK_STATS	linkWindowStart;			// MACLinkStats at the beginning of the current evaluation window
+		BYTE	linkWindowBlocks;				// data blocks sent in the current evaluation window
+		BYTE	linkUpHoldoff;					// windows left before the next step up is allowed
+#endif // ENABLE_LINK_RATE_ADAPTATION && WISDOM_STONE
+
+// Replies to broadcast commands:
+#if defined WISDOM_STONE
+	BYTE		replySlot;						// the reply slot of the stone for the current broadcast command
+	BYTE		replySlots;						// the number of reply slots (0 - not a broadcast command, replies are sent at once)
+	BOOL		isReplyStarted;					// the plug broadcast the start of the replies
+	BOOL		isReplyHeld;					// the command was handled - the reply waits for its slot (TxRx_ReplyTasks)
+	BOOL		isReplyCut;						// the reply did not fit replyBuffer - it ends with TXRX_REPLY_CUT_MARK
+	MIWI_TICK	replyTick;						// the reception of the command, and then of the start of the replies
+	char		replyBuffer[TXRX_REPLY_BUFFER_SIZE];	// the reply is collected here until it is sent (or until the reply slot)
+	WORD		replyLen;
+#elif defined COMMUNICATION_PLUG
+	BOOL		isReplyCollecting;				// the plug is collecting the replies to a broadcast command
+	BYTE		replyCollectSlots;				// the reply slots of the broadcast command
+	MIWI_TICK	replyCollectTick;				// the start of the replies was broadcast
+	BYTE		bcastCommand[MAX_CMD_LEN + TXRX_REPLY_INFO_LENGTH];
+	WORD		bcastCommandLen;				// the command, its '\0' and the reply info
+#endif
+
+#if defined COMMUNICATION_PLUG
+// Commands from the host wait in cmdQueue until they are delivered or fail; TxRx_CommandTasks advances
+// the delivery by one step per call and never waits for a stone, so a stone that does not answer delays 
+// neither the commands to other stones nor the blocks that the stones send. The commands to the same 
+// stone are delivered in their order.
+typedef enum {
+	CMD_STATE_SEND,								// the command is sent at the next step (after CMD_RETRY_BACKOFF if it failed)
+	CMD_STATE_WAIT_ACK,							// the command was sent - the ack of the stone is awaited
+	CMD_STATE_COLLECT,							// a broadcast command was delivered - its replies are collected
+	CMD_STATE_WAKE								// the stone may be dozing - it is woken before the command is sent (ENABLE_LOW_POWER_LISTEN)
+} CMD_STATE;
+
+typedef struct {
+	BYTE		isUsed		: 1;
+	BYTE		isBroadcast	: 1;
+	BYTE		isStarted	: 1;				// the first attempt was made (firstTick is valid)
+	BYTE		isWoken		: 1;				// the wake frames were sent before the current attempt (ENABLE_LOW_POWER_LISTEN)
+	BYTE		state;							// CMD_STATE
+	BYTE		tag;							// the number of the command in the reports to the host
+	BYTE		eui0;							// the destination stone
+	BYTE		retries;						// failed attempts left (of a broadcast command - to the current stone)
+	BYTE		member;							// a broadcast command: the index in stoneTable of the current stone,
+	BYTE		slot;							// its reply slot,
+	BYTE		slots;							// and the number of reply slots
+	MIWI_TICK	firstTick;						// the first attempt
+	MIWI_TICK	lastTick;						// the last attempt
+	char		command[MAX_CMD_LEN];			// the text of the command, or its binary form (ENABLE_BINARY_COMMANDS)
+	BYTE		commandLen;
+} CMD_ENTRY;
+
+CMD_ENTRY	cmdQueue[CMD_QUEUE_SIZE];
+CMD_ENTRY	*cmdActive = NULL;					// the command being delivered - the others wait until its step is over
+BYTE		cmdTag;								// the tag of the next command
+#endif // COMMUNICATION_PLUG
+
+#if defined ENABLE_TDMA_UPLOAD
+	MIWI_TICK	tdmaTick;						// the beginning of the current superframe (plug - beacon sent, stone - beacon received)
+	DWORD		tdmaSuperframe;					// the length of the current superframe in ticks (0 - no schedule, the stones contend for the channel)
+	#if defined WISDOM_STONE
+		DWORD	tdmaSlotStart;					// the upload slot of the stone, relative to the beginning of the superframe
+		DWORD	tdmaSlotEnd;
+		BOOL	tdmaOwnSlot;					// the slot is the stone's own (FALSE - the contention part)
+	#endif
+#endif // ENABLE_TDMA_UPLOAD
+
+#if defined ENABLE_TIME_SYNC
+	BYTE		tsyncSeq;						// the sequence of the last time-sync message (sent by the plug, used by the stone)
+	MIWI_TICK	tsyncTick;						// plug - the last time-sync message was sent, stone - the last reference point was taken
+	#if defined WISDOM_STONE
+		typedef struct {
+			DWORD	localTick;					// the local tick at the start of the time-sync frame
+			DWORD	offset;						// the network time in the frame minus localTick
+		} TSYNC_ENTRY;
+		TSYNC_ENTRY	tsyncTable[TSYNC_TABLE_SIZE];	// the reference points (a cyclic buffer)
+		BYTE	tsyncCount;						// the number of reference points (0 - no time base)
+		BYTE	tsyncNext;						// the entry for the next reference point
+		BYTE	tsyncErrors;					// the outliers in a row
+		BYTE	tsyncLevel;						// the level of the transmitter of the last reference point, plus 1
+		DWORD	tsyncAnchor;					// the time base: network time = local + tsyncBase + (tsyncIntercept + tsyncSkew * (local - tsyncAnchor)),
+		DWORD	tsyncBase;						// where tsyncIntercept is in 1/256 tick and tsyncSkew in 2^-24 
+		long	tsyncIntercept;
+		long	tsyncSkew;
+	#endif
+#endif // ENABLE_TIME_SYNC
+
+#if defined ENABLE_LOW_POWER_LISTEN
+#if defined COMMUNICATION_PLUG
+	MIWI_TICK	lplWakeTick;					// the last wake frame
+#elif defined WISDOM_STONE
+	MIWI_TICK	lplActiveTick;					// the last block that was sent or received
+	BOOL		lplWakeRequest;					// the plug sent a wake frame for the stone
+	BOOL		isLplDozing;					// the plug was told that the stone dozes, and no block came since
+#endif
+#endif // ENABLE_LOW_POWER_LISTEN
+
 /***************** FUNCTION DECLARATIONS ****************************/
 
 // Overall functions:
@@ -176,32 +450,160 @@ TXRX_ERRORS TxRx_PlugHandler();
 
 // Tx Functions:
 TXRX_ERRORS TxRx_TransmitBuffer();
+TXRX_ERRORS TxRx_UnicastMessage(BYTE *slice, BYTE sliceLen);
 TXRX_ERRORS TxRx_SendPacket(BYTE *data, WORD dataLen, BLOCK_TYPE bType);
+TXRX_ERRORS TxRx_TransmitPacket(BYTE *data, WORD dataLen, BLOCK_TYPE bType);
 
 #if defined WISDOM_STONE
 	TXRX_ERRORS TxRx_SendData(BYTE* samples_block, WORD TX_message_length);	
+	TXRX_ERRORS TxRx_TrySendData(BYTE *block, WORD blockLen);
 	TXRX_ERRORS m_TxRx_write(BYTE *str);
 #elif defined COMMUNICATION_PLUG
-	TXRX_ERRORS TxRx_SendCommand(BYTE* command);
+	TXRX_ERRORS TxRx_SendCommand(BYTE* command, WORD commandLen);
 #endif //WISDOM_STONE
 
 #if defined ENABLE_TXRX_ACK // YL 25.12 added #ifdef
 TXRX_ERRORS TxRx_SendAck();
 #endif
+#if defined ENABLE_CUMULATIVE_ACK
+#if defined WISDOM_STONE
+TXRX_ERRORS TxRx_WindowSend(BYTE *block, WORD blockLen);
+TXRX_ERRORS TxRx_WindowSendBlock(BYTE k);
+void TxRx_WindowSendPending(void);
+void TxRx_WindowResend(void);
+TXRX_ERRORS TxRx_WindowWait(BYTE limit);
+void TxRx_WindowReceive(void);
+BOOL TxRx_WindowAck(BYTE ackSeq);
+void TxRx_WindowTasks(void);
+#elif defined COMMUNICATION_PLUG
+void TxRx_AckTasks(void);
+#endif
+#endif // ENABLE_CUMULATIVE_ACK
+void TxRx_FillTxBlock(BYTE *data, WORD dataLen);
+#if defined ENABLE_COMPACT_HEADER
+BYTE TxRx_WriteVarLen(WORD len);
+BYTE TxRx_ReadVarLen(BYTE *src, BYTE srcLen, WORD *len);
+WORD TxRx_BlockCrc(BYTE *block, WORD blockLen);
+#endif
 BYTE TxRx_ByteAdd(BYTE toAdd, BYTE addingTo); // YL 12.1 was: TxRx_noOverflowADD; renamed to TxRx_ByteAdd
+void TxRx_RttSample(TXRX_LINK_STATS *stats, MIWI_TICK sentTick);
 
 // Rx Functions:
 TXRX_ERRORS TxRx_ReceiveHeaderPacket();
+void TxRx_CountRxFrame(void);
 void TxRx_ReceiveBuffer();
 TXRX_ERRORS TxRx_ReceiveMessage();
 TXRX_ERRORS TxRx_ReceivePacket();
+#if defined ENABLE_ZERO_COPY_RX
+void TxRx_InitRxBlock(RX_BLOCK_BUFFER *block);
+void TxRx_ReleaseRxBlock(RX_BLOCK_BUFFER *block);
+#endif
 
 #if defined COMMUNICATION_PLUG
+BOOL TxRx_SelectRxBlock(void);
 void TxRx_ReceiveJoinInfo(void);
+STONE_ENTRY* TxRx_GetStone(BYTE eui0);
+STONE_ENTRY* TxRx_AddStone(BYTE eui0);
+STONE_ENTRY* TxRx_JoinStone(BYTE eui0, BYTE parentEUI0);
+#if defined ENABLE_USB_FRAMING
+void TxRx_WriteFrame(BYTE eui0, BYTE *block, WORD blockLen);
+#endif
 #elif defined WISDOM_STONE
 void TxRx_SendJoinInfo(void);
 #endif
 
+// Control Functions:
+void TxRx_HandleControl(void);
+#if defined ENABLE_LINK_RATE_ADAPTATION
+void TxRx_LinkRateInit(void);
+void TxRx_SetLinkRate(BYTE rate);
+BOOL TxRx_LinkRateFallback(void);
+void TxRx_TuneLinkRate(BYTE rate);
+void TxRx_LinkRateSchedule(void);
+#if defined COMMUNICATION_PLUG
+BYTE TxRx_LinkRateOf(STONE_ENTRY *stone);
+STONE_ENTRY* TxRx_NextHop(STONE_ENTRY *stone);
+#elif defined WISDOM_STONE
+void TxRx_LinkRateAdapt(void);
+BOOL TxRx_IsDirectLink(void);
+#endif
+#endif // ENABLE_LINK_RATE_ADAPTATION
+BOOL TxRx_ConsumeBroadcast(void);
+#if defined COMMUNICATION_PLUG
+void TxRx_CollectReplies(BYTE slots);
+void TxRx_ReplyCollectTasks(void);
+BYTE TxRx_BroadcastStart(BYTE *command, WORD commandLen);
+BOOL TxRx_BroadcastMember(BYTE i, BYTE slot);
+void TxRx_CommandAttempt(CMD_ENTRY *entry);
+void TxRx_CommandFailed(CMD_ENTRY *entry, TXRX_ERRORS status);
+STONE_ENTRY* TxRx_CommandStone(CMD_ENTRY *entry);
+BOOL TxRx_IsCommandReady(CMD_ENTRY *entry, MIWI_TICK now);
+void TxRx_ReportCommand(CMD_ENTRY *entry, char *state, TXRX_ERRORS error);
+#elif defined WISDOM_STONE
+void TxRx_TakeCommand(void);
+TXRX_ERRORS TxRx_SendReply(void);
+void TxRx_ReplyTasks(void);
+#endif
+#if defined ENABLE_TDMA_UPLOAD
+#if defined ENABLE_LINK_RATE_ADAPTATION
+DWORD TxRx_BlockTime(BYTE rate);
+#endif
+#if defined COMMUNICATION_PLUG
+void TxRx_TdmaSchedule(void);
+STONE_ENTRY* TxRx_SlotOwner(void);
+WORD TxRx_SlotBlocks(STONE_ENTRY *stone);
+#elif defined WISDOM_STONE
+BOOL TxRx_InUploadSlot(void);
+void TxRx_ReceiveBeacon(void);
+BOOL TxRx_UploadSlotOpen(void);
+#endif
+#endif // ENABLE_TDMA_UPLOAD
+#if defined ENABLE_TIME_SYNC
+#if defined COMMUNICATION_PLUG
+void TxRx_TimeSyncTasks(void);
+#elif defined WISDOM_STONE
+void TxRx_ReceiveTimeSync(void);
+void TxRx_TimeSyncFit(void);
+#endif
+#endif // ENABLE_TIME_SYNC
+void TxRx_PrintLinkStats(BYTE eui0, TXRX_LINK_STATS *stats);
+void TxRx_PrintMacStats(void);
+#if defined ENABLE_TXRX_SECURITY
+BOOL TxRx_SecLoadKey(void);
+int TxRx_SecSetKey(char *hex);
+void TxRx_SecSchedule(BYTE eui0);
+#if defined COMMUNICATION_PLUG
+void TxRx_SecReplayInit(STONE_ENTRY *stone);
+BOOL TxRx_OpenBlock(void);
+#elif defined WISDOM_STONE
+void TxRx_SecInit(void);
+WORD TxRx_SealBlock(BYTE *dest, BYTE *block, WORD blockLen);
+#endif
+#endif // ENABLE_TXRX_SECURITY
+#if defined ENABLE_CHANNEL_MAP
+void TxRx_ChannelMapInit(void);
+void TxRx_SaveChannelMap(void);
+void TxRx_NoiseSample(BYTE channel, BYTE noise);
+void TxRx_ScanChannels(void);
+BYTE TxRx_BestChannel(BYTE exclude);
+void TxRx_ChannelTasks(void);
+void TxRx_PrintChannelMap(void);
+#if defined WISDOM_STONE
+BYTE TxRx_StartChannel(void);
+BOOL TxRx_ScanStep(void);
+void TxRx_ChangeChannel(void);
+void StartChannelHopping(BYTE OptimalChannel);		// MiWi.c (ENABLE_FREQUENCY_AGILITY)
+#endif
+#endif // ENABLE_CHANNEL_MAP
+#if defined ENABLE_LOW_POWER_LISTEN
+#if defined COMMUNICATION_PLUG
+BOOL TxRx_IsDozing(STONE_ENTRY *stone);
+BOOL TxRx_WakeStones(BYTE eui0);
+#elif defined WISDOM_STONE
+BOOL TxRx_CanDoze(void);
+#endif
+#endif // ENABLE_LOW_POWER_LISTEN
+
 /******************************************************************************
 * Function:
 *		void MRFInit()
@@ -255,6 +657,9 @@ void MRFInit() {
 	
 #if defined(HARDWARE_SPI)
      SPI2CON1 = 0b0000000100111010;
+	#if defined(ENABLE_SPI_BURST)
+     SPI2CON2 = 0x0001;			// enhanced buffer mode (SPIBEN), set while the SPI is disabled
+	#endif
      SPI2STAT = 0x8000;	
 #else
 	#error "Not defined Hardware SPI"
@@ -274,6 +679,127 @@ void MRFInit() {
     RFIE = 1; // YL 11.5(BM) - added to be like in the RFD example
 }
 
+#if defined ENABLE_FAST_REJOIN && defined WISDOM_STONE
+// The stone keeps its network state in the EEPROM (NWK_STATE_ADDRESS), and resumes it
+// after a wakeup instead of a scan and an association. The magic and the CRC tell 
+// an erased or a formatted page from a record.
+#define NWK_STATE_MAGIC		0xA5
+
+typedef struct {
+	BYTE			magic;
+	NETWORK_STATE	state;
+	WORD			crc;		// CRC16 of the bytes before it
+} NETWORK_RECORD;				// it must fit an EEPROM page (eeprom_write_block)
+
+// fails to compile (an array of size -1) if the record does not fit an EEPROM page:
+typedef char NETWORK_RECORD_FITS_PAGE[(sizeof(NETWORK_RECORD) <= EEPROM_PAGE_SIZE) ? 1 : -1];
+
+/******************************************************************************
+* Function:
+*		WORD TxRx_NetworkRecordCRC(NETWORK_RECORD *record)
+*
+* Description:
+*      Returns the CRC16 of the record, without the crc field.
+*
+******************************************************************************/
+static WORD TxRx_NetworkRecordCRC(NETWORK_RECORD *record) {
+
+	BYTE	*p = (BYTE *)record;
+	WORD	crc = 0;
+	WORD	i;
+	
+	for (i = 0; i < (BYTE *)&record->crc - p; i++) {
+		crc = CRC16_BYTE(crc, p[i]);
+	}
+	return crc;
+}
+
+/******************************************************************************
+* Function:
+*		BOOL TxRx_ReadNetwork(NETWORK_RECORD *record)
+*
+* Description:
+*      Reads the network record of the stone from the EEPROM.
+*
+* Return value: 
+*	   TRUE if the record is valid.
+*
+******************************************************************************/
+static BOOL TxRx_ReadNetwork(NETWORK_RECORD *record) {
+
+	if (eeprom_read_block(NWK_STATE_ADDRESS, (BYTE *)record, sizeof(NETWORK_RECORD))) {
+		return FALSE;
+	}
+	return (record->magic == NWK_STATE_MAGIC) && (record->crc == TxRx_NetworkRecordCRC(record));
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_SaveNetwork(void)
+*
+* Description:
+*      Writes the network state of the stone to the EEPROM. The page is written 
+*	   only if the state has changed since the last save.
+*
+******************************************************************************/
+void TxRx_SaveNetwork(void) {
+
+	NETWORK_RECORD	record, stored;
+	
+	if (!MiWiStateMachine.bits.memberOfNetwork) {
+		return;
+	}
+	memset(&record, 0, sizeof(record));		// the padding is a part of the CRC
+	record.magic = NWK_STATE_MAGIC;
+	MiApp_GetNetworkState(&record.state);
+	record.crc = TxRx_NetworkRecordCRC(&record);
+	if (TxRx_ReadNetwork(&stored) && !memcmp(&stored, &record, sizeof(record))) {
+		return;
+	}
+	eeprom_write_block(NWK_STATE_ADDRESS, (BYTE *)&record, sizeof(record));
+}
+
+/******************************************************************************
+* Function:
+*		BOOL TxRx_ResumeNetwork(void)
+*
+* Description:
+*      Resumes the network state that TxRx_SaveNetwork kept. The network starter 
+*	   resumes its network as is; any other stone confirms the link to its parent
+*	   first (MiApp_ResumeNetwork). If the stone could not resume, the stack is 
+*	   initialized again, for a scan.
+*	   A resume costs the read of the record (~70 bytes over the 400 kHz I2C, 
+*	   about 2 ms) and one data request with its MAC ack and retries, in place
+*	   of the energy scan and the active scan of every channel. The wakeup time
+*	   was not measured on the stone.
+*
+* Return value: 
+*	   TRUE if the stone operates in the network again.
+*
+******************************************************************************/
+static BOOL TxRx_ResumeNetwork(void) {
+
+	NETWORK_RECORD	record;
+	
+	if (TxRx_ReadNetwork(&record) && MiApp_ResumeNetwork(&record.state)) {
+		#if defined NWK_ROLE_COORDINATOR
+			isCoordinator = TRUE;
+		#endif
+		if (myParent < CONNECTION_SIZE) {
+			parentDeviceEUI0 = ConnectionTable[myParent].Address[0];
+		}
+		return TRUE;
+	}
+	
+	MiApp_ProtocolInit(FALSE);
+	#if defined ENABLE_LINK_RATE_ADAPTATION
+		TxRx_LinkRateInit();
+	#endif
+	MiApp_ConnectionMode(ENABLE_ALL_CONN);
+	return FALSE;
+}
+#endif // ENABLE_FAST_REJOIN && WISDOM_STONE
+
 /******************************************************************************
 * Function:
 *		void TxRx_Init(BOOL justResetNetwork)
@@ -300,44 +826,96 @@ void TxRx_Init(BOOL justResetNetwork) {
 
 	MIWI_TICK 	t1, t2;	// to limit TxRx_Init time for the plug\stone
 	BYTE		i;
+	BOOL		isResumed = FALSE;
 
 	// initialize the MRF ports
 	MRFInit();
 	
-	// read from EEPROM the byte that is used as the LSByte of the EUI:		
-	myLongAddress[0] = (BYTE)(0xFF & eeprom_read_byte(EUI_0_ADDRESS)); 
+	#if defined COMMUNICATION_PLUG
+		myLongAddress[0] = PLUG_NWK_ADDR_EUI0;		// the plug address is reserved, whatever is programmed in the EEPROM
+	#elif defined WISDOM_STONE
+		// read from EEPROM the byte that is used as the LSByte of the EUI:		
+		myLongAddress[0] = (BYTE)(0xFF & eeprom_read_byte(EUI_0_ADDRESS)); 
+	#endif
 
 	MiApp_ProtocolInit(FALSE);  
 	
+	#if defined ENABLE_LINK_RATE_ADAPTATION
+		TxRx_LinkRateInit();	// MiApp_ProtocolInit tuned the transceiver to the base rate
+	#endif
+	
+	#if defined ENABLE_ZERO_COPY_RX
+		// MiApp_ProtocolInit emptied the receive pool, so no block holds a frame:
+		#if defined WISDOM_STONE
+			TxRx_InitRxBlock(&rxBlockBuffer);
+		#elif defined COMMUNICATION_PLUG
+			for (i = 0; i < TXRX_RX_BLOCKS; i++) {
+				TxRx_InitRxBlock(&rxBlockPool[i]);
+			}
+		#endif
+	#endif
+	
 	if (!justResetNetwork) {
 		#if defined ENABLE_TXRX_ACK // YL 25.12 added #ifdef
 		TxRx_Reset_ACK_Sequencers(); //YS 22.12 init required for the acks	// YL 29.7 AY called TxRx_Reset_ACK_Sequencers in both - plug and stone if(!justResetNetwork), and in addition - at the end of TxRx_Connect, in plug only, and without any condition (whereas the stone started the network); do we need that additional call? 
 		#endif // ENABLE_TXRX_ACK
 		
+		#if !defined ENABLE_COMPACT_HEADER
 		for (i = 0; i < TXRX_TRAILER_SIZE; i++) {
 			txBlock.blockTrailer[i] = TxRx_Trailer[i];	// init of constant trailer that is used for synchronization of the block
 		}
+		#endif
 		
 		#if defined COMMUNICATION_PLUG
-			for (i = 0; i < MAX_NWK_SIZE; i++) {			
-				isStopped[i] = FALSE;
-				isNetworkMember[i] = FALSE;
-				isCoordinator[i] = FALSE;
-				parentDeviceEUI0[i] = 0xFF;
-				currentNwkSize = INIT_NWK_SIZE;				
+			for (i = 0; i <= MAX_NWK_ADDR_EUI0; i++) {			
+				stoneSlot[i] = 0;
+			}
+			stoneCount = 0;
+			for (i = 0; i < CMD_QUEUE_SIZE; i++) {
+				cmdQueue[i].isUsed = FALSE;
 			}
+			for (i = 0; i < TXRX_RX_BLOCKS; i++) {
+				rxBlockPool[i].handlingParam.isHeader = TRUE;		// free
+			}
+			#if defined ENABLE_TXRX_SECURITY
+				secScheduleEUI0 = 0xFF;
+				TxRx_SecLoadKey();
+			#endif
 		#elif defined WISDOM_STONE
 			isCoordinator = FALSE;
 			parentDeviceEUI0 = 0xFF;
+			memset(&linkStats, 0, sizeof(linkStats));
+			#if defined ENABLE_TXRX_SECURITY
+				TxRx_SecInit();
+			#endif
+			#if defined ENABLE_TIME_SYNC
+				tsyncCount = 0;
+			#endif
+		#endif
+		#if defined ENABLE_CHANNEL_MAP
+			TxRx_ChannelMapInit();
 		#endif
 	}
 	
 	MiApp_ConnectionMode(ENABLE_ALL_CONN);					                                              
 	
-	if (myLongAddress[0] == NWK_STARTER_ADDR_EUI0) {
+	#if defined ENABLE_FAST_REJOIN && defined WISDOM_STONE
+		if (!justResetNetwork) {
+			isResumed = TxRx_ResumeNetwork();	// after a network fault the stored state is not trusted
+		}
+	#endif
+	
+	if (isResumed) {
+		// the stone operates in the network it had before the shutdown
+	}
+	else if (myLongAddress[0] == NWK_STARTER_ADDR_EUI0) {
 		// the stone with NWK_STARTER_ADDR_EUI0 is the only PAN coordinator.
 		// it is the only one that starts the network, and then accepts others that join it
 		
+		#if defined ENABLE_CHANNEL_MAP
+			MiApp_SetChannel(TxRx_StartChannel());						// the best known channel, or the quietest of a scan
+			MiApp_StartConnection(START_CONN_DIRECT, 0, 0);
+		#else
 		t1 = MiWi_TickGet();
 		while (1) {
 			MiApp_StartConnection(START_CONN_ENERGY_SCN, 10, 0xFFFFFFFF); 		// YL 25.5 to select the most quiet channel: START_CONN_ENERGY_SCN instead of START_CONN_DIRECT
@@ -346,6 +924,10 @@ void TxRx_Init(BOOL justResetNetwork) {
 				break;
 			}
 		}	
+		#endif
+		#if defined ENABLE_FAST_REJOIN && defined WISDOM_STONE
+			TxRx_SaveNetwork();
+		#endif
 	}
 	else {
 		// the stone is a regular (non-PAN) coordinator.
@@ -353,37 +935,49 @@ void TxRx_Init(BOOL justResetNetwork) {
 		
 		BOOL	joinedNetwork = FALSE;
 		BYTE	totalActiveScanResponses;
+		#if defined ENABLE_CHANNEL_MAP
+		DWORD	searchMap = (chanMap.channel < CHANNEL_NUM) ? ((DWORD)1 << chanMap.channel) : 0xFFFFFFFF;	// the channel of the last network first
+		#else
+		DWORD	searchMap = 0xFFFFFFFF;
+		#endif
 		
 		t1 = MiWi_TickGet();		
 		while (!joinedNetwork) { 
-			totalActiveScanResponses = MiApp_SearchConnection(10, 0xFFFFFFFF);
+			totalActiveScanResponses = MiApp_SearchConnection(10, searchMap);
 			i = 0;
 			while ((!joinedNetwork) && (i < totalActiveScanResponses)) {			
 				if (MiApp_EstablishConnection(i, CONN_MODE_DIRECT) != 0xFF) { 
 					joinedNetwork = TRUE;  										// a connection has been established - WISDOM_STONE completed TxRx_Init successfully
 					#if defined COMMUNICATION_PLUG
+						STONE_ENTRY *stone;
 						// update plug parameters:
-						isNetworkMember[0] = TRUE;
+						stone = TxRx_AddStone(PLUG_NWK_ADDR_EUI0);
+						stone->isNetworkMember = TRUE;
 						#if defined NWK_ROLE_COORDINATOR
-							isCoordinator[0] = TRUE;	
+							stone->isCoordinator = TRUE;	
 						#endif							
-						parentDeviceEUI0[0] = ConnectionTable[myParent].Address[0];			
+						stone->parentEUI0 = ConnectionTable[myParent].Address[0];			
 						// update constant network-starter parameters:
-						isNetworkMember[NWK_STARTER_ADDR_EUI0] = TRUE;	
-						isCoordinator[NWK_STARTER_ADDR_EUI0] = TRUE;
-						parentDeviceEUI0[NWK_STARTER_ADDR_EUI0] = 0xFF;	// the parent of the network-starter is always 0xFF											
+						stone = TxRx_AddStone(NWK_STARTER_ADDR_EUI0);
+						stone->isNetworkMember = TRUE;	
+						stone->isCoordinator = TRUE;
+						stone->parentEUI0 = 0xFF;	// the parent of the network-starter is always 0xFF											
 					#elif defined WISDOM_STONE
 						// update stone parameters:
 						#if defined NWK_ROLE_COORDINATOR
 							isCoordinator = TRUE;
 						#endif
 						parentDeviceEUI0 = ConnectionTable[myParent].Address[0];
+						#if defined ENABLE_FAST_REJOIN
+							TxRx_SaveNetwork();
+						#endif
 						// 11.2 TxRx_SendJoinInfo();
 					#endif
 					break;
 				}
 				i++;  															// try to establish connection with next active scan response
 			}
+			searchMap = 0xFFFFFFFF;
 				t2 = MiWi_TickGet();  									
 				if (MiWi_TickGetDiff(t2, t1) > TIMEOUT_NWK_JOINING) {	
 					break;
@@ -395,6 +989,11 @@ void TxRx_Init(BOOL justResetNetwork) {
 		}
 	}	
 
+	#if defined ENABLE_LOW_POWER_LISTEN && defined WISDOM_STONE
+		lplActiveTick = MiWi_TickGet();		// the stone stays awake for LPL_IDLE_TIMEOUT after it joined
+		isLplDozing = FALSE;
+	#endif
+
 	play_buzzer(1);	// the stone/plug finished TxRx_Init
 	
 	// YL 25.5 added AY...
@@ -420,6 +1019,7 @@ void TxRx_ReceiveJoinInfo(void) {
 	BYTE sourceNwkAddress[MY_ADDRESS_LENGTH] = {0};
 	BYTE sourceParent = 0;
 	BOOL sourceIsCoordinator = FALSE;
+	STONE_ENTRY *stone;
 	
 	if (MiApp_MessageAvailable() == FALSE ||		// nothing to do
 		rxMessage.Payload[0] != JOIN_SEND ||		// unexpected message type
@@ -429,12 +1029,14 @@ void TxRx_ReceiveJoinInfo(void) {
 	// read the received join-info:
 	sourceNwkAddress[0] = rxMessage.Payload[1];
 	sourceNwkAddress[1] = rxMessage.Payload[2];	
-	sourceParent = (rxMessage.Payload[5] == 0xFF) ? 0xFF : (rxMessage.Payload[5] & JOIN_PARENT_MASK); // the only device with parentEUI0 = 0xFF is the PAN COORDINATOR; for the rest devices parentEUI0 isn't bigger than MAX_NWK_SIZE ( << 100)
+	sourceParent = (rxMessage.Payload[5] == 0xFF) ? 0xFF : (rxMessage.Payload[5] & JOIN_PARENT_MASK); // the only device with parentEUI0 = 0xFF is the PAN COORDINATOR; for the rest devices parentEUI0 isn't bigger than MAX_NWK_ADDR_EUI0 ( < 0x7F)
 	sourceIsCoordinator = ((rxMessage.Payload[5] & JOIN_COORDINATOR_MASK) ? TRUE : FALSE);	
 	// update the network data structures:
-	parentDeviceEUI0[(sourceNwkAddress[0])] = sourceParent;
-	isCoordinator[(sourceNwkAddress[0])] = sourceIsCoordinator;
-	isNetworkMember[(sourceNwkAddress[0])] = TRUE;
+	stone = TxRx_JoinStone(sourceNwkAddress[0], sourceParent);
+	if (stone == NULL) {							// not a stone that joined the network, or no room for another stone - do not confirm the join-info
+		return;
+	}
+	stone->isCoordinator = sourceIsCoordinator;
 	// send an acknowledgement:
 	MiApp_FlushTx();		
 	MiApp_WriteData(JOIN_RECEIVE);
@@ -455,7 +1057,6 @@ void TxRx_ReceiveJoinInfo(void) {
 		}	
 	}
 	// YL 24.10 ...
-	//YL 3.11 currentNwkSize++; // TODO - check the assumption - each stone tries joining only once
 	// ... YL 24.10	
 }
 
@@ -567,10 +1168,50 @@ tick:	t4 = MiWi_TickGet();
 ******************************************************************************/
 TXRX_ERRORS TxRx_PeriodTasks() {
 
-	TXRX_ERRORS status;
+	TXRX_ERRORS status = TXRX_NO_ERROR;
 	MIWI_TICK t1, t2; 
+	#if defined ENABLE_ZERO_COPY_RX
+	RX_BLOCK_BUFFER *handledBlock;
+	#endif
+	
+	#if defined ENABLE_LINK_RATE_ADAPTATION
+		TxRx_LinkRateSchedule();
+	#endif
+	#if defined ENABLE_CHANNEL_MAP
+		TxRx_ChannelTasks();
+	#endif
+	#if defined ENABLE_TDMA_UPLOAD && defined COMMUNICATION_PLUG
+		TxRx_TdmaSchedule();
+	#endif
+	#if defined ENABLE_TIME_SYNC && defined COMMUNICATION_PLUG
+		TxRx_TimeSyncTasks();
+	#endif
+	#if defined COMMUNICATION_PLUG
+		TxRx_ReplyCollectTasks();
+		TxRx_CommandTasks();
+	#endif
+	#if defined ENABLE_CUMULATIVE_ACK
+		#if defined WISDOM_STONE
+			TxRx_WindowTasks();
+		#elif defined COMMUNICATION_PLUG
+			TxRx_AckTasks();
+		#endif
+	#endif
 	// check if there is available message
 	if (MiApp_MessageAvailable()) {	
+		if (TxRx_ConsumeBroadcast() == TRUE) {
+			#if defined WISDOM_STONE
+				g_in_msg[0] = '\0';				// nothing for the application
+			#endif
+			return TXRX_NO_ERROR;
+		}
+		if (rxMessage.flags.bits.broadcast == 1) {
+			MiApp_DiscardMessage();				// not of the TxRx layer - and not a block, blocks are unicast
+			#if defined WISDOM_STONE
+				g_in_msg[0] = '\0';
+			#endif
+			return TXRX_NO_ERROR;
+		}
 		t1 = MiWi_TickGet();
 		while (1) {
 			status = TxRx_ReceivePacket();
@@ -580,6 +1221,7 @@ TXRX_ERRORS TxRx_PeriodTasks() {
 			t2 = MiWi_TickGet(); 
 			if (MiWi_TickGetDiff(t2, t1) > TIMEOUT_RETRYING_RECEIVING_PACKET) {
 				status = TXRX_NO_PACKET_RECEIVED;
+				break;							// a partial or foreign frame must not hold the main loop
 			}	
 		}
 
@@ -587,11 +1229,17 @@ TXRX_ERRORS TxRx_PeriodTasks() {
 			return status;	
 		}
 
+		#if defined ENABLE_ZERO_COPY_RX
+			handledBlock = rxBlock;				// the handler may receive into another block (plug)
+		#endif
 		#if defined WISDOM_STONE
 			status = TxRx_WistoneHandler();
 		#elif defined COMMUNICATION_PLUG
 			status = TxRx_PlugHandler();
 		#endif //WISDOM_STONE
+		#if defined ENABLE_ZERO_COPY_RX
+			TxRx_ReleaseRxBlock(handledBlock);	// the block was handled - its frame returns to the receive pool
+		#endif
 	}
 
 	return status;
@@ -618,15 +1266,15 @@ TXRX_ERRORS TxRx_PeriodTasks() {
 ******************************************************************************/
 TXRX_ERRORS TxRx_WistoneHandler(){	
 	
-	if (rxBlock.blockHeader.blockType == TXRX_TYPE_DATA) {   	// it is impossible that the block type here is data, since this code is running in the stone		
+	if (rxBlock->blockHeader.blockType == TXRX_TYPE_DATA) {   	// it is impossible that the block type here is data, since this code is running in the stone		
 		return TXRX_RECEIVED_INVALID_PACKET;
 	}
 	
 	#if defined ENABLE_TXRX_ACK
-		if (rxBlock.blockHeader.blockType == TXRX_TYPE_ACK) { 	// we received an ack, nothing to do	
+		if (rxBlock->blockHeader.blockType == TXRX_TYPE_ACK) { 	// we received an ack, nothing to do	
 			return TXRX_NO_ERROR;
 		}
-		else {													// it is a command, so we need to send ACK			
+		else {													// it is a command or control, so we need to send ACK			
 			TXRX_ERRORS status = TxRx_SendAck();
 			if (status != TXRX_NO_ERROR) {				
 				return status;
@@ -634,8 +1282,13 @@ TXRX_ERRORS TxRx_WistoneHandler(){
 		}
 	#endif //ENABLE_TXRX_ACK
 	
-	// copy the input command to g_in_msg array to check that RX_block_buffer is not bigger than 100
-	strcpy(g_in_msg, (char*)rxBlock.blockBuffer);	
+	if (rxBlock->blockHeader.blockType == TXRX_TYPE_CONTROL) {	// the TxRx layer consumes control blocks - nothing to pass to the application
+		TxRx_HandleControl();
+		g_in_msg[0] = '\0';
+		return TXRX_NO_ERROR;
+	}
+	
+	TxRx_TakeCommand();
 	return TXRX_NO_ERROR;
 }
 #endif //WISDOM_STONE
@@ -665,12 +1318,26 @@ TXRX_ERRORS TxRx_PlugHandler() {
 	
 	#if defined ENABLE_TXRX_ACK
 		TXRX_ERRORS status;
-		if ((rxBlock.blockHeader.blockType == TXRX_TYPE_COMMAND) ||
-			(rxBlock.blockHeader.blockType == TXRX_TYPE_DATA)) {				// need to send ack for the command/data <- can the plug receive a command?
-			if (blockAckInfo[rxFromEUI0].rxLastSeq ==
-				blockAckInfo[rxFromEUI0].rxExpectedSeq) {	// we received again a block that we handled before, since the ack was unsuccessful			
+		if ((rxBlock->blockHeader.blockType == TXRX_TYPE_COMMAND) ||
+			(rxBlock->blockHeader.blockType == TXRX_TYPE_DATA) ||
+			(rxBlock->blockHeader.blockType == TXRX_TYPE_CONTROL)) {				// need to send ack for the command/data/control <- can the plug receive a command?
+			if (rxFromStone->ackInfo.rxLastSeq ==
+				rxFromStone->ackInfo.rxExpectedSeq) {	// we received again a block that we handled before, since the ack was unsuccessful			
 				isBlockNeedToBePrinted = 0;
 			}
+			#if defined ENABLE_CUMULATIVE_ACK
+			if ((rxBlock->blockHeader.blockType == TXRX_TYPE_DATA) && (isBlockNeedToBePrinted == 1)) {	// a new data block - its ack may wait (TxRx_AckTasks)
+				rxFromStone->ackInfo.rxLastSeq = rxFromStone->ackInfo.rxExpectedSeq;
+				if (rxFromStone->ackPending++ == 0) {
+					rxFromStone->ackTick = MiWi_TickGet();
+				}
+				status = TXRX_NO_ERROR;
+				if (rxFromStone->ackPending >= TXRX_ACK_EVERY) {
+					status = TxRx_SendAck();
+				}
+			}
+			else
+			#endif
 			status = TxRx_SendAck();
 			if (status != TXRX_NO_ERROR) {			
 				return status;
@@ -684,14 +1351,40 @@ TXRX_ERRORS TxRx_PlugHandler() {
 	if (isBlockNeedToBePrinted == 0) {									// if we received a block that was handled before and the ack was not received by the stone		
 		return TXRX_NO_ERROR;
 	}
-	if (rxBlock.blockHeader.blockType == TXRX_TYPE_DATA) {				// if we received data, print it using b_write
-		if (isStopped[(finalDestinationNwkAddress[0])] == FALSE) {		// do not print the last block that was received
-			b_write(rxBlock.blockBuffer, MAX_BLOCK_SIZE);
+	if (rxBlock->blockHeader.blockType == TXRX_TYPE_DATA) {				// if we received data, print it using b_write
+		if ((rxFromStone->isStopped == FALSE)							// do not print the last block that was received
+			#if defined ENABLE_TXRX_SECURITY
+			&& (TxRx_OpenBlock() == TRUE)									// nor a block that is not authentic
+			#endif
+			) {
+			#if defined ENABLE_USB_FRAMING
+				TxRx_WriteFrame(rxFromStone->eui0, rxBlock->blockBuffer + TXRX_DATA_OFFSET, MAX_BLOCK_SIZE);
+			#else
+				b_write(rxBlock->blockBuffer + TXRX_DATA_OFFSET, MAX_BLOCK_SIZE);
+			#endif
  		}	
+		#if defined ENABLE_TDMA_UPLOAD
+			rxFromStone->slotUsed = TxRx_ByteAdd(1, rxFromStone->slotUsed);
+		#endif
 	}			
-	else if (rxBlock.blockHeader.blockType == TXRX_TYPE_COMMAND) {	 	// if we received command, print it using m_write	
-		m_write((char*)rxBlock.blockBuffer);
+	else if (rxBlock->blockHeader.blockType == TXRX_TYPE_COMMAND) {	 	// if we received command, print it using m_write	
+		if ((isReplyCollecting == TRUE) && (rxFromStone->isReplyPending == TRUE)) {	// a reply to the broadcast command
+			rxFromStone->isReplyPending = FALSE;
+		}
+		m_write("CMD#");												// the reply names its command and its stone
+		m_write(byte_to_str(rxFromStone->replyTag));
+		m_write(" STONE eui0# ");
+		m_write(byte_to_str(rxFromStone->eui0));
+		m_write(": ");
+		#if defined ENABLE_BINARY_COMMANDS
+			write_reply((char*)rxBlock->blockBuffer);		// with the text of the binary status in it
+		#else
+			m_write((char*)rxBlock->blockBuffer);
+		#endif
 	}	
+	else if (rxBlock->blockHeader.blockType == TXRX_TYPE_CONTROL) {		// control blocks are consumed by the TxRx layer
+		TxRx_HandleControl();
+	}
 
 	return TXRX_NO_ERROR;
 }
@@ -705,8 +1398,10 @@ TXRX_ERRORS TxRx_PlugHandler() {
 *      This function performs the transmission to the other device. It transmits
 *	   the header, the buffer itself and the trailer. All this data should be
 *	   filled in the txBlock , and it is done in TxRx_SendPacket function.
-*	   YL - TxRx_TransmitBuffer calls MiApp_WriteData that copies the contents 
-*	   of txBlock (blockHeader, blockBuffer, blockTrailer) into TxBuffer and unicasts it
+*	   YL - TxRx_TransmitBuffer calls MiApp_WriteData that copies the header 
+*	   and the trailer of txBlock into TxBuffer and unicasts it. A message that
+*	   ends with data takes it as a slice of blockData, which the MAC sends
+*	   after TxBuffer - the data is not copied.
 *
 * Parameters:
 *	   None
@@ -718,11 +1413,10 @@ TXRX_ERRORS TxRx_PlugHandler() {
 ******************************************************************************/
 TXRX_ERRORS TxRx_TransmitBuffer() {
 		
-	MIWI_TICK t1;	
 	WORD trailerPos = 0;
 	txBlock.blockPos = 0;
 	BYTE i = 0;								// to write "MY_ADDRESS_LENGTH" bytes of sourceNwkAddress 
-	MIWI_TICK t2;							// to enable timeout on unicast trials
+	BYTE sliceLen;							// the data of the message that is sent from blockData
 	TXRX_ERRORS status = TXRX_NO_ERROR;		// to inform on timeout
 	
 	// YL 31.10 ...
@@ -733,7 +1427,21 @@ TXRX_ERRORS TxRx_TransmitBuffer() {
 	BYTE blockInf = (txBlock.blockHeader.blockType) & TXRX_TYPE_MASK;
 	blockInf |= ((txBlock.blockHeader.ackSeq << 2) & TXRX_ACK_MASK); 			// YL blockInf = aaaa, aatt (6 ack bits + 2 type bits)
 	MiApp_WriteData(blockInf);
-			
+	
+	if (txBlock.blockHeader.blockLen > TXRX_MAX_BLOCK_LEN) {	
+		txBlock.blockHeader.blockLen = TXRX_MAX_BLOCK_LEN;
+	}
+	
+	#if defined ENABLE_COMPACT_HEADER
+	MiApp_WriteData(txBlock.blockHeader.sourceNwkAddress[0]);					// EUI_1 is constant, and MiWi addresses the destination
+	WORD message_counter = MSG_INF_LENGTH + MSG_SRC_LENGTH;
+	if (txBlock.blockHeader.blockType != TXRX_TYPE_ACK) {
+		message_counter += TxRx_WriteVarLen(txBlock.blockHeader.blockLen);
+	}
+	WORD crc = TxRx_BlockCrc(txBlock.blockData, txBlock.blockHeader.blockLen);	// the trailer
+	txBlock.blockTrailer[0] = (BYTE)(crc >> 8);
+	txBlock.blockTrailer[1] = (BYTE)crc;
+	#else
 	for (i = 0; i < MY_ADDRESS_LENGTH; i++) {
 		MiApp_WriteData(txBlock.blockHeader.sourceNwkAddress[i]);				// for: MY_ADDRESS_LENGTH = 2:
 																				//		sourceNwkAddress[0] is EUI_0 from the EEPROM
@@ -747,10 +1455,6 @@ TXRX_ERRORS TxRx_TransmitBuffer() {
 																				//		destinationNwkAddress[1] is a parameter EUI_1 																				
 	}
 	
-	if (txBlock.blockHeader.blockLen > MAX_BLOCK_SIZE) {	
-		txBlock.blockHeader.blockLen = MAX_BLOCK_SIZE;
-	}
-	
 	BYTE blockLen = 0;
 	for (i = MSG_LEN_LENGTH; i > 0; i--) {
 		blockLen = (BYTE)(txBlock.blockHeader.blockLen >> (8 * (i - 1))) ;		// the upper byte is first
@@ -758,9 +1462,17 @@ TXRX_ERRORS TxRx_TransmitBuffer() {
 	}
 		
 	WORD message_counter = MSG_INF_LENGTH + 2 * MY_ADDRESS_LENGTH + MSG_LEN_LENGTH;
+	#endif // ENABLE_COMPACT_HEADER
+	#if defined ENABLE_CUMULATIVE_ACK
+		if (txBlock.blockHeader.blockType != TXRX_TYPE_ACK) {
+			MiApp_WriteData(txBlock.blockHeader.piggyAck);
+			message_counter += MSG_ACK_LENGTH;
+		}
+	#endif
 	// YL 25.12 ... added phase
 	if (txBlock.blockHeader.blockType == TXRX_TYPE_COMMAND) {
 		isTxRxTypeCommand = TRUE;
+		txPhaseIndex = (BYTE)message_counter;
 		// YL 12.1 ...
 		g_phase_counter_stop.Val = g_phase_counter.Val - g_phase_counter_start.Val;
 		if (g_phase_counter_stop.Val < 0) {
@@ -794,59 +1506,39 @@ TXRX_ERRORS TxRx_TransmitBuffer() {
 	}
 	// ... YL 25.12
 	
-	while (txBlock.blockPos < (txBlock.blockHeader.blockLen + TXRX_TRAILER_SIZE)) {	// YL blockPos counts the bytes of the data (blockBuffer) and of blockTrailer
+	while (txBlock.blockPos < (txBlock.blockHeader.blockLen + TXRX_TRAILER_SIZE)) {	// YL blockPos counts the bytes of the data (blockData) and of blockTrailer
 		if (message_counter == 0) {
 			MiApp_FlushTx();														// YL resets the pointer (TxData) to PAYLOAD_START - the 12th byte of TxBuffer
 		}
-		if (txBlock.blockPos < txBlock.blockHeader.blockLen) {						// meaning we are writing the buffer itself.
-			MiApp_WriteData(txBlock.blockBuffer[txBlock.blockPos++]);
+		sliceLen = 0;
+		if (txBlock.blockPos + (TX_BUFFER_SIZE - MIWI_HEADER_LEN - message_counter) <= txBlock.blockHeader.blockLen) {
+			sliceLen = (BYTE)(TX_BUFFER_SIZE - MIWI_HEADER_LEN - message_counter);	// the rest of the message is data: it is sent from blockData
+			txBlock.blockPos += sliceLen;
+			message_counter += sliceLen;
 		}
-		else {																		// meaning we are writing the trailer.
-			MiApp_WriteData(txBlock.blockTrailer[trailerPos++]);
-			txBlock.blockPos++;
+		else {
+			if (txBlock.blockPos < txBlock.blockHeader.blockLen) {					// meaning we are writing the data itself.
+				MiApp_WriteData(txBlock.blockData[txBlock.blockPos++]);
+			}
+			else {																	// meaning we are writing the trailer.
+				MiApp_WriteData(txBlock.blockTrailer[trailerPos++]);
+				txBlock.blockPos++;
+			}
+			message_counter++;
 		}
-		message_counter++;
 		// YL 14.12 ... the transceiver discards the message if it's length exceeds TX_BUFFER_SIZE
 		// was: if (message_counter == TX_BUFFER_SIZE) {							 	
 		if (message_counter == TX_BUFFER_SIZE - MIWI_HEADER_LEN) {
 		// ... YL 14.12
 			message_counter = 0;														
-			t1 = MiWi_TickGet();
-			while (MiApp_UnicastAddress(finalDestinationNwkAddress, TRUE, FALSE) == FALSE) {
-				#if defined ENABLE_RETRANSMISSION
-					blockTryTxCounter = TxRx_ByteAdd(RETRANSMISSION_TIMES, blockTryTxCounter);
-				#endif
-				t2 = MiWi_TickGet();
-				if (MiWi_TickGetDiff(t2, t1) > TIMEOUT_RESENDING_PACKET) {	
-					status = TXRX_UNABLE_SEND_PACKET;					
-					break;
-				}		
-			}
-
-			#if defined ENABLE_RETRANSMISSION
-				blockTryTxCounter = TxRx_ByteAdd(messageRetryCounter, blockTryTxCounter);	// add the number of transmission needed in the lower level.
-			#endif
+			status = TxRx_UnicastMessage(&txBlock.blockData[txBlock.blockPos - sliceLen], sliceLen);
 		}  
 		if (status == TXRX_UNABLE_SEND_PACKET) {	
 			break;
 		}
 	}
 	if (message_counter > 0) {		
-		t1 = MiWi_TickGet();		
-		while (MiApp_UnicastAddress(finalDestinationNwkAddress, TRUE, FALSE) == FALSE) {	
-			#if defined ENABLE_RETRANSMISSION
-				blockTryTxCounter = TxRx_ByteAdd(RETRANSMISSION_TIMES, blockTryTxCounter);	
-			#endif
-		
-			t2 = MiWi_TickGet();
-			if (MiWi_TickGetDiff(t2, t1) > TIMEOUT_RESENDING_PACKET) {	
-				status = TXRX_UNABLE_SEND_PACKET;			
-				break;
-			}		
-		}
-		#if defined ENABLE_RETRANSMISSION
-			blockTryTxCounter = TxRx_ByteAdd(messageRetryCounter, blockTryTxCounter);			// add the number of transmission needed in the lower level.
-		#endif
+		status = TxRx_UnicastMessage(NULL, 0);
 	}   
 
 	return status;	// to return TXRX_UNABLE_SEND_PACKET if needed	
@@ -854,13 +1546,63 @@ TXRX_ERRORS TxRx_TransmitBuffer() {
 
 /******************************************************************************
 * Function:
-*		TXRX_ERRORS TxRx_SendPacket(BYTE *data, WORD dataLen, BLOCK_TYPE bType)
-*
+*		TXRX_ERRORS TxRx_UnicastMessage(BYTE *slice, BYTE sliceLen)
 * Description:
-*      This function sends a packet to the other device. This packet can be 
-*	   either command or data or ack. The function fills the txBlock with the 
-*	   data. Then it uses the TxRx_TransmitBuffer() function to send this
-*	   data. Finally, if the packet is command or data, it waits for ack for 
+*		Unicasts the message in TxBuffer, followed by sliceLen bytes of the 
+*		block at slice, to finalDestinationNwkAddress - until it is sent or 
+*		TIMEOUT_RESENDING_PACKET passes. The MAC takes the slice with the next 
+*		frame it sends, so it is given again on each trial.
+* Return value: 
+*	   TXRX_NO_ERROR
+*	   TXRX_UNABLE_SEND_PACKET
+*******************************************************************************/
+TXRX_ERRORS TxRx_UnicastMessage(BYTE *slice, BYTE sliceLen) {
+
+	MIWI_TICK t1;
+	MIWI_TICK t2;							// to enable timeout on unicast trials
+	TXRX_ERRORS status = TXRX_NO_ERROR;
+	WORD macRetries = MACLinkStats.txRetries;
+	
+	t1 = MiWi_TickGet();
+	while (1) {
+		txSlice = slice;
+		txSliceLen = sliceLen;
+		if (MiApp_UnicastAddress(finalDestinationNwkAddress, TRUE, FALSE) == TRUE) {
+			break;
+		}
+		#if defined ENABLE_RETRANSMISSION
+			blockTryTxCounter = TxRx_ByteAdd(RETRANSMISSION_TIMES, blockTryTxCounter);
+		#endif
+		t2 = MiWi_TickGet();
+		if (MiWi_TickGetDiff(t2, t1) > TIMEOUT_RESENDING_PACKET) {	
+			status = TXRX_UNABLE_SEND_PACKET;					
+			break;
+		}		
+	}
+	txSliceLen = 0;															// in case MiWi did not send the message (e.g. kept it for a sleeping device)
+	TX_STATS.macRetries += MACLinkStats.txRetries - macRetries;
+	#if defined ENABLE_LOW_POWER_LISTEN && defined WISDOM_STONE
+		if (status == TXRX_NO_ERROR) {
+			lplActiveTick = MiWi_TickGet();
+			isLplDozing = FALSE;
+		}
+	#endif
+	#if defined ENABLE_RETRANSMISSION
+		blockTryTxCounter = TxRx_ByteAdd(messageRetryCounter, blockTryTxCounter);	// add the number of transmission needed in the lower level.
+	#endif
+	
+	return status;
+}
+
+/******************************************************************************
+* Function:
+*		TXRX_ERRORS TxRx_SendPacket(BYTE *data, WORD dataLen, BLOCK_TYPE bType)
+*
+* Description:
+*      This function sends a packet to the other device. This packet can be 
+*	   either command or data or ack. The function fills the txBlock with the 
+*	   data. Then it uses the TxRx_TransmitBuffer() function to send this
+*	   data. Finally, if the packet is command or data, it waits for ack for 
 *	   the packet.
 *
 * Parameters:
@@ -878,9 +1620,79 @@ TXRX_ERRORS TxRx_TransmitBuffer() {
 
 TXRX_ERRORS TxRx_SendPacket(BYTE *data, WORD dataLen, BLOCK_TYPE bType){
 	
+	MIWI_TICK rttTick = MiWi_TickGet();											// the round trip of the block and its ack
+	TXRX_ERRORS status = TxRx_TransmitPacket(data, dataLen, bType);
+	
+	#if defined ENABLE_TXRX_ACK
+		if ((status != TXRX_NO_ERROR) || (bType == TXRX_TYPE_ACK)) {			
+			return status;
+	 	}
+		status = TxRx_ReceivePacket();											// waiting for ack of the packet to arrive (the ack is for command or for data)
+		if (status != TXRX_NO_ERROR) {	
+			return status;
+		}	
+		if (rxBlock->blockHeader.blockType == TXRX_TYPE_ACK) { 					// it is ack
+			TX_STATS.txBlocks++;
+			TxRx_RttSample(&TX_STATS, rttTick);
+			return TXRX_NO_ERROR;			
+		}
+		#if defined WISDOM_STONE
+			else if (rxBlock->blockHeader.blockType == TXRX_TYPE_COMMAND) { 		// if we received app stop in the middle of transmission
+				TxRx_TakeCommand();
+				TXRX_ERRORS status = TxRx_SendAck();							// send ack to the command
+				if (status != TXRX_NO_ERROR) {			
+					return status;
+				}
+				g_is_cmd_received = 1;											// indicates that a command was received during this period - inform the upper level by setting this variable				
+				status = TxRx_ReceivePacket();									// waiting for ack of the original packet to arrive (the ack is for command or for data)
+				if (status != TXRX_NO_ERROR) {				
+					return status;
+				}
+				if (rxBlock->blockHeader.blockType == TXRX_TYPE_ACK) { 			// it is ack
+					TX_STATS.txBlocks++;
+					return TXRX_NO_ERROR;			
+				}	
+			}
+		#endif //WISDOM_STONE
+		return TXRX_RECEIVED_UNKNOWN_PACKET;
+	#else
+		return status;		
+	#endif //ENABLE_TXRX_ACK	
+}
+
+/******************************************************************************
+* Function:
+*		TXRX_ERRORS TxRx_TransmitPacket(BYTE *data, WORD dataLen, BLOCK_TYPE bType)
+*
+* Description:
+*      Fills txBlock with the packet and transmits it (TxRx_TransmitBuffer), 
+*	   without waiting for its ack: TxRx_SendPacket waits for the ack, the 
+*	   command tasks of the plug let TxRx_PeriodTasks receive it (see
+*	   TxRx_CommandAttempt).
+*
+* Return value: 
+*	   Any parameter at the TXRX_ERRORS enum.
+*
+******************************************************************************/
+TXRX_ERRORS TxRx_TransmitPacket(BYTE *data, WORD dataLen, BLOCK_TYPE bType) {
+	
 	TXRX_ERRORS status;
 	txBlock.blockHeader.blockType = bType;										// getting the block type we want to send
 	BYTE i = 0;	// to write "MY_ADDRESS_LENGTH" bytes into sourceNwkAddress  
+	
+	#if defined COMMUNICATION_PLUG
+		txToStone = TxRx_AddStone(finalDestinationNwkAddress[0]);
+		if (txToStone == NULL) {
+			return TXRX_NWK_UNKNOWN_ADDR;
+		}
+	#endif
+	#if defined ENABLE_LINK_RATE_ADAPTATION
+		#if defined COMMUNICATION_PLUG
+			TxRx_TuneLinkRate(TxRx_LinkRateOf(TxRx_NextHop(txToStone)));		// the rate of the link the frame leaves on (PeriodTasks tunes back)
+		#elif defined WISDOM_STONE
+			TxRx_LinkRateSchedule();
+		#endif
+	#endif
 		
 	#if defined ENABLE_TXRX_ACK
 		if (bType == TXRX_TYPE_ACK) {											// if it is ack
@@ -888,8 +1700,7 @@ TXRX_ERRORS TxRx_SendPacket(BYTE *data, WORD dataLen, BLOCK_TYPE bType){
 			#if defined WISDOM_STONE
 				txBlock.blockHeader.ackSeq = blockAckInfo.rxExpectedSeq; 		 			
 			#elif defined COMMUNICATION_PLUG
-				txToEUI0 = finalDestinationNwkAddress[0];
-				txBlock.blockHeader.ackSeq = blockAckInfo[txToEUI0].rxExpectedSeq;
+				txBlock.blockHeader.ackSeq = txToStone->ackInfo.rxExpectedSeq;
 			#endif // WISDOM_STONE
 		
 			for (i = 0; i < MY_ADDRESS_LENGTH; i++) {
@@ -903,67 +1714,128 @@ TXRX_ERRORS TxRx_SendPacket(BYTE *data, WORD dataLen, BLOCK_TYPE bType){
 			return status;
 		}
 		// else - it is command or data
+		#if defined ENABLE_CUMULATIVE_ACK
+			txBlock.blockHeader.piggyAck = 0;
+			#if defined WISDOM_STONE
+				status = TxRx_WindowWait(0);									// the sequence of the block follows the data blocks in the window
+				if (status != TXRX_NO_ERROR) {
+					return status;
+				}
+			#elif defined COMMUNICATION_PLUG
+				if (txToStone->ackPending > 0) {								// ack the data blocks of the stone in the header of this block
+					txBlock.blockHeader.piggyAck = TXRX_PIGGYBACK_ACK | txToStone->ackInfo.rxLastSeq;
+				}
+			#endif
+		#endif
 		#if defined WISDOM_STONE
 			blockAckInfo.txExpectedSeq = (blockAckInfo.txLastSeq + 1) % MAX_ACK_LENGTH;
 			txBlock.blockHeader.ackSeq =  blockAckInfo.txExpectedSeq;			
 		#elif defined COMMUNICATION_PLUG
-			txToEUI0 = finalDestinationNwkAddress[0];
-			blockAckInfo[txToEUI0].txExpectedSeq = (blockAckInfo[txToEUI0].txLastSeq + 1) % MAX_ACK_LENGTH;
-			txBlock.blockHeader.ackSeq =  blockAckInfo[txToEUI0].txExpectedSeq; 								// YL ackSeq gets new (incremented) num
+			txToStone->ackInfo.txExpectedSeq = (txToStone->ackInfo.txLastSeq + 1) % MAX_ACK_LENGTH;
+			txBlock.blockHeader.ackSeq =  txToStone->ackInfo.txExpectedSeq; 											// YL ackSeq gets new (incremented) num
 		#endif // WISDOM_STONE
 	#endif // ENABLE_TXRX_ACK
 	
+	TxRx_FillTxBlock(data, dataLen);
+	
+	// initiate transmission (to USB/Wireless)
+	status = TxRx_TransmitBuffer();												// YL TxRx_TransmitBuffer sends the cmd/data
+	#if defined ENABLE_CUMULATIVE_ACK && defined COMMUNICATION_PLUG
+		if ((status == TXRX_NO_ERROR) && (txBlock.blockHeader.piggyAck != 0)) {
+			txToStone->ackPending = 0;
+		}
+	#endif
+	return status;
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_FillTxBlock(BYTE *data, WORD dataLen)
+* Description:
+*		Fills txBlock with the addresses, the length and the data of the block
+*		(the type and the sequence are set by the caller).
+*******************************************************************************/
+void TxRx_FillTxBlock(BYTE *data, WORD dataLen) {
+
+	BYTE i;
+	
 	for (i = 0; i < MY_ADDRESS_LENGTH; i++) {
 		txBlock.blockHeader.sourceNwkAddress[i] = myLongAddress[i];				// read "MY_ADDRESS_LENGTH" bytes into sourceNwkAddress
 	}	
 	for (i = 0; i < MY_ADDRESS_LENGTH; i++) {
 		txBlock.blockHeader.destinationNwkAddress[i] = finalDestinationNwkAddress[i];	// read "MY_ADDRESS_LENGTH" bytes into destinationNwkAddress	
 	}	
-	txBlock.blockHeader.blockLen = dataLen;										// YL TxRx_SendPacket fills txBlock with the len of the cmd/data, and the data itself (MAX_BLOCK_SIZE = 512 bytes max in txBlock.blockBuffer)
-	if (txBlock.blockHeader.blockLen > MAX_BLOCK_SIZE) { 						
-		txBlock.blockHeader.blockLen = MAX_BLOCK_SIZE;
-	}
-	WORD j;
-	for (j = 0; j < txBlock.blockHeader.blockLen; j++) {
-		txBlock.blockBuffer[j] = data[j]; 										
+	txBlock.blockHeader.blockLen = dataLen;										// YL TxRx_SendPacket fills txBlock with the len of the cmd/data (MAX_BLOCK_SIZE = 512 bytes max)
+	if (txBlock.blockHeader.blockLen > TXRX_MAX_BLOCK_LEN) { 						
+		txBlock.blockHeader.blockLen = TXRX_MAX_BLOCK_LEN;
 	}
+	txBlock.blockData = data;													// the data is sent from the block of the caller
+}
+
+#if defined ENABLE_COMPACT_HEADER
+/******************************************************************************
+* Function:
+*		BYTE TxRx_WriteVarLen(WORD len)
+* Description:
+*		Writes the length of the block to the message in the compact header: 
+*		7 bits per byte, LSB first; the MSB indicates that another byte follows.
+* Return value:
+*		The number of bytes written.
+*******************************************************************************/
+BYTE TxRx_WriteVarLen(WORD len) {
+
+	BYTE n = 1;
 	
-	// initiate transmission (to USB/Wireless)
-	status = TxRx_TransmitBuffer();												// YL TxRx_TransmitBuffer sends the cmd/data
+	while (len >= 0x80) {
+		MiApp_WriteData((BYTE)(len | 0x80));
+		len >>= 7;
+		n++;
+	}
+	MiApp_WriteData((BYTE)len);
+	return n;
+}
+
+/******************************************************************************
+* Function:
+*		BYTE TxRx_ReadVarLen(BYTE *src, BYTE srcLen, WORD *len)
+* Description:
+*		Reads the length of the block from the compact header (up to 
+*		MSG_LEN_LENGTH bytes, and no more than the srcLen bytes left in the
+*		message).
+* Return value:
+*		The number of bytes read, or 0 if the length does not end within them.
+*******************************************************************************/
+BYTE TxRx_ReadVarLen(BYTE *src, BYTE srcLen, WORD *len) {
+
+	BYTE n = 0;
 	
-	#if defined ENABLE_TXRX_ACK
-		if (status != TXRX_NO_ERROR) {			
-			return status;
-	 	}
-		status = TxRx_ReceivePacket();											// waiting for ack of the packet to arrive (the ack is for command or for data)
-		if (status != TXRX_NO_ERROR) {	
-			return status;
-		}	
-		if (rxBlock.blockHeader.blockType == TXRX_TYPE_ACK) { 					// it is ack
-			return TXRX_NO_ERROR;			
+	*len = 0;
+	while ((n < srcLen) && (n < MSG_LEN_LENGTH)) {
+		*len |= (WORD)(src[n] & 0x7F) << (7 * n);
+		if ((src[n++] & 0x80) == 0) {
+			return n;
 		}
-		#if defined WISDOM_STONE
-			else if (rxBlock.blockHeader.blockType == TXRX_TYPE_COMMAND) { 		// if we received app stop in the middle of transmission
-				strcpy(g_in_msg, (char*)rxBlock.blockBuffer);					// to check that RX_block_buffer is not bigger than 100 // YL 14.4 added casting to avoid signedness warning
-				TXRX_ERRORS status = TxRx_SendAck();							// send ack to the command
-				if (status != TXRX_NO_ERROR) {			
-					return status;
-				}
-				g_is_cmd_received = 1;											// indicates that a command was received during this period - inform the upper level by setting this variable				
-				status = TxRx_ReceivePacket();									// waiting for ack of the original packet to arrive (the ack is for command or for data)
-				if (status != TXRX_NO_ERROR) {				
-					return status;
-				}
-				if (rxBlock.blockHeader.blockType == TXRX_TYPE_ACK) { 			// it is ack
-					return TXRX_NO_ERROR;			
-				}	
-			}
-		#endif //WISDOM_STONE
-		return TXRX_RECEIVED_UNKNOWN_PACKET;
-	#else
-		return status;		
-	#endif //ENABLE_TXRX_ACK	
+	}
+	return 0;
+}
+
+/******************************************************************************
+* Function:
+*		WORD TxRx_BlockCrc(BYTE *block, WORD blockLen)
+* Description:
+*		The CRC16 of the block - the trailer of the compact header.
+*******************************************************************************/
+WORD TxRx_BlockCrc(BYTE *block, WORD blockLen) {
+
+	WORD crc = 0;
+	WORD i;
+	
+	for (i = 0; i < blockLen; i++) {
+		crc = CRC16_BYTE(crc, block[i]);
+	}
+	return crc;
 }
+#endif // ENABLE_COMPACT_HEADER
 
 /******************************************************************************
 * Function:
@@ -992,11 +1864,18 @@ TXRX_ERRORS TxRx_SendPacketWithConfirmation(BYTE *data, WORD dataLen, BLOCK_TYPE
 	t1 = MiWi_TickGet();	
 	while (1) {
 		status = TxRx_SendPacket(data, dataLen, bType);
-		if (status == TXRX_NO_ERROR) {
+		if (status == TXRX_NO_ERROR || status == TXRX_NWK_UNKNOWN_ADDR) {	// no point in resending to an address that can not be added to the network
 			break;
 		}
 		t2 = MiWi_TickGet();
 		if (MiWi_TickGetDiff(t2, t1) > TIMEOUT_RESENDING_PACKET) {	// waits a few seconds to get the whole command
+			#if defined ENABLE_LINK_RATE_ADAPTATION
+				if (TxRx_LinkRateFallback() == TRUE) {				// the other side may have already returned to the base rate - try again there
+					t1 = MiWi_TickGet();
+					continue;
+				}
+			#endif
+			TX_STATS.txFailures++;
 			status = TXRX_UNABLE_SEND_PACKET;		
 			break;
 		}
@@ -1024,15 +1903,83 @@ TXRX_ERRORS TxRx_SendPacketWithConfirmation(BYTE *data, WORD dataLen, BLOCK_TYPE
 ******************************************************************************/
 TXRX_ERRORS TxRx_SendData(BYTE* samples_block, WORD TX_message_length) {
 	
-	TXRX_ERRORS status = TxRx_SendPacketWithConfirmation(samples_block, TX_message_length, TXRX_TYPE_DATA);
+	TXRX_ERRORS status;
+	
+	#if defined WISDOM_STONE
+		TxRx_FlushOutput();								// the text that was written before the block goes first
+	#endif
+	#if defined ENABLE_CUMULATIVE_ACK && defined WISDOM_STONE
+		status = TxRx_WindowSend(samples_block, TX_message_length);
+	#else
+		#if defined ENABLE_TXRX_SECURITY && defined WISDOM_STONE
+			TX_message_length = TxRx_SealBlock(secBlock, samples_block, TX_message_length);
+			samples_block = secBlock;
+			if (TX_message_length == 0) {
+				status = TXRX_UNABLE_SEND_PACKET;
+			}
+			else
+		#endif
+		status = TxRx_SendPacketWithConfirmation(samples_block, TX_message_length, TXRX_TYPE_DATA);
+	#endif
 
 	if (status != TXRX_NO_ERROR) {
 		TxRx_PrintError(status);
 	}
+	#if defined ENABLE_LINK_RATE_ADAPTATION && defined WISDOM_STONE
+	else if (++linkWindowBlocks >= RATE_WINDOW_BLOCKS) {
+		TxRx_LinkRateAdapt();
+	}
+	#endif
 
 	return 0;	// YL NOTE: as if there is no error so after the timeout the stone would stop searching for non-existing nwk address and continue normally
 }
 
+#if defined WISDOM_STONE
+/******************************************************************************
+* Function:
+*		TXRX_ERRORS TxRx_TrySendData(BYTE *block, WORD blockLen)
+* Description:
+*		Best effort TxRx_SendData, for a live stream that must not hold back
+*		its sampler (TEE): the block is sent once, and is dropped (counted in
+*		the txFailures of "txrx stats") when it can not be sent without 
+*		waiting - the window is full, or its ack did not come. Text that 
+*		waits in the reply buffer is left for the main loop.
+* Return value:
+*		TXRX_UNABLE_SEND_PACKET if the block was dropped.
+*******************************************************************************/
+TXRX_ERRORS TxRx_TrySendData(BYTE *block, WORD blockLen) {
+
+	TXRX_ERRORS status;
+	
+	#if defined ENABLE_CUMULATIVE_ACK
+		TxRx_WindowReceive();									// take the acks that already arrived
+		if (txWindowCount >= TXRX_ACK_WINDOW) {
+			linkStats.txFailures++;
+			return TXRX_UNABLE_SEND_PACKET;
+		}
+		status = TxRx_WindowSend(block, blockLen);				// there is room - it does not wait
+	#else
+		#if defined ENABLE_TXRX_SECURITY
+			blockLen = TxRx_SealBlock(secBlock, block, blockLen);
+			block = secBlock;
+			if (blockLen == 0) {
+				return TXRX_UNABLE_SEND_PACKET;
+			}
+		#endif
+		status = TxRx_SendPacket(block, blockLen, TXRX_TYPE_DATA);
+		if (status != TXRX_NO_ERROR) {
+			linkStats.txFailures++;
+		}
+	#endif
+	#if defined ENABLE_LINK_RATE_ADAPTATION
+		if ((status == TXRX_NO_ERROR) && (++linkWindowBlocks >= RATE_WINDOW_BLOCKS)) {
+			TxRx_LinkRateAdapt();
+		}
+	#endif
+	return status;
+}
+#endif // WISDOM_STONE
+
 /******************************************************************************
 * Function:
 *		TXRX_ERRORS m_TxRx_write(BYTE *str)
@@ -1040,7 +1987,10 @@ TXRX_ERRORS TxRx_SendData(BYTE* samples_block, WORD TX_message_length) {
 * Description:
 *      The next function is responsible for transmitting "regular" responses.
 *      In other words, this function is the equivalent to m_write for USB.
-*	   This function is used in the stone.
+*	   This function is used in the stone. The responses are collected in 
+*	   replyBuffer, and sent as one packet (see TxRx_FlushOutput). A string
+*	   that does not fit the rest of the buffer, but fits an empty one, is 
+*	   sent in the next packet - so a binary status is never split.
 *
 * Parameters:
 *	   str - The string you want to send.
@@ -1053,108 +2003,259 @@ TXRX_ERRORS TxRx_SendData(BYTE* samples_block, WORD TX_message_length) {
 TXRX_ERRORS m_TxRx_write(BYTE *str) {
 	
 	WORD commandLen = strlen((char*)str);
-	TXRX_ERRORS status = TxRx_SendPacketWithConfirmation(str, commandLen, TXRX_TYPE_COMMAND);
+	TXRX_ERRORS status;
+	
+	#if defined WISDOM_STONE
+	WORD partLen;
+	
+	if ((replySlots != 0) && (isReplyCut == TRUE)) {
+		return TXRX_NO_ERROR;							// the rest of a cut reply is dropped
+	}
+	while (commandLen > TXRX_REPLY_BUFFER_SIZE - 1 - replyLen) {
+		partLen = TXRX_REPLY_BUFFER_SIZE - 1 - replyLen;
+		if (replySlots != 0) {							// a reply to a broadcast command must fit its slot - cut it, and mark the cut
+			if (replyLen > TXRX_REPLY_BUFFER_SIZE - sizeof(TXRX_REPLY_CUT_MARK)) {
+				replyLen = TXRX_REPLY_BUFFER_SIZE - sizeof(TXRX_REPLY_CUT_MARK);
+			}
+			commandLen = TXRX_REPLY_BUFFER_SIZE - sizeof(TXRX_REPLY_CUT_MARK) - replyLen;
+			memcpy(replyBuffer + replyLen, str, commandLen);
+			#if defined ENABLE_BINARY_COMMANDS
+				if ((replyLen + commandLen > 0) && ((BYTE)replyBuffer[replyLen + commandLen - 1] == BIN_RSP_MARK)) {
+					commandLen--;						// the cut mark must not be taken for the value of a binary status
+				}
+			#endif
+			strcpy(replyBuffer + replyLen + commandLen, TXRX_REPLY_CUT_MARK);
+			replyLen = TXRX_REPLY_BUFFER_SIZE - 1;
+			isReplyCut = TRUE;
+			return TXRX_NO_ERROR;
+		}
+		if ((replyLen != 0) && (commandLen <= TXRX_REPLY_BUFFER_SIZE - 1)) {
+			status = TxRx_SendReply();					// send the collected reply, the string goes whole in the next one
+			if (status != TXRX_NO_ERROR) {
+				return status;
+			}
+			continue;
+		}
+		memcpy(replyBuffer + replyLen, str, partLen);	// longer than the buffer - fill it, send it, and go on with the rest
+		replyLen += partLen;
+		str += partLen;
+		commandLen -= partLen;
+		status = TxRx_SendReply();
+		if (status != TXRX_NO_ERROR) {
+			return status;
+		}
+	}
+	memcpy(replyBuffer + replyLen, str, commandLen);
+	replyLen += commandLen;
+	replyBuffer[replyLen] = '\0';
+	return TXRX_NO_ERROR;
+	#else
+	status = TxRx_SendPacketWithConfirmation(str, commandLen, TXRX_TYPE_COMMAND);
 	
 	if (status != TXRX_NO_ERROR) {
 		TxRx_PrintError(status);
 	}	
 	return status;
+	#endif
 }
 
-#if defined COMMUNICATION_PLUG
+#if defined WISDOM_STONE
 /******************************************************************************
 * Function:
-*		TXRX_ERRORS TxRx_SendCommand(BYTE *command)
-*
+*		void TxRx_FlushOutput(void)
 * Description:
-*      This function sending a command packet to the other device. It uses the
-*	   TxRx_SendPacketWithConfimation() function to accomplish this aim.
-*	   This functions is used in the plug.
-*	   
-* Example:
-*		if(ProccessIO)
-*		{
-*			strcpy(msg,cmd_Current);	
-*			TXRX_ERRORS status = TxRx_SendCommand(msg);
-*			if(status != TXRX_NO_ERROR)
-*			{
-*				// Error handling
-*			}
-*		}
-*		<code>
-*
-*
-* Parameters:
-*	   command - The command you want to send.
-*
-* Return value: 
-*	   Any parameter at the TXRX_ERRORS enum.
-*	   
-*
-******************************************************************************/
-TXRX_ERRORS TxRx_SendCommand(BYTE* command) {
-		
-	TXRX_ERRORS status;
-	WORD commandLen = strlen((char*)command);
+*		Sends the collected reply at once, unless it waits for the reply slot
+*		of a broadcast command.
+*******************************************************************************/
+void TxRx_FlushOutput(void) {
+
+	if (replySlots == 0) {
+		TxRx_SendReply();
+	}
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_TakeCommand(void)
+* Description:
+*		Passes the command in rxBlock to the application (g_in_msg). A broadcast
+*		command carries the reply slot of the stone after its '\0': 
+*		[reply slot, reply slots]; m_TxRx_write then holds the reply until
+*		its slot (TxRx_ReplyTasks). A binary command (see parser.h) is copied 
+*		by its length, and its reply info follows it.
+*******************************************************************************/
+void TxRx_TakeCommand(void) {
+
+	WORD len;
+	
+	replySlots = 0;
+	isReplyHeld = FALSE;								// a reply that still waits for its slot goes with the reply to this command
+	#if defined ENABLE_BINARY_COMMANDS
+	if (rxBlock->blockBuffer[0] == BIN_CMD_MARK) {
+		int binLen = bin_command_len((char*)rxBlock->blockBuffer, rxBlock->blockHeader.blockLen);
+		if (binLen < 0) {
+			g_in_msg[0] = '\0';							// a cut command - nothing for the application
+			return;
+		}
+		len = binLen;
+		memcpy(g_in_msg, rxBlock->blockBuffer, len);
+	}
+	else 
+	#endif
+	{
+		// copy the input command to g_in_msg - up to the end of the block, and cut to MAX_CMD_LEN:
+		len = 0;
+		while ((len < rxBlock->blockHeader.blockLen) && (len < MAX_CMD_LEN - 1) && (rxBlock->blockBuffer[len] != '\0')) {
+			len++;
+		}
+		memcpy(g_in_msg, rxBlock->blockBuffer, len);
+		g_in_msg[len] = '\0';
+	}
+	if ((rxBlock->blockHeader.blockLen >= len + TXRX_REPLY_INFO_LENGTH) && (rxBlock->blockBuffer[len] == '\0')) {
+		replySlot = rxBlock->blockBuffer[len + 1];
+		replySlots = rxBlock->blockBuffer[len + 2];		// output that was not sent yet goes with the reply
+		isReplyStarted = FALSE;
+		replyTick = MiWi_TickGet();
+	}
+}
+
+/******************************************************************************
+* Function:
+*		TXRX_ERRORS TxRx_SendReply(void)
+* Description:
+*		Sends the collected reply as one packet. The buffer is emptied first,
+*		so an error print of the send starts the next reply.
+*******************************************************************************/
+TXRX_ERRORS TxRx_SendReply(void) {
+
+	TXRX_ERRORS status;
+	WORD len = replyLen;
+	
+	if (len == 0) {
+		return TXRX_NO_ERROR;
+	}
+	replyLen = 0;
+	isReplyCut = FALSE;
+	status = TxRx_SendPacketWithConfirmation((BYTE*)replyBuffer, len, TXRX_TYPE_COMMAND);
+	if (status != TXRX_NO_ERROR) {
+		TxRx_PrintError(status);
+	}	
+	return status;
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_FlushReply(void)
+* Description:
+*		Sends what is left of the reply at once, or - to a broadcast command - 
+*		holds it for TxRx_ReplyTasks.
+*******************************************************************************/
+void TxRx_FlushReply(void) {
+
+	if (replySlots == 0) {
+		TxRx_SendReply();
+		return;
+	}
+	isReplyHeld = TRUE;
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_ReplyTasks(void)
+* Description:
+*		Sends the held reply to a broadcast command when the reply slot of the
+*		stone comes: slot * TXRX_REPLY_SLOT_TIME after the plug broadcast the 
+*		start of the replies, or - if the start was missed - after the time the
+*		plug needs to deliver the command to the rest of the stones.
+*******************************************************************************/
+void TxRx_ReplyTasks(void) {
+
+	MIWI_TICK now;
+	
+	if (isReplyHeld == FALSE) {
+		return;
+	}
+	now = MiWi_TickGet();
+	if (isReplyStarted == FALSE) {
+		if (MiWi_TickGetDiff(now, replyTick) < (DWORD)(replySlots - replySlot) * TXRX_BCAST_SEND_TIME) {
+			return;
+		}
+		replyTick = now;								// the start was missed - the slots are counted from now
+		isReplyStarted = TRUE;
+	}
+	if (MiWi_TickGetDiff(now, replyTick) < (DWORD)replySlot * TXRX_REPLY_SLOT_TIME) {
+		return;
+	}
+	isReplyHeld = FALSE;
+	replySlots = 0;										// from now on the reply is sent at the prompt
+	TxRx_SendReply();
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_BackgroundTasks(void)
+*******************************************************************************/
+void TxRx_BackgroundTasks(void) {
+
+	TxRx_ReplyTasks();
+	#if defined ENABLE_CUMULATIVE_ACK
+		TxRx_WindowTasks();
+	#endif
+}
+#endif // WISDOM_STONE
+
+#if defined COMMUNICATION_PLUG
+/******************************************************************************
+* Function:
+*		TXRX_ERRORS TxRx_SendCommand(BYTE *command, WORD commandLen)
+*
+* Description:
+*      This function sending a command packet to the other device. It uses the
+*	   TxRx_SendPacketWithConfimation() function to accomplish this aim.
+*	   This functions is used in the plug.
+*	   
+* Example:
+*		if(ProccessIO)
+*		{
+*			strcpy(msg,cmd_Current);	
+*			TXRX_ERRORS status = TxRx_SendCommand(msg, strlen(msg));
+*			if(status != TXRX_NO_ERROR)
+*			{
+*				// Error handling
+*			}
+*		}
+*		<code>
+*
+*
+* Parameters:
+*	   command - The command you want to send.
+*
+* Return value: 
+*	   Any parameter at the TXRX_ERRORS enum.
+*	   
+*
+******************************************************************************/
+TXRX_ERRORS TxRx_SendCommand(BYTE* command, WORD commandLen) {
+		
+	TXRX_ERRORS status;
 	
 	if (isBroadcast == TRUE) {
-		// We use g_broadcast_counter and g_phase_counter to measure the phase 
-		// between the stones. Therefore we need these counters only when the 
-		// plug broadcasts a message with a command to all the stones in the 
-		// network. Since this is a case of application-broadcast - the lower
-		// layers (MiWi and MAC) do not treat it as such, and therefore the 
-		// counters are added to all the command-messages (i.e. - in case of
-		// application-unicast too, but we use the counters only for application-broadcast) 	
-		#if defined DEBUG_PRINT
-			m_write_debug("\r\n");
-			m_write_debug("************** B R O A D C A S T **************");
-			m_write_debug("\r\n");
-		#endif
-		// YL 12.1 ...
-		g_broadcast_counter_start.Val = g_broadcast_counter.Val;  // start to record the broadcast-counter
-		#if defined DEBUG_PRINT
-			m_write_debug("BCStart: ");
-			m_write_debug(int_to_str(g_broadcast_counter_start.Val));
-			m_write_debug("\r\n");
-			DelayMs(100);
-		#endif		
-		// ... YL 12.1
-		BYTE destinationEUI0;
-		for (destinationEUI0 = NWK_STARTER_ADDR_EUI0; destinationEUI0 < MAX_NWK_SIZE; destinationEUI0++) { 	// index "0" (the plug) is irrelevant
-			if (isNetworkMember[destinationEUI0] == TRUE) {		
-				finalDestinationNwkAddress[0] = destinationEUI0;
-				#if defined DEBUG_PRINT
-					m_write_debug("\r\n");
-					m_write_debug("******* T O: ");
-					m_write_debug(byte_to_str(finalDestinationNwkAddress[0]));
-					m_write_debug("\r\n");
-				#endif
-				// YL 12.1 ...
-				g_broadcast_counter_stop.Val = g_broadcast_counter.Val - g_broadcast_counter_start.Val; 	// read the record of the broadcast-counter
-				if (g_broadcast_counter_stop.Val < 0) {
-					g_broadcast_counter_stop.Val += 0xFFFF;		 // overflow
-				}
-				#if defined DEBUG_PRINT
-					m_write_debug("BCStop: ");
-					m_write_debug(int_to_str(g_broadcast_counter_stop.Val));
-					m_write_debug("\r\n");
-				#endif				
-				g_phase_counter_start.Val = g_phase_counter.Val; // start to record the phase-counter	
-				#if defined DEBUG_PRINT
-					m_write_debug("PHStart: ");
-					m_write_debug(int_to_str(g_phase_counter_start.Val));
-					m_write_debug("\r\n");
-				#endif				
-				// ... YL 12.1				
-				status = TxRx_SendPacketWithConfirmation(command, commandLen, TXRX_TYPE_COMMAND);
+		BYTE i;
+		BYTE slot = 0;
+		BYTE slots = TxRx_BroadcastStart(command, commandLen);
+		for (i = 0; (i < stoneCount) && (slot < slots); i++) {
+			if (TxRx_BroadcastMember(i, slot) == TRUE) {
+				slot++;
+				status = TxRx_SendPacketWithConfirmation(bcastCommand, bcastCommandLen, TXRX_TYPE_COMMAND);
 				if (status != TXRX_NO_ERROR) {
 					TxRx_PrintError(status);
 				}
+				// YL 8.11 ... remove if isn't effective
+				DelayMs(100);										// only after a delivery - the other entries are skipped at once
+				// ... YL 8.11			
 			}
-			// YL 8.11 ... remove if isn't effective
-			DelayMs(100);
-			// ... YL 8.11			
 		}
+		TxRx_CollectReplies(slots);
 	}
 	else {
 		status = TxRx_SendPacketWithConfirmation(command, commandLen, TXRX_TYPE_COMMAND);
@@ -1169,6 +2270,104 @@ TXRX_ERRORS TxRx_SendCommand(BYTE* command) {
 				// the plug would stop searching for non-existing nwk address
 				// and continue normally (after appropriate message display)
 }
+
+/******************************************************************************
+* Function:
+*		BYTE TxRx_BroadcastStart(BYTE *command, WORD commandLen)
+* Description:
+*		Prepares bcastCommand - the command (commandLen bytes - a binary 
+*		command may hold '\0') and a '\0', followed by the reply info 
+*		[reply slot, reply slots] - for the member stones.
+* Return value:
+*		The number of reply slots (one for each member stone)
+*******************************************************************************/
+BYTE TxRx_BroadcastStart(BYTE *command, WORD commandLen) {
+
+	BYTE i;
+	BYTE slots = 0;
+	
+	// We use g_broadcast_counter and g_phase_counter to measure the phase 
+	// between the stones. Therefore we need these counters only when the 
+	// plug broadcasts a message with a command to all the stones in the 
+	// network. Since this is a case of application-broadcast - the lower
+	// layers (MiWi and MAC) do not treat it as such, and therefore the 
+	// counters are added to all the command-messages (i.e. - in case of
+	// application-unicast too, but we use the counters only for application-broadcast) 	
+	#if defined DEBUG_PRINT
+		m_write_debug("\r\n");
+		m_write_debug("************** B R O A D C A S T **************");
+		m_write_debug("\r\n");
+	#endif
+	// YL 12.1 ...
+	g_broadcast_counter_start.Val = g_broadcast_counter.Val;  // start to record the broadcast-counter
+	#if defined DEBUG_PRINT
+		m_write_debug("BCStart: ");
+		m_write_debug(int_to_str(g_broadcast_counter_start.Val));
+		m_write_debug("\r\n");
+		DelayMs(100);
+	#endif		
+	// ... YL 12.1
+	for (i = 0; i < stoneCount; i++) {
+		if (stoneTable[i].isNetworkMember == TRUE && 
+			stoneTable[i].eui0 != PLUG_NWK_ADDR_EUI0) {
+			slots++;
+		}
+	}
+	// add the reply slot of each stone after the '\0' of the command:
+	if (commandLen > MAX_CMD_LEN - 1) {
+		commandLen = MAX_CMD_LEN - 1;
+	}
+	memcpy(bcastCommand, command, commandLen);
+	bcastCommand[commandLen] = '\0';
+	bcastCommand[commandLen + 2] = slots;
+	bcastCommandLen = commandLen + TXRX_REPLY_INFO_LENGTH;
+	return slots;
+}
+
+/******************************************************************************
+* Function:
+*		BOOL TxRx_BroadcastMember(BYTE i, BYTE slot)
+* Description:
+*		If stoneTable[i] is a member stone, makes it the destination of 
+*		bcastCommand, with the reply slot slot.
+* Return value:
+*		FALSE if stoneTable[i] is not a member stone (nothing is sent to it)
+*******************************************************************************/
+BOOL TxRx_BroadcastMember(BYTE i, BYTE slot) {
+
+	if (stoneTable[i].isNetworkMember == FALSE || 
+		stoneTable[i].eui0 == PLUG_NWK_ADDR_EUI0) {						// the plug is irrelevant
+		return FALSE;
+	}
+	finalDestinationNwkAddress[0] = stoneTable[i].eui0;
+	finalDestinationNwkAddress[1] = EUI_1;
+	stoneTable[i].isReplyPending = TRUE;
+	bcastCommand[bcastCommandLen - TXRX_REPLY_INFO_LENGTH + 1] = slot;
+	#if defined DEBUG_PRINT
+		m_write_debug("\r\n");
+		m_write_debug("******* T O: ");
+		m_write_debug(byte_to_str(finalDestinationNwkAddress[0]));
+		m_write_debug("\r\n");
+	#endif
+	// YL 12.1 ...
+	g_broadcast_counter_stop.Val = g_broadcast_counter.Val - g_broadcast_counter_start.Val; 	// read the record of the broadcast-counter
+	if (g_broadcast_counter_stop.Val < 0) {
+		g_broadcast_counter_stop.Val += 0xFFFF;		 // overflow
+	}
+	#if defined DEBUG_PRINT
+		m_write_debug("BCStop: ");
+		m_write_debug(int_to_str(g_broadcast_counter_stop.Val));
+		m_write_debug("\r\n");
+	#endif				
+	g_phase_counter_start.Val = g_phase_counter.Val; // start to record the phase-counter	
+	#if defined DEBUG_PRINT
+		m_write_debug("PHStart: ");
+		m_write_debug(int_to_str(g_phase_counter_start.Val));
+		m_write_debug("\r\n");
+	#endif				
+	// ... YL 12.1				
+	return TRUE;
+}
 #endif 
 
 #if defined ENABLE_TXRX_ACK // YL 25.12 added #ifdef
@@ -1200,7 +2399,10 @@ TXRX_ERRORS TxRx_SendAck() {
 		}
 	#elif defined COMMUNICATION_PLUG
 		if (status == TXRX_NO_ERROR) {
-			blockAckInfo[rxFromEUI0].rxLastSeq = blockAckInfo[rxFromEUI0].rxExpectedSeq;	// TODO YL TxRx_SendPacket of ack succeeded, so the transmitter got the ack... 			
+			rxFromStone->ackInfo.rxLastSeq = rxFromStone->ackInfo.rxExpectedSeq;	// TODO YL TxRx_SendPacket of ack succeeded, so the transmitter got the ack... 			
+			#if defined ENABLE_CUMULATIVE_ACK
+				rxFromStone->ackPending = 0;
+			#endif
 		}
 	#endif // WISDOM_STONE
 
@@ -1233,16 +2435,34 @@ TXRX_ERRORS TxRx_ReceivePacketHeader() {
 	WORD i = 0;
 	BYTE j = 0;
 	BYTE messageInformation[MSG_INF_LENGTH]; 	// to replace rxMessage.Payload[0] and to make the reading of rxMessage.Payload more clear
+	#if !defined ENABLE_COMPACT_HEADER
 	BYTE receivedSourceNwkDestination[MY_ADDRESS_LENGTH];
 	BYTE receivedDestinationNwkDestination[MY_ADDRESS_LENGTH];
+	#endif
+	WORD rxPhase = 0;
+	#if defined ENABLE_CUMULATIVE_ACK
+		BYTE piggyAck;
+	#endif
 	
+	#if defined ENABLE_ZERO_COPY_RX
+	TxRx_ReleaseRxBlock(rxBlock);													// the previous block of rxBlock is over
+	#endif
+	// each field is read only if the frame holds it - nothing is taken from a frame until its whole header is valid:
+	if (rxMessage.PayloadSize < MSG_INF_LENGTH + MSG_ADR_LENGTH) {
+		return TXRX_WRONG_PACKET_LENGTH;
+	}
 	for (i = 0; i < MSG_INF_LENGTH; i++) {
 		messageInformation[i] = rxMessage.Payload[i];
 	}
-	rxBlock.blockHeader.blockType = ((messageInformation[0]) & TXRX_TYPE_MASK);	
-	if (rxBlock.blockHeader.blockType > (TXRX_TYPE_MAX - 1)) {
+	rxBlock->blockHeader.blockType = ((messageInformation[0]) & TXRX_TYPE_MASK);	
+	if (rxBlock->blockHeader.blockType > (TXRX_TYPE_MAX - 1)) {
 		return TXRX_WRONG_BLOCK_TYPE;
 	}	
+	#if defined ENABLE_COMPACT_HEADER
+	// MiWi delivered the message to the address of this device; the received source becomes the destination for the reply:
+	finalDestinationNwkAddress[0] = rxMessage.Payload[i++];
+	finalDestinationNwkAddress[1] = EUI_1;
+	#else
 	for (i = MSG_INF_LENGTH, j = 0;
 		i < (MSG_INF_LENGTH + MY_ADDRESS_LENGTH); i++, j++) {
 		receivedSourceNwkDestination[j] = rxMessage.Payload[i];
@@ -1261,10 +2481,20 @@ TXRX_ERRORS TxRx_ReceivePacketHeader() {
 	for (j = 0; j < MY_ADDRESS_LENGTH; j++)	{
 		finalDestinationNwkAddress[j] = receivedSourceNwkDestination[j];
 	}
+	#endif // ENABLE_COMPACT_HEADER
+	#if defined COMMUNICATION_PLUG
+		// only stones send blocks to the plug - another device with the plug address must not take the entry of the plug:
+		rxFromStone = (finalDestinationNwkAddress[0] <= MAX_STONE_ADDR_EUI0) ? TxRx_AddStone(finalDestinationNwkAddress[0]) : NULL;
+		if (rxFromStone == NULL) {
+			return TXRX_NWK_UNKNOWN_ADDR;
+		}
+		rxBlock->handlingParam.eui0 = rxFromStone->eui0;
+	#endif
 	
 	#if defined ENABLE_TXRX_ACK		
-		if ((rxBlock.blockHeader.blockType == TXRX_TYPE_COMMAND) 
-			|| (rxBlock.blockHeader.blockType == TXRX_TYPE_DATA)) {					// the block is either command or data
+		if ((rxBlock->blockHeader.blockType == TXRX_TYPE_COMMAND) 
+			|| (rxBlock->blockHeader.blockType == TXRX_TYPE_DATA)
+			|| (rxBlock->blockHeader.blockType == TXRX_TYPE_CONTROL)) {				// the block is either command or data or control
 			BYTE receivedDataSeq = (((messageInformation[0]) >> 2) & TXRX_SEQ_MASK);		
 			#if defined WISDOM_STONE
 				if (receivedDataSeq == ((blockAckInfo.rxLastSeq + 1) % MAX_ACK_LENGTH)) { 	// if the received sequence is +1 more than the last ack //YL 9.8 replaced 60 with MAX_ACK_LENGTH
@@ -1277,22 +2507,35 @@ TXRX_ERRORS TxRx_ReceivePacketHeader() {
 					return TXRX_WRONG_DATA_SEQ;
 				}
 			#elif defined COMMUNICATION_PLUG
-				rxFromEUI0 = finalDestinationNwkAddress[0]; 
-				if (receivedDataSeq == ((blockAckInfo[rxFromEUI0].rxLastSeq + 1) % MAX_ACK_LENGTH)) { 	// if the received sequence is +1 more than the last ack //YL 9.8 replaced 60 with MAX_ACK_LENGTH
-					blockAckInfo[rxFromEUI0].rxExpectedSeq = receivedDataSeq;
+				if (receivedDataSeq == ((rxFromStone->ackInfo.rxLastSeq + 1) % MAX_ACK_LENGTH)) { 	// if the received sequence is +1 more than the last ack //YL 9.8 replaced 60 with MAX_ACK_LENGTH
+					rxFromStone->ackInfo.rxExpectedSeq = receivedDataSeq;
+				}
+				else if (receivedDataSeq == rxFromStone->ackInfo.rxLastSeq ) {		// the previous ack was not received
+					rxFromStone->ackInfo.rxExpectedSeq = receivedDataSeq;
 				}
-				else if (receivedDataSeq == blockAckInfo[rxFromEUI0].rxLastSeq ) {	// the previous ack was not received
-					blockAckInfo[rxFromEUI0].rxExpectedSeq = receivedDataSeq;
+				#if defined ENABLE_CUMULATIVE_ACK
+				else if ((rxBlock->blockHeader.blockType == TXRX_TYPE_DATA) &&
+					((rxFromStone->ackInfo.rxLastSeq + MAX_ACK_LENGTH - receivedDataSeq) % MAX_ACK_LENGTH < TXRX_ACK_WINDOW)) {	// the stone sent its window again
+					rxFromStone->ackInfo.rxExpectedSeq = rxFromStone->ackInfo.rxLastSeq;	// ack the last block again
 				}
+				#endif
 				else {					
 					return TXRX_WRONG_DATA_SEQ;
 				}
 			#endif // WISDOM_STONE
 		}
-		if (rxBlock.blockHeader.blockType == TXRX_TYPE_ACK) {		 				// the ack is from the plug to the stone // YL maybe "else if" instead of "if"?
+		if (rxBlock->blockHeader.blockType == TXRX_TYPE_ACK) {		 				// the ack is from the plug to the stone // YL maybe "else if" instead of "if"?
 			BYTE receivedAckSeq = (((messageInformation[0]) >> 2) & TXRX_SEQ_MASK);				
 			
 			#if defined WISDOM_STONE
+				#if defined ENABLE_CUMULATIVE_ACK
+				if (txWindowCount > 0) {											// an ack of the data blocks in the window
+					if (TxRx_WindowAck(receivedAckSeq) == TRUE) {
+						return TXRX_NO_ERROR;
+					}
+					return TXRX_WRONG_ACK_SEQ;
+				}
+				#endif
 				if (receivedAckSeq == blockAckInfo.txExpectedSeq) {					// if the received ack is the same as the last data seq that we sent
 					blockAckInfo.txLastSeq = blockAckInfo.txExpectedSeq; 				
 					return TXRX_NO_ERROR;
@@ -1301,9 +2544,8 @@ TXRX_ERRORS TxRx_ReceivePacketHeader() {
 					return TXRX_WRONG_ACK_SEQ; 
 				}
 			#elif defined COMMUNICATION_PLUG
-				rxFromEUI0 = finalDestinationNwkAddress[0];
-				if (receivedAckSeq == blockAckInfo[rxFromEUI0].txExpectedSeq) {		// if the received ack is the same as the last data seq that we sent
-					blockAckInfo[rxFromEUI0].txLastSeq = blockAckInfo[rxFromEUI0].txExpectedSeq; 				
+				if (receivedAckSeq == rxFromStone->ackInfo.txExpectedSeq) {		// if the received ack is the same as the last data seq that we sent
+					rxFromStone->ackInfo.txLastSeq = rxFromStone->ackInfo.txExpectedSeq; 				
 					return TXRX_NO_ERROR;
 				}
 				else {			
@@ -1314,21 +2556,42 @@ TXRX_ERRORS TxRx_ReceivePacketHeader() {
 	#endif // ENABLE_TXRX_ACK
 
 	// now we read the length of received message: 
-	// i = MSG_INF_LENGTH + 2 * MY_ADDRESS_LENGTH	
-	rxBlock.blockHeader.blockLen = 0;
+	// i = MSG_INF_LENGTH + MSG_ADR_LENGTH
+	#if defined ENABLE_COMPACT_HEADER
+	j = TxRx_ReadVarLen(&rxMessage.Payload[i], rxMessage.PayloadSize - i, &rxBlock->blockHeader.blockLen);
+	if (j == 0) {																	// the length is cut short
+		return TXRX_WRONG_PACKET_LENGTH;
+	}
+	i += j;
+	#else
+	if (rxMessage.PayloadSize < i + MSG_LEN_LENGTH) {
+		return TXRX_WRONG_PACKET_LENGTH;
+	}
+	rxBlock->blockHeader.blockLen = 0;
 	for (j = 0; j < MSG_LEN_LENGTH; j++) {
-		rxBlock.blockHeader.blockLen <<= 8;
-		rxBlock.blockHeader.blockLen += (WORD)rxMessage.Payload[i++];		
+		rxBlock->blockHeader.blockLen <<= 8;
+		rxBlock->blockHeader.blockLen += (WORD)rxMessage.Payload[i++];		
 	}
-	if (rxBlock.blockHeader.blockLen > MAX_BLOCK_SIZE) { 							
-		rxBlock.blockHeader.blockLen = MAX_BLOCK_SIZE;	
+	#endif
+	if (rxBlock->blockHeader.blockLen > TXRX_MAX_BLOCK_LEN) { 							
+		rxBlock->blockHeader.blockLen = TXRX_MAX_BLOCK_LEN;	
 		return TXRX_WRONG_PACKET_LENGTH;
 	}	
+	#if defined ENABLE_CUMULATIVE_ACK
+		// now we read the piggybacked ack (after the length): 
+		if (rxMessage.PayloadSize < i + MSG_ACK_LENGTH) {
+			return TXRX_WRONG_PACKET_LENGTH;
+		}
+		piggyAck = rxMessage.Payload[i];
+		i += MSG_ACK_LENGTH;
+	#endif
 	// YL 12.1 ...
 	// now we read the phase of the received message (only in case of command message): 
-	// i = MSG_INF_LENGTH + 2 * MY_ADDRESS_LENGTH + MSG_LEN_LENGTH	 
-	if (rxBlock.blockHeader.blockType == TXRX_TYPE_COMMAND) {
-		WORD rxPhase = 0;
+	// i = MSG_INF_LENGTH + MSG_ADR_LENGTH + the length [+ MSG_ACK_LENGTH]
+	if (rxBlock->blockHeader.blockType == TXRX_TYPE_COMMAND) {
+		if (rxMessage.PayloadSize < i + MSG_PHS_LENGTH) {
+			return TXRX_WRONG_PACKET_LENGTH;
+		}
 		for (j = 0; j < MSG_PHS_LENGTH; j++) {
 			rxPhase <<= 8;
 			rxPhase += (WORD)(rxMessage.Payload[i++]);	
@@ -1339,15 +2602,32 @@ TXRX_ERRORS TxRx_ReceivePacketHeader() {
 			m_write_debug(int_to_str((int)rxPhase));
 			*/
 		#endif
-		g_phase_counter_start.Val += rxPhase; // no overflow is expected since g_phase_counter_start is zeroed when the buffer is received
 	}		
+	// the header is valid - take the piggybacked ack and the phase:
+	#if defined ENABLE_CUMULATIVE_ACK && defined WISDOM_STONE
+		if (((piggyAck & TXRX_PIGGYBACK_ACK) != 0) && (txWindowCount > 0)) {	// the plug acks data blocks in the header of its block
+			TxRx_WindowAck(piggyAck & TXRX_SEQ_MASK);
+		}
+	#endif
+	if (rxBlock->blockHeader.blockType == TXRX_TYPE_COMMAND) {
+		g_phase_counter_start.Val += rxPhase; // no overflow is expected since g_phase_counter_start is zeroed when the buffer is received
+	}
 	// ... YL 12.1	
 
-	rxBlock.handlingParam.blockPos = 0;
-	rxBlock.handlingParam.isHeader = FALSE;											// YL rxBlock.handlingParam.isHeader <- FALSE to enable receiving "non header" message portions; rxBlock.handlingParam.isHeader turns TRUE again after we receive the "trailer" portion  
-	// i = MSG_INF_LENGTH + 2 * MY_ADDRESS_LENGTH + MSG_LEN_LENGTH [+ MSG_PHS_LENGTH]
-	while (i < rxMessage.PayloadSize) {												// YL the receiver reads the data into rxBlock.blockBuffer ("data" - meaning - Payload bytes except for 3 first bytes of the header; these "data" bytes may include the trailer too)
-		rxBlock.blockBuffer[rxBlock.handlingParam.blockPos++] = rxMessage.Payload[i++];
+	rxBlock->handlingParam.blockPos = 0;
+	rxBlock->handlingParam.isHeader = FALSE;											// YL rxBlock->handlingParam.isHeader <- FALSE to enable receiving "non header" message portions; rxBlock->handlingParam.isHeader turns TRUE again after we receive the "trailer" portion  
+	#if defined ENABLE_ZERO_COPY_RX
+	if ((rxBlock->blockHeader.blockType != TXRX_TYPE_DATA) &&							// data blocks are handled as MAX_BLOCK_SIZE bytes
+		(rxMessage.PayloadSize - i >= rxBlock->blockHeader.blockLen + TXRX_TRAILER_SIZE)) {	// the whole block is in this message - it is handled in the frame
+		rxBlock->rxFrame = MiApp_RetainMessage();
+		rxBlock->blockBuffer = &rxMessage.Payload[i];
+		rxBlock->handlingParam.blockPos = rxMessage.PayloadSize - i;
+		return TXRX_NO_ERROR;
+	}
+	#endif
+	// i = MSG_INF_LENGTH + MSG_ADR_LENGTH + the length [+ MSG_ACK_LENGTH] [+ MSG_PHS_LENGTH]
+	while (i < rxMessage.PayloadSize) {												// YL the receiver reads the data into rxBlock->blockBuffer ("data" - meaning - Payload bytes except for 3 first bytes of the header; these "data" bytes may include the trailer too)
+		rxBlock->blockBuffer[rxBlock->handlingParam.blockPos++] = rxMessage.Payload[i++];
     }
 	return TXRX_NO_ERROR;	
 }	
@@ -1357,290 +2637,2859 @@ TXRX_ERRORS TxRx_ReceivePacketHeader() {
 *		TXRX_ERRORS TxRx_ReceiveBuffer()
 *
 * Description:
-*      This function is responsible for transferring the message in rxMessage struct
-*	   to our rxBlock struct. Notice that this function transfers only data in
-*	   the buffer of the block, and not the packet header and trailer, which is
-*	   done in TxRx_ReceivePacketHeader() and TxRx_ReceivePacketTrailer() functions.
-*
-* Parameters:
-*	   None.
-*
-* Return value: 
-*	   None.
-*	   
-*
-******************************************************************************/
-void TxRx_ReceiveBuffer(){
+*      This function is responsible for transferring the message in rxMessage struct
+*	   to our rxBlock struct. Notice that this function transfers only data in
+*	   the buffer of the block, and not the packet header and trailer, which is
+*	   done in TxRx_ReceivePacketHeader() and TxRx_ReceivePacketTrailer() functions.
+*
+* Parameters:
+*	   None.
+*
+* Return value: 
+*	   None.
+*	   
+*
+******************************************************************************/
+void TxRx_ReceiveBuffer(){
+
+	WORD i;
+		
+    for (i = 0; i < rxMessage.PayloadSize; i++) {
+   		rxBlock->blockBuffer[rxBlock->handlingParam.blockPos++] = rxMessage.Payload[i];
+    }	
+}
+
+/******************************************************************************
+* Function:
+*		TXRX_ERRORS TxRx_ReceivePacketTrailer()
+*
+* Description:
+*       This function is responsible for receiving the packet trailer, and
+*		initialization for receiving the next packet.
+*
+* Parameters:
+*	   None.
+*
+* Return value: 
+*	   TXRX_NO_ERROR
+*	   TXRX_RECEIVED_INVALID_TRAILER
+*	   
+*
+******************************************************************************/
+TXRX_ERRORS TxRx_ReceivePacketTrailer(){
+		
+	TXRX_ERRORS status = TXRX_NO_ERROR;
+	WORD i;
+	
+	#if defined ENABLE_COMPACT_HEADER
+	if (TxRx_BlockCrc(rxBlock->blockBuffer, rxBlock->blockHeader.blockLen + TXRX_TRAILER_SIZE) != 0) {	// the CRC of the block followed by its CRC is 0
+		status = TXRX_RECEIVED_INVALID_TRAILER;
+	}
+	#else
+	for (i = 0; i < TXRX_TRAILER_SIZE; i++) {
+		rxBlock->blockTrailer[i] = rxBlock->blockBuffer[rxBlock->blockHeader.blockLen + i];		
+		if (rxBlock->blockTrailer[i] != TxRx_Trailer[i]) {						// YL check last TXRX_TRAILER_SIZE = 4 bytes of blockBuffer; these bytes should be identical to constant trailer string
+			status = TXRX_RECEIVED_INVALID_TRAILER;
+			break;
+		}
+	}
+	#endif
+	rxBlock->handlingParam.isHeader = TRUE;										// we received the whole packet; next we are waiting for the header of the next block; //YL reset rxBlock fields for next transmission
+	rxBlock->blockBuffer[rxBlock->blockHeader.blockLen] = '\0';					
+	rxBlock->handlingParam.blockPos = 0;
+	rxBlock->blockHeader.blockLen = 0;
+	return status;
+}
+
+#if defined ENABLE_ZERO_COPY_RX
+/******************************************************************************
+* Function:
+*		void TxRx_InitRxBlock(RX_BLOCK_BUFFER *block)
+*
+* Description:
+*      Points the block at its own buffer, without a received frame. 
+*	   Used after the receive pool was initialized (MiApp_ProtocolInit).
+*
+******************************************************************************/
+void TxRx_InitRxBlock(RX_BLOCK_BUFFER *block) {
+
+	block->blockBuffer = block->blockStore;
+	block->rxFrame = 0xFF;
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_ReleaseRxBlock(RX_BLOCK_BUFFER *block)
+*
+* Description:
+*      Returns the frame that holds the block (if any) to the receive pool, and
+*	   points the block at its own buffer again.
+*
+******************************************************************************/
+void TxRx_ReleaseRxBlock(RX_BLOCK_BUFFER *block) {
+
+	if (block->rxFrame != 0xFF) {
+		MiApp_ReleaseMessage(block->rxFrame);
+	}
+	TxRx_InitRxBlock(block);
+}
+#endif // ENABLE_ZERO_COPY_RX
+
+/******************************************************************************
+* Function:
+*		TXRX_ERRORS TxRx_ReceiveMessage()
+*
+* Description:
+*      This function is responsible for receiving a message. As mentioned, a packet
+*	   consists of several messages, therefore this function is used by 
+*	   TxRx_ReceivePacket() to get a message at a time, until the whole packet
+*	   is received.
+*
+* Parameters:
+*	   None.
+*
+* Return value: 
+*	   TXRX_NO_ERROR
+*	   TXRX_WRONG_BLOCK_TYPE.
+*	   TXRX_WRONG_DATA_SEQ
+*	   TXRX_WRONG_ACK_SEQ
+*	   TXRX_WRONG_PACKET_LENGTH 
+*	   TXRX_RECEIVED_INVALID_TRAILER
+*	   TXRX_NO_PACKET_RECEIVED
+*	   
+*
+******************************************************************************/
+TXRX_ERRORS TxRx_ReceiveMessage() {
+	
+	/*******************************************************************/
+	// Function MiApp_MessageAvailable will return a boolean to indicate 
+	// if a message for application layer has been received by the 
+	// transceiver. If a message has been received, all information will 
+	// be stored in the rxMessage, structure of RECEIVED_MESSAGE.
+	// YL TxRx_ReceiveMessage uses:
+	// - TxRx_ReceivePacketHeader
+	// - TxRx_ReceiveBuffer
+	// - TxRx_ReceivePacketTrailer
+	// to copy rxMessage.Payload bytes into the fields of rxBlock struct
+	/*******************************************************************/
+		
+	if (MiApp_MessageAvailable()) {		         
+		TXRX_ERRORS status;
+		if (TxRx_ConsumeBroadcast() == TRUE) {						// e.g. a beacon between the messages of the block
+			return TXRX_NO_PACKET_RECEIVED;
+		}
+		if (rxMessage.flags.bits.broadcast == 1) {					// blocks are unicast
+			MiApp_DiscardMessage();
+			return TXRX_NO_PACKET_RECEIVED;
+		}
+		#if defined COMMUNICATION_PLUG
+			if (TxRx_SelectRxBlock() == FALSE) {					// the stone retries the block later
+				MiApp_DiscardMessage();
+				return TXRX_NO_PACKET_RECEIVED;
+			}
+		#endif
+		if (rxBlock->handlingParam.isHeader == TRUE) {				// it is the beginning of the block
+			status = TxRx_ReceivePacketHeader();
+			if ((status == TXRX_WRONG_DATA_SEQ) || (status == TXRX_WRONG_ACK_SEQ)) {	// the source is known
+				RX_STATS.rxSeqErrors++;
+				TxRx_CountRxFrame();
+			}
+			if (status != TXRX_NO_ERROR) {				
+				MiApp_DiscardMessage();
+				return status;
+			}
+		}
+		else {
+			TxRx_ReceiveBuffer();
+		} 
+		TxRx_CountRxFrame();
+		if ((rxBlock->handlingParam.blockPos) >= 
+			(rxBlock->blockHeader.blockLen + TXRX_TRAILER_SIZE)) {	// we got the whole block
+			status = TxRx_ReceivePacketTrailer();
+			if (status != TXRX_NO_ERROR) {				
+				RX_STATS.rxTrailerErrors++;
+				MiApp_DiscardMessage();
+				return status;	
+			}
+		}
+		MiApp_DiscardMessage();	
+		return TXRX_NO_ERROR; // message received
+	}
+	return TXRX_NO_PACKET_RECEIVED;    			     
+}
+
+/******************************************************************************
+* Function:
+*		TXRX_ERRORS TxRx_ReceivePacket()
+*
+* Description:
+*      This function is the primary function for receiving a whole packet. The 
+*	   function uses TxRx_ReceiveMessage() to get messages, and union all these
+*	   messages to get a whole packet.
+*
+* Parameters:
+*	   None.
+*
+* Return value: 
+*	   TXRX_NO_ERROR
+*	   TXRX_WRONG_BLOCK_TYPE.
+*	   TXRX_WRONG_DATA_SEQ
+*	   TXRX_WRONG_ACK_SEQ
+*	   TXRX_WRONG_PACKET_LENGTH 
+*	   TXRX_RECEIVED_INVALID_TRAILER
+*	   TXRX_NO_PACKET_RECEIVED
+*	   TXRX_PARTIAL_PACKET_RECEIVED
+*	   
+*
+******************************************************************************/
+TXRX_ERRORS TxRx_ReceivePacket() {
+	
+	TXRX_ERRORS status = TXRX_NO_ERROR;
+	
+	#if defined WISDOM_STONE
+		WORD i = 0;
+		
+		#if defined ENABLE_ZERO_COPY_RX
+			TxRx_ReleaseRxBlock(rxBlock);								// the buffer is cleared below, not the frame
+		#endif
+		for (i = 0; i < (MAX_BLOCK_SIZE); i++) {						// YL TxRx_ReceivePacket resets all rxBlock fields before calling TxRx_ReceiveMessage that actually recieves the data according to it's type (header\buffer\trailer)
+			rxBlock->blockBuffer[i] = '\0';
+		}
+		rxBlock->blockHeader.blockType = 0;									
+		rxBlock->handlingParam.isHeader = TRUE;
+		rxBlock->handlingParam.isTrailer = FALSE;
+		rxBlock->handlingParam.blockPos = 0;
+		rxBlock->blockHeader.blockLen = 0;
+	#endif // the plug keeps the blocks that other stones are in the middle of (TxRx_SelectRxBlock) 
+	MIWI_TICK t1, t2;
+	t1 = MiWi_TickGet();
+		
+	while (1) {
+		status = TxRx_ReceiveMessage();									// receive the command packet
+		if (status != TXRX_NO_PACKET_RECEIVED) {
+			break;
+		}
+		t2 = MiWi_TickGet();		
+		if ((MiWi_TickGetDiff(t2, t1)) > TIMEOUT_RECEIVING_MESSAGE) {	// waits a few seconds to get the whole command		
+			status = TXRX_NO_PACKET_RECEIVED;
+			break;
+		}
+	}
+	if (status == TXRX_NO_ERROR) {										// we received at least the header of the packet
+		t1 = MiWi_TickGet();
+		while (rxBlock->handlingParam.isHeader == FALSE) {				// until we get the whole command - continue try getting it (the plug: until any block is complete)
+			status = TxRx_ReceiveMessage();	
+			if ((status != TXRX_NO_ERROR) && (status != TXRX_NO_PACKET_RECEIVED)) {
+				break;
+			}
+			t2 = MiWi_TickGet();
+			if ((MiWi_TickGetDiff(t2, t1)) > TIMEOUT_RECEIVING_MESSAGE) { // waits a few seconds to get the whole command
+				status = TXRX_PARTIAL_PACKET_RECEIVED;
+				break;
+			}
+		}
+	}
+	if (status == TXRX_NO_ERROR) {
+		RX_STATS.rxBlocks++;
+	}
+	#if defined COMMUNICATION_PLUG
+		if (status == TXRX_NO_ERROR) {
+			#if defined ENABLE_LOW_POWER_LISTEN
+				rxFromStone->isDozing = FALSE;							// until the block says otherwise (TXRX_CTRL_DOZE)
+				rxFromStone->lplTick = MiWi_TickGet();
+			#endif
+		}
+	#elif defined ENABLE_LOW_POWER_LISTEN
+		if (status == TXRX_NO_ERROR) {
+			lplActiveTick = MiWi_TickGet();
+			isLplDozing = FALSE;
+		}
+	#endif
+	
+	return status;
+}
+
+/******************************************************************************
+YS 30.11
+This function was written in order to prevent overflows which cause an
+arithmetic trap to occur.
+******************************************************************************/
+BYTE TxRx_ByteAdd(BYTE toAdd, BYTE addingTo) {
+
+	if (toAdd >= 0xFF - addingTo) {
+		return 0xFF;	// YL toAdd is 0xFF max, and then addingTo is 0, so there is no need to split to different cases; does the code reflect the original intention?
+	}
+	return addingTo + toAdd;
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_RttSample(TXRX_LINK_STATS *stats, MIWI_TICK sentTick)
+* Description:
+*		Adds the round trip of a block that was sent at sentTick and acked now
+*		to the moving average of the link (1/TXRX_RTT_WEIGHT of the new sample).
+*******************************************************************************/
+void TxRx_RttSample(TXRX_LINK_STATS *stats, MIWI_TICK sentTick) {
+
+	DWORD sample = MiWi_TickGetDiff(MiWi_TickGet(), sentTick) / ONE_MILI_SECOND;
+	
+	if (sample > 0xFFFF) {
+		sample = 0xFFFF;
+	}
+	if (sample == 0) {
+		sample = 1;												// 0 stands for no sample
+	}
+	if (stats->rttAverage == 0) {
+		stats->rttAverage = sample;
+	}
+	else {
+		stats->rttAverage = ((DWORD)stats->rttAverage * (TXRX_RTT_WEIGHT - 1) + sample) / TXRX_RTT_WEIGHT;
+	}
+}
+
+#if defined ENABLE_TXRX_SECURITY
+/******************************************************************************
+* Function:
+*		BOOL TxRx_SecLoadKey(void)
+* Description:
+*		Reads the network key from the EEPROM (SEC_KEY_ADDRESS), where "txrx 
+*		key" provisioned it. 
+* Return value: 
+*		FALSE if no key was provisioned (an erased EEPROM) - nothing is sealed
+*		or opened then.
+*******************************************************************************/
+BOOL TxRx_SecLoadKey(void) {
+
+	BYTE i;
+	
+	isSecKeyLoaded = FALSE;
+	if (eeprom_read_block(SEC_KEY_ADDRESS, secKey, KEY_SIZE)) {
+		return FALSE;
+	}
+	for (i = 0; i < KEY_SIZE; i++) {
+		if (secKey[i] != 0xFF) {
+			isSecKeyLoaded = TRUE;
+		}
+	}
+	return isSecKeyLoaded;
+}
+
+/******************************************************************************
+* Function:
+*		int TxRx_SecSetKey(char *hex)
+* Description:
+*		"txrx key <32 hex digits>": writes the network key to the EEPROM, and
+*		takes it at once. A stone takes it only from its own USB - commands 
+*		are not sealed, so a key from the plug would have been sent in the 
+*		clear.
+* Return value: 
+*		ERR_NONE, or the error of the command
+*******************************************************************************/
+int TxRx_SecSetKey(char *hex) {
+
+	BYTE key[KEY_SIZE];
+	BYTE i;
+	BYTE digit;
+	char c;
+	
+	#if defined WISDOM_STONE
+		if (g_usb_or_wireless_print != COMM_USB) {
+			return ERR_INVALID_COMM;
+		}
+	#endif
+	if (strlen(hex) != 2 * KEY_SIZE) {
+		return ERR_INVALID_PARAM;
+	}
+	memset(key, 0, sizeof(key));
+	for (i = 0; i < 2 * KEY_SIZE; i++) {
+		c = hex[i];
+		if ((c >= 'a') && (c <= 'f')) {
+			c -= 'a' - 'A';
+		}
+		if ((c >= '0') && (c <= '9')) {
+			digit = c - '0';
+		}
+		else if ((c >= 'A') && (c <= 'F')) {
+			digit = c - 'A' + 10;
+		}
+		else {
+			return ERR_INVALID_PARAM;
+		}
+		key[i / 2] = (key[i / 2] << 4) | digit;
+	}
+	if (eeprom_write_block(SEC_KEY_ADDRESS, key, KEY_SIZE)) {
+		return ERR_EEPROM_WRITE_N_BYTES;
+	}
+	#if defined COMMUNICATION_PLUG
+		secScheduleEUI0 = 0xFF;									// the schedule of the old key
+		TxRx_SecLoadKey();
+	#elif defined WISDOM_STONE
+		TxRx_SecInit();
+	#endif
+	return (isSecKeyLoaded == TRUE) ? ERR_NONE : ERR_INVALID_PARAM;	// all 0xFF reads as an erased EEPROM
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_SecSchedule(BYTE eui0)
+* Description:
+*		Calculates secSchedule for the key of the stone eui0: the i-th half of 
+*		the key (i = 0, 1) is [eui0, KEY_SEQUENCE_NUMBER, 0, 0, 0, 0, 0, i] 
+*		encrypted by the network key (secKey, as big endian words).
+*******************************************************************************/
+void TxRx_SecSchedule(BYTE eui0) {
+
+	DWORD key[KEY_SIZE / 4];
+	BYTE i;
+	
+	for (i = 0; i < KEY_SIZE / 4; i++) {
+		key[i] = ((DWORD)secKey[4 * i] << 24) | ((DWORD)secKey[4 * i + 1] << 16) | 
+				 ((WORD)secKey[4 * i + 2] << 8) | secKey[4 * i + 3];
+	}
+	XTEA_Schedule(key, secSchedule);							// of the network key
+	for (i = 0; i < KEY_SIZE / 4; i += 2) {
+		key[i] = ((DWORD)eui0 << 24) | ((DWORD)KEY_SEQUENCE_NUMBER << 16);
+		key[i + 1] = i / 2;
+		XTEA_Encode(&key[i], secSchedule);
+	}
+	XTEA_Schedule(key, secSchedule);
+	#if defined COMMUNICATION_PLUG
+		secScheduleEUI0 = eui0;
+	#endif
+}
+
+// the nonce of a sealed block is its header, padded with zeros:
+#define TxRx_SecNonce(nonce, header)	memset(nonce, 0, CCM_NONCE_LEN); memcpy(nonce, header, TXRX_SEC_HEADER_LEN)
+
+#if defined COMMUNICATION_PLUG
+/******************************************************************************
+* Function:
+*		void TxRx_SecReplayInit(STONE_ENTRY *stone)
+* Description:
+*		Takes the replay mark of the stone from the EEPROM: the counters below
+*		it might have been accepted before a reset of the plug.
+*******************************************************************************/
+void TxRx_SecReplayInit(STONE_ENTRY *stone) {
+
+	DWORD mark;
+	
+	if (eeprom_read_block(SEC_REPLAY_ADDRESS + 4 * (WORD)stone->eui0, (BYTE *)&mark, sizeof(mark))) {
+		mark = TXRX_SEC_COUNTER_MAX + TXRX_SEC_COUNTER_INTERVAL;	// unknown - nothing is accepted
+	}
+	else if (mark == 0xFFFFFFFF) {								// an erased EEPROM
+		mark = 0;
+	}
+	stone->secCounter = mark;
+	stone->secCounterLimit = mark;
+}
+
+/******************************************************************************
+* Function:
+*		BOOL TxRx_OpenBlock(void)
+* Description:
+*		Decrypts the data block of rxFromStone in rxBlock (in place, so the data
+*		is at TXRX_DATA_OFFSET) and checks that it is authentic and not a replay.
+*		An accepted counter at the replay mark moves the mark in the EEPROM 
+*		TXRX_SEC_COUNTER_INTERVAL up.
+* Return value: 
+*		FALSE - the block should be dropped (counted as an auth error, unless 
+*		the mark could not be written).
+*******************************************************************************/
+BOOL TxRx_OpenBlock(void) {
+
+	BYTE *block = rxBlock->blockBuffer;
+	BYTE nonce[CCM_NONCE_LEN];
+	DWORD counter = ((DWORD)block[2] << 24) | ((DWORD)block[3] << 16) | ((WORD)block[4] << 8) | block[5];
+	DWORD limit;
+	
+	if ((isSecKeyLoaded == FALSE) || (block[0] != KEY_SEQUENCE_NUMBER) || (block[1] != 0) || (counter < rxFromStone->secCounter)) {
+		rxFromStone->stats.rxAuthErrors++;
+		return FALSE;
+	}
+	if (secScheduleEUI0 != rxFromStone->eui0) {
+		TxRx_SecSchedule(rxFromStone->eui0);
+	}
+	TxRx_SecNonce(nonce, block);
+	if (CCM_OpenBlock(&block[TXRX_SEC_HEADER_LEN], MAX_BLOCK_SIZE + CCM_BLOCK_MIC_LEN, nonce, secSchedule) == FALSE) {
+		rxFromStone->stats.rxAuthErrors++;						// data blocks are handled as MAX_BLOCK_SIZE bytes
+		return FALSE;
+	}
+	if (counter >= rxFromStone->secCounterLimit) {				// only authentic blocks wear the EEPROM
+		limit = counter + TXRX_SEC_COUNTER_INTERVAL;
+		if (eeprom_write_block(SEC_REPLAY_ADDRESS + 4 * (WORD)rxFromStone->eui0, (BYTE *)&limit, sizeof(limit))) {
+			return FALSE;										// it could be replayed after a reset
+		}
+		rxFromStone->secCounterLimit = limit;
+	}
+	rxFromStone->secCounter = counter + 1;
+	return TRUE;
+}
+
+#elif defined WISDOM_STONE
+/******************************************************************************
+* Function:
+*		void TxRx_SecInit(void)
+* Description:
+*		Calculates the key of the stone, and takes the block counter from the 
+*		EEPROM (the first counter that was not reserved before the reset).
+*******************************************************************************/
+void TxRx_SecInit(void) {
+
+	if (TxRx_SecLoadKey() == FALSE) {
+		secCounter = TXRX_SEC_COUNTER_MAX + 1;					// no key was provisioned - nothing is sealed
+		return;
+	}
+	TxRx_SecSchedule(myLongAddress[0]);
+	if (eeprom_read_block(SEC_COUNTER_ADDRESS, (BYTE *)&secCounter, sizeof(secCounter))) {
+		secCounter = TXRX_SEC_COUNTER_MAX + 1;					// a counter might be reused - nothing is sealed
+	}
+	else if (secCounter == 0xFFFFFFFF) {						// an erased EEPROM
+		secCounter = 0;
+	}
+	secCounterLimit = secCounter;								// the first block reserves an interval
+}
+
+/******************************************************************************
+* Function:
+*		WORD TxRx_SealBlock(BYTE *dest, BYTE *block, WORD blockLen)
+* Description:
+*		Writes the sealed block into dest (TXRX_SEC_OVERHEAD more than blockLen).
+* Return value: 
+*		The length of the sealed block, 
+*		0 - the counter could not be reserved (or it is exhausted, or there is
+*		no key).
+*******************************************************************************/
+WORD TxRx_SealBlock(BYTE *dest, BYTE *block, WORD blockLen) {
+
+	BYTE nonce[CCM_NONCE_LEN];
+	DWORD limit;
+	
+	if (secCounter > TXRX_SEC_COUNTER_MAX) {
+		return 0;
+	}
+	if (secCounter >= secCounterLimit) {
+		limit = secCounter + TXRX_SEC_COUNTER_INTERVAL;
+		if (eeprom_write_block(SEC_COUNTER_ADDRESS, (BYTE *)&limit, sizeof(limit))) {
+			return 0;
+		}
+		secCounterLimit = limit;
+	}
+	dest[0] = KEY_SEQUENCE_NUMBER;
+	dest[1] = 0;
+	dest[2] = (BYTE)(secCounter >> 24);
+	dest[3] = (BYTE)(secCounter >> 16);
+	dest[4] = (BYTE)(secCounter >> 8);
+	dest[5] = (BYTE)secCounter;
+	secCounter++;
+	TxRx_SecNonce(nonce, dest);
+	return TXRX_SEC_HEADER_LEN + CCM_SealBlock(&dest[TXRX_SEC_HEADER_LEN], block, blockLen, nonce, secSchedule);
+}
+#endif
+#endif // ENABLE_TXRX_SECURITY
+
+#if defined ENABLE_TXRX_ACK // YL 25.12 added #ifdef
+/******************************************************************************
+YS 22.12
+This function resets the ACK sequencers.
+******************************************************************************/
+void TxRx_Reset_ACK_Sequencers() { // YS 22.12
+	
+	txBlock.blockHeader.ackSeq = 1; 
+	#if defined WISDOM_STONE
+		blockAckInfo.txLastSeq = 0;
+		blockAckInfo.txExpectedSeq = 1;
+		blockAckInfo.rxLastSeq = 0;
+		blockAckInfo.rxExpectedSeq = 1;
+		#if defined ENABLE_CUMULATIVE_ACK
+			txWindowCount = 0;
+			txWindowSent = 0;
+			isWindowSending = FALSE;
+		#endif
+	#elif defined COMMUNICATION_PLUG
+	BYTE i;
+	for (i = 0; i < stoneCount; i++) {
+		stoneTable[i].ackInfo.txLastSeq = 0;
+		stoneTable[i].ackInfo.txExpectedSeq = 1;
+		stoneTable[i].ackInfo.rxLastSeq = 0;
+		stoneTable[i].ackInfo.rxExpectedSeq = 1;
+		#if defined ENABLE_CUMULATIVE_ACK
+			stoneTable[i].ackPending = 0;
+		#endif
+	}
+	#endif
+}
+#endif // ENABLE_TXRX_ACK
+
+#if defined ENABLE_CUMULATIVE_ACK
+#if defined WISDOM_STONE
+/******************************************************************************
+* Function:
+*		TXRX_ERRORS TxRx_WindowSend(BYTE *block, WORD blockLen)
+* Description:
+*		Sends a data block without waiting for its ack: waits only for room in 
+*		the window, and keeps a copy of the block until it is acked. A block 
+*		that the MAC could not deliver is sent again with the window.
+* Return value:
+*		TXRX_UNABLE_SEND_PACKET if the blocks in the window were not acked in 
+*		TIMEOUT_RESENDING_PACKET - they are lost, as a block that could not be
+*		sent without the window (the block itself is sent).
+*******************************************************************************/
+TXRX_ERRORS TxRx_WindowSend(BYTE *block, WORD blockLen) {
+
+	TX_WINDOW_ENTRY *entry;
+	TXRX_ERRORS status;
+	
+	TxRx_WindowReceive();										// take the acks that already arrived
+	status = TxRx_WindowWait(TXRX_ACK_WINDOW - 1);
+	if (blockLen > MAX_BLOCK_SIZE) {
+		blockLen = MAX_BLOCK_SIZE;
+	}
+	entry = &txWindow[(txWindowFirst + txWindowCount) % TXRX_ACK_WINDOW];
+	#if defined ENABLE_TXRX_SECURITY
+		entry->blockLen = TxRx_SealBlock(entry->block, block, blockLen);
+		if (entry->blockLen == 0) {								// no counter left - the block is not sent
+			return TXRX_UNABLE_SEND_PACKET;
+		}
+	#else
+		memcpy(entry->block, block, blockLen);
+		entry->blockLen = blockLen;
+	#endif
+	if (txWindowCount++ == 0) {
+		txWindowTick = MiWi_TickGet();
+	}
+	TxRx_WindowSendPending();
+	return status;
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_WindowSendPending(void)
+* Description:
+*		Sends the blocks of the window that were not sent yet, while they fit
+*		in the upload slot. The stone does not wait for the slot - the rest 
+*		are sent from TxRx_WindowTasks when it comes.
+*******************************************************************************/
+void TxRx_WindowSendPending(void) {
+
+	isWindowSending = TRUE;
+	while (txWindowSent < txWindowCount) {
+		#if defined ENABLE_TDMA_UPLOAD
+			if (TxRx_UploadSlotOpen() == FALSE) {
+				txWindowTick = MiWi_TickGet();					// the wait for the slot is not part of TIMEOUT_RESENDING_PACKET
+				break;
+			}
+		#endif
+		if (TxRx_WindowSendBlock(txWindowSent++) != TXRX_NO_ERROR) {	// the next blocks would fail as well
+			break;
+		}
+	}
+	isWindowSending = FALSE;
+}
+
+/******************************************************************************
+* Function:
+*		TXRX_ERRORS TxRx_WindowSendBlock(BYTE k)
+* Description:
+*		Sends the k-th block of the window (TxRx_WindowSendPending checked 
+*		that it fits in the upload slot).
+*******************************************************************************/
+TXRX_ERRORS TxRx_WindowSendBlock(BYTE k) {
+
+	TX_WINDOW_ENTRY *entry;
+	TXRX_ERRORS status;
+	
+	#if defined ENABLE_LINK_RATE_ADAPTATION
+		if (TxRx_InUploadSlot() == TRUE) {
+			linkSlotBlocks++;
+		}
+		TxRx_LinkRateSchedule();
+	#endif
+	entry = &txWindow[(txWindowFirst + k) % TXRX_ACK_WINDOW];
+	txBlock.blockHeader.blockType = TXRX_TYPE_DATA;
+	txBlock.blockHeader.ackSeq = (blockAckInfo.txLastSeq + 1 + k) % MAX_ACK_LENGTH;
+	txBlock.blockHeader.piggyAck = 0;
+	TxRx_FillTxBlock(entry->block, entry->blockLen);
+	entry->sentTick = MiWi_TickGet();
+	status = TxRx_TransmitBuffer();
+	txResendTick = MiWi_TickGet();
+	return status;
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_WindowResend(void)
+* Description:
+*		Sends all the blocks in the window again (the ack did not come) - those
+*		that do not fit in the upload slot wait for it.
+*******************************************************************************/
+void TxRx_WindowResend(void) {
+
+	txWindowSent = 0;
+	TxRx_WindowSendPending();
+}
+
+/******************************************************************************
+* Function:
+*		TXRX_ERRORS TxRx_WindowWait(BYTE limit)
+* Description:
+*		Waits until at most limit blocks in the window are not acked, and sends
+*		the window again after each TXRX_ACK_TIMEOUT without an ack. 
+* Return value:
+*		TXRX_UNABLE_SEND_PACKET if no ack came in TIMEOUT_RESENDING_PACKET - 
+*		the window is emptied (the blocks are lost).
+*******************************************************************************/
+TXRX_ERRORS TxRx_WindowWait(BYTE limit) {
+
+	MIWI_TICK now;
+	
+	while (txWindowCount > limit) {
+		TxRx_WindowReceive();
+		if (txWindowCount <= limit) {
+			break;
+		}
+		now = MiWi_TickGet();
+		if (MiWi_TickGetDiff(now, txWindowTick) > TIMEOUT_RESENDING_PACKET) {
+			#if defined ENABLE_LINK_RATE_ADAPTATION
+				if (TxRx_LinkRateFallback() == TRUE) {			// the plug may have already returned to the base rate - try again there
+					txWindowTick = now;
+					TxRx_WindowResend();
+					continue;
+				}
+			#endif
+			linkStats.txFailures += txWindowCount;
+			txWindowCount = 0;
+			txWindowSent = 0;
+			return TXRX_UNABLE_SEND_PACKET;
+		}
+		if (txWindowSent < txWindowCount) {
+			TxRx_WindowSendPending();
+		}
+		else if (MiWi_TickGetDiff(now, txResendTick) > TXRX_ACK_TIMEOUT) {
+			TxRx_WindowResend();
+		}
+	}
+	return TXRX_NO_ERROR;
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_WindowReceive(void)
+* Description:
+*		Receives the available packet while the stone sends data blocks: an ack
+*		releases blocks of the window (in TxRx_ReceivePacketHeader), and a 
+*		command (e.g. "app stop") is acked and passed to the application, as 
+*		TxRx_SendPacket does while it waits for an ack.
+*******************************************************************************/
+void TxRx_WindowReceive(void) {
+
+	if ((MiApp_MessageAvailable() == FALSE) || (TxRx_ConsumeBroadcast() == TRUE)) {
+		return;
+	}
+	if (TxRx_ReceivePacket() != TXRX_NO_ERROR) {
+		return;
+	}
+	if (rxBlock->blockHeader.blockType == TXRX_TYPE_ACK) {
+		return;
+	}
+	if ((TxRx_WistoneHandler() == TXRX_NO_ERROR) && (rxBlock->blockHeader.blockType == TXRX_TYPE_COMMAND)) {
+		g_is_cmd_received = 1;									// inform the upper level
+	}
+}
+
+/******************************************************************************
+* Function:
+*		BOOL TxRx_WindowAck(BYTE ackSeq)
+* Description:
+*		Releases the blocks of the window up to ackSeq (a cumulative ack).
+* Return value:
+*		FALSE if ackSeq is not the sequence of a block in the window.
+*******************************************************************************/
+BOOL TxRx_WindowAck(BYTE ackSeq) {
+
+	BYTE acked = (ackSeq + MAX_ACK_LENGTH - blockAckInfo.txLastSeq) % MAX_ACK_LENGTH;	// the blocks that the ack releases
+	
+	if ((acked == 0) || (acked > txWindowCount)) {
+		return FALSE;
+	}
+	linkStats.txBlocks += acked;
+	TxRx_RttSample(&linkStats, txWindow[(txWindowFirst + acked - 1) % TXRX_ACK_WINDOW].sentTick);	// the last block that the ack releases
+	txWindowFirst = (txWindowFirst + acked) % TXRX_ACK_WINDOW;
+	txWindowCount -= acked;
+	txWindowSent = (txWindowSent > acked) ? (txWindowSent - acked) : 0;
+	blockAckInfo.txLastSeq = ackSeq;
+	txWindowTick = MiWi_TickGet();
+	return TRUE;
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_WindowTasks(void)
+* Description:
+*		Sends the blocks that waited for the upload slot, sends the window 
+*		again when its ack did not come (e.g. after the last block of the 
+*		recording), and empties it after TIMEOUT_RESENDING_PACKET. 
+*******************************************************************************/
+void TxRx_WindowTasks(void) {
+
+	MIWI_TICK now = MiWi_TickGet();
+	
+	if ((txWindowCount == 0) || (isWindowSending == TRUE)) {
+		return;
+	}
+	if (MiWi_TickGetDiff(now, txWindowTick) > TIMEOUT_RESENDING_PACKET) {
+		linkStats.txFailures += txWindowCount;
+		txWindowCount = 0;
+		txWindowSent = 0;
+		TxRx_PrintError(TXRX_UNABLE_SEND_PACKET);
+	}
+	else if (txWindowSent < txWindowCount) {
+		TxRx_WindowSendPending();
+	}
+	else if (MiWi_TickGetDiff(now, txResendTick) > TXRX_ACK_TIMEOUT) {
+		TxRx_WindowResend();
+	}
+}
+
+#elif defined COMMUNICATION_PLUG
+/******************************************************************************
+* Function:
+*		void TxRx_AckTasks(void)
+* Description:
+*		Acks the data blocks of a stone that were not acked TXRX_ACK_DELAY after 
+*		the first of them (the stream stopped before TXRX_ACK_EVERY blocks, and
+*		no block was sent to the stone meanwhile). 
+*******************************************************************************/
+void TxRx_AckTasks(void) {
+
+	MIWI_TICK now = MiWi_TickGet();
+	BYTE i;
+	
+	for (i = 0; i < stoneCount; i++) {
+		if ((stoneTable[i].ackPending > 0) && (MiWi_TickGetDiff(now, stoneTable[i].ackTick) > TXRX_ACK_DELAY)) {
+			rxFromStone = &stoneTable[i];
+			rxFromStone->ackInfo.rxExpectedSeq = rxFromStone->ackInfo.rxLastSeq;
+			finalDestinationNwkAddress[0] = rxFromStone->eui0;
+			finalDestinationNwkAddress[1] = EUI_1;
+			TxRx_SendAck();
+			rxFromStone->ackPending = 0;						// if the ack is lost, the stone sends the window again, and the repeated block is acked at once
+		}
+	}
+}
+#endif // WISDOM_STONE
+#endif // ENABLE_CUMULATIVE_ACK
+
+/******************************************************************************
+* Function:
+* 		int TxRx_PrintError(TXRX_ERRORS error)
+******************************************************************************/
+int TxRx_PrintError(TXRX_ERRORS error) {
+	
+	#if defined COMMUNICATION_PLUG		
+		m_write(TxRx_err_messages[error]);
+	#endif // COMMUNICATION_PLUG
+
+	write_eol();
+	return (-1);
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_CountRxFrame(void)
+* Description:
+*		Counts the available message in the statistics of its source, with 
+*		the RSSI and DQD bits that the MRF49XA reported for it.
+*******************************************************************************/
+void TxRx_CountRxFrame(void) {
+
+	#if defined COMMUNICATION_PLUG
+		if (rxFromStone == NULL) {
+			return;
+		}
+	#endif
+	RX_STATS.rxFrames++;
+	if (rxMessage.PacketRSSI != 0) {
+		RX_STATS.rxRssiHigh++;
+	}
+	if (rxMessage.PacketLQI != 0) {
+		RX_STATS.rxDqd++;
+	}
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_AppendStat(char *line, WORD value)
+* Description:
+*		Appends a field of a statistics record (see "txrx stats" in TxRx.h).
+*******************************************************************************/
+static void TxRx_AppendStat(char *line, WORD value) {
+
+	strcat(line, ",");
+	strcat(line, long_to_str((long)value));						// the counters are unsigned
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_PrintLinkStats(BYTE eui0, TXRX_LINK_STATS *stats)
+* Description:
+*		Prints the LINK record of the neighbour eui0.
+*******************************************************************************/
+void TxRx_PrintLinkStats(BYTE eui0, TXRX_LINK_STATS *stats) {
+
+	char data_to_print[100];
+	
+	strcpy(data_to_print, "LINK");
+	TxRx_AppendStat(data_to_print, myLongAddress[0]);
+	TxRx_AppendStat(data_to_print, eui0);
+	TxRx_AppendStat(data_to_print, stats->txBlocks);
+	TxRx_AppendStat(data_to_print, stats->txFailures);
+	TxRx_AppendStat(data_to_print, stats->macRetries);
+	TxRx_AppendStat(data_to_print, stats->rxFrames);
+	TxRx_AppendStat(data_to_print, stats->rxRssiHigh);
+	TxRx_AppendStat(data_to_print, stats->rxDqd);
+	TxRx_AppendStat(data_to_print, stats->rxBlocks);
+	TxRx_AppendStat(data_to_print, stats->rxTrailerErrors);
+	TxRx_AppendStat(data_to_print, stats->rxSeqErrors);
+	TxRx_AppendStat(data_to_print, stats->rttAverage);
+	TxRx_AppendStat(data_to_print, stats->rxAuthErrors);
+	strcat(data_to_print, "\r\n");
+	m_write(data_to_print);
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_PrintMacStats(void)
+* Description:
+*		Prints the MAC record (MACLinkStats) - the MAC drops a frame with a bad 
+*		CRC before its source is known, so these counters are not per neighbour.
+*******************************************************************************/
+void TxRx_PrintMacStats(void) {
+
+	char data_to_print[100];
+	
+	strcpy(data_to_print, "MAC");
+	TxRx_AppendStat(data_to_print, myLongAddress[0]);
+	TxRx_AppendStat(data_to_print, MACLinkStats.txFrames);
+	TxRx_AppendStat(data_to_print, MACLinkStats.txRetries);
+	TxRx_AppendStat(data_to_print, MACLinkStats.txFailures);
+	TxRx_AppendStat(data_to_print, MACLinkStats.rxFrames);
+	TxRx_AppendStat(data_to_print, MACLinkStats.rxCrcErrors);
+	TxRx_AppendStat(data_to_print, MACLinkStats.rxDqdLost);
+	TxRx_AppendStat(data_to_print, MACLinkStats.rxRssiHigh);
+	TxRx_AppendStat(data_to_print, MACLinkStats.rxPoolFull);
+	TxRx_AppendStat(data_to_print, MACLinkStats.rxBadLength);
+	TxRx_AppendStat(data_to_print, MACLinkStats.rxTimeouts);
+	TxRx_AppendStat(data_to_print, MACLinkStats.rxNotForMe);
+	TxRx_AppendStat(data_to_print, MACLinkStats.rxDuplicates);
+	strcat(data_to_print, "\r\n");
+	m_write(data_to_print);
+}
+
+/******************************************************************************
+* Function:
+*		int handle_txrx(int sub_cmd)
+* Description:
+*		"txrx stats": the plug prints a LINK record for each stone it knows,
+*		the stone prints the LINK record of the plug; both end with the MAC 
+*		record. "txrx key <32 hex digits>" provisions the network key of the
+*		block security.
+*******************************************************************************/
+int handle_txrx(int sub_cmd) {
+
+	#if defined COMMUNICATION_PLUG
+	BYTE i;
+	#endif
+	#if defined ENABLE_TXRX_SECURITY
+	int res;
+	#endif
+	
+	switch (sub_cmd) {
+		case SUB_CMD_STATS:
+			#if defined COMMUNICATION_PLUG
+				for (i = 0; i < stoneCount; i++) {
+					if (stoneTable[i].eui0 != PLUG_NWK_ADDR_EUI0) {
+						TxRx_PrintLinkStats(stoneTable[i].eui0, &stoneTable[i].stats);
+					}
+				}
+			#elif defined WISDOM_STONE
+				TxRx_PrintLinkStats(PLUG_NWK_ADDR_EUI0, &linkStats);
+			#endif
+			#if defined ENABLE_CHANNEL_MAP
+				TxRx_PrintChannelMap();
+			#endif
+			TxRx_PrintMacStats();
+			break;
+		#if defined ENABLE_TXRX_SECURITY
+		case SUB_CMD_KEY:
+			if (g_ntokens < 3) {
+				return cmd_error(ERR_INVALID_PARAM_COUNT);
+			}
+			res = TxRx_SecSetKey(g_tokens[2]);
+			if (res != ERR_NONE) {
+				return cmd_error(res);
+			}
+			break;
+		#endif
+		default:
+			err(ERR_UNKNOWN_SUB_CMD);
+			return cmd_error(0);
+	}
+	cmd_ok();
+	return 0;
+}
+
+/******************************************************************************
+* Function:
+*		BOOL TxRx_ConsumeBroadcast(void)
+* Description:
+*		The TxRx layer sends broadcast messages for its own use (TDMA beacons,
+*		start of the replies to a broadcast command, time sync, wake frames); 
+*		the stone takes them from the available message, and both sides 
+*		discard it. Any other message is left for the caller. A wake frame for
+*		a single stone is unicast - it is too short to be a block.
+* Return value:
+*		TRUE if the available message was a broadcast of the TxRx layer
+*******************************************************************************/
+BOOL TxRx_ConsumeBroadcast(void) {
+
+	BOOL isWake = FALSE;
+	
+	#if defined ENABLE_LOW_POWER_LISTEN
+		isWake = ((rxMessage.PayloadSize == LPL_WAKE_LENGTH) && (rxMessage.Payload[0] == LPL_WAKE_ID));
+	#endif
+	if (((rxMessage.flags.bits.broadcast == 0) && (isWake == FALSE)) || (rxMessage.PayloadSize == 0)) {
+		return FALSE;
+	}
+	switch (rxMessage.Payload[0]) {
+		#if defined ENABLE_TDMA_UPLOAD
+		case TDMA_BEACON_ID:
+			#if defined WISDOM_STONE
+				TxRx_ReceiveBeacon();
+			#endif
+			break;
+		#endif
+		case TXRX_REPLY_START_ID:
+			#if defined WISDOM_STONE
+				if (replySlots != 0) {
+					replyTick = MiWi_TickGet();
+					isReplyStarted = TRUE;
+				}
+			#endif
+			break;
+		#if defined ENABLE_TIME_SYNC
+		case TSYNC_ID:
+			#if defined WISDOM_STONE
+				TxRx_ReceiveTimeSync();
+			#endif
+			break;
+		#endif
+		#if defined ENABLE_LOW_POWER_LISTEN
+		case LPL_WAKE_ID:
+			#if defined WISDOM_STONE
+				if ((rxMessage.PayloadSize == LPL_WAKE_LENGTH) && 
+					((rxMessage.Payload[1] == myLongAddress[0]) || (rxMessage.Payload[1] == LPL_WAKE_ALL))) {
+					lplWakeRequest = TRUE;
+				}
+			#endif
+			break;
+		#endif
+		default:
+			return FALSE;								// not a broadcast of the TxRx layer
+	}
+	MiApp_DiscardMessage();
+	return TRUE;
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_HandleControl(void)
+* Description:
+*		Executes the control block in rxBlock. The block was already acked,
+*		so a rate change takes effect after the ack left at the old rate.
+*******************************************************************************/
+void TxRx_HandleControl(void) {
+
+	switch (rxBlock->blockBuffer[0]) {
+		#if defined ENABLE_LINK_RATE_ADAPTATION
+		case TXRX_CTRL_RATE:
+			TxRx_SetLinkRate(rxBlock->blockBuffer[1]);
+			break;
+		#endif
+		#if defined ENABLE_LOW_POWER_LISTEN && defined COMMUNICATION_PLUG
+		case TXRX_CTRL_DOZE:
+			rxFromStone->isDozing = TRUE;
+			break;
+		#endif
+		default:
+			break;	// unknown control - ignore
+	}
+}
+
+#if defined ENABLE_LINK_RATE_ADAPTATION
+/******************************************************************************
+* Link rate adaptation:
+* The stone owns the decision - it sends most of the traffic (data blocks), 
+* so the MAC retransmissions of its frames, and the CRC/DQD/RSSI of the acks 
+* it receives, describe its link to the plug in both directions. 
+* Every RATE_WINDOW_BLOCKS data blocks the stone evaluates the window and may 
+* send TXRX_CTRL_RATE to the plug. The plug acks it and keeps the new rate of
+* the stone; the stone keeps it when the ack arrives. 
+* The rate is used only in the upload slot of the stone (TDMA): there both 
+* sides tune to it, and everywhere else - the other slots, the contention part,
+* beacons, commands and replies - the whole network stays at BASE_LINK_RATE, so
+* the plug never goes deaf to the other stones. Only a direct link adapts: a 
+* stone whose neighbour on the way to the plug is the plug itself, and that 
+* relays for no other device (relayed frames leave at the rate of the relay).
+* The plug keys the rate of a frame on its next hop, not on its destination.
+* A stone whose slot passes without a data block, or is freed, returns to
+* BASE_LINK_RATE - the plug and the stone decide it on their own from the same
+* superframe; a failed transmission returns to BASE_LINK_RATE as well.
+*******************************************************************************/
+
+/******************************************************************************
+* Function:
+*		void TxRx_LinkRateInit(void)
+*******************************************************************************/
+void TxRx_LinkRateInit(void) {
+
+	#if defined COMMUNICATION_PLUG
+		BYTE i;
+		for (i = 0; i < stoneCount; i++) {
+			stoneTable[i].linkRate = BASE_LINK_RATE;
+		}
+	#elif defined WISDOM_STONE
+		linkRate = BASE_LINK_RATE;
+		linkSlotBlocks = 0;
+		linkWindowStart = MACLinkStats;
+		linkWindowBlocks = 0;
+		linkUpHoldoff = 0;
+	#endif
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_SetLinkRate(BYTE rate)
+* Description:
+*		Keeps the new rate of the link - of the source of the control block
+*		(plug), or of the stone itself, and starts a new evaluation window 
+*		(stone). The transceiver is tuned by TxRx_LinkRateSchedule.
+*******************************************************************************/
+void TxRx_SetLinkRate(BYTE rate) {
+
+	if (rate >= LINK_RATE_NUM) {
+		return;
+	}
+	#if defined COMMUNICATION_PLUG
+		if (rxFromStone != NULL) {
+			rxFromStone->linkRate = rate;
+		}
+	#elif defined WISDOM_STONE
+		linkRate = rate;
+		linkWindowStart = MACLinkStats;
+		linkWindowBlocks = 0;
+	#endif
+	TxRx_LinkRateSchedule();
+}
+
+/******************************************************************************
+* Function:
+*		BOOL TxRx_LinkRateFallback(void)
+* Description:
+*		Called when a transmission failed: a link that was above/below the base
+*		rate (the slot of the stone) returns to it.
+* Return value:
+*		TRUE if the link returned to the base rate (worth retrying the 
+*		transmission), FALSE if it was already there
+*******************************************************************************/
+BOOL TxRx_LinkRateFallback(void) {
+
+	if (currentLinkRate == BASE_LINK_RATE) {
+		return FALSE;
+	}
+	#if defined COMMUNICATION_PLUG
+		STONE_ENTRY *owner = TxRx_SlotOwner();
+		if (owner != NULL) {
+			owner->linkRate = BASE_LINK_RATE;
+		}
+	#elif defined WISDOM_STONE
+		linkRate = BASE_LINK_RATE;
+		linkUpHoldoff = RATE_UP_HOLDOFF;
+	#endif
+	TxRx_TuneLinkRate(BASE_LINK_RATE);
+	return TRUE;
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_TuneLinkRate(BYTE rate)
+*******************************************************************************/
+void TxRx_TuneLinkRate(BYTE rate) {
+
+	if (rate != currentLinkRate) {
+		MiMAC_SetDataRate(rate);
+	}
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_LinkRateSchedule(void)
+* Description:
+*		Tunes the transceiver to the rate of the current slot: the rate of its
+*		stone in the upload slot of a stone, BASE_LINK_RATE anywhere else.
+*******************************************************************************/
+void TxRx_LinkRateSchedule(void) {
+
+	#if defined COMMUNICATION_PLUG
+		TxRx_TuneLinkRate(TxRx_LinkRateOf(TxRx_SlotOwner()));
+	#elif defined WISDOM_STONE
+		TxRx_TuneLinkRate((TxRx_InUploadSlot() == TRUE) ? linkRate : BASE_LINK_RATE);
+	#endif
+}
+
+#if defined COMMUNICATION_PLUG
+/******************************************************************************
+* Function:
+*		BYTE TxRx_LinkRateOf(STONE_ENTRY *stone)
+* Return value:
+*		The rate of the link to the neighbour stone now - its own rate in its
+*		upload slot, BASE_LINK_RATE anywhere else (or for NULL)
+*******************************************************************************/
+BYTE TxRx_LinkRateOf(STONE_ENTRY *stone) {
+
+	if ((stone == NULL) || (stone != TxRx_SlotOwner())) {
+		return BASE_LINK_RATE;
+	}
+	return stone->linkRate;
+}
+
+/******************************************************************************
+* Function:
+*		STONE_ENTRY* TxRx_NextHop(STONE_ENTRY *stone)
+* Description:
+*		Follows the parents of the stone up to the plug: the next hop is the
+*		child of the plug on the way down, or else the parent of the plug.
+* Return value:
+*		The entry of the neighbour the frame to the stone leaves to, or NULL 
+*		if it is unknown
+*******************************************************************************/
+STONE_ENTRY* TxRx_NextHop(STONE_ENTRY *stone) {
+
+	STONE_ENTRY *hop = stone;
+	BYTE plugParent = (myParent < CONNECTION_SIZE) ? ConnectionTable[myParent].Address[0] : 0xFF;
+	BYTE i;
+	
+	if (stone == NULL) {
+		return NULL;
+	}
+	if (stone->eui0 == plugParent) {
+		return stone;
+	}
+	for (i = 0; (hop != NULL) && (i < stoneCount); i++) {		// bounded - the parents may be stale
+		if (hop->parentEUI0 == myLongAddress[0]) {
+			return hop;
+		}
+		hop = TxRx_GetStone(hop->parentEUI0);
+	}
+	return TxRx_GetStone(plugParent);
+}
+#endif // COMMUNICATION_PLUG
+
+#if defined WISDOM_STONE
+/******************************************************************************
+* Function:
+*		void TxRx_LinkRateAdapt(void)
+* Description:
+*		Evaluates the MAC statistics of the last window, and asks the plug 
+*		to step the rate one LINK_RATE up or down if needed.
+*******************************************************************************/
+void TxRx_LinkRateAdapt(void) {
+
+	WORD txFrames  = MACLinkStats.txFrames - linkWindowStart.txFrames;
+	WORD txRetries = MACLinkStats.txRetries - linkWindowStart.txRetries;
+	WORD txFailures = MACLinkStats.txFailures - linkWindowStart.txFailures;
+	WORD rxFrames  = MACLinkStats.rxFrames - linkWindowStart.rxFrames;
+	WORD rxErrors  = (MACLinkStats.rxCrcErrors - linkWindowStart.rxCrcErrors) + 
+					 (MACLinkStats.rxDqdLost - linkWindowStart.rxDqdLost);
+	WORD rxRssiHigh = MACLinkStats.rxRssiHigh - linkWindowStart.rxRssiHigh;
+	BYTE rate = linkRate;
+	BYTE ctrl[2];
+	
+	linkWindowStart = MACLinkStats;
+	linkWindowBlocks = 0;
+	
+	if (TxRx_IsDirectLink() == FALSE) {
+		return;									// the link stays at the base rate
+	}
+	if ((txFailures > 0) ||
+		((DWORD)txRetries * 100 > (DWORD)txFrames * RATE_DOWN_RETRY_PERCENT) ||
+		((DWORD)rxErrors * 100 > (DWORD)(rxFrames + rxErrors) * RATE_DOWN_RX_ERR_PERCENT)) {
+		linkUpHoldoff = RATE_UP_HOLDOFF;
+		if (rate > LINK_RATE_9600) {
+			rate--;
+		}
+	}
+	else if (linkUpHoldoff > 0) {
+		linkUpHoldoff--;
+	}
+	else if (((DWORD)txRetries * 100 <= (DWORD)txFrames * RATE_UP_RETRY_PERCENT) &&
+			 ((DWORD)rxRssiHigh * 100 >= (DWORD)rxFrames * RATE_UP_RSSI_PERCENT) &&
+			 (rxFrames > 0)) {
+		if (rate < TXRX_MAX_LINK_RATE) {
+			rate++;
+		}
+	}
+	if (rate == linkRate) {
+		return;
+	}
+	// propose the new rate at the current rate; re-tune only when the plug acked it:
+	ctrl[0] = TXRX_CTRL_RATE;
+	ctrl[1] = rate;
+	if (TxRx_SendPacket(ctrl, sizeof(ctrl), TXRX_TYPE_CONTROL) == TXRX_NO_ERROR) {
+		TxRx_SetLinkRate(rate);
+	}
+}
+
+/******************************************************************************
+* Function:
+*		BOOL TxRx_IsDirectLink(void)
+* Return value:
+*		TRUE if the plug is the parent or the child of the stone, and the stone
+*		has no other child to relay for
+*******************************************************************************/
+BOOL TxRx_IsDirectLink(void) {
+
+	BOOL isPlugNeighbour = (parentDeviceEUI0 == PLUG_NWK_ADDR_EUI0);
+	BYTE i;
+	
+	for (i = 0; i < CONNECTION_SIZE; i++) {
+		if ((ConnectionTable[i].status.bits.isValid) && (ConnectionTable[i].status.bits.isFamily) && (i != myParent)) {
+			if (ConnectionTable[i].Address[0] != PLUG_NWK_ADDR_EUI0) {
+				return FALSE;					// a child of its own
+			}
+			isPlugNeighbour = TRUE;
+		}
+	}
+	return isPlugNeighbour;
+}
+#endif // WISDOM_STONE
+#endif // ENABLE_LINK_RATE_ADAPTATION
+
+#if defined ENABLE_CHANNEL_MAP
+/******************************************************************************
+* Function:
+*		WORD TxRx_ChannelMapCRC(void)
+* Description:
+*		Returns the CRC16 of chanMap, without the crc field.
+*******************************************************************************/
+static WORD TxRx_ChannelMapCRC(void) {
+
+	BYTE	*p = (BYTE *)&chanMap;
+	WORD	crc = 0;
+	WORD	i;
+	
+	for (i = 0; i < (BYTE *)&chanMap.crc - p; i++) {
+		crc = CRC16_BYTE(crc, p[i]);
+	}
+	return crc;
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_ChannelMapInit(void)
+* Description:
+*		Reads the channel map from the EEPROM; an erased or a formatted page 
+*		gives an empty map.
+*******************************************************************************/
+void TxRx_ChannelMapInit(void) {
+
+	if (eeprom_read_block(CHANNEL_MAP_ADDRESS, (BYTE *)&chanMap, sizeof(chanMap)) || 
+		(chanMap.magic != CHMAP_MAGIC) || (chanMap.crc != TxRx_ChannelMapCRC())) {
+		memset(&chanMap, 0, sizeof(chanMap));				// the padding is a part of the CRC
+		memset(chanMap.noise, CHMAP_UNKNOWN, sizeof(chanMap.noise));
+		chanMap.magic = CHMAP_MAGIC;
+		chanMap.channel = 0xFF;
+	}
+	chanSavedPer = (chanMap.channel < CHANNEL_NUM) ? chanMap.per[chanMap.channel] : 0;
+	chanWindowStart = MACLinkStats;
+	chanSampleFrames = 0;
+	chanSampleTick = MiWi_TickGet();
+	#if defined WISDOM_STONE
+		chanHopTick = chanSampleTick;
+		chanScanNext = CHMAP_NO_SCAN;
+	#endif
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_SaveChannelMap(void)
+*******************************************************************************/
+void TxRx_SaveChannelMap(void) {
+
+	chanMap.crc = TxRx_ChannelMapCRC();
+	eeprom_write_block(CHANNEL_MAP_ADDRESS, (BYTE *)&chanMap, sizeof(chanMap));
+	if (chanMap.channel < CHANNEL_NUM) {
+		chanSavedPer = chanMap.per[chanMap.channel];
+	}
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_NoiseSample(BYTE channel, BYTE noise)
+*******************************************************************************/
+void TxRx_NoiseSample(BYTE channel, BYTE noise) {
+
+	if (chanMap.noise[channel] == CHMAP_UNKNOWN) {
+		chanMap.noise[channel] = noise;
+	}
+	else {
+		chanMap.noise[channel] = ((WORD)chanMap.noise[channel] * (CHMAP_EWMA_WEIGHT - 1) + noise + CHMAP_EWMA_WEIGHT / 2) / CHMAP_EWMA_WEIGHT;
+	}
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_ScanChannels(void)
+* Description:
+*		Measures the noise of every channel (CHMAP_SCAN_DURATION each), and 
+*		returns to the operating channel.
+*******************************************************************************/
+void TxRx_ScanChannels(void) {
+
+	BYTE channel = currentChannel;
+	BYTE noise;
+	BYTE i;
+	
+	for (i = 0; i < CHANNEL_NUM; i++) {
+		if (FULL_CHANNEL_MAP & ((DWORD)1 << i)) {
+			noise = CHMAP_UNKNOWN;
+			MiApp_NoiseDetection((DWORD)1 << i, CHMAP_SCAN_DURATION, NOISE_DETECT_ENERGY, &noise);
+			chanMap.noise[i] = noise;						// a scan replaces the average
+		}
+	}
+	MiApp_SetChannel(channel);
+}
+
+/******************************************************************************
+* Function:
+*		BYTE TxRx_BestChannel(BYTE exclude)
+* Return value:
+*		The channel of the lowest noise + CHMAP_PER_WEIGHT * PER, except for 
+*		exclude; 0xFF if its noise is unknown.
+*******************************************************************************/
+BYTE TxRx_BestChannel(BYTE exclude) {
+
+	BYTE best = 0xFF;
+	WORD bestCost = 0xFFFF;
+	WORD cost;
+	BYTE i;
+	
+	for (i = 0; i < CHANNEL_NUM; i++) {
+		if ((i == exclude) || !(FULL_CHANNEL_MAP & ((DWORD)1 << i))) {
+			continue;
+		}
+		cost = chanMap.noise[i] + (WORD)CHMAP_PER_WEIGHT * chanMap.per[i];
+		if (cost < bestCost) {
+			bestCost = cost;
+			best = i;
+		}
+	}
+	if ((best == 0xFF) || (chanMap.noise[best] == CHMAP_UNKNOWN)) {
+		return 0xFF;
+	}
+	return best;
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_ChannelTasks(void)
+* Description:
+*		Follows the operating channel of the network, samples its noise when 
+*		the link is quiet, and its PER every CHMAP_PER_FRAMES frames; the 
+*		network starter moves the network when the PER is too high, after a
+*		scan of one channel per call (TxRx_ScanStep).
+*******************************************************************************/
+void TxRx_ChannelTasks(void) {
+
+	MIWI_TICK now = MiWi_TickGet();
+	WORD frames = MACLinkStats.txFrames + MACLinkStats.txRetries + MACLinkStats.rxFrames + MACLinkStats.rxCrcErrors;
+	WORD attempts;
+	WORD errors;
+	BYTE per;
+	
+	if (!MiWiStateMachine.bits.memberOfNetwork) {
+		return;
+	}
+	if (chanMap.channel != currentChannel) {				// a new network, or it moved (CHANNEL_HOPPING_REQUEST)
+		chanMap.channel = currentChannel;
+		chanWindowStart = MACLinkStats;
+		TxRx_SaveChannelMap();
+		#if defined ENABLE_FAST_REJOIN && defined WISDOM_STONE
+			TxRx_SaveNetwork();
+		#endif
+		return;
+	}
+	#if defined WISDOM_STONE
+		if ((chanScanNext != CHMAP_NO_SCAN) && TxRx_ScanStep()) {
+			TxRx_ChangeChannel();
+		}
+	#endif
+	if (MiWi_TickGetDiff(now, chanSampleTick) > CHMAP_SAMPLE_PERIOD) {
+		if (frames == chanSampleFrames) {
+			TxRx_NoiseSample(currentChannel, MiMAC_ChannelAssessment(CHANNEL_ASSESSMENT_ENERGY_DETECT));
+		}
+		chanSampleFrames = frames;
+		chanSampleTick = now;
+	}
+	
+	attempts = (MACLinkStats.txFrames - chanWindowStart.txFrames) + (MACLinkStats.txRetries - chanWindowStart.txRetries) + 
+			   (MACLinkStats.rxFrames - chanWindowStart.rxFrames) + (MACLinkStats.rxCrcErrors - chanWindowStart.rxCrcErrors);
+	if (attempts < CHMAP_PER_FRAMES) {
+		return;
+	}
+	errors = (MACLinkStats.txRetries - chanWindowStart.txRetries) + (MACLinkStats.txFailures - chanWindowStart.txFailures) + 
+			 (MACLinkStats.rxCrcErrors - chanWindowStart.rxCrcErrors);
+	chanWindowStart = MACLinkStats;
+	per = (errors >= attempts) ? 100 : (BYTE)((DWORD)errors * 100 / attempts);
+	chanMap.per[currentChannel] = ((WORD)chanMap.per[currentChannel] * (CHMAP_EWMA_WEIGHT - 1) + per + CHMAP_EWMA_WEIGHT / 2) / CHMAP_EWMA_WEIGHT;
+	if ((chanMap.per[currentChannel] >= chanSavedPer + CHMAP_SAVE_PER_STEP) || 
+		(chanMap.per[currentChannel] + CHMAP_SAVE_PER_STEP <= chanSavedPer)) {
+		TxRx_SaveChannelMap();
+	}
+	#if defined WISDOM_STONE
+		if ((myLongAddress[0] == NWK_STARTER_ADDR_EUI0) && (chanMap.per[currentChannel] >= CHMAP_AGILITY_PER) &&
+			(MiWi_TickGetDiff(now, chanHopTick) > CHMAP_AGILITY_HOLDOFF) && (chanScanNext == CHMAP_NO_SCAN)) {
+			chanHopTick = now;
+			chanScanNext = 0;								// the scan starts in the next call
+		}
+	#endif
+}
+
+#if defined WISDOM_STONE
+/******************************************************************************
+* Function:
+*		BYTE TxRx_StartChannel(void)
+* Description:
+*		Selects the channel of the network starter: the best known channel if 
+*		it is not noisier now than known, otherwise the best after a scan.
+*******************************************************************************/
+BYTE TxRx_StartChannel(void) {
+
+	BYTE channel = TxRx_BestChannel(0xFF);
+	BYTE noise = CHMAP_UNKNOWN;
+	
+	chanHopTick = MiWi_TickGet();
+	if (channel != 0xFF) {
+		MiApp_NoiseDetection((DWORD)1 << channel, CHMAP_CHECK_DURATION, NOISE_DETECT_ENERGY, &noise);
+		if ((WORD)noise <= (WORD)chanMap.noise[channel] + CHMAP_NOISE_MARGIN) {
+			TxRx_NoiseSample(channel, noise);
+			return channel;
+		}
+	}
+	TxRx_ScanChannels();
+	channel = TxRx_BestChannel(0xFF);
+	return (channel == 0xFF) ? currentChannel : channel;
+}
+
+/******************************************************************************
+* Function:
+*		BOOL TxRx_ScanStep(void)
+* Description:
+*		Measures the noise of the next channel of the agility scan (chanScanNext,
+*		CHMAP_STEP_DURATION), and returns to the operating channel - so the 
+*		stone is away from the network for one short window per call.
+* Return value: 
+*		TRUE - the scan is complete.
+*******************************************************************************/
+BOOL TxRx_ScanStep(void) {
+
+	BYTE channel = currentChannel;
+	BYTE noise;
+	
+	while ((chanScanNext < CHANNEL_NUM) && !(FULL_CHANNEL_MAP & ((DWORD)1 << chanScanNext))) {
+		chanScanNext++;
+	}
+	if (chanScanNext >= CHANNEL_NUM) {
+		chanScanNext = CHMAP_NO_SCAN;
+		return TRUE;
+	}
+	noise = CHMAP_UNKNOWN;
+	MiApp_ConnectionMode(DISABLE_ALL_CONN);
+	MiApp_NoiseDetection((DWORD)1 << chanScanNext, CHMAP_STEP_DURATION, NOISE_DETECT_ENERGY, &noise);
+	MiApp_SetChannel(channel);
+	MiApp_ConnectionMode(ENABLE_ALL_CONN);
+	chanMap.noise[chanScanNext++] = noise;					// a scan replaces the average
+	return FALSE;
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_ChangeChannel(void)
+* Description:
+*		After the agility scan, moves the network to the best channel if it is 
+*		better than the operating channel (TxRx_ChannelTasks saves the new
+*		channel).
+*******************************************************************************/
+void TxRx_ChangeChannel(void) {
+
+	BYTE channel;
+	
+	chanHopTick = MiWi_TickGet();
+	channel = TxRx_BestChannel(currentChannel);
+	if ((channel == 0xFF) || 
+		(chanMap.noise[channel] + (WORD)CHMAP_PER_WEIGHT * chanMap.per[channel] >= 
+		 chanMap.noise[currentChannel] + (WORD)CHMAP_PER_WEIGHT * chanMap.per[currentChannel])) {
+		TxRx_SaveChannelMap();								// the scan results - the network stays
+		return;
+	}
+	StartChannelHopping(channel);
+}
+#endif // WISDOM_STONE
+
+/******************************************************************************
+* Function:
+*		void TxRx_PrintChannelMap(void)
+* Description:
+*		Prints the CHAN record ("txrx stats").
+*******************************************************************************/
+void TxRx_PrintChannelMap(void) {
+
+	char data_to_print[16 + 8 * CHANNEL_NUM];
+	BYTE i;
+	
+	strcpy(data_to_print, "CHAN");
+	TxRx_AppendStat(data_to_print, myLongAddress[0]);
+	TxRx_AppendStat(data_to_print, currentChannel);
+	for (i = 0; i < CHANNEL_NUM; i++) {
+		TxRx_AppendStat(data_to_print, chanMap.noise[i]);
+		TxRx_AppendStat(data_to_print, chanMap.per[i]);
+	}
+	strcat(data_to_print, "\r\n");
+	m_write(data_to_print);
+}
+#endif // ENABLE_CHANNEL_MAP
+
+#if defined ENABLE_TDMA_UPLOAD
+/******************************************************************************
+* TDMA upload:
+* Every stone that streams data gets a slot in the superframe of the plug. The
+* plug measures the use of each slot: a full slot means the stone has backlog, 
+* so the slot is doubled (up to 1 << TDMA_MAX_SLOT_SHIFT blocks); a slot used up 
+* to its half is halved, and a slot left unused for TDMA_IDLE_SUPERFRAMES is 
+* freed. A stone without a slot sends in the contention part, and is given a 
+* slot of one block in the next superframe. When no stone has a slot, the plug
+* stops the beacons, and the stones return to contention by TDMA_BEACON_LOSS.
+* Only data blocks wait for the slot - commands, responses and acks are sent 
+* at once, as before (replies to broadcast commands have their own slots).
+* The slots are TDMA_BLOCK_TIME units of the base rate; a link at a faster
+* rate fits more blocks in its slot (TxRx_BlockTime).
+*******************************************************************************/
+
+#if defined ENABLE_LINK_RATE_ADAPTATION
+ROM WORD linkRateBaud[LINK_RATE_NUM] = {96, 192, 384, 576, 1152};		// the link rates in 100 bps
+
+/******************************************************************************
+* Function:
+*		DWORD TxRx_BlockTime(BYTE rate)
+* Return value:
+*		The time of a data block with its ack at the given link rate - the air
+*		time of the block scales with the rate
+*******************************************************************************/
+DWORD TxRx_BlockTime(BYTE rate) {
+
+	return ((DWORD)TDMA_BLOCK_TIME * linkRateBaud[BASE_LINK_RATE]) / linkRateBaud[rate];
+}
+#endif // ENABLE_LINK_RATE_ADAPTATION
+
+#if defined WISDOM_STONE
+/******************************************************************************
+* Function:
+*		void TxRx_ReceiveBeacon(void)
+* Description:
+*		Takes the upload slot of the stone from the beacon in rxMessage.
+*******************************************************************************/
+void TxRx_ReceiveBeacon(void) {
+
+	BYTE i;
+	BYTE slots = rxMessage.Payload[1];
+	DWORD offset = TDMA_GUARD_TIME;
+	DWORD slotLen;
+	
+	if ((rxMessage.PayloadSize < TDMA_BEACON_HEADER) ||
+		(rxMessage.PayloadSize < TDMA_BEACON_HEADER + slots)) {
+		return;
+	}
+	#if defined ENABLE_LINK_RATE_ADAPTATION
+		if ((tdmaSuperframe != 0) && (tdmaOwnSlot == TRUE) && (linkSlotBlocks == 0)) {
+			linkRate = BASE_LINK_RATE;				// the slot passed without a block - the plug returned to the base rate too
+		}
+		linkSlotBlocks = 0;
+	#endif
+	tdmaTick = MiWi_TickGet();
+	tdmaSlotStart = 0;
+	tdmaSlotEnd = 0;
+	tdmaOwnSlot = TRUE;
+	for (i = 0; i < slots; i++) {
+		slotLen = (DWORD)(1 << (rxMessage.Payload[TDMA_BEACON_HEADER + i] & TDMA_SLOT_SHIFT_MASK)) * TDMA_BLOCK_TIME;
+		if ((rxMessage.Payload[TDMA_BEACON_HEADER + i] >> 2) == myLongAddress[0]) {
+			tdmaSlotStart = offset;
+			tdmaSlotEnd = offset + slotLen;
+		}
+		offset += slotLen;
+	}
+	if (tdmaSlotEnd == 0) {							// no slot yet - use the contention part
+		tdmaOwnSlot = FALSE;
+		#if defined ENABLE_LINK_RATE_ADAPTATION
+			linkRate = BASE_LINK_RATE;
+		#endif
+		tdmaSlotStart = offset;
+		tdmaSlotEnd = offset + (DWORD)rxMessage.Payload[2] * TDMA_BLOCK_TIME;
+	}
+	tdmaSuperframe = offset + (DWORD)rxMessage.Payload[2] * TDMA_BLOCK_TIME;
+}
+
+/******************************************************************************
+* Function:
+*		BOOL TxRx_InUploadSlot(void)
+* Return value:
+*		TRUE while the stone is in its own upload slot (not the contention part)
+*******************************************************************************/
+BOOL TxRx_InUploadSlot(void) {
+
+	DWORD elapsed;
+	
+	if ((tdmaSuperframe == 0) || (tdmaOwnSlot == FALSE)) {
+		return FALSE;
+	}
+	elapsed = MiWi_TickGetDiff(MiWi_TickGet(), tdmaTick);
+	if (elapsed > TDMA_BEACON_LOSS * tdmaSuperframe) {
+		return FALSE;
+	}
+	elapsed %= tdmaSuperframe;
+	return ((elapsed >= tdmaSlotStart) && (elapsed < tdmaSlotEnd));
+}
+#endif // WISDOM_STONE
+
+#if defined COMMUNICATION_PLUG
+/******************************************************************************
+* Function:
+*		void TxRx_TdmaSchedule(void)
+* Description:
+*		At the end of the superframe - updates the slots according to their use,
+*		and broadcasts the beacon of the next superframe.
+*******************************************************************************/
+void TxRx_TdmaSchedule(void) {
+
+	MIWI_TICK now = MiWi_TickGet();
+	STONE_ENTRY *stone;
+	STONE_ENTRY *largest;
+	BYTE i;
+	BYTE slots = 0;
+	WORD blocks = 0;
+	
+	if ((tdmaSuperframe != 0) && (MiWi_TickGetDiff(now, tdmaTick) < tdmaSuperframe)) {
+		return;											// the superframe is not over yet
+	}
+	for (i = 0; i < stoneCount; i++) {
+		stone = &stoneTable[i];
+		if (stone->slotUsed == 0) {
+			if ((stone->slotShift != TDMA_NO_SLOT) && (++stone->slotIdle >= TDMA_IDLE_SUPERFRAMES)) {
+				stone->slotShift = TDMA_NO_SLOT;
+			}
+			#if defined ENABLE_LINK_RATE_ADAPTATION
+				stone->linkRate = BASE_LINK_RATE;		// the stone does the same (TxRx_ReceiveBeacon)
+			#endif
+		}
+		else {
+			stone->slotIdle = 0;
+			if (stone->slotShift == TDMA_NO_SLOT) {		// heard in the contention part
+				stone->slotShift = 0;
+			}
+			else if (stone->slotUsed >= TxRx_SlotBlocks(stone)) {
+				if (stone->slotShift < TDMA_MAX_SLOT_SHIFT) {
+					stone->slotShift++;
+				}
+			}
+			else if ((stone->slotShift > 0) && (stone->slotUsed <= TxRx_SlotBlocks(stone) / 2)) {
+				stone->slotShift--;
+			}
+		}
+		stone->slotUsed = 0;
+		if (stone->slotShift != TDMA_NO_SLOT) {
+			slots++;
+			blocks += 1 << stone->slotShift;
+		}
+	}
+	while (blocks > TDMA_MAX_SUPERFRAME_BLOCKS) {		// halve the largest slot until the superframe fits
+		largest = NULL;
+		for (i = 0; i < stoneCount; i++) {
+			stone = &stoneTable[i];
+			if ((stone->slotShift != TDMA_NO_SLOT) && 
+				((largest == NULL) || (stone->slotShift > largest->slotShift))) {
+				largest = stone;
+			}
+		}
+		if (largest->slotShift == 0) {					// can not happen - TDMA_MAX_SUPERFRAME_BLOCKS covers a block per stone
+			break;
+		}
+		largest->slotShift--;
+		blocks -= 1 << largest->slotShift;
+	}
+	if (slots == 0) {
+		tdmaSuperframe = 0;								// nobody uploads - no beacons
+		return;
+	}
+	#if defined ENABLE_LINK_RATE_ADAPTATION
+		TxRx_TuneLinkRate(BASE_LINK_RATE);
+	#endif
+	MiApp_FlushTx();
+	MiApp_WriteData(TDMA_BEACON_ID);
+	MiApp_WriteData(slots);
+	MiApp_WriteData(TDMA_CONTENTION_BLOCKS);
+	for (i = 0; i < stoneCount; i++) {
+		stone = &stoneTable[i];
+		if (stone->slotShift != TDMA_NO_SLOT) {
+			MiApp_WriteData((stone->eui0 << 2) | stone->slotShift);
+		}
+	}
+	MiApp_BroadcastPacket(FALSE);
+	tdmaTick = now;
+	tdmaSuperframe = TDMA_GUARD_TIME + (DWORD)(blocks + TDMA_CONTENTION_BLOCKS) * TDMA_BLOCK_TIME;
+}
+
+/******************************************************************************
+* Function:
+*		WORD TxRx_SlotBlocks(STONE_ENTRY *stone)
+* Return value:
+*		The data blocks that fit in the slot of the stone at the rate of its link
+*******************************************************************************/
+WORD TxRx_SlotBlocks(STONE_ENTRY *stone) {
+
+	#if defined ENABLE_LINK_RATE_ADAPTATION
+		return (WORD)(((DWORD)(1 << stone->slotShift) * TDMA_BLOCK_TIME) / TxRx_BlockTime(stone->linkRate));
+	#else
+		return 1 << stone->slotShift;
+	#endif
+}
+
+/******************************************************************************
+* Function:
+*		STONE_ENTRY* TxRx_SlotOwner(void)
+* Description:
+*		Walks the slots of the current superframe in the order of the beacon.
+* Return value:
+*		The stone whose upload slot is now, or NULL (guard time, contention 
+*		part, or no schedule)
+*******************************************************************************/
+STONE_ENTRY* TxRx_SlotOwner(void) {
+
+	DWORD elapsed;
+	DWORD offset = TDMA_GUARD_TIME;
+	BYTE i;
+	
+	if (tdmaSuperframe == 0) {
+		return NULL;
+	}
+	elapsed = MiWi_TickGetDiff(MiWi_TickGet(), tdmaTick);
+	if (elapsed < offset) {
+		return NULL;
+	}
+	for (i = 0; i < stoneCount; i++) {
+		if (stoneTable[i].slotShift != TDMA_NO_SLOT) {
+			offset += (DWORD)(1 << stoneTable[i].slotShift) * TDMA_BLOCK_TIME;
+			if (elapsed < offset) {
+				return &stoneTable[i];
+			}
+		}
+	}
+	return NULL;
+}
+
+#elif defined WISDOM_STONE
+/******************************************************************************
+* Function:
+*		BOOL TxRx_UploadSlotOpen(void)
+* Return value:
+*		TRUE if a whole data block fits in the rest of the slot of the stone,
+*		or there are no beacons
+*******************************************************************************/
+BOOL TxRx_UploadSlotOpen(void) {
+
+	DWORD elapsed;
+	DWORD blockTime = TDMA_BLOCK_TIME;
+	
+	if (tdmaSuperframe == 0) {
+		return TRUE;
+	}
+	elapsed = MiWi_TickGetDiff(MiWi_TickGet(), tdmaTick);
+	if (elapsed > TDMA_BEACON_LOSS * tdmaSuperframe) {	// the plug stopped the beacons - back to contention
+		tdmaSuperframe = 0;
+		#if defined ENABLE_LINK_RATE_ADAPTATION
+			linkRate = BASE_LINK_RATE;
+		#endif
+		return TRUE;
+	}
+	elapsed %= tdmaSuperframe;							// the superframe repeats until the next beacon
+	#if defined ENABLE_LINK_RATE_ADAPTATION
+		if (tdmaOwnSlot == TRUE) {						// the link leaves the base rate only in the slot of the stone
+			blockTime = TxRx_BlockTime(linkRate);
+		}
+	#endif
+	return ((elapsed >= tdmaSlotStart) && (elapsed + blockTime <= tdmaSlotEnd));
+}
+#endif // COMMUNICATION_PLUG
+#endif // ENABLE_TDMA_UPLOAD
+
+#if defined ENABLE_TIME_SYNC
+/******************************************************************************
+* Time sync:
+* The network time is the symbol timer of the plug. The MAC stamps the 
+* time-sync message at the start of the frame (see TxPacket), and the receiver
+* takes its own tick at the start of the frame (MACRxPacket.SofTick), so the 
+* MiWi rebroadcast jitter, CSMA and the processing of the message do not add 
+* to the error - only the interrupt latency and the tick resolution do.
+* A coordinator stone restamps the message when MiWi rebroadcasts it, with its
+* own network time, so the error grows slowly with the hops.
+* The stone fits a line to its last reference points (least squares): the 
+* slope is the skew of its oscillator relative to the plug, so the time base
+* stays accurate between the messages.
+*******************************************************************************/
+
+/******************************************************************************
+* Function:
+*		BOOL TxRx_GlobalTime(DWORD localTick, DWORD *globalTick)
+*******************************************************************************/
+BOOL TxRx_GlobalTime(DWORD localTick, DWORD *globalTick) {
+
+	#if defined COMMUNICATION_PLUG
+		*globalTick = localTick;
+		return TRUE;
+	#elif defined WISDOM_STONE
+		long correction;
+		
+		if ((tsyncCount != 0) && (MiWi_TickGetDiff(MiWi_TickGet(), tsyncTick) > TSYNC_TIMEOUT)) {
+			tsyncCount = 0;								// the plug is not heard any more
+		}
+		if (tsyncCount < TSYNC_MIN_ENTRIES) {
+			return FALSE;
+		}
+		correction = (tsyncIntercept + (((long long)tsyncSkew * (long)(localTick - tsyncAnchor)) >> 16) + 128) >> 8;
+		*globalTick = localTick + tsyncBase + correction;
+		return TRUE;
+	#endif
+}
+
+/******************************************************************************
+* Function:
+*******************************************************************************/
+BYTE TxRx_TimeSyncLevel(void) {
+
+	#if defined COMMUNICATION_PLUG
+		return 0;
+	#elif defined WISDOM_STONE
+		return tsyncLevel;
+	#endif
+}
+
+#if defined COMMUNICATION_PLUG
+/******************************************************************************
+* Function:
+*		void TxRx_TimeSyncTasks(void)
+* Description:
+*		Broadcasts the time-sync message every TSYNC_PERIOD. The level and the
+*		network time are written by the MAC.
+*******************************************************************************/
+void TxRx_TimeSyncTasks(void) {
+
+	MIWI_TICK now = MiWi_TickGet();
+	BYTE i;
+	
+	if (MiWi_TickGetDiff(now, tsyncTick) < TSYNC_PERIOD) {
+		return;
+	}
+	#if defined ENABLE_LINK_RATE_ADAPTATION
+		TxRx_TuneLinkRate(BASE_LINK_RATE);		// broadcasts leave at the base rate
+	#endif
+	MiApp_FlushTx();
+	MiApp_WriteData(TSYNC_ID);
+	MiApp_WriteData(++tsyncSeq);
+	for (i = TSYNC_LEVEL; i < TSYNC_LENGTH; i++) {
+		MiApp_WriteData(0);
+	}
+	MiApp_BroadcastPacket(FALSE);
+	tsyncTick = now;
+}
+
+#elif defined WISDOM_STONE
+/******************************************************************************
+* Function:
+*		void TxRx_ReceiveTimeSync(void)
+* Description:
+*		Adds the time-sync message in rxMessage to the reference points. 
+*		Only the first copy of each message is used (MiWi drops most of the 
+*		rebroadcast copies). An older sequence is an outlier as well: it is 
+*		a late copy, or - if TSYNC_MAX_ERRORS come in a row - the plug was 
+*		restarted, and the stone starts over.
+*******************************************************************************/
+void TxRx_ReceiveTimeSync(void) {
+
+	DWORD		localTick = MACRxPacket.SofTick;
+	DWORD_VAL	globalTick;
+	DWORD		estimate;
+	long		error;
+	signed char	seqDiff;
+	BYTE		i;
+	
+	if ((rxMessage.PayloadSize < TSYNC_LENGTH) || (rxMessage.Payload[TSYNC_LEVEL] == TSYNC_NOT_SYNCED)) {
+		return;
+	}
+	seqDiff = (signed char)(rxMessage.Payload[1] - tsyncSeq);
+	if ((tsyncCount != 0) && (seqDiff == 0)) {			// another copy of the last message
+		return;
+	}
+	if ((tsyncCount != 0) && (seqDiff < 0)) {
+		if (++tsyncErrors < TSYNC_MAX_ERRORS) {
+			return;
+		}
+		tsyncCount = 0;
+	}
+	for (i = 0; i < 4; i++) {
+		globalTick.v[i] = rxMessage.Payload[TSYNC_TIME + i];
+	}
+	if (TxRx_GlobalTime(localTick, &estimate) == TRUE) {
+		error = (long)(globalTick.Val - estimate);
+		if ((error > (long)TSYNC_ERROR_LIMIT) || (error < -(long)TSYNC_ERROR_LIMIT)) {
+			if (++tsyncErrors < TSYNC_MAX_ERRORS) {
+				return;
+			}
+			tsyncCount = 0;
+		}
+	}
+	tsyncErrors = 0;
+	if (tsyncCount == 0) {
+		tsyncNext = 0;
+	}
+	tsyncTable[tsyncNext].localTick = localTick;
+	tsyncTable[tsyncNext].offset = globalTick.Val - localTick;
+	tsyncNext = (tsyncNext + 1) % TSYNC_TABLE_SIZE;
+	if (tsyncCount < TSYNC_TABLE_SIZE) {
+		tsyncCount++;
+	}
+	tsyncSeq = rxMessage.Payload[1];
+	tsyncLevel = rxMessage.Payload[TSYNC_LEVEL] + 1;
+	tsyncTick = MiWi_TickGet();
+	TxRx_TimeSyncFit();
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_TimeSyncFit(void)
+* Description:
+*		Fits offset = intercept + skew * (local - anchor) to the reference 
+*		points, where the anchor is their mean local tick. The sums are taken
+*		relative to the first entry, so they fit in 64 bits.
+*******************************************************************************/
+void TxRx_TimeSyncFit(void) {
+
+	long long	sumLocal = 0;
+	long long	sumOffset = 0;
+	long long	sumLocal2 = 0;
+	long long	sumLocalOffset = 0;
+	long long	den;
+	long		dLocal;
+	long		dOffset;
+	BYTE		i;
+	
+	for (i = 0; i < tsyncCount; i++) {
+		sumLocal += (long)(tsyncTable[i].localTick - tsyncTable[0].localTick);
+	}
+	tsyncAnchor = tsyncTable[0].localTick + (long)(sumLocal / tsyncCount);
+	tsyncBase = tsyncTable[0].offset;
+	sumLocal = 0;
+	for (i = 0; i < tsyncCount; i++) {
+		dLocal = (long)(tsyncTable[i].localTick - tsyncAnchor);
+		dOffset = (long)(tsyncTable[i].offset - tsyncBase);
+		sumLocal += dLocal;
+		sumOffset += dOffset;
+		sumLocal2 += (long long)dLocal * dLocal;
+		sumLocalOffset += (long long)dLocal * dOffset;
+	}
+	den = tsyncCount * sumLocal2 - sumLocal * sumLocal;
+	if (den > 0) {
+		tsyncSkew = (long)(((tsyncCount * sumLocalOffset - sumLocal * sumOffset) << 24) / den);
+	}
+	else {
+		tsyncSkew = 0;									// a single reference point - offset only
+	}
+	tsyncIntercept = (long)(((sumOffset << 8) - ((tsyncSkew * sumLocal) >> 16)) / tsyncCount);
+}
+#endif // COMMUNICATION_PLUG
+#endif // ENABLE_TIME_SYNC
+
+#if defined ENABLE_LOW_POWER_LISTEN && defined WISDOM_STONE
+/******************************************************************************
+* Function:
+*		BOOL TxRx_CanDoze(void)
+* Return value:
+*		TRUE if no block waits for an ack, and no child joined the stone 
+*		(the stone would not route the messages of its children while dozing)
+*******************************************************************************/
+BOOL TxRx_CanDoze(void) {
+
+	BYTE i;
+	
+	#if defined ENABLE_CUMULATIVE_ACK
+		if (txWindowCount > 0) {
+			return FALSE;
+		}
+	#endif
+	if (isReplyHeld == TRUE) {								// the reply waits for its slot
+		return FALSE;
+	}
+	for (i = 0; i < CONNECTION_SIZE; i++) {
+		if ((ConnectionTable[i].status.bits.isValid) && (ConnectionTable[i].status.bits.isFamily) && (i != myParent)) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_LowPowerListen(void)
+* Description:
+*		After LPL_IDLE_TIMEOUT without blocks, tells the plug that the stone
+*		dozes. Each later call is one doze cycle: sleeps with the wake-up timer
+*		of the transceiver, and listens LPL_LISTEN_MS after the wakeup - so 
+*		the main loop runs between the cycles. A wake frame for the stone, a
+*		message for it, or a block that was sent or received ends the doze; 
+*		the message is left for TxRx_PeriodTasks. The MiWi tick stops while 
+*		the MCU sleeps, so the timeouts that started before the doze are 
+*		extended by it.
+*******************************************************************************/
+void TxRx_LowPowerListen(void) {
+
+	BYTE		ctrl[1];
+	MIWI_TICK	t1;
+	
+	if (isLplDozing == FALSE) {
+		if ((MiWi_TickGetDiff(MiWi_TickGet(), lplActiveTick) < LPL_IDLE_TIMEOUT) || (TxRx_CanDoze() == FALSE)) {
+			return;
+		}
+		ctrl[0] = TXRX_CTRL_DOZE;
+		finalDestinationNwkAddress[0] = PLUG_NWK_ADDR_EUI0;
+		finalDestinationNwkAddress[1] = PLUG_NWK_ADDR_EUI1;
+		TxRx_SendPacket(ctrl, sizeof(ctrl), TXRX_TYPE_CONTROL);	// if it is lost, the plug takes the stone for dozing after LPL_IDLE_TIMEOUT
+		lplWakeRequest = FALSE;
+		isLplDozing = TRUE;
+		return;												// the first cycle is in the next call
+	}
+	if (TxRx_CanDoze() == FALSE) {							// e.g. a child joined since
+		isLplDozing = FALSE;
+		lplActiveTick = MiWi_TickGet();
+		return;
+	}
+	MiMAC_PowerState(POWER_STATE_WAKE_TIMER);
+	Sleep();												// until the wake-up timer (or another interrupt)
+	MiMAC_PowerState(POWER_STATE_OPERATE);
+	t1 = MiWi_TickGet();
+	while ((lplWakeRequest == FALSE) && (MiWi_TickGetDiff(MiWi_TickGet(), t1) < LPL_LISTEN_MS * ONE_MILI_SECOND)) {
+		if (MiApp_MessageAvailable() && (TxRx_ConsumeBroadcast() == FALSE)) {
+			if (rxMessage.flags.bits.broadcast == 1) {
+				MiApp_DiscardMessage();						// not of the TxRx layer
+			}
+			else {
+				lplWakeRequest = TRUE;						// a block for the stone
+			}
+		}
+	}
+	if (lplWakeRequest == TRUE) {
+		isLplDozing = FALSE;
+		lplActiveTick = MiWi_TickGet();
+	}
+}
+#endif // ENABLE_LOW_POWER_LISTEN && WISDOM_STONE
+
+//OOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOO
+#if defined COMMUNICATION_PLUG
+//OOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOO
+
+/******************************************************************************
+* Function:
+*		void TxRx_AppStop(void)
+* Description:
+*		TxRx_AppStop updates the isStopped flag of the destination stone
+*		(or of all the stones) according to isAppStop
+*		(the command "app stop" is sent separately)
+* Parameters:
+*		None
+* Return value:
+*		None
+*******************************************************************************/
+void TxRx_AppStop(void) {
+		
+	if (isBroadcast == FALSE) {	
+		// update the entry of the destination stone:
+		STONE_ENTRY *stone = TxRx_AddStone(finalDestinationNwkAddress[0]);
+		if (stone != NULL) {
+			stone->isStopped = isAppStop;
+		}
+	}
+	else {	
+		// in case of broadcast - update the whole table (the plug entry is irrelevant):
+		BYTE i;	
+		for (i = 0; i < stoneCount; i++) {
+			stoneTable[i].isStopped = isAppStop;
+		}
+	}
+	return;
+}
+
+/******************************************************************************
+* Function:
+*		TXRX_ERRORS TxRx_QueueCommand(BYTE *command)
+* Description:
+*		Queues the command for the destination that TxRx_ExecuteIfPlugCommand
+*		found (finalDestinationNwkAddress, isBroadcast), and reports its tag.
+* Return value:
+*		TXRX_CMD_QUEUE_FULL if there is no room for the command
+*******************************************************************************/
+TXRX_ERRORS TxRx_QueueCommand(BYTE *command) {
+
+	BYTE 		i;
+	CMD_ENTRY 	*entry;
+	
+	for (i = 0; i < CMD_QUEUE_SIZE; i++) {
+		entry = &cmdQueue[i];
+		if (entry->isUsed == FALSE) {
+			entry->isUsed = TRUE;
+			entry->isBroadcast = isBroadcast;
+			entry->isStarted = FALSE;
+			entry->isWoken = FALSE;
+			entry->state = CMD_STATE_SEND;
+			entry->tag = cmdTag++;
+			entry->eui0 = finalDestinationNwkAddress[0];
+			entry->retries = CMD_RETRIES;
+			entry->commandLen = 0;
+			#if defined ENABLE_BINARY_COMMANDS
+				entry->commandLen = encode_command((char*)command, entry->command);
+			#endif
+			if (entry->commandLen == 0) {					// the command is sent as text
+				strncpy(entry->command, (char*)command, MAX_CMD_LEN - 1);
+				entry->command[MAX_CMD_LEN - 1] = '\0';
+				entry->commandLen = strlen(entry->command);
+			}
+			TxRx_ReportCommand(entry, "QUEUED", TXRX_NO_ERROR);
+			return TXRX_NO_ERROR;
+		}
+	}
+	TxRx_PrintError(TXRX_CMD_QUEUE_FULL);
+	return TXRX_CMD_QUEUE_FULL;
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_CommandTasks(void)
+* Description:
+*		Advances the delivery of the queued commands by one step (see 
+*		TxRx_CommandAttempt). The step of the active command (cmdActive) comes 
+*		first; otherwise the ready commands take turns (round robin). 
+*******************************************************************************/
+void TxRx_CommandTasks(void) {
+
+	static BYTE	next = 0;
+	CMD_ENTRY 	*entry = NULL;
+	MIWI_TICK 	now = MiWi_TickGet();
+	BYTE		i, k;
+	
+	if (cmdActive == NULL) {
+		for (k = 0; k < CMD_QUEUE_SIZE; k++) {
+			i = (next + k) % CMD_QUEUE_SIZE;
+			if ((cmdQueue[i].isUsed == TRUE) && (TxRx_IsCommandReady(&cmdQueue[i], now) == TRUE)) {
+				entry = &cmdQueue[i];
+				next = (i + 1) % CMD_QUEUE_SIZE;
+				break;
+			}
+		}
+		if (entry == NULL) {
+			return;
+		}
+		if (entry->isStarted == FALSE) {
+			entry->isStarted = TRUE;
+			entry->firstTick = now;
+			if (entry->isBroadcast == TRUE) {
+				entry->slots = TxRx_BroadcastStart((BYTE*)entry->command, entry->commandLen);
+				entry->member = 0;
+				entry->slot = 0;
+				entry->lastTick = now;
+			}
+		}
+		cmdActive = entry;
+	}
+	TxRx_CommandAttempt(cmdActive);
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_CommandAttempt(CMD_ENTRY *entry)
+* Description:
+*		Makes one step in the delivery of the command, and returns - the ack of
+*		the stone is received by TxRx_PeriodTasks with the other blocks:
+*		CMD_STATE_SEND - sends the command (TxRx_TransmitPacket). A broadcast
+*			command is sent to its member stones one after the other 
+*			(CMD_MEMBER_GAP apart), and then its replies are collected.
+*		CMD_STATE_WAIT_ACK - the command was delivered if the stone acked its 
+*			sequence; the attempt failed if CMD_ACK_TIMEOUT passed.
+*		CMD_STATE_COLLECT - the broadcast command is done when the replies are
+*			in (TxRx_ReplyCollectTasks).
+*		CMD_STATE_WAKE - a wake frame every LPL_WAKE_GAP for LPL_WAKE_TIME 
+*			(ENABLE_LOW_POWER_LISTEN), before the command is sent to a dozing 
+*			stone.
+*		cmdActive is released when the command is done, failed, or waits for 
+*		CMD_RETRY_BACKOFF.
+*******************************************************************************/
+void TxRx_CommandAttempt(CMD_ENTRY *entry) {
+
+	STONE_ENTRY	*stone;
+	TXRX_ERRORS	status;
+	MIWI_TICK 	now = MiWi_TickGet();
+	#if defined ENABLE_LOW_POWER_LISTEN
+		BYTE	eui0;
+	#endif
+	
+	switch (entry->state) {
+	case CMD_STATE_SEND:
+		if (entry->isBroadcast == TRUE) {
+			if (MiWi_TickGetDiff(now, entry->lastTick) < CMD_MEMBER_GAP) {
+				return;
+			}
+			while ((entry->member < stoneCount) && (entry->slot < entry->slots) &&
+				   (TxRx_BroadcastMember(entry->member, entry->slot) == FALSE)) {
+				entry->member++;
+				entry->retries = CMD_RETRIES;
+			}
+			if ((entry->member >= stoneCount) || (entry->slot == entry->slots)) {	// delivered to every member stone
+				TxRx_CollectReplies(entry->slots);
+				entry->state = CMD_STATE_COLLECT;
+				return;
+			}
+		}
+		#if defined ENABLE_LOW_POWER_LISTEN
+			stone = TxRx_CommandStone(entry);
+			if ((entry->isWoken == FALSE) && (stone != NULL) && (TxRx_IsDozing(stone) == TRUE)) {	// the stone is woken first
+				entry->lastTick = now;
+				entry->state = CMD_STATE_WAKE;
+				return;
+			}
+		#endif
+		if (entry->isBroadcast == TRUE) {
+			isBroadcast = TRUE;
+			status = TxRx_TransmitPacket(bcastCommand, bcastCommandLen, TXRX_TYPE_COMMAND);
+		}
+		else {
+			isBroadcast = FALSE;
+			finalDestinationNwkAddress[0] = entry->eui0;
+			finalDestinationNwkAddress[1] = EUI_1;
+			status = TxRx_TransmitPacket((BYTE*)entry->command, entry->commandLen, TXRX_TYPE_COMMAND);
+		}
+		entry->lastTick = now;
+		if (status != TXRX_NO_ERROR) {
+			TxRx_CommandFailed(entry, status);
+			return;
+		}
+		stone = TxRx_CommandStone(entry);
+		stone->replyTag = entry->tag;										// the replies of the stone are reported with the tag of the command
+		entry->state = CMD_STATE_WAIT_ACK;
+		return;
+	case CMD_STATE_WAIT_ACK:
+		#if defined ENABLE_TXRX_ACK
+			stone = TxRx_CommandStone(entry);
+			if (stone == NULL) {												// the network was reset
+				TxRx_CommandFailed(entry, TXRX_NWK_UNKNOWN_ADDR);
+				return;
+			}
+			if (stone->ackInfo.txLastSeq != stone->ackInfo.txExpectedSeq) {	// not acked yet (the header of the ack sets txLastSeq)
+				if (MiWi_TickGetDiff(now, entry->lastTick) > CMD_ACK_TIMEOUT) {
+					TxRx_CommandFailed(entry, TXRX_NO_PACKET_RECEIVED);
+				}
+				return;
+			}
+			stone->stats.txBlocks++;
+			TxRx_RttSample(&stone->stats, entry->lastTick);					// lastTick - the command was sent
+		#endif
+		if (entry->isBroadcast == TRUE) {
+			entry->member++;
+			entry->slot++;
+			entry->retries = CMD_RETRIES;
+			entry->state = CMD_STATE_SEND;
+			return;
+		}
+		TxRx_ReportCommand(entry, "DELIVERED", TXRX_NO_ERROR);
+		entry->isUsed = FALSE;
+		cmdActive = NULL;
+		return;
+	case CMD_STATE_COLLECT:
+		if (isReplyCollecting == FALSE) {
+			TxRx_ReportCommand(entry, "DONE", TXRX_NO_ERROR);
+			entry->isUsed = FALSE;
+			cmdActive = NULL;
+		}
+		return;
+	#if defined ENABLE_LOW_POWER_LISTEN
+	case CMD_STATE_WAKE:
+		eui0 = (entry->isBroadcast == TRUE) ? LPL_WAKE_ALL : entry->eui0;	// a broadcast command wakes all its dozing stones at once
+		if (MiWi_TickGetDiff(now, entry->lastTick) < LPL_WAKE_TIME) {
+			if (MiWi_TickGetDiff(now, lplWakeTick) < LPL_WAKE_GAP) {
+				return;
+			}
+			lplWakeTick = now;
+			if (TxRx_WakeStones(eui0) == FALSE) {
+				return;
+			}
+		}
+		entry->isWoken = TRUE;											// until an attempt fails - the stone may have missed the frames
+		entry->state = CMD_STATE_SEND;
+		return;
+	#endif
+	}
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_CommandFailed(CMD_ENTRY *entry, TXRX_ERRORS status)
+* Description:
+*		Counts a failed attempt to deliver the command. The command is reported
+*		failed after CMD_RETRIES attempts or CMD_TIMEOUT; otherwise it is sent
+*		again - after CMD_RETRY_BACKOFF, and the other commands take turns in
+*		the meantime. A broadcast command gives up on the current stone after 
+*		CMD_RETRIES attempts, and goes on to the next one.
+*******************************************************************************/
+void TxRx_CommandFailed(CMD_ENTRY *entry, TXRX_ERRORS status) {
+
+	STONE_ENTRY *stone = TxRx_CommandStone(entry);
+	
+	entry->state = CMD_STATE_SEND;
+	entry->isWoken = FALSE;
+	#if defined ENABLE_LINK_RATE_ADAPTATION
+		if ((status != TXRX_NWK_UNKNOWN_ADDR) && (stone != NULL)) {
+			TxRx_TuneLinkRate(TxRx_LinkRateOf(TxRx_NextHop(stone)));			// the rate the command left at
+			if (TxRx_LinkRateFallback() == TRUE) {								// the stone may have already returned to the base rate
+				return;
+			}
+		}
+	#endif
+	if (entry->retries > 0) {
+		entry->retries--;
+	}
+	if (entry->isBroadcast == TRUE) {
+		if ((status == TXRX_NWK_UNKNOWN_ADDR) || (entry->retries == 0)) {
+			if (stone != NULL) {
+				stone->stats.txFailures++;
+			}
+			TxRx_PrintError(status);
+			entry->member++;
+			entry->slot++;
+			entry->retries = CMD_RETRIES;
+		}
+		return;
+	}
+	cmdActive = NULL;
+	if ((status == TXRX_NWK_UNKNOWN_ADDR) || (entry->retries == 0) ||
+		(MiWi_TickGetDiff(MiWi_TickGet(), entry->firstTick) > CMD_TIMEOUT)) {
+		if (stone != NULL) {
+			stone->stats.txFailures++;
+		}
+		TxRx_ReportCommand(entry, "FAILED", status);
+		entry->isUsed = FALSE;
+	}
+}
+
+#if defined ENABLE_LOW_POWER_LISTEN
+/******************************************************************************
+* Function:
+*		BOOL TxRx_IsDozing(STONE_ENTRY *stone)
+* Return value:
+*		TRUE if the stone may be dozing: it sent TXRX_CTRL_DOZE, or no block 
+*		came from it for LPL_IDLE_TIMEOUT (its TXRX_CTRL_DOZE may be lost)
+*******************************************************************************/
+BOOL TxRx_IsDozing(STONE_ENTRY *stone) {
+
+	if (MiWi_TickGetDiff(MiWi_TickGet(), stone->lplTick) > LPL_IDLE_TIMEOUT) {
+		stone->isDozing = TRUE;
+	}
+	return stone->isDozing;
+}
+
+/******************************************************************************
+* Function:
+*		BOOL TxRx_WakeStones(BYTE eui0)
+* Description:
+*		Sends one wake frame [LPL_WAKE_ID, eui0] - unicast to the stone eui0,
+*		or broadcast to all the dozing stones (LPL_WAKE_ALL). 
+*		TxRx_CommandAttempt sends one every LPL_WAKE_GAP for LPL_WAKE_TIME, so
+*		that one of them comes while the stone listens.
+* Return value:
+*		TRUE if the stone is a neighbour of the plug, and acked the frame (the
+*		MAC ack) - it listens
+*******************************************************************************/
+BOOL TxRx_WakeStones(BYTE eui0) {
+
+	BYTE		address[MY_ADDRESS_LENGTH];
+	STONE_ENTRY	*stone;
+	
+	#if defined ENABLE_LINK_RATE_ADAPTATION
+		TxRx_TuneLinkRate(BASE_LINK_RATE);		// the stones listen at the base rate
+	#endif
+	MiApp_FlushTx();
+	MiApp_WriteData(LPL_WAKE_ID);
+	MiApp_WriteData(eui0);
+	if (eui0 == LPL_WAKE_ALL) {
+		MiApp_BroadcastPacket(FALSE);
+		return FALSE;
+	}
+	address[0] = eui0;
+	address[1] = EUI_1;
+	stone = TxRx_GetStone(eui0);
+	return ((MiApp_UnicastAddress(address, TRUE, FALSE) == TRUE) &&
+			(stone != NULL) && (stone->parentEUI0 == PLUG_NWK_ADDR_EUI0));	// the ack of another stone only tells that the frame is routed
+}
+#endif // ENABLE_LOW_POWER_LISTEN
+
+/******************************************************************************
+* Function:
+*		STONE_ENTRY* TxRx_CommandStone(CMD_ENTRY *entry)
+* Return value:
+*		The stone that the command is sent to (of a broadcast command - the 
+*		current member stone), or NULL if it is not in stoneTable
+*******************************************************************************/
+STONE_ENTRY* TxRx_CommandStone(CMD_ENTRY *entry) {
+
+	if (entry->isBroadcast == TRUE) {
+		return (entry->member < stoneCount) ? &stoneTable[entry->member] : NULL;
+	}
+	return TxRx_GetStone(entry->eui0);
+}
+
+/******************************************************************************
+* Function:
+*		BOOL TxRx_IsCommandReady(CMD_ENTRY *entry, MIWI_TICK now)
+* Return value:
+*		TRUE if no earlier command to the same destination is queued, and the
+*		command was not attempted in the last CMD_RETRY_BACKOFF
+*******************************************************************************/
+BOOL TxRx_IsCommandReady(CMD_ENTRY *entry, MIWI_TICK now) {
+
+	BYTE i;
+	BYTE age;
+	
+	for (i = 0; i < CMD_QUEUE_SIZE; i++) {
+		if ((cmdQueue[i].isUsed == TRUE) && (cmdQueue[i].eui0 == entry->eui0)) {
+			age = entry->tag - cmdQueue[i].tag;
+			if ((age != 0) && (age < 0x80)) {								// cmdQueue[i] was queued before the entry
+				return FALSE;
+			}
+		}
+	}
+	if (entry->isStarted == FALSE) {
+		return TRUE;
+	}
+	return (MiWi_TickGetDiff(now, entry->lastTick) > CMD_RETRY_BACKOFF);
+}
+
+/******************************************************************************
+* Function:
+*		void TxRx_ReportCommand(CMD_ENTRY *entry, char *state, TXRX_ERRORS error)
+* Description:
+*		Writes "CMD#<tag> TO STONE eui0# <eui0>: <state>[ - <error>]" to the host.
+*******************************************************************************/
+void TxRx_ReportCommand(CMD_ENTRY *entry, char *state, TXRX_ERRORS error) {
 
-	WORD i;
-		
-    for (i = 0; i < rxMessage.PayloadSize; i++) {
-   		rxBlock.blockBuffer[rxBlock.handlingParam.blockPos++] = rxMessage.Payload[i];
-    }	
+	m_write("CMD#");
+	m_write(byte_to_str(entry->tag));
+	if (entry->isBroadcast == TRUE) {
+		m_write(" TO ALL: ");
+	}
+	else {
+		m_write(" TO STONE eui0# ");
+		m_write(byte_to_str(entry->eui0));
+		m_write(": ");
+	}
+	m_write(state);
+	if (error != TXRX_NO_ERROR) {
+		m_write(" - ");
+		m_write(TxRx_err_messages[error]);
+	}
+	write_eol();
 }
 
 /******************************************************************************
 * Function:
-*		TXRX_ERRORS TxRx_ReceivePacketTrailer()
-*
+*		void TxRx_CollectReplies(BYTE slots)
 * Description:
-*       This function is responsible for receiving the packet trailer, and
-*		initialization for receiving the next packet.
-*
-* Parameters:
-*	   None.
-*
-* Return value: 
-*	   TXRX_NO_ERROR
-*	   TXRX_RECEIVED_INVALID_TRAILER
-*	   
-*
-******************************************************************************/
-TXRX_ERRORS TxRx_ReceivePacketTrailer(){
-		
-	TXRX_ERRORS status = TXRX_NO_ERROR;
-	WORD i;
+*		Broadcasts the start of the replies to the broadcast command, and 
+*		returns: TxRx_PlugHandler prints each reply as it arrives in its slot,
+*		and TxRx_ReplyCollectTasks ends the response.
+*******************************************************************************/
+void TxRx_CollectReplies(BYTE slots) {
+
+	#if defined ENABLE_LINK_RATE_ADAPTATION
+		TxRx_TuneLinkRate(BASE_LINK_RATE);
+	#endif
+	MiApp_FlushTx();
+	MiApp_WriteData(TXRX_REPLY_START_ID);
+	MiApp_WriteData(slots);
+	MiApp_BroadcastPacket(FALSE);
 	
-	for (i = 0; i < TXRX_TRAILER_SIZE; i++) {
-		rxBlock.blockTrailer[i] = rxBlock.blockBuffer[rxBlock.blockHeader.blockLen + i];		
-		if (rxBlock.blockTrailer[i] != TxRx_Trailer[i]) {						// YL check last TXRX_TRAILER_SIZE = 4 bytes of blockBuffer; these bytes should be identical to constant trailer string
-			status = TXRX_RECEIVED_INVALID_TRAILER;
-			break;
-		}
-	}
-	rxBlock.handlingParam.isHeader = TRUE;										// we received the whole packet; next we are waiting for the header of the next block; //YL reset rxBlock fields for next transmission
-	rxBlock.blockBuffer[rxBlock.blockHeader.blockLen] = '\0';					
-	rxBlock.handlingParam.blockPos = 0;
-	rxBlock.blockHeader.blockLen = 0;
-	return status;
+	replyCollectSlots = slots;
+	replyCollectTick = MiWi_TickGet();
+	isReplyCollecting = TRUE;
 }
 
 /******************************************************************************
 * Function:
-*		TXRX_ERRORS TxRx_ReceiveMessage()
-*
+*		void TxRx_ReplyCollectTasks(void)
 * Description:
-*      This function is responsible for receiving a message. As mentioned, a packet
-*	   consists of several messages, therefore this function is used by 
-*	   TxRx_ReceivePacket() to get a message at a time, until the whole packet
-*	   is received.
-*
-* Parameters:
-*	   None.
-*
-* Return value: 
-*	   TXRX_NO_ERROR
-*	   TXRX_WRONG_BLOCK_TYPE.
-*	   TXRX_WRONG_DATA_SEQ
-*	   TXRX_WRONG_ACK_SEQ
-*	   TXRX_WRONG_PACKET_LENGTH 
-*	   TXRX_RECEIVED_INVALID_TRAILER
-*	   TXRX_NO_PACKET_RECEIVED
-*	   
-*
-******************************************************************************/
-TXRX_ERRORS TxRx_ReceiveMessage() {
+*		Ends the response to the broadcast command when every stone replied, or
+*		when the reply slots (and TXRX_REPLY_GUARD_TIME) passed: prints how many
+*		stones replied, and the stones that did not.
+*******************************************************************************/
+void TxRx_ReplyCollectTasks(void) {
+
+	BYTE replied = 0;
+	BYTE i;
 	
-	/*******************************************************************/
-	// Function MiApp_MessageAvailable will return a boolean to indicate 
-	// if a message for application layer has been received by the 
-	// transceiver. If a message has been received, all information will 
-	// be stored in the rxMessage, structure of RECEIVED_MESSAGE.
-	// YL TxRx_ReceiveMessage uses:
-	// - TxRx_ReceivePacketHeader
-	// - TxRx_ReceiveBuffer
-	// - TxRx_ReceivePacketTrailer
-	// to copy rxMessage.Payload bytes into the fields of rxBlock struct
-	/*******************************************************************/
-		
-	if (MiApp_MessageAvailable()) {		         
-		TXRX_ERRORS status;
-		if (rxBlock.handlingParam.isHeader == TRUE) {				// it is the beginning of the block
-			status = TxRx_ReceivePacketHeader();
-			if (status != TXRX_NO_ERROR) {				
-				MiApp_DiscardMessage();
-				return status;
-			}
+	if (isReplyCollecting == FALSE) {
+		return;
+	}
+	for (i = 0; i < stoneCount; i++) {
+		if ((stoneTable[i].isNetworkMember == TRUE) && 
+			(stoneTable[i].eui0 != PLUG_NWK_ADDR_EUI0) &&
+			(stoneTable[i].isReplyPending == FALSE)) {
+			replied++;
 		}
-		else {
-			TxRx_ReceiveBuffer();
-		} 
-		if ((rxBlock.handlingParam.blockPos) >= 
-			(rxBlock.blockHeader.blockLen + TXRX_TRAILER_SIZE)) {	// we got the whole block
-			status = TxRx_ReceivePacketTrailer();
-			if (status != TXRX_NO_ERROR) {				
-				MiApp_DiscardMessage();
-				return status;	
+	}
+	if ((replied < replyCollectSlots) && 
+		(MiWi_TickGetDiff(MiWi_TickGet(), replyCollectTick) < (DWORD)replyCollectSlots * TXRX_REPLY_SLOT_TIME + TXRX_REPLY_GUARD_TIME)) {
+		return;
+	}
+	isReplyCollecting = FALSE;
+	
+	m_write("\r\nBROADCAST: ");
+	m_write(byte_to_str(replied));
+	m_write("/");
+	m_write(byte_to_str(replyCollectSlots));
+	m_write(" replied");
+	if (replied < replyCollectSlots) {
+		m_write(", MISSING eui0#:");
+		for (i = 0; i < stoneCount; i++) {
+			if (stoneTable[i].isReplyPending == TRUE) {
+				stoneTable[i].isReplyPending = FALSE;
+				m_write(" ");
+				m_write(byte_to_str(stoneTable[i].eui0));
 			}
 		}
-		MiApp_DiscardMessage();	
-		return TXRX_NO_ERROR; // message received
 	}
-	return TXRX_NO_PACKET_RECEIVED;    			     
+	write_eol();
 }
 
 /******************************************************************************
 * Function:
-*		TXRX_ERRORS TxRx_ReceivePacket()
-*
+*		BOOL TxRx_SelectRxBlock(void)
 * Description:
-*      This function is the primary function for receiving a whole packet. The 
-*	   function uses TxRx_ReceiveMessage() to get messages, and union all these
-*	   messages to get a whole packet.
-*
-* Parameters:
-*	   None.
-*
+*		Points rxBlock at the block that the message in rxMessage belongs to: the
+*		block being received from the same MiWi source, or else a free block - 
+*		and then the message is the header of a new block. A block without a 
+*		message for TIMEOUT_RECEIVING_MESSAGE is abandoned, and is free.
+*		rxFromStone is the stone of the block (the header sets it for a new block).
 * Return value: 
-*	   TXRX_NO_ERROR
-*	   TXRX_WRONG_BLOCK_TYPE.
-*	   TXRX_WRONG_DATA_SEQ
-*	   TXRX_WRONG_ACK_SEQ
-*	   TXRX_WRONG_PACKET_LENGTH 
-*	   TXRX_RECEIVED_INVALID_TRAILER
-*	   TXRX_NO_PACKET_RECEIVED
-*	   TXRX_PARTIAL_PACKET_RECEIVED
-*	   
-*
-******************************************************************************/
-TXRX_ERRORS TxRx_ReceivePacket() {
-	
-	WORD i = 0;
-	TXRX_ERRORS status = TXRX_NO_ERROR;
+*		FALSE - all the blocks are being received from other stones
+*******************************************************************************/
+BOOL TxRx_SelectRxBlock(void) {
+
+	BYTE 			i;
+	RX_BLOCK_BUFFER *block;
+	RX_BLOCK_BUFFER *freeBlock = NULL;
+	MIWI_TICK 		now = MiWi_TickGet();
 	
-	for (i = 0; i < (MAX_BLOCK_SIZE); i++) {							// YL TxRx_ReceivePacket resets all rxBlock fields before calling TxRx_ReceiveMessage that actually recieves the data according to it's type (header\buffer\trailer)
-		rxBlock.blockBuffer[i] = '\0';
-	}
-	rxBlock.blockHeader.blockType = 0;									
-	rxBlock.handlingParam.isHeader = TRUE;
-	rxBlock.handlingParam.isTrailer = FALSE;
-	rxBlock.handlingParam.blockPos = 0;
-	rxBlock.blockHeader.blockLen = 0;
-	MIWI_TICK t1, t2;
-	t1 = MiWi_TickGet();
-		
-	while (1) {
-		status = TxRx_ReceiveMessage();									// receive the command packet
-		if (status != TXRX_NO_PACKET_RECEIVED) {
-			break;
-		}
-		t2 = MiWi_TickGet();		
-		if ((MiWi_TickGetDiff(t2, t1)) > TIMEOUT_RECEIVING_MESSAGE) {	// waits a few seconds to get the whole command		
-			status = TXRX_NO_PACKET_RECEIVED;
-			break;
-		}
-	}
-	if (status == TXRX_NO_ERROR) {										// we received at least the header of the packet
-		t1 = MiWi_TickGet();
-		while (rxBlock.handlingParam.isHeader == FALSE) {				// until we get the whole command - continue try getting it
-			status = TxRx_ReceiveMessage();	
-			if ((status != TXRX_NO_ERROR) && (status != TXRX_NO_PACKET_RECEIVED)) {
-				break;
+	for (i = 0; i < TXRX_RX_BLOCKS; i++) {
+		block = &rxBlockPool[i];
+		if (block->handlingParam.isHeader == FALSE) {
+			if (MiWi_TickGetDiff(now, block->handlingParam.lastTick) > TIMEOUT_RECEIVING_MESSAGE) {
+				block->handlingParam.isHeader = TRUE;			// abandoned (e.g. the stone is retrying the block from its header)
 			}
-			t2 = MiWi_TickGet();
-			if ((MiWi_TickGetDiff(t2, t1)) > TIMEOUT_RECEIVING_MESSAGE) { // waits a few seconds to get the whole command
-				status = TXRX_PARTIAL_PACKET_RECEIVED;
-				break;
+			else if ((block->handlingParam.isAltSrcAddr == rxMessage.flags.bits.altSrcAddr) &&
+					 (block->handlingParam.srcAddr[0] == rxMessage.SourceAddress[0]) &&
+					 (block->handlingParam.srcAddr[1] == rxMessage.SourceAddress[1])) {
+				block->handlingParam.lastTick = now;
+				rxFromStone = TxRx_GetStone(block->handlingParam.eui0);
+				rxBlock = block;
+				return TRUE;
 			}
 		}
+		if ((block->handlingParam.isHeader == TRUE) && (freeBlock == NULL)) {
+			freeBlock = block;
+		}
 	}
-	
-	return status;
+	if (freeBlock == NULL) {
+		return FALSE;
+	}
+	#if defined ENABLE_ZERO_COPY_RX
+	TxRx_ReleaseRxBlock(freeBlock);						// the buffer is cleared below, not the frame
+	#endif
+	for (i = 0; i < MAX_BLOCK_SIZE; i++) {
+		freeBlock->blockBuffer[i] = '\0';
+	}
+	freeBlock->blockHeader.blockType = 0;
+	freeBlock->blockHeader.blockLen = 0;
+	freeBlock->handlingParam.isTrailer = FALSE;
+	freeBlock->handlingParam.blockPos = 0;
+	freeBlock->handlingParam.isAltSrcAddr = rxMessage.flags.bits.altSrcAddr;
+	freeBlock->handlingParam.srcAddr[0] = rxMessage.SourceAddress[0];
+	freeBlock->handlingParam.srcAddr[1] = rxMessage.SourceAddress[1];
+	freeBlock->handlingParam.lastTick = now;
+	rxBlock = freeBlock;
+	return TRUE;
 }
 
+#if defined ENABLE_USB_FRAMING
 /******************************************************************************
-YS 30.11
-This function was written in order to prevent overflows which cause an
-arithmetic trap to occur.
-******************************************************************************/
-BYTE TxRx_ByteAdd(BYTE toAdd, BYTE addingTo) {
+* Function:
+*		void TxRx_WriteFrame(BYTE eui0, BYTE *block, WORD blockLen)
+* Description:
+*		Writes a data block of the stone to the host as a USB frame (see 
+*		ENABLE_USB_FRAMING in TxRx.h).
+*******************************************************************************/
+void TxRx_WriteFrame(BYTE eui0, BYTE *block, WORD blockLen) {
 
-	if (toAdd >= 0xFF - addingTo) {
-		return 0xFF;	// YL toAdd is 0xFF max, and then addingTo is 0, so there is no need to split to different cases; does the code reflect the original intention?
+	BYTE	frameHeader[USB_FRAME_HEADER_SIZE];
+	BYTE	frameCRC[USB_FRAME_CRC_SIZE];
+	WORD	crc = 0;
+	WORD	i;
+	
+	frameHeader[0] = USB_FRAME_SYNC_0;
+	frameHeader[1] = USB_FRAME_SYNC_1;
+	frameHeader[2] = eui0;
+	frameHeader[3] = EUI_1;
+	frameHeader[4] = (BYTE)(blockLen >> 8);
+	frameHeader[5] = (BYTE)blockLen;
+	for (i = 2; i < USB_FRAME_HEADER_SIZE; i++) {
+		crc = CRC16_BYTE(crc, frameHeader[i]);
 	}
-	return addingTo + toAdd;
+	for (i = 0; i < blockLen; i++) {
+		crc = CRC16_BYTE(crc, block[i]);
+	}
+	frameCRC[0] = (BYTE)(crc >> 8);
+	frameCRC[1] = (BYTE)crc;
+	b_write(frameHeader, USB_FRAME_HEADER_SIZE);
+	b_write(block, blockLen);
+	b_write(frameCRC, USB_FRAME_CRC_SIZE);
 }
+#endif // ENABLE_USB_FRAMING
 
-#if defined ENABLE_TXRX_ACK // YL 25.12 added #ifdef
 /******************************************************************************
-YS 22.12
-This function resets the ACK sequencers.
-******************************************************************************/
-void TxRx_Reset_ACK_Sequencers() { // YS 22.12
-	
-	txBlock.blockHeader.ackSeq = 1; 
-	#if defined WISDOM_STONE
-		blockAckInfo.txLastSeq = 0;
-		blockAckInfo.txExpectedSeq = 1;
-		blockAckInfo.rxLastSeq = 0;
-		blockAckInfo.rxExpectedSeq = 1;
-	#elif defined COMMUNICATION_PLUG
-	BYTE i;
-	for (i = 1; i < MAX_NWK_SIZE; i++) {  	// index "0" (the plug) is irrelevant // TODO - check
-		blockAckInfo[i].txLastSeq = 0;
-		blockAckInfo[i].txExpectedSeq = 1;
-		blockAckInfo[i].rxLastSeq = 0;
-		blockAckInfo[i].rxExpectedSeq = 1;
+* Function:
+*		STONE_ENTRY* TxRx_GetStone(BYTE eui0)
+* Return value:
+*		The entry of the device with the given EUI_0, or NULL if it is unknown
+*******************************************************************************/
+STONE_ENTRY* TxRx_GetStone(BYTE eui0) {
+
+	if ((eui0 > MAX_NWK_ADDR_EUI0) || (stoneSlot[eui0] == 0)) {
+		return NULL;
 	}
-	#endif
+	return &stoneTable[stoneSlot[eui0] - 1];
 }
-#endif // ENABLE_TXRX_ACK
 
 /******************************************************************************
 * Function:
-* 		int TxRx_PrintError(TXRX_ERRORS error)
-******************************************************************************/
-int TxRx_PrintError(TXRX_ERRORS error) {
-	
-	#if defined COMMUNICATION_PLUG		
-		m_write(TxRx_err_messages[error]);
-	#endif // COMMUNICATION_PLUG
+*		STONE_ENTRY* TxRx_AddStone(BYTE eui0)
+* Description:
+*		Returns the entry of the device with the given EUI_0; the entry is 
+*		allocated (with initial ack sequences and base link rate) when the
+*		device is not known yet.
+* Return value:
+*		NULL if eui0 is not a device address, or stoneTable is full
+*******************************************************************************/
+STONE_ENTRY* TxRx_AddStone(BYTE eui0) {
 
-	write_eol();
-	return (-1);
+	STONE_ENTRY *stone = TxRx_GetStone(eui0);
+	
+	if (stone != NULL) {
+		return stone;
+	}
+	if ((eui0 == BROADCAST_NWK_ADDR) || (eui0 > MAX_NWK_ADDR_EUI0) || (stoneCount == MAX_NWK_SIZE)) {
+		return NULL;
+	}
+	stone = &stoneTable[stoneCount];
+	stone->eui0 = eui0;
+	stone->parentEUI0 = 0xFF;
+	stone->isNetworkMember = FALSE;
+	stone->isCoordinator = FALSE;
+	stone->isStopped = FALSE;
+	stone->isReplyPending = FALSE;
+	stone->replyTag = 0;
+	#if defined ENABLE_LOW_POWER_LISTEN
+		stone->isDozing = FALSE;
+		stone->lplTick = MiWi_TickGet();
+	#endif
+	stone->ackInfo.txLastSeq = 0;
+	stone->ackInfo.txExpectedSeq = 1;
+	stone->ackInfo.rxLastSeq = 0;
+	stone->ackInfo.rxExpectedSeq = 1;
+	#if defined ENABLE_CUMULATIVE_ACK
+		stone->ackPending = 0;
+	#endif
+	#if defined ENABLE_LINK_RATE_ADAPTATION
+		stone->linkRate = BASE_LINK_RATE;
+	#endif
+	#if defined ENABLE_TDMA_UPLOAD
+		stone->slotShift = TDMA_NO_SLOT;
+		stone->slotUsed = 0;
+		stone->slotIdle = 0;
+	#endif
+	memset(&stone->stats, 0, sizeof(stone->stats));
+	#if defined ENABLE_TXRX_SECURITY
+		TxRx_SecReplayInit(stone);
+	#endif
+	stoneSlot[eui0] = ++stoneCount;
+	return stone;
 }
 
-//OOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOO
-#if defined COMMUNICATION_PLUG
-//OOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOO
-
 /******************************************************************************
 * Function:
-*		void TxRx_AppStop(void)
+*		STONE_ENTRY* TxRx_JoinStone(BYTE eui0, BYTE parentEUI0)
 * Description:
-*		TxRx_AppStop updates isStopped array only if isAppStop is TRUE
-*		(the command "app stop" is sent separately)
-* Parameters:
-*		None
+*		Marks the stone as a network member (join-info). A stone joins through
+*		a parent that is already a member; only the network-starter has no
+*		parent (0xFF).
 * Return value:
-*		None
+*		The entry of the stone, or NULL if eui0 is not a stone address, the 
+*		parent is not a member, or stoneTable is full
 *******************************************************************************/
-void TxRx_AppStop(void) {
-		
-	if (isBroadcast == FALSE) {	
-		// update isStopped array at "EUI_0 of the stone" index:
-		if (isAppStop == TRUE) {
-			isStopped[(finalDestinationNwkAddress[0])] = TRUE;			
-		}
-		else {
-			isStopped[(finalDestinationNwkAddress[0])] = FALSE;			
-		}
+STONE_ENTRY* TxRx_JoinStone(BYTE eui0, BYTE parentEUI0) {
+
+	STONE_ENTRY *stone;
+	STONE_ENTRY *parent;
+	
+	if ((eui0 == BROADCAST_NWK_ADDR) || (eui0 > MAX_STONE_ADDR_EUI0)) {
+		return NULL;
 	}
-	else {	
-		// in case of broadcast - update the whole isStopped array:
-		BYTE i;	
-		if (isAppStop == TRUE) {		
-			for (i = 1; i < MAX_NWK_SIZE; i++) {	// index "0" (the plug) is irrelevant
-				isStopped[i] = TRUE;
-			}
+	if (parentEUI0 == 0xFF) {
+		if (eui0 != NWK_STARTER_ADDR_EUI0) {
+			return NULL;
 		}
-		else {		
-			for (i = 1; i < MAX_NWK_SIZE; i++) {	// index "0" (the plug) is irrelevant
-				isStopped[i] = FALSE;
-			}
+	}
+	else {
+		parent = TxRx_GetStone(parentEUI0);
+		if ((parentEUI0 == eui0) || (parent == NULL) || (parent->isNetworkMember == FALSE)) {
+			return NULL;
 		}
 	}
-	return;
+	stone = TxRx_AddStone(eui0);
+	if (stone == NULL) {
+		return NULL;
+	}
+	stone->parentEUI0 = parentEUI0;
+	stone->isNetworkMember = TRUE;
+	return stone;
 }
 
 /******************************************************************************
@@ -1655,7 +5504,7 @@ void TxRx_PrintNetworkTopology(void) {
 	while (1) {		
 		TxRx_ReceiveJoinInfo();
 		t2 = MiWi_TickGet();
-		if (currentNwkSize == MAX_NWK_SIZE || 
+		if (stoneCount == MAX_NWK_SIZE || 
 			MiWi_TickGetDiff(t2, t1) > TIMEOUT_NWK_ESTABLISHMENT) {
 			break;
 		}
@@ -1664,16 +5513,12 @@ void TxRx_PrintNetworkTopology(void) {
 	write_eol();
 	write_eol();
 	m_write("NETWORK COORDINATORS: ");
-	BYTE eui0;
-	for (eui0 = 0; eui0 < MAX_NWK_SIZE; eui0++) {
-		if (isCoordinator[eui0] == TRUE) {
-			if (eui0 == 0) {
-				m_write(byte_to_str(PLUG_NWK_ADDR_EUI0));
-			}
-			else {
-				m_write(byte_to_str(eui0));
-			}
-			if (eui0 == NWK_STARTER_ADDR_EUI0) {
+	BYTE i;
+	STONE_ENTRY *stone;
+	for (i = 0; i < stoneCount; i++) {
+		if (stoneTable[i].isCoordinator == TRUE) {
+			m_write(byte_to_str(stoneTable[i].eui0));
+			if (stoneTable[i].eui0 == NWK_STARTER_ADDR_EUI0) {
 				m_write(" (PAN)");
 			}
 			m_write("  ");
@@ -1684,12 +5529,16 @@ void TxRx_PrintNetworkTopology(void) {
 	m_write("NETWORK MEMBERS:");
 	write_eol();
 	// the stones:
-	for (eui0 = 1; eui0 < MAX_NWK_SIZE; eui0++) {
+	for (i = 0; i < stoneCount; i++) {
+		stone = &stoneTable[i];
+		if (stone->eui0 == PLUG_NWK_ADDR_EUI0) {
+			continue;
+		}
 		m_write("\tSTONE eui0# - ");
-		m_write(byte_to_str(eui0));
-		if (isNetworkMember[eui0] == TRUE) {
+		m_write(byte_to_str(stone->eui0));
+		if (stone->isNetworkMember == TRUE) {
 			m_write(": yes, PARENT eui0# - ");
-			m_write(byte_to_str(parentDeviceEUI0[eui0]));
+			m_write(byte_to_str(stone->parentEUI0));
 		}
 		else {
 			m_write(": no");
@@ -1702,9 +5551,10 @@ void TxRx_PrintNetworkTopology(void) {
 	// the plug:
 	m_write("\tPLUG  eui0# - ");
 	m_write(byte_to_str(PLUG_NWK_ADDR_EUI0));
-	if (isNetworkMember[0] == TRUE) {
+	stone = TxRx_GetStone(PLUG_NWK_ADDR_EUI0);
+	if ((stone != NULL) && (stone->isNetworkMember == TRUE)) {
 		m_write(": yes, PARENT eui0# - ");
-		m_write(byte_to_str(parentDeviceEUI0[0]));
+		m_write(byte_to_str(stone->parentEUI0));
 	}
 	else {
 		m_write(": no");
@@ -1780,7 +5630,12 @@ BOOL TxRx_ExecuteIfPlugCommand(void) {
 		
 	switch (finalDestinationNwkAddress[0]) {	
 		case PLUG_NWK_ADDR_EUI0:	
-			TxRx_Reconnect();	// execute the only plug command 
+			if (strcmp("txrx", g_tokens[1]) == 0) {		// handle_plug_msg left "txrx <sub command>" in g_curr_msg
+				handle_msg(g_curr_msg);
+			}
+			else {
+				TxRx_Reconnect();
+			}
 			return TRUE;
 		case BROADCAST_NWK_ADDR:	
 			isBroadcast = TRUE;	
@@ -3955,6 +3955,99 @@ BOOL MiApp_ProtocolInit(BOOL bNetworkFreezer)
     
     }
 
+    #if defined(ENABLE_FAST_REJOIN)
+    /*********************************************************************
+     * Function:        void MiApp_GetNetworkState(NETWORK_STATE *state)
+     *
+     * PreCondition:    The node has started or joined a network
+     *
+     * Output:          The network state of the node in state
+     *
+     * Overview:        This function copies what the network freezer 
+     *                  would keep in NVM
+     ********************************************************************/
+    void MiApp_GetNetworkState(NETWORK_STATE *state)
+    {
+        BYTE i;
+        
+        state->PANID.Val = myPANID.Val;
+        state->ShortAddress.Val = myShortAddress.Val;
+        state->Channel = currentChannel;
+        state->Parent = myParent;
+        #if defined(NWK_ROLE_COORDINATOR)
+            state->Role = role;
+            state->KnownCoordinators = knownCoordinators;
+            for(i = 0; i < 8; i++)
+            {
+                state->RoutingTable[i] = RoutingTable[i];
+            }
+        #endif
+        for(i = 0; i < CONNECTION_SIZE; i++)
+        {
+            state->ConnectionTable[i] = ConnectionTable[i];
+        }
+    }
+    
+    /*********************************************************************
+     * Function:        BOOL MiApp_ResumeNetwork(NETWORK_STATE *state)
+     *
+     * PreCondition:    MiApp_ProtocolInit(FALSE) has been called
+     *
+     * Input:           state   - the network state from MiApp_GetNetworkState
+     *
+     * Output:          TRUE if the node operates in the network again
+     *
+     * Overview:        This function restores the network state, like the
+     *                  network freezer in MiApp_ProtocolInit, and confirms
+     *                  the link to the parent with a data request: the MAC
+     *                  of the parent acknowledges it, and its MiWi layer 
+     *                  ignores it (no indirect messages).
+     ********************************************************************/
+    BOOL MiApp_ResumeNetwork(NETWORK_STATE *state)
+    {
+        BYTE i;
+        
+        if( state->Channel >= 32 || state->ShortAddress.Val == 0xFFFF )
+        {
+            return FALSE;
+        }
+        
+        myPANID.Val = state->PANID.Val;
+        myShortAddress.Val = state->ShortAddress.Val;
+        currentChannel = state->Channel;
+        myParent = state->Parent;
+        #if defined(NWK_ROLE_COORDINATOR)
+            role = state->Role;
+            knownCoordinators = state->KnownCoordinators;
+            for(i = 0; i < 8; i++)
+            {
+                RoutingTable[i] = state->RoutingTable[i];
+            }
+            MiWiCapacityInfo.bits.Role = role;
+        #endif
+        for(i = 0; i < CONNECTION_SIZE; i++)
+        {
+            ConnectionTable[i] = state->ConnectionTable[i];
+        }
+        
+        MiMAC_SetAltAddress(myShortAddress.v, myPANID.v);
+        MiApp_SetChannel(currentChannel);
+        MiWiStateMachine.bits.memberOfNetwork = 1;
+        
+        if( myParent < CONNECTION_SIZE )
+        {
+            MAC_FlushTx();
+            MiApp_WriteData(MAC_COMMAND_DATA_REQUEST);
+            if( SendMACPacket(myPANID.v, ConnectionTable[myParent].Address, PACKET_TYPE_COMMAND, 0) == FALSE )
+            {
+                MiWiStateMachine.bits.memberOfNetwork = 0;
+                return FALSE;
+            }
+        }
+        return TRUE;
+    }
+    #endif
+
     #if defined(ENABLE_SLEEP) /*YL ENABLE_SLEEP isn't defined; commented the following lines*/
     /************************************************************************************
      * Function:
@@ -4475,6 +4568,22 @@ void MiApp_DiscardMessage(void)
     MiWiStateMachine.bits.RxHasUserData = 0;
     MiMAC_DiscardPacket();    
 }    
+
+/*******************************************************************************
+BYTE MiApp_RetainMessage(void)
+*******************************************************************************/    
+BYTE MiApp_RetainMessage(void)
+{
+    return MiMAC_RetainPacket();
+}
+
+/*******************************************************************************
+void MiApp_ReleaseMessage(BYTE handle)
+*******************************************************************************/    
+void MiApp_ReleaseMessage(BYTE handle)
+{
+    MiMAC_ReleasePacket(handle);
+}
     
 /************************************************************************************
  * Function:
@@ -128,6 +128,7 @@ void  __attribute__((interrupt, auto_psv)) _INT2Interrupt(void) {
 		if ((g_accmtr_blk_buff_w_ptr & 0x01FF) == (LAST_DATA_BYTE + 1)) {		// check if last data byte was written; block tail starts with [RETRY | HW_OVERFLOW | SW_OVERFLOW] counters and is padded with 'x'
 			blockNum = ((g_accmtr_blk_buff_w_ptr & (0xFE00)) >> 9);				// dividing g_accmtr_blk_buff_w_ptr by 512; blockNum indicates what buffer was filled
 			g_accmtr_is_blk_rdy[blockNum] = 1;									// notify that block[blockNum] was filled and ready to be sent through usb/wireless, or saved to flash
+			post_event(EVENT_BLOCK_READY);
 			// YL 9.12 ... was:
 			// g_accmtr_blk_buff[++g_accmtr_blk_buff_w_ptr] = g_accmtr_overflow_cntr;		// put in the 505 place of the current block the overflow status
 			// g_accmtr_blk_buff[++g_accmtr_blk_buff_w_ptr] = g_accmtr_blk_overflow_cntr; 	// put in the 506 place of the current block the overflow cyclic buffer status			
@@ -150,6 +151,7 @@ void  __attribute__((interrupt, auto_psv)) _INT2Interrupt(void) {
 	if ((g_accmtr_blk_buff_w_ptr & 0x01FF) == (LAST_DATA_BYTE + 1)) {						
 		blockNum = ((g_accmtr_blk_buff_w_ptr & (0xFE00)) >> 9);								
 		g_accmtr_is_blk_rdy[blockNum] = 1; 													
+		post_event(EVENT_BLOCK_READY);
 		g_accmtr_blk_buff[HW_OVERFLOW_LOCATION] = g_accmtr_overflow_cntr; 				
 		g_accmtr_blk_buff[SW_OVERFLOW_LOCATION] = g_accmtr_blk_overflow_cntr; 			
 		g_accmtr_overflow_cntr = 0;
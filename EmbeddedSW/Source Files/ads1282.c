@@ -105,6 +105,7 @@ void  __attribute__((interrupt, auto_psv)) _INT3Interrupt(void) { //YL 8.12 TODO
 	if ((g_ads1282_blk_buff_w_ptr & 0x01FF) >= (MAX_BLOCK_SIZE - 8)) {				//if reached max num of bytes in block	
 		blk_num = ((g_ads1282_blk_buff_w_ptr & (0xFE00)) >> 9);						//dividing g_ads1282_blk_buff_w_ptr by 512	
 		g_ads1282_is_blk_rdy[blk_num] = 1; 											//notify that block[blk_num] was filled and ready to be sent through usb/wireless, or saved to flash
+		post_event(EVENT_BLOCK_READY);
 		g_ads1282_blk_buff[g_ads1282_blk_buff_w_ptr + 2] = g_ads1282_blk_overflow_cntr; 			//put in the 506 place of the current block the overflow cyclic buffer status
 		g_ads1282_blk_overflow_cntr = 0;
 		g_ads1282_blk_buff_w_ptr = ((g_ads1282_blk_buff_w_ptr + 8) & (CYCLIC_BLOCK_MASK));	//put the buffer pointer to the next block
@@ -22,7 +22,10 @@ this file contains functions for handling application tasks.
 - start sampling/storing/transmitting according to:
 	- <mode> = SS - Sample and Store mode for num_of_blocks x 0.5KB samples
 	- <mode> = TS - Transmit Samples mode for num_of_blocks x 0.5KB samples
-	- <mode> = OST - Online Sample and Transmit mode for num_of_blocks x 0.5KB samples
+	- <mode> = OST - Online Sample and Transmit mode for num_of_blocks x 0.5KB samples,
+	optionally decimated by 2, 4 or 8 before transmission (see decimator.c)
+	- <mode> = TEE - Sample and Store num_of_blocks x 0.5KB samples, and at the same
+	time transmit them on-line, optionally decimated (SS + OST in a single session)
 - app stop
 - app sleep
 using HW implemented SPI1 module in PIC to access the FLASH.
@@ -37,20 +40,35 @@ using HW implemented SPI1 module in PIC to access the FLASH.
 
 #include "app.h"				//Application
 #include "command.h"			//Application
+#include "decimator.h"			//Application
 #include "error.h"				//Application
 #include "parser.h"				//Application
+#include "soft_timer.h"			//Application
 #include "misc_c.h"				//Common	
 #include "p24FJ256GB110.h"		//Common	
 #include "accelerometer.h"		//Devices
 #include "ads1282.h"			//Devices	
+#include "eeprom.h"				//Devices
 #include "flash.h"				//Devices
 #include "rtc.h"				//Devices
 #include "TxRx.h"				//TxRx - Application
+#include "led_buzzer.h"			//Devices (after TxRx.h, for ENABLE_TIME_SYNC)
 #include "TimeDelay.h"			//TxRx - Common
+#include "SymbolTime.h"			//TxRx - Common
 //#include "P2P.h"				//TxRx - Protocols
 #include "Compiler.h"
 #include "wistone_usb.h"
 
+/***** DEFINE: ****************************************************************/
+#define TS_PAUSE_MS		100		// YS 10.11 - mail instruction: pause after reading each FLASH sector
+
+// handle_TS() stages - each main iteration runs one of them:
+enum {
+	TS_READ = 0,				// read a sector, and start TIMER_TS_PAUSE
+	TS_PAUSE,					// wait for TIMER_TS_PAUSE (the main loop goes on meanwhile)
+	TS_SEND						// transmit the sector
+};
+
 /***** GLOBAL VARIABLES: ******************************************************/
 int 	g_mode = MODE_IDLE;
 int 	g_communication = COMM_NONE; 	//YL 5.8 was: g_destination		
@@ -63,12 +81,16 @@ int 	g_single_dual_mode;
 BYTE 	g_accmtr_next_printed_blk;
 BYTE 	g_ads1282_next_printed_blk;
 long	g_accmtr_num_of_blocks;
+BYTE	g_ts_stage = TS_READ;
 
 /***** INTERNAL PROTOTYPES: ***************************************************/
 int 	handle_application_start(void);	
 void 	handle_application_stop(void);	
 int 	handle_active_mode(void); 
 void 	send_start_block(void);
+void 	ost_send_block(BYTE *blk);
+int 	ost_stream_block(BYTE *blk, BOOL is_accmtr);
+int 	parse_decimation(int token);
 int 	sampler_start(void);		
 void 	sampler_stop(void);	
 void 	handle_application_sleep(void); 	
@@ -168,16 +190,24 @@ void handle_SS(void)
 // handle_TS()
 // handle Transmit Samples mode:
 // read and transmit samples stored in FLASH.
+// the pause after each read is a soft timer, so the main loop keeps handling
+// commands (and idles) meanwhile.
 *******************************************************************************/
 void handle_TS(void)
 { 	
-	int				i, res = 0;
-	static BOOL		toggleTS = TRUE; 											// toggle reading and transmitting each main iteration
+	int				i;
+	static int		res = 0;
 	TXRX_ERRORS		status;
 	
-	if (toggleTS == TRUE) {
+	if (g_ts_stage == TS_READ) {
 		res = flash_read_sector(g_sector_addr_ptr, g_accmtr_blk_buff);			// read 1 block from FLASH into start of the buffer
-		DelayMs(100); // YS 10.11 - mail instruction 
+		soft_timer_start(TIMER_TS_PAUSE, TS_PAUSE_MS, TIMER_ONE_SHOT, NULL, EVENT_TIMER);
+		g_ts_stage = TS_PAUSE;
+		return;
+	}
+	if (g_ts_stage == TS_PAUSE) {
+		if (soft_timer_is_running(TIMER_TS_PAUSE) == TRUE)
+			return;
 		if (res < 0) {															// retry read from FLASH
 			res = flash_read_sector(g_sector_addr_ptr, g_accmtr_blk_buff);		// read 1 block from FLASH into start of the buffer
 			if (res < 0) { 														// if still fails, fill buffer with FF
@@ -186,6 +216,7 @@ void handle_TS(void)
 			}
 		}
 		g_sector_addr_ptr++;
+		g_ts_stage = TS_SEND;
 	}
 	else {
 		if (g_communication == COMM_WIRELESS) {	
@@ -210,85 +241,139 @@ void handle_TS(void)
 		else // COMM_USB
 			b_write(g_accmtr_blk_buff, MAX_BLOCK_SIZE);				
 		g_num_of_blocks--;
+		g_ts_stage = TS_READ;
 	}
 	if (g_num_of_blocks <= 0) {
 		handle_application_stop();		
 	}
-	toggleTS = !toggleTS;	
 }
 
 /*******************************************************************************
 // handle_OST()
 // handle Online Sample and Transmit mode:
 // - go over the blocks and check if ready
-// - if ready, try to TX the block up to two times
-// - if second time failed, skip current block
+// - if ready, transmit the block (or feed it to the decimator, and transmit 
+//   the decimated blocks it completes)
 // - do the same for Accelerometer and ADS1282
+// - g_accmtr_num_of_blocks counts the transmitted Accelerometer blocks
 *******************************************************************************/
 void handle_OST(void)
 {	 
-	TXRX_ERRORS		status;
-	
-	// go over all the ADC blocks that are in the cyclic buffer, starting from the g_accmtr_next_printed_blk.
-	while (g_ads1282_is_blk_rdy[g_ads1282_next_printed_blk] == 1) { 															// if the next_block is filled by the sampler, then it is ready to be saved to the flash.
-		if (g_communication == COMM_WIRELESS) {																					// if the destination of the sending is wireless
-			// YL 9.12 ... added #ifdef + replaced 504 with RETRY_COUNTER_LOCATION
-			// was:
-			// g_ads1282_blk_buff[(g_ads1282_next_printed_blk * MAX_BLOCK_SIZE) + 504] = blockTryTxCounter;						// put the number of transmission needed in the previous block..
-			// blockTryTxCounter = 0; 	// YS 25.1
-			#if defined ENABLE_RETRANSMISSION
-				g_ads1282_blk_buff[(g_ads1282_next_printed_blk * MAX_BLOCK_SIZE) + RETRY_COUNTER_LOCATION] = blockTryTxCounter;	// put the number of transmission needed in the previous block..
-				blockTryTxCounter = 0; 	// YS 25.1
-			#endif
-			// ... YL 9.12
-			status = TxRx_SendData(&g_ads1282_blk_buff[g_ads1282_next_printed_blk * MAX_BLOCK_SIZE], MAX_BLOCK_SIZE);			// send the data through the wireless.
-			while (status != TXRX_NO_ERROR) {
-				TxRx_PrintError(status);
-				//TxRx_Init(TRUE); 	//YS 5.10 //YS 17.11
-				status = TxRx_SendData(&g_accmtr_blk_buff[g_ads1282_next_printed_blk * MAX_BLOCK_SIZE], MAX_BLOCK_SIZE);		// YS 17.11
-			}
-			//YS 25.1
-		}		
-		else { 
-			b_write(&g_ads1282_blk_buff[g_ads1282_next_printed_blk * MAX_BLOCK_SIZE], MAX_BLOCK_SIZE);							// else print it through the usb.
-		}
+	// go over all the ADC blocks that are in the cyclic buffer, starting from the g_ads1282_next_printed_blk.
+	while (g_ads1282_is_blk_rdy[g_ads1282_next_printed_blk] == 1) { 															// if the next_block is filled by the sampler, then it is ready to be transmitted.
+		ost_stream_block(&g_ads1282_blk_buff[g_ads1282_next_printed_blk * MAX_BLOCK_SIZE], FALSE);
 		g_ads1282_is_blk_rdy[g_ads1282_next_printed_blk] = 0;
 		g_ads1282_next_printed_blk = (g_ads1282_next_printed_blk + 1) % (CYCLIC_BUFFER_SIZE);									// g_ads1282_next_printed_blk points to the next block..
 	}
 	
 	// go over Accmtr blocks:
-	while (g_accmtr_is_blk_rdy[g_accmtr_next_printed_blk] == 1) { 																// if the next_block is filled by the sampler, then it is ready to be saved to the flash.
-		if (g_communication == COMM_WIRELESS) {																					// if the destination of the sending is wireless
-			// YL 9.12 ... added #ifdef + replaced 504 with RETRY_COUNTER_LOCATION
-			// was: 
-			// g_accmtr_blk_buff[(g_accmtr_next_printed_blk * MAX_BLOCK_SIZE) + 504] = blockTryTxCounter;
-			// blockTryTxCounter = 0; 	// YS 25.1
-			#if defined ENABLE_RETRANSMISSION
-				g_accmtr_blk_buff[(g_accmtr_next_printed_blk * MAX_BLOCK_SIZE) + RETRY_COUNTER_LOCATION] = blockTryTxCounter;	// put the number of transmission needed in the previous block..
-				blockTryTxCounter = 0; 	// YS 25.1
-			#endif
-			// ... YL 9.12
-			status = TxRx_SendData(&g_accmtr_blk_buff[g_accmtr_next_printed_blk * MAX_BLOCK_SIZE], MAX_BLOCK_SIZE);				// send the data through the wireless.
-			while (status != TXRX_NO_ERROR) { 	// YS 17.11
-				TxRx_PrintError(status);
-				//TxRx_Init(TRUE); 	// YS 5.10 	// YS 17.11
-				status = TxRx_SendData(&g_accmtr_blk_buff[g_accmtr_next_printed_blk * MAX_BLOCK_SIZE], MAX_BLOCK_SIZE);			// YS 17.11
-			}
-			//YS 25.1
-		}		
-		else {
-			b_write(&g_accmtr_blk_buff[g_accmtr_next_printed_blk * MAX_BLOCK_SIZE], MAX_BLOCK_SIZE);							// else print it through the usb.
-		}
-		g_accmtr_num_of_blocks--;
+	while (g_accmtr_is_blk_rdy[g_accmtr_next_printed_blk] == 1) { 																// if the next_block is filled by the sampler, then it is ready to be transmitted.
+		g_accmtr_num_of_blocks -= ost_stream_block(&g_accmtr_blk_buff[g_accmtr_next_printed_blk * MAX_BLOCK_SIZE], TRUE);
 		g_accmtr_is_blk_rdy[g_accmtr_next_printed_blk] = 0;
 		g_accmtr_next_printed_blk = (g_accmtr_next_printed_blk + 1) % (CYCLIC_BUFFER_SIZE);										// g_accmtr_next_printed_blk points to the next block..
-		if(g_accmtr_num_of_blocks <= 0) {																						// if we sampled the amount of blocks needed, then stop the sampler and go to IDLE mode.
+		if(g_accmtr_num_of_blocks <= 0) {																						// if we transmitted the amount of blocks needed, then stop the sampler and go to IDLE mode.
+			handle_application_stop();
+			return;
+		}
+	}
+}
+
+/*******************************************************************************
+// handle_TEE()
+// handle Sample and Store + Online Transmit mode:
+// - for each ready block: copy it into FLASH (as in SS), then stream it (as in OST, 
+//   decimated if required) - both directly from the cyclic buffer, no copy is made
+// - only then release the block to the sampler
+// - stop when all the requested Accelerometer blocks were stored 
+//   (a partially filled decimated block at the end of the session is not transmitted)
+*******************************************************************************/
+void handle_TEE(void)
+{	
+	BYTE	*blk;
+
+	// start with ADC blocks:
+	while (g_ads1282_is_blk_rdy[g_ads1282_next_printed_blk] == 1) {
+		blk = &g_ads1282_blk_buff[MAX_BLOCK_SIZE * g_ads1282_next_printed_blk];
+		flash_write_sector(g_ads1282_sector_addr_ptr, blk);
+		g_ads1282_sector_addr_ptr++;
+		ost_stream_block(blk, FALSE);
+		g_ads1282_is_blk_rdy[g_ads1282_next_printed_blk] = 0;
+		g_ads1282_next_printed_blk = (g_ads1282_next_printed_blk + 1) % (CYCLIC_BUFFER_SIZE);
+	}
+	// continue with Accmtr blocks:
+	while (g_accmtr_is_blk_rdy[g_accmtr_next_printed_blk] == 1) {
+		blk = &g_accmtr_blk_buff[MAX_BLOCK_SIZE * g_accmtr_next_printed_blk];
+		flash_write_sector(g_accmtr_sector_addr_ptr, blk);
+		g_accmtr_sector_addr_ptr++;
+		ost_stream_block(blk, TRUE);
+		g_accmtr_is_blk_rdy[g_accmtr_next_printed_blk] = 0;
+		g_accmtr_next_printed_blk = (g_accmtr_next_printed_blk + 1) % (CYCLIC_BUFFER_SIZE);
+		// check if completed requested number of blocks:
+		g_accmtr_num_of_blocks--;
+		if (g_accmtr_num_of_blocks <= 0) {
 			handle_application_stop();
 			return;
 		}
 	}
 }
 
+/*******************************************************************************
+// ost_stream_block()
+// transmit a sampler block as is, or feed it to the decimator and transmit the 
+// decimated blocks it completes (the decimator may complete an output block in
+// the middle of blk; at most one output block per input block).
+// is_accmtr - TRUE for Accelerometer block, FALSE for ADS1282 block
+// returns the number of transmitted blocks.
+*******************************************************************************/
+int ost_stream_block(BYTE *blk, BOOL is_accmtr)
+{
+	BYTE	*out_blk;
+	int		num_of_sent = 0;
+
+	if (g_decim_factor == 1) {
+		ost_send_block(blk);
+		return 1;
+	}
+	while ((out_blk = (is_accmtr ? decim_accmtr_block(blk) : decim_ads1282_block(blk))) != NULL) {
+		ost_send_block(out_blk);
+		num_of_sent++;
+	}
+	return num_of_sent;
+}
+
+/*******************************************************************************
+// ost_send_block()
+// transmit a single OST block:
+// - wireless: put the number of transmissions needed for the previous block in 
+//   its tail, and retry until the block is sent (OST); in TEE the stream is best
+//   effort - a block that can not be sent at once is dropped, so the radio never 
+//   holds back the FLASH store (it has all the blocks anyway)
+// - usb: print it through the usb
+*******************************************************************************/
+void ost_send_block(BYTE *blk)
+{
+	TXRX_ERRORS		status;
+
+	if (g_communication == COMM_WIRELESS) {																						// if the destination of the sending is wireless
+		#if defined ENABLE_RETRANSMISSION
+			blk[RETRY_COUNTER_LOCATION] = blockTryTxCounter;																	// put the number of transmission needed in the previous block..
+			blockTryTxCounter = 0; 	// YS 25.1
+		#endif
+		if (g_mode == MODE_TEE) {
+			TxRx_TrySendData(blk, MAX_BLOCK_SIZE);
+			return;
+		}
+		status = TxRx_SendData(blk, MAX_BLOCK_SIZE);																			// send the data through the wireless.
+		while (status != TXRX_NO_ERROR) { 	// YS 17.11
+			TxRx_PrintError(status);
+			status = TxRx_SendData(blk, MAX_BLOCK_SIZE);
+		}
+	}		
+	else {
+		b_write(blk, MAX_BLOCK_SIZE);																							// else print it through the usb.
+	}
+}
+
 /*******************************************************************************
 // handle_application()
 // if first token was "app", then handle application commands message:
@@ -327,12 +412,20 @@ int handle_application(int sub_cmd)
 // handle_active_mode()
 // dispatch to relevant handling function according to appropriate mode
 // general app start cmd structure: app start <mode> <start sector address> <num of blocks> <destination> 
+// OST may be followed by: [<decimation> [<cut-off>]], e.g: app start ost 100 wireless dual 4 narrow
+// TEE: app start tee <num of blocks> <start sector address> <communication> <combination mode> [<decimation> [<cut-off>]]
 *******************************************************************************/
 int handle_active_mode(void) 
 {
-	if ((g_ntokens != 5) && (g_ntokens != 6))									// app start may be called only with 6 params //YL 7.11
+	if ((g_ntokens < 5) || (g_ntokens > 9))										// app start may be called only with 6 params (OST - up to 8, TEE - 7 to 9) //YL 7.11
 		return (err(ERR_INVALID_PARAM_COUNT));
 	g_mode = parse_mode(g_tokens[2]);
+	if (((g_mode == MODE_SS || g_mode == MODE_TS) && (g_ntokens > 6)) || 
+		((g_mode == MODE_OST) && (g_ntokens > 8)) || 
+		((g_mode == MODE_TEE) && (g_ntokens < 7))) {
+		g_mode = MODE_IDLE;
+		return (err(ERR_INVALID_PARAM_COUNT));
+	}
 	g_num_of_blocks = parse_long_num(g_tokens[3]);
 	init_block_buffers();
 	switch (g_mode) {
@@ -340,11 +433,28 @@ int handle_active_mode(void)
 		g_communication = parse_communication(g_tokens[4]);
 		g_single_dual_mode = parse_single_dual_mode(g_tokens[5]);				// single sensor or dual sensors to sample
 		g_accmtr_num_of_blocks = g_num_of_blocks;
+		if (parse_decimation(6) != 0) {
+			g_mode = MODE_IDLE;
+			return(-1);
+		}
+		break;
+	case MODE_TEE:
+		g_start_sector_addr = parse_long_num(g_tokens[4]);
+		g_communication = parse_communication(g_tokens[5]);
+		g_single_dual_mode = parse_single_dual_mode(g_tokens[6]);
+		g_accmtr_num_of_blocks = g_num_of_blocks;
+		g_accmtr_sector_addr_ptr = g_start_sector_addr;
+		g_ads1282_sector_addr_ptr = FLASH_SECTOR_ADS1282_OFFSET;
+		if (parse_decimation(7) != 0) {
+			g_mode = MODE_IDLE;
+			return(-1);
+		}
 		break;
 	case MODE_TS:
 		g_start_sector_addr = parse_long_num(g_tokens[4]);						// g_start_sector_addr is relevant only in TS and SS modes
 		g_communication = parse_communication(g_tokens[5]);
 		g_sector_addr_ptr = g_start_sector_addr;
+		g_ts_stage = TS_READ;
 		break;
 	case MODE_SS:
 		g_start_sector_addr = parse_long_num(g_tokens[4]);						// g_start_sector_addr is relevant only in TS and SS modes
@@ -368,13 +478,30 @@ int handle_active_mode(void)
 	return(0);
 }
 
+/*******************************************************************************
+// parse_decimation()
+// parse the optional [<decimation> [<cut-off>]] tokens of OST / TEE, starting at
+// g_tokens[token], and initialize the decimator accordingly.
+// default is no decimation (1) and wide cut-off.
+// returns 0 on success, (-1) otherwise.
+*******************************************************************************/
+int parse_decimation(int token)
+{
+	int		factor = (g_ntokens > token) ? parse_int_num(g_tokens[token]) : 1;
+	int		cutoff = (g_ntokens > token + 1) ? parse_cutoff(g_tokens[token + 1]) : CUTOFF_WIDE;
+
+	if ((factor < 0) || (cutoff < 0))
+		return(-1);
+	return decim_init(factor, cutoff);
+}
+
 /*******************************************************************************
 // handle_application_start()
 *******************************************************************************/
 int handle_application_start(void)	
 {
 	send_start_block();		// we generate a single header block even when dual mode is used
-	if (g_mode == MODE_SS || g_mode == MODE_OST) {
+	if (g_mode == MODE_SS || g_mode == MODE_OST || g_mode == MODE_TEE) {
 		if (sampler_start() != 0)
 			return(-1);
 	}
@@ -387,7 +514,7 @@ int handle_application_start(void)
 *******************************************************************************/
 void handle_application_stop(void)	
 {
-	if (g_mode == MODE_SS || g_mode == MODE_OST)
+	if (g_mode == MODE_SS || g_mode == MODE_OST || g_mode == MODE_TEE)
 		sampler_stop();
 		
 	write_eol();
@@ -401,6 +528,9 @@ void handle_application_stop(void)
 		case MODE_OST:
 			m_write	("OSTCOMPLETED: completed transmitting the requested num of blocks");
 			break;
+		case MODE_TEE:
+			m_write	("TEECOMPLETED: completed storing the requested num of blocks");
+			break;
 		case MODE_IDLE:
 			m_write ("APPSTOPPED: application stopped");
 			break;
@@ -437,6 +567,7 @@ void handle_application_sleep() { // YL handle_application_sleep isn't used mean
 	sampler_stop(); // Puts the sampler to standby mode - its lowest mode
 	// TxRx_SetLowPowerMode();
 	// The watch-dog timer is off  (in OSC1 configuration register FWDTEN_OFF)
+	eeprom_wait_ready(); // Timer4 stops in sleep - let the EEPROM finish its write cycle first
 
 	while (1){	// while we not received "app wake"
 		// Puts the MCU to sleep
@@ -478,7 +609,7 @@ void send_start_block(void)
 	strcat((char*)g_accmtr_blk_buff, " <> Start Sector: ");
 	// YL 22.12 ...
 	// was: strcat((char*)g_accmtr_blk_buff, long_to_str(g_accmtr_sector_addr_ptr));
-	if (g_mode == MODE_SS) 
+	if (g_mode == MODE_SS || g_mode == MODE_TEE) 
 		strcat((char*)g_accmtr_blk_buff, long_to_str(g_accmtr_sector_addr_ptr));
 	else if (g_mode == MODE_TS)	
 		strcat((char*)g_accmtr_blk_buff, long_to_str(g_sector_addr_ptr));
@@ -490,6 +621,23 @@ void send_start_block(void)
 		strcat((char*)g_accmtr_blk_buff, "Both ADS1282 and MMA8451Q");
 	else
 		strcat((char*)g_accmtr_blk_buff, "MMA8451Q only");
+	#if defined ENABLE_TIME_SYNC
+	strcat((char*)g_accmtr_blk_buff, " <> SYNC Phase Error: ");	// in every mode - the session shows the sync state of the stone
+	if (g_sync_locked == FALSE)
+		strcat((char*)g_accmtr_blk_buff, "not synced");
+	else {
+		if (g_sync_phase_error < 0)
+			strcat((char*)g_accmtr_blk_buff, "-");	// long_to_str() does not handle negative numbers
+		strcat((char*)g_accmtr_blk_buff, long_to_str((long)((g_sync_phase_error < 0) ? -g_sync_phase_error : g_sync_phase_error) * (1000000 / SYMBOL_TIMER_FREQ)));
+		strcat((char*)g_accmtr_blk_buff, " uSec, level ");
+		strcat((char*)g_accmtr_blk_buff, byte_to_str(TxRx_TimeSyncLevel()));
+	}
+	#endif // ENABLE_TIME_SYNC
+	if (g_mode == MODE_OST || g_mode == MODE_TEE) {
+		strcat((char*)g_accmtr_blk_buff, " <> Decimation: ");
+		strcat((char*)g_accmtr_blk_buff, int_to_str(g_decim_factor));
+		strcat((char*)g_accmtr_blk_buff, (g_decim_cutoff == CUTOFF_NARROW) ? " narrow" : " wide");
+	}
 	strcat((char*)g_accmtr_blk_buff, " <> Start Time: ");
 	rtc_get_time_date(&tad);
 	strcat((char*)g_accmtr_blk_buff, byte_to_str(tad.date.day));
@@ -511,11 +659,11 @@ void send_start_block(void)
 	strcat((char*)g_accmtr_blk_buff, int_to_str(accmtr_reg_read(XYZ_DATA_CFG)));
 
 	// transmit the header block:
-	if (g_mode == MODE_SS) {
+	if (g_mode == MODE_SS || g_mode == MODE_TEE) {
 		flash_write_sector(g_accmtr_sector_addr_ptr, g_accmtr_blk_buff); 		//transmit block from memory buffer
 		g_accmtr_sector_addr_ptr++;
 	}
-	else { 		// MODE_TS, MODE_OST
+	if (g_mode != MODE_SS) { 	// MODE_TS, MODE_OST, MODE_TEE
 		if (g_communication == COMM_WIRELESS)
 			TxRx_SendData(g_accmtr_blk_buff, MAX_BLOCK_SIZE);
 		else  	// COMM_USB
@@ -30,6 +30,7 @@ handle read and write, write msgs to terminal, etc.
 #include "system.h"						//Application
 #include "wistone_main.h"				//Application
 #include "eeprom.h"						//Devices	//YL 18.9 for boot cmds	
+#include "soft_timer.h"					//Application
 #include "led_buzzer.h"					//Devices
 #include "rtc.h"						//Devices	//YL 18.9 for RTC wakeup source	
 #ifdef USBCOM							
@@ -52,6 +53,7 @@ CommTypes 	g_usb_or_wireless_print;			// indicate where to send the response to.
 BYTE 		g_character_array[] = {'0','1','2','3','4','5','6','7','8','9','A','B','C','D','E','F'}; // used for USB send HEX numbers //YL 8.12
 BYTE 		g_is_cmd_received;
 BOOL		g_boot_seq_pause = FALSE;			// indicates wait before read next boot command
+BOOL		g_is_bin_cmd = FALSE;				// the current message is a binary command (see parser.h)
 
 //OOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOO
 #if defined WISDOM_STONE
@@ -85,9 +87,12 @@ int exec_message_command(void)
 	// (for example, we got "app stop" while sending blocks and expecting acks), therefore
 	// "g_is_cmd_received" flag indicates that during this period a message was received.
 	if (g_is_cmd_received == 1) {
+		g_usb_or_wireless_print = COMM_WIRELESS;
 		handle_msg(g_in_msg);
+		TxRx_FlushReply();							// the reply to a broadcast command waits for its slot
 		g_is_cmd_received = 0;
-	}	
+	}
+	TxRx_BackgroundTasks();							// the reply and the data blocks that wait for their slot
 	if (MiApp_MessageAvailable()) {					// check for commands from TXRX
 		g_usb_or_wireless_print = COMM_WIRELESS;
 		TXRX_ERRORS status = TxRx_PeriodTasks();	// TXRX periodic tasks and check for incoming data
@@ -99,6 +104,8 @@ int exec_message_command(void)
 			// ... YL 16.8
 		}
 		handle_msg(g_in_msg);
+		TxRx_FlushReply();
+		post_event(EVENT_RADIO);					// look again - another frame may be waiting
 	}
 	if (g_rtc_wakeup == TRUE && g_boot_seq_pause == FALSE) {	//YL 18.9
 		if (eeprom_boot_get(boot_cmd_addr)) {
@@ -127,6 +134,8 @@ int exec_message_command(void)
 *******************************************************************************/
 void cmd_ok(void)
 {
+	if (bin_status(ERR_NONE) == TRUE)
+		return;
 	m_write("ok");
 	write_eol();
 }
@@ -146,13 +155,66 @@ int cmd_error(int errid)
 	return -1;
 }
 
+/*******************************************************************************
+// bin_status()
+// send back the status of a binary command that came over the wireless 
+// (see parser.h) instead of its text. return FALSE if the text is sent.
+*******************************************************************************/
+BOOL bin_status(BYTE error)
+{
+#if defined WISDOM_STONE && defined ENABLE_BINARY_COMMANDS
+	char status[3];
+
+	if ((g_is_bin_cmd == FALSE) || (g_usb_or_wireless_print != COMM_WIRELESS))
+		return FALSE;
+	status[0] = BIN_RSP_MARK;
+	status[1] = BIN_RSP_ERROR | error;
+	status[2] = '\0';
+	m_write(status);
+	return TRUE;
+#else
+	return FALSE;
+#endif // WISDOM_STONE, ENABLE_BINARY_COMMANDS
+}
+
+#if defined COMMUNICATION_PLUG
+/*******************************************************************************
+// write_reply()
+// write the reply of a stone to the host, with the text of each binary status 
+// in it (see parser.h) - "ok" or the error message, as cmd_ok()/err() write.
+*******************************************************************************/
+void write_reply(char *reply)
+{
+	char	*p;
+	BYTE	error;
+
+	while ((p = strchr(reply, BIN_RSP_MARK)) != NULL) {
+		b_write((BYTE*)reply, p - reply);
+		if (p[1] == '\0')						// the status was cut
+			return;
+		error = (BYTE)p[1] & ~BIN_RSP_ERROR;
+		if (error == ERR_NONE)
+			m_write("ok");
+		else
+			m_write(get_error_str(error));
+		write_eol();
+		reply = p + 2;
+	}
+	m_write(reply);
+}
+#endif // COMMUNICATION_PLUG
+
 /*******************************************************************************
 // write_eol()
-// send prompt
+// send prompt (and with it the reply that was collected for the wireless)
 *******************************************************************************/
 void write_eol(void)
 {
 	m_write("\r\nWISTONE> ");
+#if defined WISDOM_STONE
+	if (g_usb_or_wireless_print == COMM_WIRELESS)
+		TxRx_FlushOutput();
+#endif // WISDOM_STONE
 }
 
 /*******************************************************************************
@@ -194,9 +256,7 @@ void m_write(char *str)	// AY 7.8
 	#endif // RS232COM, USBCOM
 	}	
 	else if (g_usb_or_wireless_print == COMM_WIRELESS) {
-		DelayMs(20);	
-		m_TxRx_write((BYTE*)str);  	// YL 14.4 added casting to avoid signedness warning
-		DelayMs(20);
+		m_TxRx_write((BYTE*)str);  	// YL 14.4 added casting to avoid signedness warning; collected until the prompt (TxRx_FlushOutput)
 	}
 
 #elif defined COMMUNICATION_PLUG // AY if it is communication_plug, we write only to the usb		
@@ -252,16 +312,29 @@ void put_char_debug(void)
 	i++;
 }
 
+BOOL is_debug_pending(void)
+{
+	return (read_index != write_index);
+}
+
 #endif // DEBUG_PRINT
 
+/*******************************************************************************
+// blink_led_off() - TIMER_LED_BLINK callback
+*******************************************************************************/
+void blink_led_off(void)
+{
+	set_led(0, LED_2);
+}
+
 /*******************************************************************************
 // blink_led() - for debug
+// the LED is turned off 40mSec later, by the TIMER_LED_BLINK callback
 *******************************************************************************/
 void blink_led() 
 {
 	set_led(1, LED_2); //blink LED#2
-	DelayMs(40); 
-	set_led(0, LED_2);
+	soft_timer_start(TIMER_LED_BLINK, 40, TIMER_ONE_SHOT, blink_led_off, NO_EVENT);
 }
 
 /*******************************************************************************
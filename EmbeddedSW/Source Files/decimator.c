@@ -0,0 +1,334 @@
+/*******************************************************************************
+
+decimator.c - decimation filter for Online Sample and Transmit mode
+===================================================================
+
+	Revision History:
+	=================
+ ver 1.00, date: 18.10.26
+		- Initial revision
+
+********************************************************************************
+	General:
+	========
+at 400Hz the accelerometer alone produces ~2.4KB/s, which is close to what the
+wireless link can deliver; dual mode is well beyond it.
+this file implements a fixed point polyphase FIR decimator that sits between the
+cyclic sample buffers and the OST transmitter:
+- decimation factor of 1 (bypass), 2, 4 or 8
+- selectable cut-off (CutoffTypes) - wide (0.8) or narrow (0.5) of the output Nyquist
+- FIR length is (factor x DECIM_TAPS_PER_PHASE), Hamming windowed sinc,
+  Q15 coefficients with DC gain of exactly 1.0 (sum = 32768)
+- the filter is implemented in its transposed polyphase form: each input sample
+  is multiplied by the DECIM_TAPS_PER_PHASE coefficients of its phase only,
+  and accumulated into the partial sums of the outputs it contributes to;
+  there is no delay line and no output is computed just to be thrown away.
+- accelerometer: 3 axes x 16 bit samples, 16x16 -> 32 bit MAC (sum of |h| < 2^16, no overflow)
+- ADS1282: 32 bit samples, 32x16 -> 64 bit MAC
+decimated samples are packed into output blocks with the same layout as the
+sampler blocks (data + BLOCK_TAIL_SIZE tail), so the receiving side parses them
+as usual. the block tail carries the overflow counters accumulated over all the
+input blocks that were folded into the output block.
+*******************************************************************************/
+
+/***** INCLUDE FILES: *********************************************************/
+#include "wistone_main.h"		// Application
+#ifdef WISDOM_STONE
+
+#include "decimator.h"			// Application
+#include "error.h"				// Application
+#include "parser.h"				// Application
+#include "accelerometer.h"		// Devices
+#include "ads1282.h"			// Devices
+
+/***** DEFINE: ****************************************************************/
+#define ACCMTR_NUM_OF_AXES		3
+
+typedef struct {
+	long		acc[DECIM_TAPS_PER_PHASE];	// partial sums of the next DECIM_TAPS_PER_PHASE outputs
+} DECIM_CHANNEL_16;
+
+typedef struct {
+	long long	acc[DECIM_TAPS_PER_PHASE];
+} DECIM_CHANNEL_32;
+
+typedef struct {
+	BYTE		phase;						// taps of the current input sample start at coeffs[phase]
+	BYTE		head;						// acc[head] is the next output to complete
+	int			in_ptr;						// read pointer into the input block (resumed after a full output block)
+	int			out_ptr;					// write pointer into the output block
+} DECIM_STATE;
+
+/***** GLOBAL VARIABLES: ******************************************************/
+BYTE 	g_decim_factor = 1;					// 1 - decimator is bypassed
+int		g_decim_cutoff = CUTOFF_WIDE;
+
+static const int *decim_coeffs = NULL;
+
+static DECIM_STATE		accmtr_state;
+static DECIM_CHANNEL_16	accmtr_channel[ACCMTR_NUM_OF_AXES];
+static BYTE				accmtr_out_blk[MAX_BLOCK_SIZE];
+
+static DECIM_STATE		ads1282_state;
+static DECIM_CHANNEL_32	ads1282_channel;
+static BYTE				ads1282_out_blk[MAX_BLOCK_SIZE];
+
+/*******************************************************************************
+* Tables:
+*		decim_coeffs_<cutoff>_x<factor>
+* Description:
+*		- Q15 low pass FIR coefficients, (factor x DECIM_TAPS_PER_PHASE) taps each
+*		- Hamming windowed sinc, fc = 0.8 (wide) or 0.5 (narrow) x (fs / 2 / factor)
+*		- rounding residue is folded into the two centre taps, so sum = 32768
+*******************************************************************************/
+static const int decim_coeffs_wide_x2[2 * DECIM_TAPS_PER_PHASE] = {
+	89, -207, -983, 0, 5528, 11957, 11957, 5528, 0, -983, -207, 89
+};
+static const int decim_coeffs_wide_x4[4 * DECIM_TAPS_PER_PHASE] = {
+	58, 30, -50, -223, -455, -577, -333, 495, 1933, 3726, 5388, 6392,
+	6392, 5388, 3726, 1933, 495, -333, -577, -455, -223, -50, 30, 58
+};
+static const int decim_coeffs_wide_x8[8 * DECIM_TAPS_PER_PHASE] = {
+	32, 27, 21, 9, -12, -46, -93, -150, -211, -265, -297, -291,
+	-228, -96, 116, 407, 772, 1193, 1645, 2098, 2516, 2866, 3118, 3253,
+	3253, 3118, 2866, 2516, 2098, 1645, 1193, 772, 407, 116, -96, -228,
+	-291, -297, -265, -211, -150, -93, -46, -12, 9, 21, 27, 32
+};
+static const int decim_coeffs_narrow_x2[2 * DECIM_TAPS_PER_PHASE] = {
+	-146, -142, 415, 2436, 5642, 8179, 8179, 5642, 2436, 415, -142, -146
+};
+static const int decim_coeffs_narrow_x4[4 * DECIM_TAPS_PER_PHASE] = {
+	-73, -83, -92, -56, 92, 410, 928, 1625, 2425, 3205, 3828, 4175,
+	4175, 3828, 3205, 2425, 1625, 928, 410, 92, -56, -92, -83, -73
+};
+static const int decim_coeffs_narrow_x8[8 * DECIM_TAPS_PER_PHASE] = {
+	-36, -38, -42, -47, -50, -49, -39, -17, 22, 80, 162, 268,
+	399, 553, 728, 918, 1116, 1316, 1509, 1687, 1841, 1963, 2048, 2092,
+	2092, 2048, 1963, 1841, 1687, 1509, 1316, 1116, 918, 728, 553, 399,
+	268, 162, 80, 22, -17, -39, -49, -50, -47, -42, -38, -36
+};
+
+/***** INTERNAL PROTOTYPES: ***************************************************/
+static void decim_state_reset(DECIM_STATE *state, BYTE *out_blk);
+static void decim_out_blk_reset(DECIM_STATE *state, BYTE *out_blk);
+static void decim_block_enter(DECIM_STATE *state, BYTE *out_blk, BYTE *in_blk);
+
+/*******************************************************************************
+* Function:
+*		decim_init()
+* Description:
+*		select the coefficients table and reset the filter state of both sensors.
+*		should be called before the sampler is started.
+* Parameters:
+*		factor - decimation factor: 1 (bypass), 2, 4 or 8
+*		cutoff - CUTOFF_WIDE or CUTOFF_NARROW
+* Return value:
+*		0 on success, (-1) and ERR_INVALID_DECIM if the parameters are invalid
+*******************************************************************************/
+int decim_init(int factor, int cutoff) {
+
+	BYTE i, j;
+
+	if ((cutoff != CUTOFF_WIDE) && (cutoff != CUTOFF_NARROW))
+		return err(ERR_INVALID_DECIM);
+	switch (factor) {
+		case 1:
+			decim_coeffs = NULL;
+			break;
+		case 2:
+			decim_coeffs = (cutoff == CUTOFF_NARROW) ? decim_coeffs_narrow_x2 : decim_coeffs_wide_x2;
+			break;
+		case 4:
+			decim_coeffs = (cutoff == CUTOFF_NARROW) ? decim_coeffs_narrow_x4 : decim_coeffs_wide_x4;
+			break;
+		case 8:
+			decim_coeffs = (cutoff == CUTOFF_NARROW) ? decim_coeffs_narrow_x8 : decim_coeffs_wide_x8;
+			break;
+		default:
+			return err(ERR_INVALID_DECIM);
+	}
+	g_decim_factor = factor;
+	g_decim_cutoff = cutoff;
+
+	for (i = 0; i < DECIM_TAPS_PER_PHASE; i++) {
+		for (j = 0; j < ACCMTR_NUM_OF_AXES; j++)
+			accmtr_channel[j].acc[i] = 0;
+		ads1282_channel.acc[i] = 0;
+	}
+	decim_state_reset(&accmtr_state, accmtr_out_blk);
+	decim_state_reset(&ads1282_state, ads1282_out_blk);
+
+	return 0;
+}
+
+/*******************************************************************************
+* Function:
+*		decim_accmtr_block()
+* Description:
+*		feed one accelerometer block (ACCMTR_SAMP_SIZE byte samples, big endian
+*		X, Y, Z) to the decimator.
+*		an input block does not hold a whole number of output blocks, so the
+*		output block may fill up in the middle of the input block. in that case
+*		the full output block is returned, and the next call with the same input
+*		block resumes from where it stopped. the caller should therefore loop:
+*      <code>
+*      while ((out_blk = decim_accmtr_block(in_blk)) != NULL)
+*          transmit(out_blk);
+*      release(in_blk);
+*      </code>
+*		the input block is not modified.
+* Parameters:
+*		in_blk - pointer to the sampler block
+* Return value:
+*		pointer to a full output block that should be transmitted before the
+*		next call, or NULL if the input block was fully consumed
+*******************************************************************************/
+BYTE *decim_accmtr_block(BYTE *in_blk) {
+
+	const int	*h;
+	BYTE		axis, k, idx;
+	int			x;
+	long		y;
+
+	decim_block_enter(&accmtr_state, accmtr_out_blk, in_blk);
+	while (accmtr_state.in_ptr <= LAST_DATA_BYTE) {
+		// accumulate the sample of each axis into the outputs it contributes to:
+		for (axis = 0; axis < ACCMTR_NUM_OF_AXES; axis++) {
+			x = (SHORT)(((WORD)in_blk[accmtr_state.in_ptr] << 8) | in_blk[accmtr_state.in_ptr + 1]);
+			accmtr_state.in_ptr += 2;
+			h = &decim_coeffs[accmtr_state.phase];
+			idx = accmtr_state.head;
+			for (k = 0; k < DECIM_TAPS_PER_PHASE; k++) {
+				accmtr_channel[axis].acc[idx] += (long)(*h) * x;
+				h += g_decim_factor;
+				if (++idx == DECIM_TAPS_PER_PHASE)
+					idx = 0;
+			}
+		}
+		if (accmtr_state.phase != 0) {
+			accmtr_state.phase--;
+			continue;
+		}
+		// acc[head] is complete - round, saturate and pack it:
+		for (axis = 0; axis < ACCMTR_NUM_OF_AXES; axis++) {
+			y = (accmtr_channel[axis].acc[accmtr_state.head] + (1L << 14)) >> 15;
+			if (y > 32767)
+				y = 32767;
+			else if (y < -32768)
+				y = -32768;
+			accmtr_channel[axis].acc[accmtr_state.head] = 0;	// becomes the partial sum of the farthest output
+			accmtr_out_blk[accmtr_state.out_ptr++] = (BYTE)(y >> 8);
+			accmtr_out_blk[accmtr_state.out_ptr++] = (BYTE)y;
+		}
+		if (++accmtr_state.head == DECIM_TAPS_PER_PHASE)
+			accmtr_state.head = 0;
+		accmtr_state.phase = g_decim_factor - 1;
+		if (accmtr_state.out_ptr > LAST_DATA_BYTE)				// 504 is a multiple of ACCMTR_SAMP_SIZE
+			return accmtr_out_blk;
+	}
+	accmtr_state.in_ptr = 0;
+
+	return NULL;
+}
+
+/*******************************************************************************
+* Function:
+*		decim_ads1282_block()
+* Description:
+*		same as decim_accmtr_block(), for ADS1282 blocks (32 bit big endian samples)
+*******************************************************************************/
+BYTE *decim_ads1282_block(BYTE *in_blk) {
+
+	const int	*h;
+	BYTE		k, idx;
+	long		x;
+	long long	y;
+
+	decim_block_enter(&ads1282_state, ads1282_out_blk, in_blk);
+	while (ads1282_state.in_ptr <= LAST_DATA_BYTE) {
+		x = (LONG)(((DWORD)in_blk[ads1282_state.in_ptr] << 24) | ((DWORD)in_blk[ads1282_state.in_ptr + 1] << 16) |
+				   ((DWORD)in_blk[ads1282_state.in_ptr + 2] << 8) | in_blk[ads1282_state.in_ptr + 3]);
+		ads1282_state.in_ptr += DECIM_ADS1282_SAMP_SIZE;
+		h = &decim_coeffs[ads1282_state.phase];
+		idx = ads1282_state.head;
+		for (k = 0; k < DECIM_TAPS_PER_PHASE; k++) {
+			ads1282_channel.acc[idx] += (long long)(*h) * x;
+			h += g_decim_factor;
+			if (++idx == DECIM_TAPS_PER_PHASE)
+				idx = 0;
+		}
+		if (ads1282_state.phase != 0) {
+			ads1282_state.phase--;
+			continue;
+		}
+		y = (ads1282_channel.acc[ads1282_state.head] + (1LL << 14)) >> 15;
+		if (y > 2147483647LL)
+			y = 2147483647LL;
+		else if (y < -2147483647LL - 1)
+			y = -2147483647LL - 1;
+		ads1282_channel.acc[ads1282_state.head] = 0;
+		if (++ads1282_state.head == DECIM_TAPS_PER_PHASE)
+			ads1282_state.head = 0;
+		ads1282_state.phase = g_decim_factor - 1;
+		ads1282_out_blk[ads1282_state.out_ptr++] = (BYTE)(y >> 24);
+		ads1282_out_blk[ads1282_state.out_ptr++] = (BYTE)(y >> 16);
+		ads1282_out_blk[ads1282_state.out_ptr++] = (BYTE)(y >> 8);
+		ads1282_out_blk[ads1282_state.out_ptr++] = (BYTE)y;
+		if (ads1282_state.out_ptr > LAST_DATA_BYTE)				// 504 is a multiple of DECIM_ADS1282_SAMP_SIZE
+			return ads1282_out_blk;
+	}
+	ads1282_state.in_ptr = 0;
+
+	return NULL;
+}
+
+/*******************************************************************************
+// decim_state_reset()
+// restart the polyphase commutator and prepare an empty output block.
+*******************************************************************************/
+static void decim_state_reset(DECIM_STATE *state, BYTE *out_blk) {
+
+	state->phase = 0;
+	state->head = 0;
+	state->in_ptr = 0;
+	decim_out_blk_reset(state, out_blk);
+}
+
+/*******************************************************************************
+// decim_out_blk_reset()
+// start a new output block: pad the tail with 'x'-s and clear its counters
+// (same as init_block_buffers() does for the sampler blocks).
+*******************************************************************************/
+static void decim_out_blk_reset(DECIM_STATE *state, BYTE *out_blk) {
+
+	int i;
+
+	for (i = (LAST_DATA_BYTE + 1); i < MAX_BLOCK_SIZE; i++)
+		out_blk[i] = 'x';
+	out_blk[RETRY_COUNTER_LOCATION] = 0;
+	out_blk[HW_OVERFLOW_LOCATION] = 0;
+	out_blk[SW_OVERFLOW_LOCATION] = 0;
+	state->out_ptr = 0;
+}
+
+/*******************************************************************************
+// decim_block_enter()
+// - start a new output block if the previous one was handed out
+// - on the first entry to an input block, fold its overflow counters into the
+//   output block tail (saturated to a BYTE)
+*******************************************************************************/
+static void decim_block_enter(DECIM_STATE *state, BYTE *out_blk, BYTE *in_blk) {
+
+	WORD sum;
+
+	if (state->out_ptr > LAST_DATA_BYTE)
+		decim_out_blk_reset(state, out_blk);
+	if (state->in_ptr != 0)
+		return;
+	sum = (WORD)out_blk[HW_OVERFLOW_LOCATION] + in_blk[HW_OVERFLOW_LOCATION];
+	out_blk[HW_OVERFLOW_LOCATION] = (sum > 0xFF) ? 0xFF : (BYTE)sum;
+	sum = (WORD)out_blk[SW_OVERFLOW_LOCATION] + in_blk[SW_OVERFLOW_LOCATION];
+	out_blk[SW_OVERFLOW_LOCATION] = (sum > 0xFF) ? 0xFF : (BYTE)sum;
+}
+
+#endif // #ifdef WISDOM_STONE
@@ -44,9 +44,12 @@ the code enables using 128 KByte EEPROM of Microchip 24FC1025-I/SM (as mentioned
 #include "error.h"			//Application
 #include "parser.h"			//Application	
 #include "system.h"			//Application	//YL for boot global vars
+#include "soft_timer.h"		//Application
 #include "eeprom.h"			//Devices 	 
 #include "i2c.h"			//Protocols	
-#include "TimeDelay.h"		//TxRx - Common
+
+/***** DEFINE: ****************************************************************/
+#define EEPROM_WRITE_CYCLE_MS	20			//need at least 20ms delay between writes
 
 /***** GLOBAL VARIABLES: ******************************************************/	
 char 	g_eeprom_buffer[EEPROM_PAGE_SIZE];	//YL 20.9 temporary buffer //YL 8.12 TODO
@@ -54,6 +57,18 @@ char 	g_eeprom_buffer[EEPROM_PAGE_SIZE];	//YL 20.9 temporary buffer //YL 8.12 TO
 /***** INTERNAL PROTOTYPES: ***************************************************/
 char* 	get_string(void);		//YL 19.9
 
+/*******************************************************************************
+// eeprom_wait_ready()
+// a write returns once the EEPROM took the data, and starts TIMER_EEPROM_WRITE
+// for its internal write cycle; the next access waits here for the rest of it
+// (if any) - so a single write does not hold the caller at all. a power-down
+// (prepare_for_shutdown) waits here too, or the last write may be lost.
+*******************************************************************************/
+void eeprom_wait_ready(void)
+{
+	soft_timer_wait(TIMER_EEPROM_WRITE);
+}
+
 /*******************************************************************************
 // eeprom_write_byte()
 // write a single data Byte into EEPROM at a given address
@@ -81,11 +96,12 @@ int eeprom_write_byte(long addr, BYTE dat)
 	data_to_write[0] = (addr >> 8) & 0x000000FF; 	//high address //YL 28.9	
 	data_to_write[1] = addr & 0x000000FF; 			//low address
 	data_to_write[2] = dat; 						//data byte
+	eeprom_wait_ready();
 	if (device_write_i2c_ert(device_addr, 3, (BYTE*)data_to_write, I2C_WRITE)){ // YL 14.4 added casting to avoid signedness warning										
 		err(ERR_EEPROM_WRITE_BYTE);					//2 error cases: EEPROM didn't ack, or failing to write after 5 trials
 		return -1;
 	}
-	DelayMs(20); 									//need at least 20ms delay between writes
+	soft_timer_start(TIMER_EEPROM_WRITE, EEPROM_WRITE_CYCLE_MS, TIMER_ONE_SHOT, NULL, NO_EVENT);
 	return 0;
 }
 
@@ -111,6 +127,7 @@ int eeprom_read_byte(long addr)
 	data_to_write[0] = (addr >> 8) & 0x000000FF;	//high address //YL 28.9	
 	data_to_write[1] = addr & 0x000000FF; 			//low address
 	// first, write the address we would like to start read from
+	eeprom_wait_ready();
 	if (device_write_i2c_ert(device_addr, 2, (BYTE*)data_to_write, I2C_READ)){ // YL 14.4 added casting to avoid signedness warning
 		err(ERR_EEPROM_WRITE_BYTE);					//EEPROM acks accepting the address by 0
 		return -1;
@@ -124,6 +141,66 @@ int eeprom_read_byte(long addr)
 	return res;
 }
 
+/*******************************************************************************
+// eeprom_write_block()
+// write len binary data Bytes into EEPROM starting with given address,
+// in a single page write (the block should not cross a page boundary)
+*******************************************************************************/
+int eeprom_write_block(long addr, BYTE* dat, int len)
+{
+	char data_to_write[EEPROM_PAGE_SIZE + 2];		//2 address bytes precede the data
+	BYTE device_addr = EEPROM_DEVICE_ADDRESS;
+	int i = 0;
+	
+#ifdef EEPROM_128K
+	BYTE block_addr = 0; 							//to allow using 128K EEPROM
+	block_addr = addr & 0x00010000;					//to get 17-th bit 
+	block_addr = block_addr << 3;					//pick upper/lower block in 128K EEPROM address space
+	device_addr = device_addr & block_addr;					
+#endif //EEPROM_128K
+	if (len <= 0 || (addr % EEPROM_PAGE_SIZE) + len > EEPROM_PAGE_SIZE || addr <= LAST_BOOT_ADDRESS)	//to avoid crossing a page, or writing the boot table
+		return err(ERR_EEPROM_WRITE_N_BYTES);
+	data_to_write[0] = (addr >> 8) & 0x000000FF; 	//high address
+	data_to_write[1] = addr & 0x000000FF; 			//low address
+	for (i = 0; i < len; i++)
+		data_to_write[i + 2] = dat[i];
+	eeprom_wait_ready();
+	if (device_write_i2c_ert(device_addr, len + 2, (BYTE*)data_to_write, I2C_WRITE))
+		return err(ERR_EEPROM_WRITE_N_BYTES);
+	soft_timer_start(TIMER_EEPROM_WRITE, EEPROM_WRITE_CYCLE_MS, TIMER_ONE_SHOT, NULL, NO_EVENT);
+	return 0;
+}
+
+/*******************************************************************************
+// eeprom_read_block()
+// read len binary data Bytes from EEPROM starting with given address
+// (unlike eeprom_read_n_bytes, nothing is displayed)
+*******************************************************************************/
+int eeprom_read_block(long addr, BYTE* dat, int len)
+{
+	char data_to_write[2];
+	BYTE device_addr = EEPROM_DEVICE_ADDRESS;
+	
+#ifdef EEPROM_128K
+	BYTE block_addr = 0; 							//to allow using 128K EEPROM
+	block_addr = addr & 0x00010000;					//to get 17-th bit
+	block_addr = block_addr << 3;					//pick upper/lower block in 128K EEPROM address space
+	device_addr = device_addr & block_addr;	
+#endif //EEPROM_128K
+	if (len <= 0 || addr + len > EEPROM_MEMORY_SIZE)	//to avoid accessing illegal addrs
+		return err(ERR_EEPROM_READ_N_BYTES);
+	data_to_write[0] = (addr >> 8) & 0x000000FF;	//high address
+	data_to_write[1] = addr & 0x000000FF; 			//low address
+	// first, write the address we would like to start read from
+	eeprom_wait_ready();
+	if (device_write_i2c_ert(device_addr, 2, (BYTE*)data_to_write, I2C_READ))
+		return err(ERR_EEPROM_READ_N_BYTES);
+	// then, read the data
+	if (device_read_i2c_ert(device_addr, len, dat, I2C_READ))
+		return err(ERR_EEPROM_READ_N_BYTES);
+	return 0;
+}
+
 #ifdef WISDOM_STONE //YL 23.4 moved to let the plug use the eeprom too
 
 /*******************************************************************************
@@ -144,6 +221,7 @@ int eeprom_format(void)
 	// was: while (i < NUM_OF_EEPROM_PAGES){
 	while (i < NUM_OF_EEPROM_PAGES - 1){
 	// ... YL 22.8
+		eeprom_wait_ready();
 		start_i2c_ert(0);
 		high_addr = ((i * EEPROM_PAGE_SIZE) >> 8) & 0x00FF; //YL 27.9 was: (i * EEPROM_PAGE_SIZE) & 0xFF00;
 		low_addr = (i * EEPROM_PAGE_SIZE) & 0x00FF;
@@ -156,7 +234,7 @@ int eeprom_format(void)
 			j++;		//next eeprom byte
 		}
 		stop_i2c_ert();
-		DelayMs(20); 	//needs at least 20ms delay between page writes
+		soft_timer_start(TIMER_EEPROM_WRITE, EEPROM_WRITE_CYCLE_MS, TIMER_ONE_SHOT, NULL, NO_EVENT);
 		i++;			//next eeprom page 
 	}
 	return 0;
@@ -190,9 +268,10 @@ int eeprom_write_n_bytes(long addr, char* dat)	//YL 17.9
 	if (dat[0] != '\0') 
 		strcpy(&data_to_write[2], dat);			//if dat string isn't empty then it is appended after 2 first address bytes (if dat string is empty, then it is meant to erase 64-bytes boot table entry) 				
 	len = EEPROM_PAGE_SIZE + 2;						//len includes 2 first address bytes, and is the same - whether the string is empty or not	
+	eeprom_wait_ready();
 	if (device_write_i2c_ert(device_addr, len, (BYTE*)data_to_write, I2C_WRITE))	// YL 14.4 added casting to avoid signedness warning						
 		return err(ERR_EEPROM_WRITE_N_BYTES);			
-	DelayMs(20); 									//need at least 20ms delay between writes
+	soft_timer_start(TIMER_EEPROM_WRITE, EEPROM_WRITE_CYCLE_MS, TIMER_ONE_SHOT, NULL, NO_EVENT);
 	
 	return 0;
 }
@@ -226,6 +305,7 @@ int eeprom_read_n_bytes(long addr, char* data_to_read, int len)	 //YL 17.9 no le
 	j = len % EEPROM_PAGE_SIZE;
 	while (i) {	 									//display all blocks of EEPROM_PAGE_SIZE (64 bytes)
 		// first, write the address we would like to start read from 
+		eeprom_wait_ready();
 		if (device_write_i2c_ert(device_addr, 2, (BYTE*)data_to_write, I2C_READ))	// YL 14.4 added casting to avoid signedness warning //there is no restriction on length, but the buffer that is used for reading is statically allocated, so before we read a new block - 2 addresses (device_addr and data_to_write) need to be sent first
 			return err(ERR_EEPROM_READ_N_BYTES);						
 		// then, read the data string
@@ -261,6 +341,7 @@ int eeprom_read_n_bytes(long addr, char* data_to_read, int len)	 //YL 17.9 no le
 	} 
 	if (j) {												//display the remaining bytes (less than EEPROM_PAGE_SIZE)
 		// first, write the address we would like to start read from
+		eeprom_wait_ready();
 		if (device_write_i2c_ert(device_addr, 2, (BYTE*)data_to_write, I2C_READ)) // YL 14.4 added casting to avoid signedness warning
 			return err(ERR_EEPROM_READ_N_BYTES);				
 		// then, read the data string
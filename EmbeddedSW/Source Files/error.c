@@ -80,6 +80,7 @@ static char *g_err_messages[] = {
 	"Invalid Mode",			
 	"Invalid Communication",			// YL 5.8 communication instead of destination 
 	"Invalid Sampler",
+	"Invalid Decimation. Must be 1, 2, 4 or 8 [wide|narrow]",
 	
 	"ACCMTR Unknown ID",		
 	"ACCMTR Register Write Failed", 		
@@ -104,6 +105,19 @@ char *get_last_error_str(void) {
 	return g_err_messages[g_error];
 }
 
+/*******************************************************************************
+* Function:
+*		get_error_str()
+* Description:
+* 		Return the error description string of the given error code
+*******************************************************************************/
+char *get_error_str(int error) {
+
+	if ((error < ERR_NONE) || (error >= ERR_MAX))
+		error = ERR_UNKNOWN;
+	return g_err_messages[error];
+}
+
 /*******************************************************************************
 * Function:
 *		err()
@@ -120,8 +134,10 @@ int err(ErrType err) {
 	// only first error matters: //YL 8.8 <- changed this to display all the errors
 	if (!g_error) {
 		g_error = err;
-		m_write(g_err_messages[g_error]);
-		write_eol();
+		if (bin_status(g_error) == FALSE) {	// the status of a binary command is sent instead of the text
+			m_write(g_err_messages[g_error]);
+			write_eol();
+		}
 		err_clear();	//YL 8.8 to reset g_error after error print
 	}
 	return -1;
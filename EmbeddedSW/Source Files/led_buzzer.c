@@ -29,10 +29,13 @@ the following functions:
 #include "system.h"
 #include "error.h"				// Application
 #include "wistone_main.h"		// Application
+#include "soft_timer.h"			// Application
 #include "HardwareProfile.h"	// Common
 #include "p24FJ256GB110.h"		// Common
 #include "ads1282.h"			// Devices
+#include "TxRx.h"				// TxRx - Application (before led_buzzer.h, for ENABLE_TIME_SYNC)
 #include "led_buzzer.h"			// Devices
+#include "SymbolTime.h"			// TxRx - Common
 
 /***** GLOBAL VARIABLES: ******************************************************/
 int g_buzz_period = 0; 			// in order to play buzzer sound at 1Khz for some period (in mSec units) set this global variable to the period
@@ -44,6 +47,11 @@ WORD_VAL g_phase_counter;
 #endif // COMMUNICATION_PLUG
 // ... YL 31.10
 
+#if defined WISDOM_STONE && defined ENABLE_TIME_SYNC
+	BOOL g_sync_locked = FALSE;		// Timer4 follows the network time
+	int	 g_sync_phase_error;		// last measured offset of the Timer4 match from the network grid [symbol ticks]
+#endif
+
 /***** DEFINES: ***************************************************************/
 #define ADS1282_FREQ	400		// external ADC desired sample frequency [Hz]
 // assume we have Fcy = 16Mhz
@@ -57,6 +65,12 @@ WORD_VAL g_phase_counter;
 //#define TIMER_4_PERIOD	((16000000 / 256) / ADS1282_FREQ / 10)
 // ... YL 24.12
 
+// Timer4 and the symbol timer count the same Fcy / 256 clock. The network grid is every
+// SYNC_GRID_PERIOD ticks of network time (a match takes PR4 + 1 counts); a phase error
+// is removed by moving a single match by at most SYNC_MAX_SLEW counts:
+#define SYNC_GRID_PERIOD	(TIMER_4_PERIOD + 1)
+#define SYNC_MAX_SLEW		8
+
 /*******************************************************************************
 // init_timer4()
 // this function initiates Timer4, used later for:
@@ -77,6 +91,62 @@ void init_timer4(void)
 	IEC1bits.T4IE = 1;
 }
 
+#if defined WISDOM_STONE && defined ENABLE_TIME_SYNC
+/*******************************************************************************
+// timer4_sync_tasks()
+// keep the Timer4 matches - and with them the ADS1282 SYNC pulses - on the
+// instants where the network time is a multiple of SYNC_GRID_PERIOD, so every
+// stone samples at the same time. called from the main loop, once per period:
+// - the local time of the last match is MiWi_TickGet() - TMR4
+// - its distance from the grid anchor modulo SYNC_GRID_PERIOD is the phase error
+// - the error is removed by moving the coming match (PR4), the ISR restores PR4
+// the grid anchor is a network time on the grid, taken at lock and then moved
+// to the grid point of each match. 2^32 is not a multiple of SYNC_GRID_PERIOD,
+// so the network time itself modulo SYNC_GRID_PERIOD would jump by 81 ticks
+// when it wraps (every ~19 hours); the difference from the anchor does not.
+// the SYNC pin (RF12) can not be mapped to an output compare, so the pulse is
+// still driven by the ISR, a constant latency after the match.
+*******************************************************************************/
+void timer4_sync_tasks(void)
+{
+	static DWORD	last_match = 0;
+	static DWORD	grid_anchor;
+	MIWI_TICK		now;
+	WORD			count;
+	DWORD			match;
+	DWORD			global;
+	int				error;
+	
+	IEC1bits.T4IE = 0;
+	count = TMR4;
+	now = MiWi_TickGet();
+	match = now.Val - count;
+	// moving the match is safe only early in the period, and once per period:
+	if ((IFS1bits.T4IF == 0) && (count < TIMER_4_PERIOD / 2) && (match != last_match)) {
+		last_match = match;
+		if (TxRx_GlobalTime(match, &global) == TRUE) {
+			if (g_sync_locked == FALSE)
+				grid_anchor = global - (global % SYNC_GRID_PERIOD);
+			error = (int)((global - grid_anchor) % SYNC_GRID_PERIOD);
+			if (error > SYNC_GRID_PERIOD / 2)
+				error -= SYNC_GRID_PERIOD;		// positive - the match came late
+			grid_anchor = global - error;		// the grid point of this match
+			g_sync_phase_error = error;
+			g_sync_locked = TRUE;
+			if (error > SYNC_MAX_SLEW)
+				error = SYNC_MAX_SLEW;
+			else if (error < -SYNC_MAX_SLEW)
+				error = -SYNC_MAX_SLEW;
+			PR4 = TIMER_4_PERIOD - error;
+		}
+		else {
+			g_sync_locked = FALSE;
+		}
+	}
+	IEC1bits.T4IE = 1;
+}
+#endif // WISDOM_STONE && ENABLE_TIME_SYNC
+
 /*******************************************************************************
 // _T4Interrupt()
 // interrupt service routine (ISR) for handling Timer4 event.
@@ -85,6 +155,7 @@ void init_timer4(void)
 // - if buzzer period is on, then toggle buzzer output (yield 400/2 Hz sound)
 // - according to mSec counter, toggle power LED indication
 // - check if power switch is pressed
+// - post EVENT_TIMER to the main loop, and count down the soft timers
 *******************************************************************************/
 void __attribute__((__interrupt__, auto_psv, __shadow__)) _T4Interrupt(void)
 {
@@ -108,6 +179,11 @@ void __attribute__((__interrupt__, auto_psv, __shadow__)) _T4Interrupt(void)
 		Nop();
 		ADS1282_SYNC_LAT = 0;	
 	}
+	#if defined WISDOM_STONE && defined ENABLE_TIME_SYNC
+		PR4 = TIMER_4_PERIOD;	// undo the correction timer4_sync_tasks() may have made to the last period
+	#endif
+	post_event(EVENT_TIMER);	// the main loop runs its periodic tasks
+	soft_timer_tick();
 
 	//===============
 	// BUZZER
@@ -66,7 +66,8 @@ char *g_cmd_names[] = {
 	"flash",
 	"ads",
 	"accmtr",	// YL 15.9
-	"app"
+	"app",
+	"txrx"
 };
 
 /*******************************************************************************
@@ -113,7 +114,9 @@ char *g_sub_cmd_names[] = {
 	"minit",
 	"gcap",			
 	"wsector",		
-	"rsector"		
+	"rsector",
+	"stats",	// txrx link statistics
+	"key"		// txrx block security key
 };
 
 /*******************************************************************************
@@ -147,6 +150,7 @@ char* g_mode_names[] = {
 	"ss",
 	"ts",
 	"ost",
+	"tee",
 	"" 		// no "idle" cmd mode parameter  
 };
 
@@ -175,6 +179,35 @@ char* g_samp_names[] = {
 	"single"
 };
 
+/*******************************************************************************
+* Table: 
+*		g_cutoff_names:
+* Description:
+*		- holds all possible OST decimator cut-off types
+*		- must be in the same order as the enum CutoffTypes
+*******************************************************************************/
+char* g_cutoff_names[] = {   
+	"wide",
+	"narrow"
+};
+
+/*******************************************************************************
+* Table: 
+*		g_name_lists:
+* Description:
+*		- holds the tables of names that a binary command refers to (see parser.h)
+*		- must be in the same order as the enum NameListTypes
+*******************************************************************************/
+NAME_LIST g_name_lists[] = {
+	{g_cmd_names,		N_COMMANDS},
+	{g_sub_cmd_names,	N_SUB_COMMANDS},
+	{g_dev_names,		N_DEVICES},
+	{g_mode_names,		N_MODES},
+	{g_comm_names,		N_COMMUNICATIONS},
+	{g_samp_names,		N_SAMPLERS},
+	{g_cutoff_names,	N_CUTOFFS}
+};
+
 /*******************************************************************************
 * Table: 
 *		default_addr:
@@ -221,6 +254,7 @@ long default_data[] = {
 /***** INTERNAL PROTOTYPES: ***************************************************/
 char*	skip_sep(char *p);
 char*	skip_token(char *p);
+void	tokenize_binary(char *msg, char *copy);
 
 /*******************************************************************************
 * Function: 	
@@ -239,6 +273,13 @@ char*	skip_token(char *p);
 void tokenize(char *msg) {
 
 	static char	msg_copy[MAX_CMD_LEN];	// YL 20.9 added copy, so g_in_msg remain unchanged; 
+#if defined ENABLE_BINARY_COMMANDS
+	if ((BYTE)msg[0] == BIN_CMD_MARK) {
+		tokenize_binary(msg, msg_copy);
+		return;
+	}
+	g_is_bin_cmd = FALSE;
+#endif
 	strcpy(msg_copy, msg);
 	char *p = msg_copy;
 
@@ -262,6 +303,84 @@ void tokenize(char *msg) {
 	return;
 }
 
+#if defined ENABLE_BINARY_COMMANDS
+/*******************************************************************************
+* Function: 	
+*		tokenize_binary()
+* Description:
+*		Point the tokens to the tokens of a binary command (see parser.h).
+* Parameters:
+*		msg - the binary command
+*		copy - the copy of the command that the tokens point to
+* Return value:
+*		None
+* Side effects:
+*		- Updates global variables: g_tokens, g_ntokens and g_is_bin_cmd
+*******************************************************************************/
+void tokenize_binary(char *msg, char *copy) {
+
+	int 	len = bin_command_len(msg, MAX_CMD_LEN);
+	char 	*p = copy + BIN_CMD_HEADER_LEN;
+
+	g_ntokens = 0;
+	g_is_bin_cmd = TRUE;
+	if (len < 0) {
+		return;
+	}
+	memcpy(copy, msg, len);
+	while ((g_ntokens < (BYTE)copy[1]) && (g_ntokens < MAX_TOKENS)) {
+		g_tokens[g_ntokens] = p;
+		g_ntokens++;
+		if (*p == BIN_ARG_NAME)
+			p += BIN_NAME_LEN;
+		else if (*p == BIN_ARG_NUM)
+			p += BIN_NUM_LEN;
+		else
+			p += strlen(p) + 1;
+	}
+}
+#endif // ENABLE_BINARY_COMMANDS
+
+/*******************************************************************************
+* Function: 	
+*		bin_command_len()
+* Description:
+*		Find the length of a binary command (see parser.h).
+* Parameters:
+*		msg - the binary command
+*		len - the number of bytes in msg
+* Return value:
+*		the length of the command, or (-1) if it is not a binary command, or
+*		it is cut
+* Side effects:
+*		None
+*******************************************************************************/
+int bin_command_len(char *msg, int len) {
+
+	int 	i = BIN_CMD_HEADER_LEN;
+	BYTE 	count;
+
+	if ((len < BIN_CMD_HEADER_LEN) || ((BYTE)msg[0] != BIN_CMD_MARK))
+		return -1;
+	if (len > MAX_CMD_LEN)
+		len = MAX_CMD_LEN;
+	for (count = msg[1]; count > 0; count--) {
+		if (i >= len)
+			return -1;
+		if (msg[i] == BIN_ARG_NAME)
+			i += BIN_NAME_LEN;
+		else if (msg[i] == BIN_ARG_NUM)
+			i += BIN_NUM_LEN;
+		else {
+			while ((i < len) && msg[i]) i++;
+			i++;	// the '\0'
+		}
+		if (i > len)
+			return -1;
+	}
+	return i;
+}
+
 /*******************************************************************************
 * Function: 	
 *		skip_sep()
@@ -321,6 +440,14 @@ long parse_long_num(char *str) {
 	long 	max_res = MAX_SIGNED_LONG / 10; 
 	char 	*p = str;
 
+#if defined ENABLE_BINARY_COMMANDS
+	if ((BYTE)*str == BIN_ARG_NUM) {	// a binary number (see parser.h)
+		DWORD value = (DWORD)(BYTE)str[1] | ((DWORD)(BYTE)str[2] << 8) | ((DWORD)(BYTE)str[3] << 16) | ((DWORD)(BYTE)str[4] << 24);
+		if (value > MAX_SIGNED_LONG) 
+			return err(ERR_NUM_TOO_BIG);
+		return (long)value;
+	}
+#endif
 	while ((*p >= '0') && (*p <= '9')) {			
 		if ((res > max_res) || ((res == max_res) && (*p > '7'))) 
 			return err(ERR_NUM_TOO_BIG);
@@ -424,6 +551,13 @@ int parse_name(char *name, char **namelist, int listlen) {
 	char 	*p1, *p2;
 	int 	i;
 
+#if defined ENABLE_BINARY_COMMANDS
+	if ((BYTE)*name == BIN_ARG_NAME) {	// a binary name (see parser.h) - of the given list or of none
+		if (((BYTE)name[1] < N_NAME_LISTS) && (g_name_lists[(BYTE)name[1]].names == namelist) && ((BYTE)name[2] < listlen))
+			return (BYTE)name[2];
+		return -1;
+	}
+#endif
 	for (i = 0; i < listlen; i++) {
 		p1 = name;
 		p2 = namelist[i];
@@ -564,6 +698,29 @@ int parse_single_dual_mode(char *name) {
 	return res;
 }
 
+/*******************************************************************************
+* Function: 	
+*		parse_cutoff()
+* Description:
+*		Look for the current cut-off type in the list of possible decimator cut-offs.
+* Parameters:
+*		name - the string we are looking for
+* Return value:
+*		the index of the string in the list if found, (-1) if not
+* Side effects:
+*		None
+*******************************************************************************/
+int parse_cutoff(char *name) {
+
+	int res = parse_name(name, g_cutoff_names, N_CUTOFFS);
+
+	if (res < 0) {
+		err_clear(); // make sure following error superseded any prev one
+		err(ERR_INVALID_DECIM);
+	}
+	return res;
+}
+
 //YL 4.8 added handle_plug_msg...
 
 //OOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOO
@@ -604,9 +761,15 @@ int handle_plug_msg(void) {
 	if ((dest < 0) || (dest > MAX_NWK_ADDR_EUI0)) {
 		return TxRx_PrintError(TXRX_NWK_UNKNOWN_ADDR);
 	}
-	if ((dest == PLUG_NWK_ADDR_EUI0) && (strcmp("reconnect", g_tokens[1]) != 0)) {		// so far - "reconnect" is the only plug command		
+	if ((dest == PLUG_OLD_NWK_ADDR_EUI0) && (strcmp("reconnect", g_tokens[1]) == 0)) {	// "3 reconnect" of hosts that knew the plug as 3 - stones have no "reconnect"
+		dest = PLUG_NWK_ADDR_EUI0;
+	}
+	if ((dest == PLUG_NWK_ADDR_EUI0) && (strcmp("reconnect", g_tokens[1]) != 0) && (strcmp("txrx", g_tokens[1]) != 0)) {		// the plug commands are "reconnect" and "txrx"
 		return cmd_error(ERR_UNKNOWN_CMD);
 	}
+	if ((dest != PLUG_NWK_ADDR_EUI0) && (g_ntokens > 2) && (strcmp("txrx", g_tokens[1]) == 0) && (strcmp("key", g_tokens[2]) == 0)) {
+		return cmd_error(ERR_INVALID_COMM);		// commands are sent in the clear - a stone takes its key from its own USB
+	}
 	if ((strcmp("app", g_tokens[1]) == 0) && (strcmp("stop", g_tokens[2]) == 0)) {		// the command is "app stop"
 		isAppStop = TRUE;
 	}
@@ -620,6 +783,115 @@ int handle_plug_msg(void) {
 	return dest;
 }
 
+#if defined ENABLE_BINARY_COMMANDS
+/*******************************************************************************
+* Function: 	
+*		bin_number()
+* Description:
+*		Parse a token that is only a number, without error prints.
+* Parameters:
+*		str - input string.
+* Return value:
+*		the number from [0 : (2^31 - 1)], or (-1) if str is not such a number
+* Side effects:
+*		None
+*******************************************************************************/
+long bin_number(char *str) {
+
+	long 	res = 0;
+	long 	max_res = MAX_SIGNED_LONG / 10; 
+	char 	*p = str;
+
+	while ((*p >= '0') && (*p <= '9')) {			
+		if ((res > max_res) || ((res == max_res) && (*p > '7'))) 
+			return -1;
+		res = res * 10 + *p - '0';
+		p++;
+	}
+	if ((p == str) || *p)
+		return -1;
+	return res;
+}
+
+/*******************************************************************************
+* Function: 	
+*		encode_command()
+* Description:
+*		Translate a stone command into its binary form (see parser.h): the 
+*		command, the sub command, and the names and the numbers among the 
+*		arguments become fixed width tokens, and the rest are copied as they
+*		are. A command that takes free text, or that is not known (the stone
+*		reports it), is left to be sent as text.
+* Parameters:
+*		msg - the command (without the destination)
+*		bin - the binary command, up to (MAX_CMD_LEN - 1) bytes
+* Return value:
+*		the length of the binary command, or 0 if the command is sent as text
+* Side effects:
+*		- tokenize() updates global variables: g_tokens and g_ntokens
+*******************************************************************************/
+int encode_command(char *msg, char *bin) {
+
+	char 	*p = bin + BIN_CMD_HEADER_LEN;
+	int 	cmd, sub_cmd, list, index, len, i;
+	long 	num = 0;
+	BYTE 	type;
+
+	tokenize(msg);
+	if ((g_ntokens < 2) || (g_ntokens > MAX_TOKENS)) 
+		return 0;
+	cmd = parse_command(g_tokens[0]);
+	sub_cmd = parse_sub_command(g_tokens[1]);
+	if ((cmd < 0) || (sub_cmd < 0) || (cmd == CMD_WRITE) || (cmd == CMD_READ) ||
+		((cmd == CMD_EEPROM) && ((sub_cmd == SUB_CMD_SBOOT) || (sub_cmd == SUB_CMD_WRITE))) ||
+		((cmd == CMD_FLASH) && (sub_cmd == SUB_CMD_WSECTOR))) 
+		return 0;
+	bin[0] = BIN_CMD_MARK;
+	bin[1] = g_ntokens;
+	for (i = 0; i < g_ntokens; i++) {
+		// the arguments are looked for in the lists of the argument names (which do not share names):
+		list = (i == 0) ? LIST_CMD : ((i == 1) ? LIST_SUB_CMD : LIST_MODE);
+		index = (i == 0) ? cmd : ((i == 1) ? sub_cmd : -1);
+		while ((index < 0) && (list < N_NAME_LISTS)) {
+			index = parse_name(g_tokens[i], g_name_lists[list].names, g_name_lists[list].len);
+			if (index < 0)
+				list++;
+		}
+		if (index >= 0) {
+			type = BIN_ARG_NAME;
+			len = BIN_NAME_LEN;
+		}
+		else if ((num = bin_number(g_tokens[i])) >= 0) {
+			type = BIN_ARG_NUM;
+			len = BIN_NUM_LEN;
+		}
+		else {
+			type = 0;
+			len = strlen(g_tokens[i]) + 1;
+		}
+		if ((p - bin) + len > MAX_CMD_LEN - 1) 
+			return 0;
+		if (type == BIN_ARG_NAME) {
+			p[0] = BIN_ARG_NAME;
+			p[1] = list;
+			p[2] = index;
+		}
+		else if (type == BIN_ARG_NUM) {
+			p[0] = BIN_ARG_NUM;
+			p[1] = num & 0xFF;
+			p[2] = (num >> 8) & 0xFF;
+			p[3] = (num >> 16) & 0xFF;
+			p[4] = (num >> 24) & 0xFF;
+		}
+		else {
+			strcpy(p, g_tokens[i]);
+		}
+		p += len;
+	}
+	return p - bin;
+}
+#endif // ENABLE_BINARY_COMMANDS
+
 #endif	//COMMUNICATION_PLUG
 
 //...YL 4.8
@@ -711,6 +983,10 @@ int handle_msg(char *msg) {	// YL TODO - make sure the command is executed only
 		handle_application(sub_cmd);	
 		break;
 
+	case CMD_TXRX:
+		handle_txrx(sub_cmd);
+		break;
+
 	default:
 		err(ERR_UNKNOWN_CMD);
 		cmd_error(0);
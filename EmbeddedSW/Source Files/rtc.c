@@ -81,8 +81,10 @@ void init_rtc(void) //YL 21.8
 			err(ERR_RTC_INIT);
 		if (device_read_i2c_ert(RTC_ADD, 1, &ctrl_reg_2[1], I2C_READ)) 
 			err(ERR_RTC_INIT);
-		if (ctrl_reg_2[1] & 0x08) 					//if #3 (AF) bit is set - the wakeup source is rtc
+		if (ctrl_reg_2[1] & 0x08) {					//if #3 (AF) bit is set - the wakeup source is rtc
 			g_rtc_wakeup = TRUE;
+			post_event(EVENT_RTC);					//the main loop starts the boot sequence
+		}
 		ctrl_reg_2[1] = ctrl_reg_2[1] & 0xF7;		//clear #3 (AF) bit
 	} 		
 	
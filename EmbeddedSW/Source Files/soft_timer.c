@@ -0,0 +1,207 @@
+/*******************************************************************************
+
+soft_timer.c - software timers on Timer4
+========================================
+
+	Revision History:
+	=================
+ ver 1.00, date: 18.10.26
+		- Initial revision
+
+********************************************************************************
+	General:
+	========
+a fixed DelayMs() holds the CPU for its whole length; nothing else runs in the
+main loop meanwhile, and the CPU can not idle.
+this file implements software timers that count the Timer4 ticks (400Hz, 2.5mSec):
+- each user owns a timer id (SoftTimerIds)
+- one-shot or periodic timers (SoftTimerModes)
+- when a timer expires it can post a main loop event (from the Timer4 ISR), and/or
+  have its callback called by soft_timer_tasks() (from the main loop)
+- soft_timer_is_running() lets a state machine return to the main loop until
+  the timer expires; soft_timer_wait() idles (Idle()) until then, for the
+  callers that can not return.
+a timer of N mSec expires after N to N + 2.5 mSec.
+the time spent in blocking delays - DelayMs() and soft_timer_wait() - is
+counted by add_blocking_delay() (reported by "sys gpower").
+Timer4 must be running (init_timer4) before a timer is started.
+*******************************************************************************/
+
+/***** INCLUDE FILES: *********************************************************/
+#include "wistone_main.h"		// Application
+#include "soft_timer.h"			// Application
+#include "Compiler.h"			// Common
+
+/***** DEFINE: ****************************************************************/
+typedef struct {
+	WORD					count;		// Timer4 ticks left until it expires
+	WORD					period;		// Timer4 ticks
+	BYTE					mode;		// SoftTimerModes
+	BYTE					event;		// EventTypes, or NO_EVENT
+	SOFT_TIMER_CALLBACK		callback;	// or NULL
+	volatile BYTE			running;
+	volatile BYTE			expired;	// the callback is due (soft_timer_tasks)
+} SOFT_TIMER;
+
+/***** GLOBAL VARIABLES: ******************************************************/
+DWORD			g_blocking_delay_ms = 0;		// the time spent in blocking delays since the start [mSec]
+SOFT_TIMER		g_soft_timers[TIMER_NUM];
+volatile DWORD	g_soft_ticks = 0;				// Timer4 ticks since the start
+
+/***** INTERNAL PROTOTYPES: ***************************************************/
+DWORD get_soft_ticks(void);
+
+/*******************************************************************************
+// soft_timer_start()
+// (re)start timer id to expire after ms mSec - once, or every ms mSec; when it
+// expires, post event (unless NO_EVENT), and call callback (unless NULL) from
+// soft_timer_tasks().
+*******************************************************************************/
+void soft_timer_start(BYTE id, WORD ms, BYTE mode, SOFT_TIMER_CALLBACK callback, BYTE event)
+{
+	SOFT_TIMER	*timer = &g_soft_timers[id];
+	WORD		ticks = ((DWORD)ms * SOFT_TIMER_TICK_HZ + 999) / 1000;
+	int			ipl;
+
+	if (ticks == 0)
+		ticks = 1;
+	SET_AND_SAVE_CPU_IPL(ipl, 7);
+	timer->count = ticks + 1;		// the current tick is partly over
+	timer->period = ticks;
+	timer->mode = mode;
+	timer->event = event;
+	timer->callback = callback;
+	timer->expired = FALSE;
+	timer->running = TRUE;
+	RESTORE_CPU_IPL(ipl);
+}
+
+/*******************************************************************************
+// soft_timer_stop()
+// stop timer id; its callback is not called.
+*******************************************************************************/
+void soft_timer_stop(BYTE id)
+{
+	int ipl;
+
+	SET_AND_SAVE_CPU_IPL(ipl, 7);
+	g_soft_timers[id].running = FALSE;
+	g_soft_timers[id].expired = FALSE;
+	RESTORE_CPU_IPL(ipl);
+}
+
+/*******************************************************************************
+// soft_timer_is_running()
+// return TRUE until timer id expires (a periodic timer runs until it is stopped).
+*******************************************************************************/
+BOOL soft_timer_is_running(BYTE id)
+{
+	return g_soft_timers[id].running;
+}
+
+/*******************************************************************************
+// soft_timer_wait()
+// idle (Idle()) until timer id expires, and count the time as a blocking delay.
+// the check and Idle() are made with the interrupts masked (see wait_for_event).
+*******************************************************************************/
+void soft_timer_wait(BYTE id)
+{
+	DWORD	start;
+	int		ipl;
+
+	if (g_soft_timers[id].running == FALSE)
+		return;
+	start = get_soft_ticks();
+	SET_AND_SAVE_CPU_IPL(ipl, 7);
+	while (g_soft_timers[id].running == TRUE) {
+		Idle();						// woken by the next Timer4 tick at the latest
+		RESTORE_CPU_IPL(ipl);		// serve the interrupt
+		SET_AND_SAVE_CPU_IPL(ipl, 7);
+	}
+	RESTORE_CPU_IPL(ipl);
+	add_blocking_delay(((get_soft_ticks() - start) * 1000) / SOFT_TIMER_TICK_HZ);
+}
+
+/*******************************************************************************
+// soft_timer_tick()
+// called by the Timer4 ISR: count down the running timers, and expire them.
+*******************************************************************************/
+void soft_timer_tick(void)
+{
+	SOFT_TIMER	*timer;
+	BYTE		i;
+
+	g_soft_ticks++;
+	for (i = 0; i < TIMER_NUM; i++) {
+		timer = &g_soft_timers[i];
+		if ((timer->running == FALSE) || (--timer->count != 0))
+			continue;
+		if (timer->mode == TIMER_PERIODIC)
+			timer->count = timer->period;
+		else
+			timer->running = FALSE;
+		if (timer->callback != NULL)
+			timer->expired = TRUE;
+		if (timer->event != NO_EVENT)
+			post_event(timer->event);
+	}
+}
+
+/*******************************************************************************
+// soft_timer_tasks()
+// called by the main loop: call the callbacks of the timers that expired.
+*******************************************************************************/
+void soft_timer_tasks(void)
+{
+	BYTE i;
+
+	for (i = 0; i < TIMER_NUM; i++) {
+		if (g_soft_timers[i].expired == TRUE) {
+			g_soft_timers[i].expired = FALSE;
+			g_soft_timers[i].callback();
+		}
+	}
+}
+
+/*******************************************************************************
+// add_blocking_delay()
+// add ms to the time spent in blocking delays (DelayMs() calls it through DelayMsHook, also from ISRs).
+*******************************************************************************/
+void add_blocking_delay(WORD ms)
+{
+	int ipl;
+
+	SET_AND_SAVE_CPU_IPL(ipl, 7);
+	g_blocking_delay_ms += ms;
+	RESTORE_CPU_IPL(ipl);
+}
+
+/*******************************************************************************
+// get_blocking_delay()
+// return the time spent in blocking delays since the start [mSec].
+*******************************************************************************/
+DWORD get_blocking_delay(void)
+{
+	DWORD	ms;
+	int		ipl;
+
+	SET_AND_SAVE_CPU_IPL(ipl, 7);
+	ms = g_blocking_delay_ms;
+	RESTORE_CPU_IPL(ipl);
+	return ms;
+}
+
+/*******************************************************************************
+// get_soft_ticks()
+// return g_soft_ticks (a DWORD is read in 2 instructions - mask Timer4 meanwhile).
+*******************************************************************************/
+DWORD get_soft_ticks(void)
+{
+	DWORD	ticks;
+	int		ipl;
+
+	SET_AND_SAVE_CPU_IPL(ipl, 7);
+	ticks = g_soft_ticks;
+	RESTORE_CPU_IPL(ipl);
+	return ticks;
+}
@@ -27,6 +27,7 @@ following are the functions for handling system commands, like get version...
 #include "error.h"							// Application	
 #include "parser.h"							// Application
 #include "system.h"							// Application
+#include "soft_timer.h"						// Application
 #include "HardwareProfile.h"				// Common
 #include "HardwareProfileRemappable.h"		// Common
 #include "misc_c.h"							// Common	//YL 19.9
@@ -46,6 +47,7 @@ following are the functions for handling system commands, like get version...
 #include "rs232.h"							// USB_UART
 #endif // #ifdef USBCOM
 #include "TxRx.h"							// TxRx - Application
+#include "MCHP_API.h"						// TxRx - Application (for MRF49XA_IsrHook)
 #include "SymbolTime.h"						// TxRx - Application
 #include "HardwareProfileTxRx.h"			// TxRx - Common	
 #include "TimeDelay.h"						// TxRx - Common	
@@ -60,10 +62,10 @@ unsigned int 	g_vbat_level;						// the voltage sampled at AN10, updated by Time
 void handle_get_error(void);
 void handle_gver();	
 void display_welcome(void);
+void post_radio_event(void);
 
-#define MAX_USB_RETRIES 1000 // YS 17.8
-//defines the time we wait for a USB connection - each retry is 2mSec long
-//For example - 1000 means we wait for 2 seconds.
+#define USB_ATTACH_TIMEOUT_MS	2000	// YS 17.8 the time we wait for a USB connection
+#define SHUTDOWN_TIMEOUT_MS		1000	// the longest time we wait for the last message to go out
 
 /*******************************************************************************
 // init_all()
@@ -71,33 +73,36 @@ void display_welcome(void);
 // used in both WISDOME_STONE and COMMUNICATION_PLUG modes
 *******************************************************************************/
 void init_all(void) {
+	MRF49XA_IsrHook = post_radio_event;	// before the transceiver interrupt is enabled (TxRx_Init)
+	DelayMsHook = add_blocking_delay;	// the time spent in blocking delays (sys gpower)
 	// remappable pins configs
 	PPS_config(); 	// YL 5.8 moved here from main of the plug and of the stone		
 	init_power();		
+	init_leds();
+	init_buzzer(); 
+	init_timer4(); 					// needed for activating power LED blink and buzzer, and for the soft timers
 #ifdef RS232COM
 	init_rs232(); 					// initialize RS232
 #elif defined USBCOM
-    long USBRetries = 0;
 	InitializeSystem(); 			// initialize USB
 	USBDeviceAttach();	
 	// wait for the USB to connect:
 	// if USB could not connect for some reason, then this is endless loop
 	// therefore, when Wistone is under ground without USB, undef USBCOM
-	while ((USBGetDeviceState() < CONFIGURED_STATE) && (USBRetries < MAX_USB_RETRIES)) {
-		USBRetries++;				// YS 17.8
-		DelayMs(2);
+	// the CPU idles meanwhile - the USB interrupt and Timer4 wake it
+	soft_timer_start(TIMER_USB_ATTACH, USB_ATTACH_TIMEOUT_MS, TIMER_ONE_SHOT, NULL, NO_EVENT);
+	while ((USBGetDeviceState() < CONFIGURED_STATE) && (soft_timer_is_running(TIMER_USB_ATTACH) == TRUE)) {
+		Idle();
 	}
-	if (USBRetries == MAX_USB_RETRIES) {
+	if (USBGetDeviceState() < CONFIGURED_STATE) {
 		g_usb_connected = FALSE; 	// YS 17.8
 		USBDisableInterrupts();
 	} 
 	else {
+		soft_timer_stop(TIMER_USB_ATTACH);
 		g_usb_connected = TRUE; 	// YS 17.8		
 	}
 #endif //#ifdef RS232COM 
-	init_leds();
-	init_buzzer(); 
-	init_timer4(); 					// needed for activating power LED blink and buzzer
 	init_i2c();						// YL 18.7 init_i2c() for the plug too - to let it read the EUI for TxRx
 #ifdef WISDOM_STONE
 	init_rtc();	
@@ -139,6 +144,15 @@ void init_all(void) {
 	return;
 }
 
+/*******************************************************************************
+// post_radio_event()
+// the transceiver interrupt hook: the main loop handles what the transceiver received
+*******************************************************************************/
+void post_radio_event(void)
+{
+	post_event(EVENT_RADIO);
+}
+
 /*******************************************************************************
 // init_power()
 // init power board related IO and their pull-ups: status and control pins.
@@ -253,8 +267,19 @@ void prepare_for_shutdown(void) //YL 18.9 moved here from app, edited 19.9
 			main();		//if alarm setting did not succeed - do not shut down (go back to main)	
 		}
 	}
+	#if defined ENABLE_FAST_REJOIN
+		TxRx_SaveNetwork();										// to rejoin the network without a scan on wakeup
+	#endif
 	m_write("shutting down... good bye.");
-	DelayMs(1000);
+	// wait for the message to go out (up to SHUTDOWN_TIMEOUT_MS), instead of a fixed delay:
+	TxRx_FlushOutput();					// m_TxRx_write collects it until the prompt
+	soft_timer_start(TIMER_SHUTDOWN, SHUTDOWN_TIMEOUT_MS, TIMER_ONE_SHOT, NULL, NO_EVENT);
+	#if defined USBCOM
+		while ((g_usb_connected == TRUE) && (USB_IsSendPending() == TRUE) && (soft_timer_is_running(TIMER_SHUTDOWN) == TRUE)) {
+			Idle();						// the USB interrupt or Timer4 wake the CPU
+		}
+	#endif // USBCOM
+	eeprom_wait_ready();				// a write (e.g. the saved network) is lost if the power is cut in its write cycle
 	PWR_SHUTDOWN = 0;	
 	while(1) {}
 }
@@ -353,7 +378,7 @@ int handle_set_id(void)
 void handle_get_power_status(void)
 {
 	// YL 29.12 ... data_to_print for more effective wireless transmissions
-	char data_to_print[200];
+	char data_to_print[240];
 	
 	// was:
 	// m_write("\tPower Status:");
@@ -431,6 +456,14 @@ void handle_get_power_status(void)
 	else
 		strcat(data_to_print, "almost empty");
 	strcat(data_to_print, "\r\n");
+	#if defined WISDOM_STONE && defined ENABLE_EVENT_LOOP
+		strcat(data_to_print, "\t\tIdle time: ");		// since the last report
+		strcat(data_to_print, int_to_str(get_idle_percent()));
+		strcat(data_to_print, "%\r\n");
+	#endif
+	strcat(data_to_print, "\t\tBlocking delays: ");			// since the start
+	strcat(data_to_print, long_to_str(get_blocking_delay()));
+	strcat(data_to_print, " mSec\r\n");
 	m_write(data_to_print);
 	// ... YL 29.10
 	return;
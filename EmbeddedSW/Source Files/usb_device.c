@@ -248,6 +248,7 @@ firmware design flexibility.
 #include "usb.h"
 #include "HardwareProfileUSB.h"
 #include "usb_device_local.h"
+#include "wistone_main.h"		// for post_event
 
 #if defined(USB_USE_MSD)
     #include "usb_function_msd.h"
@@ -678,6 +679,8 @@ void USBDeviceTasks(void)
 {
     BYTE i;
 
+    post_event(EVENT_USB);		// the main loop checks for data from the host
+
 // YL 10.9 ...
 // commented because USB_SUPPORT_OTG is not defined
 /*
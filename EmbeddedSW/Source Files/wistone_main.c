@@ -69,20 +69,25 @@ the main process of the plug transmits:
 *******************************************************************************/
 
 /***** INCLUDE FILES: *********************************************************/
+#include <string.h>
 #include "wistone_main.h"					// Application
 #include "app.h"							// Application
 #include "command.h"						// Application
 #include "system.h"							// Application	
 #include "parser.h"							// Application
+#include "soft_timer.h"						// Application
 #include "HardwareProfileRemappable.h"		// Common
 #include "misc_c.h"							// Common
 #include "p24FJ256GB110.h"					// Common
 #include "lcd.h"							// Devices
+#include "rtc.h"							// Devices
 #include "usb.h"							// USB
 #include "wistone_usb.h"					// USB
 #include "TxRx.h"							// TxRx - Application
 #include "Compiler.h"
 #include "MCHP_API.h"						// TxRx - Application
+#include "led_buzzer.h"						// Devices (after TxRx.h, for ENABLE_TIME_SYNC)
+#include "SymbolTime.h"						// TxRx - Common
 
 /***** GLOBAL CONFIGURATIONS: *************************************************/
 // Note that main clk is 20MHz (Fcy = 10MHz) //YL 32MHz, 16MHz
@@ -94,12 +99,106 @@ _CONFIG2( PLL_96MHZ_ON & IESO_OFF & FCKSM_CSDCMD & POSCMOD_HS & OSCIOFNC_OFF & F
 BYTE	g_sleep_request = 0;				// flag: "1" - need to goto_sleep
 char 	g_curr_msg[MAX_CMD_LEN]; 			// the message string received from USB port
 BOOL	g_usb_connected; 					// YS 17.8 - was usb connected successfully
+volatile BYTE g_events[EVENT_NUM];			// the events that the ISRs posted and the main loop did not take yet
 
 //OOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOO
 // Wisdom-Stone Application main loop
 #if defined WISDOM_STONE
 //OOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOO
 
+/***** GLOBAL VARIABLES: ******************************************************/
+#if defined ENABLE_EVENT_LOOP
+DWORD		g_idle_ticks = 0;				// the time that the main loop idled since g_idle_since
+MIWI_TICK	g_idle_since;
+#endif // ENABLE_EVENT_LOOP
+
+/*******************************************************************************
+//is_work_pending()
+//return TRUE if the main loop has work that no event announces:
+//TS mode (reads the FLASH) unless it pauses, a command that was received while transmitting, 
+//the boot sequence, or debug prints.
+*******************************************************************************/
+BOOL is_work_pending(void)
+{
+	if ((g_mode == MODE_TS) && (soft_timer_is_running(TIMER_TS_PAUSE) == FALSE))
+		return TRUE;
+	if (g_is_cmd_received == 1)
+		return TRUE;
+	if ((g_rtc_wakeup == TRUE) && (g_boot_seq_pause == FALSE))
+		return TRUE;
+	#ifdef DEBUG_PRINT
+		if (is_debug_pending() == TRUE)
+			return TRUE;
+	#endif // DEBUG_PRINT
+	return FALSE;
+}
+
+#if defined ENABLE_EVENT_LOOP
+/*******************************************************************************
+//take_events()
+//copy the posted events into events and clear them; the interrupts are masked
+//meanwhile, so an event that an ISR posts in between is not lost.
+*******************************************************************************/
+void take_events(BYTE *events)
+{
+	int ipl;
+	int i;
+	
+	SET_AND_SAVE_CPU_IPL(ipl, 7);
+	for (i = 0; i < EVENT_NUM; i++) {
+		events[i] = g_events[i];
+		g_events[i] = 0;
+	}
+	RESTORE_CPU_IPL(ipl);
+}
+
+/*******************************************************************************
+//wait_for_event()
+//idle (Idle()) until the next interrupt, unless an event or other work is 
+//pending. the check and Idle() are made with the interrupts masked: an enabled
+//interrupt still wakes the CPU, and is served once the IPL is restored, so an
+//event can not be posted between the check and Idle() and wait for the next one.
+//the time spent idle is added to g_idle_ticks.
+*******************************************************************************/
+void wait_for_event(void)
+{
+	int 		ipl;
+	int 		i;
+	MIWI_TICK	start;
+	
+	SET_AND_SAVE_CPU_IPL(ipl, 7);
+	for (i = 0; i < EVENT_NUM; i++) {
+		if (g_events[i])
+			break;
+	}
+	if ((i == EVENT_NUM) && (is_work_pending() == FALSE)) {
+		start = MiWi_TickGet();
+		Idle();
+		g_idle_ticks += MiWi_TickGetDiff(MiWi_TickGet(), start);
+	}
+	RESTORE_CPU_IPL(ipl);
+}
+
+/*******************************************************************************
+//get_idle_percent()
+//return the percent of the time that the main loop idled since the last call.
+*******************************************************************************/
+BYTE get_idle_percent(void)
+{
+	MIWI_TICK	now = MiWi_TickGet();
+	DWORD		total = MiWi_TickGetDiff(now, g_idle_since);
+	DWORD		percent = 0;
+	
+	if (total >= 100)
+		percent = g_idle_ticks / (total / 100);
+	if (percent > 100)
+		percent = 100;
+	g_idle_ticks = 0;
+	g_idle_since = now;
+	return (BYTE)percent;
+}
+#endif // ENABLE_EVENT_LOOP
+
 /*******************************************************************************
 //main()
 //wait for message using polling method, then handle it; execute the loop until
@@ -107,32 +206,66 @@ BOOL	g_usb_connected; 					// YS 17.8 - was usb connected successfully
 // - according to mode (if not IDLE):
 //		- SS: sample and store block in FLASH, or
 //		- TS: read from FLASH and transmit block, or
-//		- OST: sample and transmit block on-line
+//		- OST: sample and transmit block on-line, or
+//		- TEE: sample and store block in FLASH, and transmit it (decimated) on-line
 //	- handle USB periodical tasks (we use interrupt mode)
 //	- handle command (if received)
 //	- handle power maintenance
+//	- call the callbacks of the expired soft timers
 //	- refresh LCD screen
+//with ENABLE_EVENT_LOOP each pass runs only the handlers of the posted events
+//(and the pending work), and then idles until the next interrupt.
 *******************************************************************************/
 int main(void) {
 	
+	BYTE	events[EVENT_NUM];
+	
 	//YL 5.8 - moved: PPS_config(); to init_all  	//YS 17.8	// remappable pins configs
 	init_all();							// init entire system's components
+	#if defined ENABLE_EVENT_LOOP
+		g_idle_since = MiWi_TickGet();
+	#endif // ENABLE_EVENT_LOOP
 	while (!g_sleep_request) { 			// continue until "app sleep" command received
-		if (g_mode == MODE_SS)  		// Store and Sample
-			handle_SS();
-		else if (g_mode == MODE_TS) 	// Transmit Samples
+		#if defined ENABLE_EVENT_LOOP
+			take_events(events);		// the events that were posted since the last pass
+		#else
+			memset(events, 1, EVENT_NUM);	// poll all the handlers
+		#endif // ENABLE_EVENT_LOOP
+		if (events[EVENT_BLOCK_READY]) {
+			if (g_mode == MODE_SS)  		// Store and Sample
+				handle_SS();
+			else if (g_mode == MODE_OST) 	// Online Sample and Transmit
+				handle_OST();
+			else if (g_mode == MODE_TEE) 	// Sample and Store + Online Transmit
+				handle_TEE();
+		}
+		if (g_mode == MODE_TS) 			// Transmit Samples
 			handle_TS();
-		else if (g_mode == MODE_OST) 	// Online Sample and Transmit
-			handle_OST();
 	
-		exec_message_command();			// execute commands received from: USB/RX/Boot
+		if (events[EVENT_RADIO] || events[EVENT_USB] || events[EVENT_RTC] || events[EVENT_TIMER] || is_work_pending())
+			exec_message_command();		// execute commands received from: USB/RX/Boot
+		#if defined ENABLE_TIME_SYNC
+			if (events[EVENT_TIMER])
+				timer4_sync_tasks();	// keep ADS1282 SYNC on the network time
+		#endif // ENABLE_TIME_SYNC
+		if (events[EVENT_TIMER])
+			soft_timer_tasks();			// the callbacks of the expired soft timers
+		#if defined ENABLE_LOW_POWER_LISTEN
+			if ((g_mode == MODE_IDLE) && (g_usb_connected == FALSE) && (g_rtc_wakeup == FALSE)) {
+				TxRx_LowPowerListen();	// a doze cycle, until the plug wakes the stone (not during the boot sequence)
+			}
+		#endif // ENABLE_LOW_POWER_LISTEN
 		#ifdef LCD_INSTALLED
-			refresh_screen(); 			// periodically, copy screen 4 x 16 memory buffer to LCD
+			if (events[EVENT_TIMER])
+				refresh_screen(); 		// periodically, copy screen 4 x 16 memory buffer to LCD
 			//DelayMs(1);				// to be used only when nothing is activated except for the LCD
 		#endif // LCD_INSTALLED	
 		#ifdef DEBUG_PRINT	// YL 12.1
 			put_char_debug();
 		#endif // DEBUG_PRINT		
+		#if defined ENABLE_EVENT_LOOP
+			wait_for_event();			// idle until an ISR posts an event
+		#endif // ENABLE_EVENT_LOOP
 	}
 	prepare_for_shutdown();				// actions needed before going to sleep
 	return(0);							// should never get here...
@@ -170,19 +303,15 @@ int main(void) {	  //YL 21.4 int main() instead of void main()
 			// and if so - execute it; otherwise - we consider it "stone" command (including the case of illegal string) 
 			BOOL isPlugCommand = TxRx_ExecuteIfPlugCommand();
 			if (isPlugCommand == FALSE) {
-				// send the command to the stone
-				while (TxRx_SendCommand((BYTE*)g_curr_msg) != TXRX_NO_ERROR) {
-					// keep calling TxRx_Init(TRUE) 
-					// (to reset the network without resetting the data counters) 
-					// as long as TxRx_SendCommand fails to transmit the command to the stone
-					// YL 3.11 TxRx_Init(TRUE); 12.12 NOTE that the Starter STONE must call TxRx_Init too simultaneously
-				}
+				// queue the command to the stone - TxRx_PeriodTasks delivers it, and reports the result to the host
+				TxRx_QueueCommand((BYTE*)g_curr_msg);
 			}
 		}
 		// ... YL 4.8		
 	#endif // USBCOM
 	// YL handle the messages that the stone sends to the plug
 	TxRx_PeriodTasks();	// YS 25.1
+	soft_timer_tasks();	// the callbacks of the expired soft timers
 	#ifdef DEBUG_PRINT	// YL 12.1
 		put_char_debug();
 	#endif // DEBUG_PRINT	
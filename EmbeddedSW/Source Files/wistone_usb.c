@@ -483,6 +483,33 @@ void USB_SendDataToHost(void) 	// YL 5.11 the massive data flow is expected from
 }
 // ... YL 7.11
 
+/******************************************************************************
+ * Function:        BOOL USB_IsSendPending(void)
+ *
+ * PreCondition:    None
+ *
+ * Input:           None
+ *
+ * Output:          TRUE while the data that was written (USB_WriteData) did
+ *					not reach the host yet.
+ *
+ * Side Effects:    None
+ *
+ * Overview:        Performs the CDC transmission tasks, and tells whether the
+ *					transmission is still in progress. Call it until it returns
+ *					FALSE to wait for the output to go out (see prepare_for_shutdown).
+ *
+ * Note:            None
+ *****************************************************************************/
+BOOL USB_IsSendPending(void)
+{
+	if ((USBDeviceState < CONFIGURED_STATE) || (USBSuspendControl == 1)) {
+		return FALSE;			// there is nobody to take it
+	}
+	CDCTxService();
+	return (USBUSARTIsTxTrfReady() == FALSE);
+}
+
 
 // *****************************************************************************
 // ************************** USB Callback Functions ***************************